@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan
+ * @{
+ *
+ * @file
+ * @brief   GNRC LoRaWAN payload compression
+ *
+ * With @ref CONFIG_GNRC_LORAWAN_COMPRESS, the FRMPayload of uplinks sent on
+ * selected FPorts is compressed before encryption. The FPort to codec
+ * mapping is configured with @ref gnrc_lorawan_codec_set and must be the same
+ * on the application server, which decompresses the payload after decryption
+ * (e.g with the same codec functions or `sim/gnrc_lorawan_decompress.py`).
+ *
+ * The maximum payload size of the datarate applies to the compressed
+ * payload. Retransmissions send the same compressed frame.
+ *
+ * Built-in codecs:
+ *
+ * - @ref GNRC_LORAWAN_CODEC_DELTA: the payload is a sequence of little endian
+ *   signed integers of the same width (e.g periodic sensor samples). Every
+ *   value is encoded as the difference to the value `stride` positions
+ *   before (the first `stride` values as they are), zigzag encoded and
+ *   written as a varint. With `stride` set to the number of interleaved
+ *   measurements (e.g 2 for temperature, humidity, temperature, ...), slowly
+ *   changing readings take one byte each.
+ * - @ref GNRC_LORAWAN_CODEC_DICT: byte strings of a small dictionary shared by
+ *   both ends (e.g JSON keys or fixed record headers) are replaced by one
+ *   byte. Every token is either `0x80 | index` for a dictionary word or
+ *   `len - 1` followed by `len` (up to 128) literal bytes.
+ *
+ * Custom codecs only need to provide the two functions of
+ * @ref gnrc_lorawan_codec_t.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef NET_GNRC_LORAWAN_COMPRESS_H
+#define NET_GNRC_LORAWAN_COMPRESS_H
+
+#include <sys/types.h>
+
+#include "gnrc_lorawan/lorawan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief maximum stride of the delta codec
+ */
+#define GNRC_LORAWAN_CODEC_DELTA_STRIDE_MAX (8U)
+
+/**
+ * @brief maximum number of words of the dictionary codec
+ */
+#define GNRC_LORAWAN_CODEC_DICT_NUMOF_MAX (128U)
+
+/**
+ * @brief Dictionary word
+ */
+typedef struct {
+    const void *data;   /**< bytes of the word */
+    uint8_t len;        /**< length of the word */
+} gnrc_lorawan_codec_word_t;
+
+/**
+ * @brief Compression codec descriptor
+ */
+typedef struct gnrc_lorawan_codec {
+    /**
+     * @brief Compress a payload
+     *
+     * @param[in] codec the codec descriptor
+     * @param[in] in uncompressed payload
+     * @param[out] out destination buffer
+     * @param[in] max size of @p out
+     *
+     * @return size of the compressed payload
+     * @return -EMSGSIZE if the compressed payload doesn't fit in @p out
+     * @return -EINVAL if the payload can't be encoded by the codec
+     */
+    ssize_t (*compress)(const struct gnrc_lorawan_codec *codec,
+                        const iolist_t *in, uint8_t *out, size_t max);
+    /**
+     * @brief Decompress a payload
+     *
+     * @param[in] codec the codec descriptor
+     * @param[in] in compressed payload
+     * @param[in] len size of @p in
+     * @param[out] out destination buffer
+     * @param[in] max size of @p out
+     *
+     * @return size of the decompressed payload
+     * @return -EMSGSIZE if the payload doesn't fit in @p out
+     * @return -EINVAL if @p in is malformed
+     */
+    ssize_t (*decompress)(const struct gnrc_lorawan_codec *codec,
+                          const uint8_t *in, size_t len, uint8_t *out, size_t max);
+    union {
+        struct {
+            uint8_t width;      /**< width of a value in bytes (1, 2 or 4) */
+            uint8_t stride;     /**< distance to the reference value */
+        } delta;                /**< parameters of the delta codec */
+        struct {
+            const gnrc_lorawan_codec_word_t *words; /**< dictionary words */
+            uint8_t numof;      /**< number of words */
+        } dict;                 /**< parameters of the dictionary codec */
+        const void *arg;        /**< parameters of a custom codec */
+    };
+} gnrc_lorawan_codec_t;
+
+/**
+ * @brief Compress with the delta codec
+ *
+ * @see gnrc_lorawan_codec_t::compress
+ */
+ssize_t gnrc_lorawan_codec_delta_compress(const gnrc_lorawan_codec_t *codec,
+                                          const iolist_t *in, uint8_t *out, size_t max);
+
+/**
+ * @brief Decompress with the delta codec
+ *
+ * @see gnrc_lorawan_codec_t::decompress
+ */
+ssize_t gnrc_lorawan_codec_delta_decompress(const gnrc_lorawan_codec_t *codec,
+                                            const uint8_t *in, size_t len,
+                                            uint8_t *out, size_t max);
+
+/**
+ * @brief Compress with the dictionary codec
+ *
+ * @see gnrc_lorawan_codec_t::compress
+ */
+ssize_t gnrc_lorawan_codec_dict_compress(const gnrc_lorawan_codec_t *codec,
+                                         const iolist_t *in, uint8_t *out, size_t max);
+
+/**
+ * @brief Decompress with the dictionary codec
+ *
+ * @see gnrc_lorawan_codec_t::decompress
+ */
+ssize_t gnrc_lorawan_codec_dict_decompress(const gnrc_lorawan_codec_t *codec,
+                                           const uint8_t *in, size_t len,
+                                           uint8_t *out, size_t max);
+
+/**
+ * @brief Static initializer of a delta codec
+ *
+ * @param[in] w width of a value in bytes (1, 2 or 4)
+ * @param[in] s stride, up to @ref GNRC_LORAWAN_CODEC_DELTA_STRIDE_MAX
+ */
+#define GNRC_LORAWAN_CODEC_DELTA(w, s) { \
+        .compress = gnrc_lorawan_codec_delta_compress, \
+        .decompress = gnrc_lorawan_codec_delta_decompress, \
+        .delta = { .width = (w), .stride = (s) } \
+}
+
+/**
+ * @brief Static initializer of a dictionary codec
+ *
+ * @param[in] w array of @ref gnrc_lorawan_codec_word_t
+ * @param[in] n number of words, up to @ref GNRC_LORAWAN_CODEC_DICT_NUMOF_MAX
+ */
+#define GNRC_LORAWAN_CODEC_DICT(w, n) { \
+        .compress = gnrc_lorawan_codec_dict_compress, \
+        .decompress = gnrc_lorawan_codec_dict_decompress, \
+        .dict = { .words = (w), .numof = (n) } \
+}
+
+#if CONFIG_GNRC_LORAWAN_COMPRESS || defined(DOXYGEN)
+/**
+ * @brief Set the compression codec of a FPort
+ *
+ * Must not be called while the MAC is busy.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] port FPort (1 to 223)
+ * @param[in] codec codec descriptor, NULL to send the payload uncompressed.
+ *                  Must stay valid while it's in use
+ *
+ * @return 0 on success
+ * @return -EINVAL if @p port is not an application port
+ * @return -ENOMEM if @ref CONFIG_GNRC_LORAWAN_COMPRESS_PORTS ports have a
+ *         codec already
+ */
+int gnrc_lorawan_codec_set(gnrc_lorawan_t *mac, uint8_t port,
+                           const gnrc_lorawan_codec_t *codec);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_GNRC_LORAWAN_COMPRESS_H */
+/** @} */
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan
+ * @{
+ *
+ * @file
+ * @brief   GNRC LoRaWAN completion queue
+ *
+ * By default the MAC calls @ref gnrc_lorawan_mcps_confirm,
+ * @ref gnrc_lorawan_mcps_indication, @ref gnrc_lorawan_mlme_confirm and
+ * @ref gnrc_lorawan_mlme_indication from the context that handles the MAC
+ * events. With @ref CONFIG_GNRC_LORAWAN_CQ and after a call to
+ * @ref gnrc_lorawan_cq_init, confirms and indications are copied into a
+ * fixed size ring instead. The application is woken up with
+ * @ref gnrc_lorawan_cq_notify and drains all pending events in one go with
+ * @ref gnrc_lorawan_cq_drain, possibly from a different thread.
+ *
+ * Synchronous confirms (the ones returned by @ref gnrc_lorawan_mcps_request
+ * and @ref gnrc_lorawan_mlme_request) are not affected.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef NET_GNRC_LORAWAN_CQ_H
+#define NET_GNRC_LORAWAN_CQ_H
+
+#include "gnrc_lorawan/lorawan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Completion queue event types
+ */
+typedef enum {
+    GNRC_LORAWAN_CQ_MCPS_CONFIRM,       /**< MCPS confirm */
+    GNRC_LORAWAN_CQ_MCPS_INDICATION,    /**< MCPS indication */
+    GNRC_LORAWAN_CQ_MLME_CONFIRM,       /**< MLME confirm */
+    GNRC_LORAWAN_CQ_MLME_INDICATION,    /**< MLME indication */
+} gnrc_lorawan_cq_type_t;
+
+/**
+ * @brief Completion queue entry
+ */
+typedef struct gnrc_lorawan_cq_entry {
+    uint8_t type;   /**< event type (@ref gnrc_lorawan_cq_type_t) */
+    union {
+        mcps_confirm_t mcps_confirm;        /**< MCPS confirm */
+        mcps_indication_t mcps_indication;  /**< MCPS indication */
+        mlme_confirm_t mlme_confirm;        /**< MLME confirm */
+        mlme_indication_t mlme_indication;  /**< MLME indication */
+    };
+    /**
+     * @brief payload of a MCPS indication. `mcps_indication.data.pkt` points
+     *        here in drained entries
+     */
+    iolist_t pkt;
+    uint8_t payload[CONFIG_GNRC_LORAWAN_CQ_PAYLOAD_MAX]; /**< payload buffer */
+} gnrc_lorawan_cq_entry_t;
+
+/**
+ * @brief Deliver confirms and indications through a completion queue
+ *
+ * Must not be called while the MAC is busy.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] entries ring buffer. Must stay valid while the queue is in use
+ * @param[in] numof number of entries. Must be a power of two, not bigger
+ *                  than 2^15. If 0, the MAC goes back to call the confirm and
+ *                  indication functions directly
+ */
+void gnrc_lorawan_cq_init(gnrc_lorawan_t *mac, gnrc_lorawan_cq_entry_t *entries,
+                          size_t numof);
+
+/**
+ * @brief Copy and remove the oldest events of the completion queue
+ *
+ * May be called from a different context than the MAC, as long as there is
+ * only one reader.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[out] entries destination buffer
+ * @param[in] max maximum number of entries to copy
+ *
+ * @return number of copied entries
+ */
+size_t gnrc_lorawan_cq_drain(gnrc_lorawan_t *mac, gnrc_lorawan_cq_entry_t *entries,
+                             size_t max);
+
+#if CONFIG_GNRC_LORAWAN_CQ || defined(DOXYGEN)
+/**
+ * @brief Get the number of events dropped because the queue was full
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ *
+ * @return number of dropped events
+ */
+static inline uint16_t gnrc_lorawan_cq_lost(const gnrc_lorawan_t *mac)
+{
+    return mac->cq.lost;
+}
+#endif
+
+/**
+ * @brief Notify the application that an event was added to the queue
+ *
+ * Called after every event, from the context of the MAC. The application
+ * should not assume one call per drained event: a counting notification
+ * (e.g a semaphore, a thread flag or an eventfd) lets it handle several
+ * events per wake up.
+ *
+ * @note To be implemented by the user if @ref CONFIG_GNRC_LORAWAN_CQ is set
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+void gnrc_lorawan_cq_notify(gnrc_lorawan_t *mac);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_GNRC_LORAWAN_CQ_H */
+/** @} */
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan
+ * @{
+ *
+ * @file
+ * @brief   GNRC LoRaWAN Fragmented Data Block Transport (LoRaWAN TS004)
+ *
+ * Downlinks received on @ref GNRC_LORAWAN_FRAG_PORT are processed by the
+ * fragmentation layer instead of being passed to
+ * @ref gnrc_lorawan_mcps_indication. Uncoded fragments are written to storage
+ * as they arrive. Coded fragments are combined with the fragments already
+ * in storage and kept in a bounded number of rows
+ * (@ref CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY) until they recover a missing
+ * fragment, which is then written to storage too.
+ *
+ * Answers to the server are queued and announced with a
+ * @ref MLME_SCHEDULE_UPLINK indication. The application fetches them with
+ * @ref gnrc_lorawan_frag_get_answer and sends them unconfirmed on
+ * @ref GNRC_LORAWAN_FRAG_PORT.
+ *
+ * @note Only one fragmentation session can be active at a time.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef NET_GNRC_LORAWAN_FRAG_H
+#define NET_GNRC_LORAWAN_FRAG_H
+
+#include "gnrc_lorawan/lorawan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GNRC_LORAWAN_FRAG_PORT (201U)   /**< FPort of the Fragmented Data Block Transport */
+
+/**
+ * @brief Get and clear the pending fragmentation answers
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[out] buf destination buffer
+ * @param[in] len size of the destination buffer
+ *
+ * @return size of the answers
+ * @return 0 if there are no pending answers
+ * @return -ENOBUFS if the buffer is too small
+ */
+int gnrc_lorawan_frag_get_answer(gnrc_lorawan_t *mac, uint8_t *buf, size_t len);
+
+/**
+ * @brief Write a reassembled fragment to storage
+ *
+ * @note To be implemented by the user
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] offset offset of the fragment in the data block
+ * @param[in] buf fragment data
+ * @param[in] len size of the fragment
+ *
+ * @return 0 on success
+ * @return negative errno on failure
+ */
+int gnrc_lorawan_frag_write(gnrc_lorawan_t *mac, uint32_t offset,
+                            const uint8_t *buf, size_t len);
+
+/**
+ * @brief Read a fragment from storage
+ *
+ * @note To be implemented by the user
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] offset offset of the fragment in the data block
+ * @param[out] buf destination buffer
+ * @param[in] len size of the fragment
+ *
+ * @return 0 on success
+ * @return negative errno on failure
+ */
+int gnrc_lorawan_frag_read(gnrc_lorawan_t *mac, uint32_t offset,
+                           uint8_t *buf, size_t len);
+
+/**
+ * @brief Indicate that all fragments of a session are in storage
+ *
+ * @note To be implemented by the user
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] size size of the data block (without padding)
+ * @param[in] descriptor descriptor of the session
+ */
+void gnrc_lorawan_frag_done(gnrc_lorawan_t *mac, uint32_t size,
+                            uint32_t descriptor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_GNRC_LORAWAN_FRAG_H */
+/** @} */
@@ -35,6 +35,10 @@ extern "C" {
 #include "errno.h"
 
 #define GNRC_LORAWAN_MAX_CHANNELS (16U)                 /**< Maximum number of channels */
+#define GNRC_LORAWAN_DATARATES_NUMOF (6U)               /**< Number of datarates in the current region */
+#define GNRC_LORAWAN_BANDS_NUMOF (6U)                   /**< Number of duty cycle bands in the current region */
+#define GNRC_LORAWAN_CHANNEL_SIZE (3U)                  /**< size of a packed channel frequency */
+#define GNRC_LORAWAN_CHANNEL_STEP (100U)                /**< resolution of a packed channel frequency in Hz */
 #define GNRC_LORAWAN_BACKOFF_WINDOW_TICK (3600000000LL) /**< backoff expire tick in usecs (set to 1 second) */
 
 
@@ -55,6 +59,345 @@ extern "C" {
 #define CONFIG_GNRC_LORAWAN_MIN_SYMBOLS_TIMEOUT 50
 #endif
 
+/**
+ * @brief enable MAC statistics counters (see @ref MIB_STATS)
+ *
+ * When disabled, the counters are removed from the MAC descriptor and all
+ * increments compile to nothing.
+ */
+#ifndef CONFIG_GNRC_LORAWAN_STATS
+#define CONFIG_GNRC_LORAWAN_STATS 0
+#endif
+
+/**
+ * @brief enable the binary MAC event trace (see @ref gnrc_lorawan_trace_drain)
+ *
+ * Requires @ref gnrc_lorawan_timer_now. When disabled, the trace ring is
+ * removed from the MAC descriptor and all trace points compile to nothing.
+ */
+#ifndef CONFIG_GNRC_LORAWAN_TRACE
+#define CONFIG_GNRC_LORAWAN_TRACE 0
+#endif
+
+/**
+ * @brief number of entries of the MAC event trace. Must be a power of two.
+ */
+#ifndef CONFIG_GNRC_LORAWAN_TRACE_SIZE
+#define CONFIG_GNRC_LORAWAN_TRACE_SIZE 32
+#endif
+
+#if CONFIG_GNRC_LORAWAN_TRACE
+#if (CONFIG_GNRC_LORAWAN_TRACE_SIZE & (CONFIG_GNRC_LORAWAN_TRACE_SIZE - 1)) || \
+    (CONFIG_GNRC_LORAWAN_TRACE_SIZE > 0x8000)
+#error "CONFIG_GNRC_LORAWAN_TRACE_SIZE must be a power of two not above 0x8000"
+#endif
+#include <stdatomic.h>
+#endif
+
+/**
+ * @brief enable radio energy accounting (see @ref MIB_ENERGY)
+ *
+ * Requires @ref gnrc_lorawan_timer_now. When disabled, the accounting state
+ * is removed from the MAC descriptor and compiles to nothing.
+ *
+ * @note The MAC has no TX power setting, so every transmission is accounted
+ *       with the single TX current of the profile
+ *       (@ref gnrc_lorawan_energy_profile_t::tx_ua).
+ */
+#ifndef CONFIG_GNRC_LORAWAN_ENERGY
+#define CONFIG_GNRC_LORAWAN_ENERGY 0
+#endif
+
+/**
+ * @brief enable the duty cycle bookkeeping of the regional bands
+ *
+ * Retransmissions and automatic uplinks wait until a band has duty cycle
+ * budget, and channels of bands with budget are preferred. Requires
+ * @ref gnrc_lorawan_timer_now, so it's only enabled by default if the MAC
+ * provides the hook (with xtimer or ztimer). Ports with their own clock
+ * enable it explicitly.
+ */
+#ifndef CONFIG_GNRC_LORAWAN_DUTY_CYCLE
+#if defined(MODULE_XTIMER) || defined(MODULE_ZTIMER_USEC)
+#define CONFIG_GNRC_LORAWAN_DUTY_CYCLE 1
+#else
+#define CONFIG_GNRC_LORAWAN_DUTY_CYCLE 0
+#endif
+#endif
+
+/**
+ * @brief maximum size of the MAC descriptor in bytes. The build fails if
+ *        @ref gnrc_lorawan_t gets bigger. 0 disables the check
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIZE_MAX
+#define CONFIG_GNRC_LORAWAN_SIZE_MAX 0
+#endif
+
+/**
+ * @brief enable the Fragmented Data Block Transport (LoRaWAN TS004) on
+ *        @ref GNRC_LORAWAN_FRAG_PORT (see gnrc_lorawan/frag.h)
+ */
+#ifndef CONFIG_GNRC_LORAWAN_FRAG
+#define CONFIG_GNRC_LORAWAN_FRAG 0
+#endif
+
+/**
+ * @brief maximum number of fragments of a fragmentation session
+ */
+#ifndef CONFIG_GNRC_LORAWAN_FRAG_MAX_NB
+#define CONFIG_GNRC_LORAWAN_FRAG_MAX_NB 256
+#endif
+
+/**
+ * @brief maximum size of a fragment
+ */
+#ifndef CONFIG_GNRC_LORAWAN_FRAG_MAX_SIZE
+#define CONFIG_GNRC_LORAWAN_FRAG_MAX_SIZE 48
+#endif
+
+/**
+ * @brief maximum number of coded fragments kept for the recovery of missing
+ *        fragments. Each one takes CONFIG_GNRC_LORAWAN_FRAG_MAX_NB / 8 +
+ *        CONFIG_GNRC_LORAWAN_FRAG_MAX_SIZE bytes.
+ */
+#ifndef CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY
+#define CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY 8
+#endif
+
+/**
+ * @brief enable channel access with Listen Before Talk or Channel Activity
+ *        Detection before every transmission (see @ref gnrc_lorawan_radio_cca)
+ */
+#ifndef CONFIG_GNRC_LORAWAN_LBT
+#define CONFIG_GNRC_LORAWAN_LBT 0
+#endif
+
+/**
+ * @brief number of channels checked before a transmission is deferred
+ */
+#ifndef CONFIG_GNRC_LORAWAN_LBT_CHANNELS_MAX
+#define CONFIG_GNRC_LORAWAN_LBT_CHANNELS_MAX 3
+#endif
+
+/**
+ * @brief number of times a transmission is deferred before it's given up
+ */
+#ifndef CONFIG_GNRC_LORAWAN_LBT_DEFER_MAX
+#define CONFIG_GNRC_LORAWAN_LBT_DEFER_MAX 4
+#endif
+
+/**
+ * @brief maximum random backoff of a deferred transmission in ms. It grows
+ *        linearly with the number of deferrals
+ */
+#ifndef CONFIG_GNRC_LORAWAN_LBT_BACKOFF
+#define CONFIG_GNRC_LORAWAN_LBT_BACKOFF 500
+#endif
+
+/**
+ * @brief enable delivery of confirms and indications through a completion
+ *        queue (see @ref gnrc_lorawan_cq_init)
+ */
+#ifndef CONFIG_GNRC_LORAWAN_CQ
+#define CONFIG_GNRC_LORAWAN_CQ 0
+#endif
+
+/**
+ * @brief maximum MCPS indication payload stored in a completion queue entry.
+ *        Longer downlinks are dropped and counted as lost
+ */
+#ifndef CONFIG_GNRC_LORAWAN_CQ_PAYLOAD_MAX
+#define CONFIG_GNRC_LORAWAN_CQ_PAYLOAD_MAX 242
+#endif
+
+#if CONFIG_GNRC_LORAWAN_CQ
+#include <stdatomic.h>
+#endif
+
+/**
+ * @brief enable payload compression before encryption on selected FPorts
+ *        (see @ref gnrc_lorawan_codec_set)
+ */
+#ifndef CONFIG_GNRC_LORAWAN_COMPRESS
+#define CONFIG_GNRC_LORAWAN_COMPRESS 0
+#endif
+
+/**
+ * @brief maximum number of FPorts with a compression codec
+ */
+#ifndef CONFIG_GNRC_LORAWAN_COMPRESS_PORTS
+#define CONFIG_GNRC_LORAWAN_COMPRESS_PORTS 2
+#endif
+
+/**
+ * @brief split MCPS requests larger than the maximum payload of the datarate
+ *        into several uplinks instead of rejecting them
+ *
+ * Every fragment starts with a @ref GNRC_LORAWAN_UPLINK_FRAG_HDR_SIZE bytes
+ * big endian header: a 3 bit transfer counter, a flag set on the last
+ * fragment and a 12 bit fragment index. Fragments are sent one after the
+ * other on the FPort of the request, as soon as a band has duty cycle budget.
+ * The request completes with a single MCPS confirm once the last fragment was
+ * sent (or acknowledged), or when a fragment fails. The MAC stays busy for the
+ * whole transfer and a MLME_RESET cancels it with status -ECANCELED.
+ *
+ * @note The MAC reads the fragments from the payload of the request, which
+ *       must stay valid until the MCPS confirm.
+ */
+#ifndef CONFIG_GNRC_LORAWAN_UPLINK_FRAG
+#define CONFIG_GNRC_LORAWAN_UPLINK_FRAG 0
+#endif
+
+/**
+ * @brief maximum payload size of a fragmented MCPS request
+ */
+#ifndef CONFIG_GNRC_LORAWAN_UPLINK_FRAG_SIZE_MAX
+#define CONFIG_GNRC_LORAWAN_UPLINK_FRAG_SIZE_MAX 4096
+#endif
+
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG_SIZE_MAX > 0xFFFF
+#error "CONFIG_GNRC_LORAWAN_UPLINK_FRAG_SIZE_MAX must not be above 0xFFFF"
+#endif
+
+/**
+ * @brief generate the keystream of a FRMPayload with
+ *        @ref gnrc_lorawan_aes128_encrypt_blocks instead of one call to
+ *        @ref gnrc_lorawan_aes128_encrypt per block. Lets crypto backends
+ *        pipeline independent blocks (e.g AES-NI)
+ */
+#ifndef CONFIG_GNRC_LORAWAN_AES128_BLOCKS
+#define CONFIG_GNRC_LORAWAN_AES128_BLOCKS 0
+#endif
+
+/**
+ * @brief maximum number of blocks passed to
+ *        @ref gnrc_lorawan_aes128_encrypt_blocks at once
+ */
+#ifndef CONFIG_GNRC_LORAWAN_AES128_BLOCKS_MAX
+#define CONFIG_GNRC_LORAWAN_AES128_BLOCKS_MAX 8
+#endif
+
+/**
+ * @brief maximum Time on Air of an uplink in ms, 0 for no limit.
+ *
+ * Set to 400 in regions with an uplink dwell time limit (e.g AS923 or
+ * US915). Datarates are only used for payloads that fit in the limit.
+ */
+#ifndef CONFIG_GNRC_LORAWAN_DWELL_TIME_MAX
+#define CONFIG_GNRC_LORAWAN_DWELL_TIME_MAX 0
+#endif
+
+/**
+ * @brief link margin in dB required by @ref GNRC_LORAWAN_DR_AUTO over the
+ *        demodulation floor of a datarate
+ */
+#ifndef CONFIG_GNRC_LORAWAN_AUTO_DR_MARGIN
+#define CONFIG_GNRC_LORAWAN_AUTO_DR_MARGIN 10
+#endif
+
+/**
+ * @brief keep an exponentially weighted estimate of the RSSI and SNR of the
+ *        downlinks received on every channel (see @ref gnrc_lorawan_link_get)
+ */
+#ifndef CONFIG_GNRC_LORAWAN_LINK_QUALITY
+#define CONFIG_GNRC_LORAWAN_LINK_QUALITY 0
+#endif
+
+/**
+ * @brief weight of a new sample in the link quality estimate, as a power of
+ *        two (3 weights every sample with 1/8)
+ */
+#ifndef CONFIG_GNRC_LORAWAN_LINK_QUALITY_SHIFT
+#define CONFIG_GNRC_LORAWAN_LINK_QUALITY_SHIFT 3
+#endif
+
+/**
+ * @brief precompute the AES keystream of the next uplink and of the expected
+ *        downlink while the MAC waits for the reception windows
+ */
+#ifndef CONFIG_GNRC_LORAWAN_KEYSTREAM
+#define CONFIG_GNRC_LORAWAN_KEYSTREAM 0
+#endif
+
+/**
+ * @brief number of 16 byte keystream blocks precomputed per direction.
+ *        Longer payloads compute the remaining blocks on demand
+ */
+#ifndef CONFIG_GNRC_LORAWAN_KEYSTREAM_BLOCKS
+#define CONFIG_GNRC_LORAWAN_KEYSTREAM_BLOCKS 4
+#endif
+
+/**
+ * @brief multiplex the timers of the MAC and of the application onto the
+ *        timer hooks with a hierarchical timer wheel (see
+ *        @ref gnrc_lorawan/wheel.h)
+ */
+#ifndef CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+#define CONFIG_GNRC_LORAWAN_TIMER_WHEEL 0
+#endif
+
+/**
+ * @brief number of levels of the timer wheel
+ */
+#ifndef CONFIG_GNRC_LORAWAN_TIMER_WHEEL_LEVELS
+#define CONFIG_GNRC_LORAWAN_TIMER_WHEEL_LEVELS 6
+#endif
+
+/**
+ * @brief slots per level of the timer wheel, as a power of two (at most 5).
+ *        The wheel covers delays of up to 2^(levels * bits) ms
+ */
+#ifndef CONFIG_GNRC_LORAWAN_TIMER_WHEEL_BITS
+#define CONFIG_GNRC_LORAWAN_TIMER_WHEEL_BITS 4
+#endif
+
+/**
+ * @brief send uplinks without FRMPayload on behalf of the application
+ *        (see @ref MIB_DRAIN_POLICY)
+ *
+ * Depending on the policy, the MAC answers a downlink with the FPending bit
+ * and the ACK requested by a confirmed downlink itself. The uplink carries
+ * only the pending MAC commands. It is sent once the transaction ended and a
+ * band has duty cycle budget, without a MCPS confirm. The MAC stays busy
+ * until the last automatic uplink ended. Clearing the policy or a MLME_RESET
+ * cancels a scheduled automatic uplink.
+ */
+#ifndef CONFIG_GNRC_LORAWAN_DRAIN
+#define CONFIG_GNRC_LORAWAN_DRAIN 0
+#endif
+
+/**
+ * @brief maximum number of consecutive automatic uplinks. The MAC falls
+ *        back to @ref MLME_SCHEDULE_UPLINK after that
+ */
+#ifndef CONFIG_GNRC_LORAWAN_DRAIN_MAX
+#define CONFIG_GNRC_LORAWAN_DRAIN_MAX 32
+#endif
+
+#if CONFIG_GNRC_LORAWAN_DRAIN_MAX > 0xFF
+#error "CONFIG_GNRC_LORAWAN_DRAIN_MAX must not be above 0xFF"
+#endif
+
+#define GNRC_LORAWAN_UPLINK_FRAG_HDR_SIZE (2U)          /**< size of the uplink fragment header */
+#define GNRC_LORAWAN_UPLINK_FRAG_LAST (0x1000U)         /**< last fragment flag of the uplink fragment header */
+#define GNRC_LORAWAN_UPLINK_FRAG_INDEX_MASK (0x0FFFU)   /**< fragment index mask of the uplink fragment header */
+#define GNRC_LORAWAN_UPLINK_FRAG_SESSION_POS (13U)      /**< transfer counter position of the uplink fragment header */
+
+#define GNRC_LORAWAN_DRAIN_FPENDING (0x01U)             /**< answer downlinks with the FPending bit */
+#define GNRC_LORAWAN_DRAIN_ACK      (0x02U)             /**< deliver the ACK of confirmed downlinks */
+
+/**
+ * @brief Let the MAC choose the datarate of a MCPS request
+ *
+ * The MAC picks the fastest datarate that fits the payload (within
+ * @ref CONFIG_GNRC_LORAWAN_DWELL_TIME_MAX) and, with
+ * @ref CONFIG_GNRC_LORAWAN_LINK_QUALITY, leaves
+ * @ref CONFIG_GNRC_LORAWAN_AUTO_DR_MARGIN dB over the demodulation floor for
+ * the weakest channel estimate. If no datarate has enough margin, the most
+ * robust one that fits is used. Compressed payloads are sized uncompressed.
+ */
+#define GNRC_LORAWAN_DR_AUTO (0xFFU)
+
 #define GNRC_LORAWAN_REQ_STATUS_SUCCESS (0)     /**< MLME or MCPS request successful status */
 #define GNRC_LORAWAN_REQ_STATUS_DEFERRED (1)    /**< the MLME or MCPS confirm message is asynchronous */
 
@@ -83,51 +426,362 @@ typedef struct {
 typedef struct {
     iolist_t *pkt;    /**< packet of the request */
     uint8_t port;           /**< port of the request */
-    uint8_t dr;             /**< datarate of the request */
+    uint8_t dr;             /**< datarate of the request or @ref GNRC_LORAWAN_DR_AUTO */
 } mcps_data_t;
 
+/**
+ * @brief MAC statistics counters
+ */
+typedef struct {
+    uint32_t uplinks;           /**< number of MCPS uplink requests sent */
+    uint32_t retransmissions;   /**< number of retransmissions of confirmed uplinks */
+    uint32_t join_attempts;     /**< number of Join Requests sent */
+    uint32_t rx1;               /**< valid frames received in the first reception window */
+    uint32_t rx2;               /**< valid frames received in the second reception window */
+    uint32_t no_rx;             /**< transmissions without any reception */
+    uint32_t mic_failures;      /**< downlinks or Join Accepts dropped due to invalid MIC */
+    uint32_t fcnt_drops;        /**< downlinks dropped due to a frame counter out of window */
+    uint32_t addr_drops;        /**< downlinks dropped due to foreign device address */
+    uint32_t cca_clear;         /**< channel access checks that found a clear channel */
+    uint32_t cca_busy;          /**< channel access checks that found a busy channel */
+    uint32_t tx_deferred;       /**< transmissions deferred because all checked channels were busy */
+    uint32_t tx_aborted;        /**< transmissions given up after @ref CONFIG_GNRC_LORAWAN_LBT_DEFER_MAX deferrals */
+    uint32_t drain_uplinks;     /**< automatic uplinks sent with @ref CONFIG_GNRC_LORAWAN_DRAIN */
+    uint32_t toa_dr[GNRC_LORAWAN_DATARATES_NUMOF];  /**< cumulative Time on Air per datarate (in ms) */
+    uint32_t toa_channel[GNRC_LORAWAN_MAX_CHANNELS];/**< cumulative Time on Air per channel (in ms) */
+} gnrc_lorawan_stats_t;
+
+/**
+ * @brief MAC event trace identifiers
+ */
+typedef enum {
+    GNRC_LORAWAN_TRACE_STATE,           /**< state change. arg0: old state, arg1: new state */
+    GNRC_LORAWAN_TRACE_TIMER_SET,       /**< timer armed. arg0: state, arg1: timeout in ms */
+    GNRC_LORAWAN_TRACE_TIMER_STOP,      /**< timer stopped. arg0: state */
+    GNRC_LORAWAN_TRACE_RADIO_SEND,      /**< radio send. arg0: datarate, arg1: frame length */
+    GNRC_LORAWAN_TRACE_RADIO_RX_ON,     /**< radio RX on. arg0: state */
+    GNRC_LORAWAN_TRACE_RADIO_SLEEP,     /**< radio sleep. arg0: state */
+    GNRC_LORAWAN_TRACE_MCPS_CONFIRM,    /**< MCPS confirm. arg0: type, arg1: status */
+    GNRC_LORAWAN_TRACE_MCPS_INDICATION, /**< MCPS indication. arg0: port, arg1: length */
+    GNRC_LORAWAN_TRACE_MLME_CONFIRM,    /**< MLME confirm. arg0: type, arg1: status */
+    GNRC_LORAWAN_TRACE_MLME_INDICATION, /**< MLME indication. arg0: type */
+    GNRC_LORAWAN_TRACE_CCA,             /**< channel access check. arg0: channel, arg1: clear */
+} gnrc_lorawan_trace_event_t;
+
+/**
+ * @brief MAC event trace entry
+ */
+typedef struct {
+    uint32_t timestamp;     /**< timestamp from @ref gnrc_lorawan_timer_now */
+    uint8_t event;          /**< event identifier (@ref gnrc_lorawan_trace_event_t) */
+    uint8_t arg0;           /**< first argument of the event */
+    uint16_t arg1;          /**< second argument of the event */
+} gnrc_lorawan_trace_entry_t;
+
+#if CONFIG_GNRC_LORAWAN_TRACE || defined(DOXYGEN)
+/**
+ * @brief MAC event trace ring
+ *
+ * The MAC is the only writer of `head` and the reader (@ref
+ * gnrc_lorawan_trace_drain) the only writer of `tail`, so recording never
+ * takes a lock. When the ring is full, new events are dropped and counted.
+ */
+typedef struct {
+    gnrc_lorawan_trace_entry_t entries[CONFIG_GNRC_LORAWAN_TRACE_SIZE]; /**< trace entries */
+    atomic_uint_least16_t head; /**< free running write index */
+    atomic_uint_least16_t tail; /**< free running read index */
+    uint16_t lost;              /**< number of events dropped because the ring was full */
+} gnrc_lorawan_trace_t;
+#endif
+
+/**
+ * @brief Radio current profile used for energy accounting
+ *
+ * The radio is assumed to transmit at a fixed power. Set
+ * @ref MIB_ENERGY_PROFILE again with another `tx_ua` if the port changes it.
+ */
+typedef struct {
+    uint16_t voltage_mv;    /**< supply voltage (in mV) */
+    uint32_t tx_ua;         /**< current while transmitting at the fixed TX power of the radio (in uA) */
+    uint32_t rx_ua;         /**< current while listening (in uA) */
+    uint32_t sleep_ua;      /**< current while sleeping (in uA) */
+} gnrc_lorawan_energy_profile_t;
+
+/**
+ * @brief Radio energy counters (all values in nJ)
+ */
+typedef struct {
+    uint64_t tx;            /**< cumulative energy spent transmitting */
+    uint64_t rx;            /**< cumulative energy spent in reception windows */
+    uint64_t sleep;         /**< cumulative energy spent sleeping */
+    uint64_t transaction;   /**< TX and RX energy of the current (or last) MCPS or Join request */
+} gnrc_lorawan_energy_t;
+
+#if CONFIG_GNRC_LORAWAN_ENERGY || defined(DOXYGEN)
+/**
+ * @brief Radio energy accounting state
+ */
+typedef struct {
+    gnrc_lorawan_energy_t counters;                 /**< energy counters */
+    const gnrc_lorawan_energy_profile_t *profile;   /**< radio current profile */
+    uint32_t since;                                 /**< timestamp of the last radio mode change */
+    uint8_t mode;                                   /**< current radio mode */
+} gnrc_lorawan_energy_state_t;
+#endif
+
+#if CONFIG_GNRC_LORAWAN_FRAG || defined(DOXYGEN)
+#define GNRC_LORAWAN_FRAG_BITMAP_SIZE ((CONFIG_GNRC_LORAWAN_FRAG_MAX_NB + 7) / 8) /**< size of a fragment bitmap */
+#define GNRC_LORAWAN_FRAG_ANS_MAX (16U)     /**< maximum size of pending fragmentation answers */
+
+/**
+ * @brief Linear combination of missing fragments
+ */
+typedef struct {
+    uint8_t frags[GNRC_LORAWAN_FRAG_BITMAP_SIZE];   /**< fragments in the combination */
+    uint8_t data[CONFIG_GNRC_LORAWAN_FRAG_MAX_SIZE];/**< XOR of the fragments */
+} gnrc_lorawan_frag_row_t;
+
+/**
+ * @brief Fragmentation session
+ */
+typedef struct {
+    /**
+     * @brief coded fragments in reduced row echelon form. The extra row is
+     *        used to reduce incoming coded fragments
+     */
+    gnrc_lorawan_frag_row_t rows[CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY + 1];
+    uint8_t known[GNRC_LORAWAN_FRAG_BITMAP_SIZE];   /**< received or recovered fragments */
+    uint32_t descriptor;    /**< session descriptor */
+    uint16_t nb_frag;       /**< number of uncoded fragments */
+    uint16_t nb_received;   /**< number of received fragments (coded or uncoded) */
+    uint16_t nb_known;      /**< number of received or recovered fragments */
+    uint8_t frag_size;      /**< size of a fragment */
+    uint8_t padding;        /**< padding of the last fragment */
+    uint8_t index;          /**< FragIndex of the session */
+    uint8_t num_rows;       /**< number of rows in use */
+    uint8_t flags;          /**< session flags */
+    uint8_t ans_len;        /**< length of pending answers */
+    uint8_t ans[GNRC_LORAWAN_FRAG_ANS_MAX]; /**< pending answers */
+} gnrc_lorawan_frag_t;
+#endif
+
+#if CONFIG_GNRC_LORAWAN_CQ || defined(DOXYGEN)
+struct gnrc_lorawan_cq_entry;
+
+/**
+ * @brief Completion queue ring
+ *
+ * Same scheme as the event trace: the MAC is the only writer of `head` and
+ * the reader (@ref gnrc_lorawan_cq_drain) the only writer of `tail`.
+ */
+typedef struct {
+    struct gnrc_lorawan_cq_entry *entries;  /**< entries provided with @ref gnrc_lorawan_cq_init */
+    uint16_t mask;              /**< number of entries minus one */
+    atomic_uint_least16_t head; /**< free running write index */
+    atomic_uint_least16_t tail; /**< free running read index */
+    uint16_t lost;              /**< number of events dropped because the ring was full */
+} gnrc_lorawan_cq_t;
+#endif
+
+#if CONFIG_GNRC_LORAWAN_COMPRESS || defined(DOXYGEN)
+struct gnrc_lorawan_codec;
+
+/**
+ * @brief Compression codec of a FPort
+ */
+typedef struct {
+    const struct gnrc_lorawan_codec *codec; /**< codec, NULL if the slot is free */
+    uint8_t port;                           /**< FPort */
+} gnrc_lorawan_codec_slot_t;
+#endif
+
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG || defined(DOXYGEN)
+/**
+ * @brief Fragmented uplink transfer
+ */
+typedef struct {
+    const iolist_t *pkt;    /**< payload of the transfer, NULL if there's none */
+    uint16_t size;          /**< size of the payload */
+    uint16_t offset;        /**< offset of the next fragment */
+    uint16_t index;         /**< index of the next fragment */
+    uint8_t attempts;       /**< transmissions of all fragments so far */
+    uint8_t port;           /**< FPort of the transfer */
+    uint8_t dr;             /**< datarate of the transfer */
+    uint8_t session : 3;    /**< transfer counter */
+    uint8_t confirmed : 1;  /**< whether fragments are sent as confirmed uplinks */
+} gnrc_lorawan_uplink_frag_t;
+#endif
+
+#if CONFIG_GNRC_LORAWAN_DRAIN || defined(DOXYGEN)
+/**
+ * @brief Automatic uplinks
+ */
+typedef struct {
+    uint8_t policy;         /**< GNRC_LORAWAN_DRAIN_* flags */
+    uint8_t count;          /**< consecutive automatic uplinks */
+    uint8_t pending : 1;    /**< the last downlink had the FPending bit */
+    uint8_t active : 1;     /**< the scheduled or current uplink is automatic */
+} gnrc_lorawan_drain_t;
+#endif
+
+#if CONFIG_GNRC_LORAWAN_KEYSTREAM || defined(DOXYGEN)
+/**
+ * @brief Precomputed FRMPayload keystream of one direction
+ */
+typedef struct {
+    uint8_t blocks[CONFIG_GNRC_LORAWAN_KEYSTREAM_BLOCKS * 16]; /**< keystream */
+    uint8_t key[16];        /**< key used to compute the keystream */
+    le_uint32_t dev_addr;   /**< device address of the frame */
+    uint32_t fcnt;          /**< frame counter of the frame */
+    uint8_t valid;          /**< true if the keystream wasn't used yet */
+} gnrc_lorawan_keystream_t;
+#endif
+
+#if CONFIG_GNRC_LORAWAN_LINK_QUALITY || defined(DOXYGEN)
+/**
+ * @brief index of the link quality estimate of the RX2 frequency
+ */
+#define GNRC_LORAWAN_LINK_RX2 (GNRC_LORAWAN_MAX_CHANNELS)
+
+/**
+ * @brief Link quality estimate of a channel
+ */
+typedef struct {
+    int16_t rssi;       /**< RSSI estimate in 1/16 dBm */
+    int16_t snr;        /**< SNR estimate in 1/16 dB */
+    uint16_t count;     /**< number of samples (saturates at UINT16_MAX) */
+    uint32_t last;      /**< timestamp of the last sample */
+} gnrc_lorawan_link_t;
+#endif
+
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL || defined(DOXYGEN)
+#define GNRC_LORAWAN_WHEEL_SLOTS (1U << CONFIG_GNRC_LORAWAN_TIMER_WHEEL_BITS) /**< slots per level */
+
+/**
+ * @brief Logical timer of the timer wheel
+ */
+typedef struct gnrc_lorawan_timer {
+    struct gnrc_lorawan_timer *next;    /**< next timer of the slot */
+    struct gnrc_lorawan_timer **prev;   /**< link to this timer, NULL if not armed */
+    void (*cb)(struct gnrc_lorawan_timer *timer);   /**< expiry callback */
+    void *arg;                          /**< argument of the callback */
+    uint32_t expiry;                    /**< expiry on the clock of the wheel in ms */
+    uint8_t level;                      /**< level of the slot */
+    uint8_t slot;                       /**< index of the slot */
+} gnrc_lorawan_timer_t;
+
+/**
+ * @brief Hierarchical timer wheel
+ *
+ * Level n has slots of 2^(n * @ref CONFIG_GNRC_LORAWAN_TIMER_WHEEL_BITS) ms.
+ */
+typedef struct {
+    gnrc_lorawan_timer_t *slots[CONFIG_GNRC_LORAWAN_TIMER_WHEEL_LEVELS][GNRC_LORAWAN_WHEEL_SLOTS]; /**< timers per slot */
+    uint32_t occupied[CONFIG_GNRC_LORAWAN_TIMER_WHEEL_LEVELS];  /**< non empty slots per level */
+    uint32_t now;           /**< time the slots are relative to, in ms */
+    uint32_t clock;         /**< current time in ms */
+    uint32_t stamp;         /**< @ref gnrc_lorawan_timer_now at @p clock */
+    uint32_t armed;         /**< deadline of the timer hook in ms */
+    uint8_t is_armed : 1;   /**< the timer hook is set */
+    uint8_t expiring : 1;   /**< expired timers are being dispatched */
+} gnrc_lorawan_wheel_t;
+#endif
+
 /**
  * @brief MCPS service access point descriptor
  */
 typedef struct {
     uint32_t fcnt;                  /**< uplink framecounter */
     uint32_t fcnt_down;             /**< downlink frame counter */
-    int nb_trials;              /**< holds the remaining number of retransmissions */
-    int ack_requested;          /**< wether the network server requested an ACK */
-    int waiting_for_ack;        /**< true if the MAC layer is waiting for an ACK */
+    int8_t nb_trials;               /**< holds the remaining number of retransmissions */
+    uint8_t attempts;               /**< number of transmissions of the current uplink */
+    uint8_t ack_requested : 1;      /**< wether the network server requested an ACK */
+    uint8_t waiting_for_ack : 1;    /**< true if the MAC layer is waiting for an ACK */
 } gnrc_lorawan_mcps_t;
 
 /**
  * @brief MLME service access point descriptor
  */
 typedef struct {
-    uint8_t activation;         /**< Activation mechanism of the MAC layer */
-    int pending_mlme_opts;  /**< holds pending mlme opts */
-    uint32_t nid;               /**< current Network ID */
-    int32_t backoff_budget;     /**< remaining Time On Air budget */
-    uint8_t dev_nonce[2];       /**< Device Nonce */
-    uint8_t backoff_state;      /**< state in the backoff state machine */
+    uint32_t nid;                   /**< current Network ID */
+    int32_t backoff_budget;         /**< remaining Time On Air budget */
+    uint8_t dev_nonce[2];           /**< Device Nonce */
+    uint8_t backoff_state;          /**< state in the backoff state machine */
+    uint8_t activation : 2;         /**< Activation mechanism of the MAC layer */
+    uint8_t pending_mlme_opts : 6;  /**< holds pending mlme opts */
 } gnrc_lorawan_mlme_t;
 
 /**
- * @brief GNRC LoRaWAN mac descriptor */
+ * @brief GNRC LoRaWAN mac descriptor
+ *
+ * The members used on every event of a transaction come first, so they share
+ * as few cache lines as possible. The configuration and duty cycle state
+ * used once per transmission follows.
+ */
 typedef struct {
-    gnrc_lorawan_mcps_t mcps;                       /**< MCPS descriptor */
-    gnrc_lorawan_mlme_t mlme;                       /**< MLME descriptor */
-    uint8_t *tx_buf;
-    size_t tx_len;
-    uint8_t *nwkskey;                               /**< pointer to Network SKey buffer */
-    uint8_t *appskey;                               /**< pointer to Application SKey buffer */
-    uint32_t channel[GNRC_LORAWAN_MAX_CHANNELS];    /**< channel array */
+    uint8_t *tx_buf;                                /**< pointer to the uplink buffer */
     uint32_t toa;                                   /**< Time on Air of the last transmission */
-    int busy;                                       /**< MAC busy  */
-    int shutdown_req;                               /**< MAC Shutdown request */
     le_uint32_t dev_addr;                           /**< Device address */
-    int state;                                      /**< state of MAC layer */
+    gnrc_lorawan_mcps_t mcps;                       /**< MCPS descriptor */
+    uint8_t state : 3;                              /**< state of MAC layer */
+    uint8_t busy : 1;                               /**< MAC busy  */
+    uint8_t shutdown_req : 1;                       /**< MAC Shutdown request */
+    uint8_t tx_len;                                 /**< length of the uplink in @ref gnrc_lorawan_t::tx_buf */
+    uint8_t last_dr;                                /**< datarate of the last transmission */
+    uint8_t last_chan;                              /**< index of the channel of the last transmission */
     uint8_t dl_settings;                            /**< downlink settings */
     uint8_t rx_delay;                               /**< Delay of first reception window */
-    uint8_t dr_range[GNRC_LORAWAN_MAX_CHANNELS];    /**< Datarate Range for all channels */
-    uint8_t last_dr;                                /**< datarate of the last transmission */
+    gnrc_lorawan_mlme_t mlme;                       /**< MLME descriptor */
+    uint8_t *nwkskey;                               /**< pointer to Network SKey buffer */
+    uint8_t *appskey;                               /**< pointer to Application SKey buffer */
+#if CONFIG_GNRC_LORAWAN_DUTY_CYCLE
+    uint32_t band_last_tx[GNRC_LORAWAN_BANDS_NUMOF];/**< timestamp of the last transmission per band */
+    uint32_t band_off[GNRC_LORAWAN_BANDS_NUMOF];    /**< duty cycle off time after the last transmission per band (in usecs) */
+#endif
+    /**
+     * @brief channel array. Frequencies are stored in units of
+     *        @ref GNRC_LORAWAN_CHANNEL_STEP as 24 bit little endian, like in
+     *        the CFList. Use @ref gnrc_lorawan_channel_get to read them
+     */
+    uint8_t channel[GNRC_LORAWAN_MAX_CHANNELS][GNRC_LORAWAN_CHANNEL_SIZE];
+#if CONFIG_GNRC_LORAWAN_STATS
+    gnrc_lorawan_stats_t stats;                     /**< MAC statistics counters */
+#endif
+#if CONFIG_GNRC_LORAWAN_TRACE
+    gnrc_lorawan_trace_t trace;                     /**< MAC event trace */
+#endif
+#if CONFIG_GNRC_LORAWAN_ENERGY
+    gnrc_lorawan_energy_state_t energy;             /**< radio energy accounting */
+#endif
+#if CONFIG_GNRC_LORAWAN_FRAG
+    gnrc_lorawan_frag_t frag;                       /**< fragmentation session */
+#endif
+#if CONFIG_GNRC_LORAWAN_LBT
+    uint8_t lbt_deferrals;                          /**< deferrals of the pending transmission */
+#endif
+#if CONFIG_GNRC_LORAWAN_CQ
+    gnrc_lorawan_cq_t cq;                           /**< completion queue */
+#endif
+#if CONFIG_GNRC_LORAWAN_KEYSTREAM
+    gnrc_lorawan_keystream_t keystream[2];          /**< precomputed keystream per direction */
+#endif
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG
+    gnrc_lorawan_uplink_frag_t ufrag;               /**< fragmented uplink transfer */
+#endif
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    gnrc_lorawan_drain_t drain;                     /**< automatic uplinks */
+#endif
+#if CONFIG_GNRC_LORAWAN_LINK_QUALITY
+    gnrc_lorawan_link_t link[GNRC_LORAWAN_MAX_CHANNELS + 1]; /**< link quality per channel and RX2 */
+#endif
+#if CONFIG_GNRC_LORAWAN_COMPRESS
+    gnrc_lorawan_codec_slot_t codecs[CONFIG_GNRC_LORAWAN_COMPRESS_PORTS]; /**< compression codecs per FPort */
+#endif
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+    gnrc_lorawan_wheel_t wheel;                     /**< timer wheel */
+    gnrc_lorawan_timer_t timer;                     /**< reception windows and transmissions */
+    gnrc_lorawan_timer_t backoff_timer;             /**< hourly backoff and duty cycle expiry */
+#endif
 } gnrc_lorawan_t;
 /**
  * @brief MCPS events
@@ -135,6 +789,7 @@ typedef struct {
 typedef enum {
     MCPS_EVENT_RX,            /**< MCPS RX event */
     MCPS_EVENT_NO_RX,         /**< MCPS no RX event */
+    MCPS_EVENT_CHANNEL_BUSY,  /**< MCPS transmission given up due to busy channels */
 } mcps_event_t;
 
 /**
@@ -153,6 +808,10 @@ typedef enum {
     MIB_ACTIVATION_METHOD,      /**< type is activation method */
     MIB_DEV_ADDR,               /**< type is dev addr */
     MIB_RX2_DR,                 /**< type is rx2 DR */
+    MIB_STATS,                  /**< type is MAC statistics (set clears them) */
+    MIB_ENERGY,                 /**< type is radio energy counters (set clears them) */
+    MIB_ENERGY_PROFILE,         /**< type is radio current profile */
+    MIB_DRAIN_POLICY,           /**< type is automatic uplink policy (GNRC_LORAWAN_DRAIN_* flags) */
 } mlme_mib_type_t;
 
 /**
@@ -184,6 +843,10 @@ typedef struct {
         mlme_activation_t activation;   /**< holds activation mechanism */
         void *dev_addr;               /**< pointer to the dev_addr */
         uint8_t rx2_dr;
+        const gnrc_lorawan_stats_t *stats; /**< pointer to the MAC statistics */
+        const gnrc_lorawan_energy_t *energy; /**< pointer to the radio energy counters */
+        const gnrc_lorawan_energy_profile_t *energy_profile; /**< pointer to the radio current profile */
+        uint8_t drain_policy;           /**< automatic uplink policy */
     };
 } mlme_mib_t;
 
@@ -227,8 +890,25 @@ typedef struct {
     void *data;     /**< data of the MCPS confirm */
     int16_t status; /**< status of the MCPS confirm */
     mcps_type_t type;   /**< type of the MCPS confirm */
+    uint8_t attempts;   /**< number of transmissions (only set on deferred confirm) */
 } mcps_confirm_t;
 
+/**
+ * @brief Reception metadata of a frame
+ *
+ * The radio driver sets the timestamp, RSSI and SNR. The other members are
+ * set by the MAC.
+ */
+typedef struct {
+    uint32_t timestamp; /**< end of the reception, from @ref gnrc_lorawan_timer_now */
+    uint32_t freq;      /**< frequency in Hz, from the reception window */
+    int16_t rssi;       /**< RSSI in dBm */
+    int8_t snr;         /**< SNR in dB */
+    uint8_t dr;         /**< datarate, from the reception window */
+    uint8_t window : 2; /**< reception window, 1 or 2 */
+    uint8_t radio : 1;  /**< the radio driver reported the timestamp, RSSI and SNR */
+} gnrc_lorawan_rx_info_t;
+
 /**
  * @brief Mac Common Part Sublayer (MCPS) indication representation
  */
@@ -237,6 +917,7 @@ typedef struct {
     union {
         mcps_data_t data; /**< MCPS Data holder */
     };
+    gnrc_lorawan_rx_info_t rx; /**< reception metadata of the downlink */
 } mcps_indication_t;
 
 /**
@@ -292,6 +973,9 @@ void gnrc_lorawan_mlme_request(gnrc_lorawan_t *mac, const mlme_request_t *mlme_r
  *             be GNRC_LORAWAN_REQ_STATUS_SUCCESS if the request was OK,
  *             GNRC_LORAWAN_REQ_STATUS_DEFERRED if the confirmation is deferred
  *             or an standard error number
+ *
+ * @note With @ref CONFIG_GNRC_LORAWAN_UPLINK_FRAG the payload of a fragmented
+ *       request must stay valid until the MCPS confirm.
  */
 void gnrc_lorawan_mcps_request(gnrc_lorawan_t *mac, const mcps_request_t *mcps_request,
                                mcps_confirm_t *mcps_confirm);
@@ -300,6 +984,9 @@ void gnrc_lorawan_mcps_request(gnrc_lorawan_t *mac, const mcps_request_t *mcps_r
  * @brief MLME Backoff expiration tick
  *
  *        Should be called every hour in order to maintain the Time On Air budget.
+ *        With @ref CONFIG_GNRC_LORAWAN_TIMER_WHEEL the MAC ticks itself,
+ *        starting from @ref gnrc_lorawan_init. Ports must not call this
+ *        function then; it does nothing.
  *
  * @param[in] mac pointer to the MAC descriptor
  */
@@ -314,20 +1001,89 @@ void gnrc_lorawan_mlme_backoff_expire(gnrc_lorawan_t *mac);
  * @param[in] mac pointer to the MAC descriptor
  * @param[in] data pointer to the received packet
  * @param[in] size size of the received packet
+ * @param[in] info reception metadata reported by the radio, or NULL if the
+ *                 radio driver doesn't report it. The link quality estimate
+ *                 is only updated with metadata
+ */
+void gnrc_lorawan_process_pkt(gnrc_lorawan_t *mac, uint8_t *data, size_t size,
+                              const gnrc_lorawan_rx_info_t *info);
+
+#if CONFIG_GNRC_LORAWAN_LINK_QUALITY || defined(DOXYGEN)
+/**
+ * @brief Get the link quality estimate of a channel
+ *
+ *        The estimate is only updated by downlinks with a valid MIC, and
+ *        cleared when the channels are reset.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] chan index of the channel, or @ref GNRC_LORAWAN_LINK_RX2
+ *
+ * @return pointer to the estimate. gnrc_lorawan_link_t::count is 0 if no
+ *         downlink was received on the channel yet
+ */
+static inline const gnrc_lorawan_link_t *gnrc_lorawan_link_get(const gnrc_lorawan_t *mac,
+                                                              unsigned chan)
+{
+    return &mac->link[chan];
+}
+#endif
+
+/**
+ * @brief Copy and remove the oldest entries of the MAC event trace
+ *
+ * May be called from a different context than the MAC, as long as there is
+ * only one reader.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[out] entries destination buffer
+ * @param[in] max maximum number of entries to copy
+ *
+ * @return number of copied entries
  */
-void gnrc_lorawan_process_pkt(gnrc_lorawan_t *mac, uint8_t *data, size_t size);
+size_t gnrc_lorawan_trace_drain(gnrc_lorawan_t *mac,
+                                gnrc_lorawan_trace_entry_t *entries, size_t max);
 
 /**
  * @brief Tell the MAC layer the timer was fired
  *
+ * With @ref CONFIG_GNRC_LORAWAN_TIMER_WHEEL, runs all expired timers of the
+ * wheel and sets the timer again for the next one.
+ *
  * @param mac pointer to the MAC descriptor
  */
 void gnrc_lorawan_timer_fired(gnrc_lorawan_t *mac);
 
 void gnrc_lorawan_timer_stop(gnrc_lorawan_t *mac);
 void gnrc_lorawan_timer_set(gnrc_lorawan_t *mac, uint32_t secs);
+
+/**
+ * @brief Sleep for the given time
+ *
+ * @deprecated Not used by the MAC anymore. The Join Request jitter runs on
+ *             the MAC timer (see @ref gnrc_lorawan_timer_set)
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] us time to sleep in microseconds
+ */
 void gnrc_lorawan_timer_usleep(gnrc_lorawan_t *mac, uint32_t us);
 
+/**
+ * @brief Get the current time in microseconds
+ *
+ * @note Only required if @ref CONFIG_GNRC_LORAWAN_DUTY_CYCLE,
+ *       @ref CONFIG_GNRC_LORAWAN_TRACE, @ref CONFIG_GNRC_LORAWAN_ENERGY or
+ *       @ref CONFIG_GNRC_LORAWAN_TIMER_WHEEL are enabled
+ *
+ * With the xtimer or the ztimer_usec module, the MAC provides a weak default
+ * that returns `xtimer_now_usec()` or `ztimer_now(ZTIMER_USEC)`. Ports
+ * override it if the MAC descriptor runs on another clock.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ *
+ * @return current time in microseconds (wrapping)
+ */
+uint32_t gnrc_lorawan_timer_now(gnrc_lorawan_t *mac);
+
 void gnrc_lorawan_mcps_indication(gnrc_lorawan_t *mac, mcps_indication_t *ind);
 void gnrc_lorawan_mlme_indication(gnrc_lorawan_t *mac, mlme_indication_t *ind);
 void gnrc_lorawan_mcps_confirm(gnrc_lorawan_t *mac, mcps_confirm_t *confirm);
@@ -343,12 +1099,47 @@ void gnrc_lorawan_radio_rx_on(gnrc_lorawan_t *mac);
 void gnrc_lorawan_radio_set_sf(gnrc_lorawan_t *mac, uint8_t sf);
 void gnrc_lorawan_radio_set_bw(gnrc_lorawan_t *mac, uint8_t bw);
 void gnrc_lorawan_radio_send(gnrc_lorawan_t *mac, iolist_t *io);
+
+/**
+ * @brief Check if the channel is clear before a transmission
+ *
+ * Called with the radio already configured for the transmission (frequency,
+ * spreading factor and bandwidth). Can be implemented with Channel Activity
+ * Detection or by comparing the RSSI against a threshold during the listen
+ * time required by the region (Listen Before Talk).
+ *
+ * @note To be implemented by the user if @ref CONFIG_GNRC_LORAWAN_LBT is set
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ *
+ * @return true if the channel is clear
+ * @return false if the channel is busy
+ */
+int gnrc_lorawan_radio_cca(gnrc_lorawan_t *mac);
 void gnrc_lorawan_cmac_init(gnrc_lorawan_t *mac, const void *key);
 void gnrc_lorawan_cmac_update(gnrc_lorawan_t *mac, const void *buf, size_t len);
 void gnrc_lorawan_cmac_finish(gnrc_lorawan_t *mac, void *out);
 void gnrc_lorawan_aes128_init(gnrc_lorawan_t *mac, const void *key);
 void gnrc_lorawan_aes128_encrypt(gnrc_lorawan_t *mac, const void *in, void *out);
 
+/**
+ * @brief Encrypt independent blocks with the key of the last
+ *        @ref gnrc_lorawan_aes128_init call
+ *
+ * Equivalent to calling @ref gnrc_lorawan_aes128_encrypt for every block.
+ *
+ * @note To be implemented by the user if
+ *       @ref CONFIG_GNRC_LORAWAN_AES128_BLOCKS is set
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] in input blocks
+ * @param[out] out output blocks. May be the same as @p in
+ * @param[in] numof number of 16 byte blocks, up to
+ *                  @ref CONFIG_GNRC_LORAWAN_AES128_BLOCKS_MAX
+ */
+void gnrc_lorawan_aes128_encrypt_blocks(gnrc_lorawan_t *mac, const void *in, void *out,
+                                        size_t numof);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan
+ * @{
+ *
+ * @file
+ * @brief   GNRC LoRaWAN radio multiplexer
+ *
+ * Lets several MAC descriptors (e.g. different DevEUIs and keys) share one
+ * transceiver. A MAC owns the radio from the start of a transmission until
+ * the end of its last receive window. Join and data requests of other MAC
+ * descriptors are queued during that time and dispatched in round robin order
+ * once the radio is free again. The same applies to timers that start a
+ * transmission: retransmissions of confirmed uplinks, the Join Request jitter
+ * and transmissions deferred by Listen Before Talk.
+ *
+ * When a MAC descriptor is registered to a multiplexer, the user must use the
+ * multiplexer functions instead of the MAC ones:
+ *
+ * - @ref gnrc_lorawan_mux_mcps_request and @ref gnrc_lorawan_mux_mlme_request
+ *   instead of @ref gnrc_lorawan_mcps_request and
+ *   @ref gnrc_lorawan_mlme_request.
+ * - @ref gnrc_lorawan_mux_event_tx_complete,
+ *   @ref gnrc_lorawan_mux_event_timeout and @ref gnrc_lorawan_mux_process_pkt
+ *   for radio events, which are delivered to the MAC that owns the radio.
+ * - @ref gnrc_lorawan_mux_timer_fired when the timer of a MAC descriptor
+ *   fires.
+ *
+ * The radio hooks are still called with the MAC descriptor that owns the
+ * radio, so they can be implemented once for all descriptors. The MAC
+ * configures the radio completely before every transmission and receive
+ * window, so no radio settings leak from one descriptor to another.
+ *
+ * @note Requests that get queued complete with a deferred status. If they
+ *       fail once dispatched, the error is reported with
+ *       @ref gnrc_lorawan_mcps_confirm or @ref gnrc_lorawan_mlme_confirm.
+ *       The payload of a queued MCPS request and the keys of a queued join
+ *       request must stay valid until then.
+ *
+ * @note Queued operations are only dispatched from the event functions and
+ *       @ref gnrc_lorawan_mux_timer_fired, so confirms and indications of a
+ *       MAC descriptor are delivered from the context that handles the MAC
+ *       events, as the completion queue expects. A request never runs the
+ *       operations of other MAC descriptors. If it frees the radio, the
+ *       timer hook of a waiting MAC descriptor is called with a delay of 0
+ *       to dispatch them. Timers the MAC armed itself are not moved.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef NET_GNRC_LORAWAN_MUX_H
+#define NET_GNRC_LORAWAN_MUX_H
+
+#include "gnrc_lorawan/lorawan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief maximum number of MAC descriptors sharing a radio
+ */
+#ifndef CONFIG_GNRC_LORAWAN_MUX_NUMOF
+#define CONFIG_GNRC_LORAWAN_MUX_NUMOF 4
+#endif
+
+#define GNRC_LORAWAN_MUX_PENDING_MCPS   (1 << 0)    /**< MCPS request queued */
+#define GNRC_LORAWAN_MUX_PENDING_MLME   (1 << 1)    /**< join request queued */
+#define GNRC_LORAWAN_MUX_PENDING_TIMER  (1 << 2)    /**< timer event queued */
+
+/**
+ * @brief MAC descriptor registered to a multiplexer
+ */
+typedef struct {
+    gnrc_lorawan_t *mac;    /**< pointer to the MAC descriptor */
+    uint8_t pending;        /**< queued operations */
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL || defined(DOXYGEN)
+    gnrc_lorawan_timer_t dispatch;  /**< dispatches queued operations after a request */
+#endif
+    union {
+        mcps_request_t mcps;    /**< queued MCPS request */
+        mlme_request_t mlme;    /**< queued join request */
+    } req;                  /**< queued request */
+} gnrc_lorawan_mux_slot_t;
+
+/**
+ * @brief Radio multiplexer descriptor
+ */
+typedef struct {
+    gnrc_lorawan_mux_slot_t slots[CONFIG_GNRC_LORAWAN_MUX_NUMOF]; /**< registered MAC descriptors */
+    gnrc_lorawan_t *owner;  /**< MAC descriptor that owns the radio */
+    uint8_t numof;          /**< number of registered MAC descriptors */
+    uint8_t next;           /**< next slot to be dispatched */
+} gnrc_lorawan_mux_t;
+
+/**
+ * @brief Init a radio multiplexer
+ *
+ * @param[in] mux pointer to the multiplexer descriptor
+ */
+void gnrc_lorawan_mux_init(gnrc_lorawan_mux_t *mux);
+
+/**
+ * @brief Register a MAC descriptor to a multiplexer
+ *
+ * @param[in] mux pointer to the multiplexer descriptor
+ * @param[in] mac pointer to an initialized MAC descriptor
+ *
+ * @return 0 on success
+ * @return -ENOMEM if there are already @ref CONFIG_GNRC_LORAWAN_MUX_NUMOF
+ *         registered MAC descriptors
+ */
+int gnrc_lorawan_mux_add(gnrc_lorawan_mux_t *mux, gnrc_lorawan_t *mac);
+
+/**
+ * @brief Get the MAC descriptor that owns the radio
+ *
+ * @param[in] mux pointer to the multiplexer descriptor
+ *
+ * @return pointer to the MAC descriptor
+ * @return NULL if the radio is free
+ */
+static inline gnrc_lorawan_t *gnrc_lorawan_mux_owner(gnrc_lorawan_mux_t *mux)
+{
+    return mux->owner;
+}
+
+/**
+ * @brief Perform a MCPS request, or queue it if the radio is in use
+ *
+ * @param[in] mux pointer to the multiplexer descriptor
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] mcps_request the MCPS request
+ * @param[out] mcps_confirm the MCPS confirm. Same as
+ *             @ref gnrc_lorawan_mcps_request. -EBUSY if there's already a
+ *             request queued for @p mac
+ */
+void gnrc_lorawan_mux_mcps_request(gnrc_lorawan_mux_t *mux, gnrc_lorawan_t *mac,
+                                   const mcps_request_t *mcps_request,
+                                   mcps_confirm_t *mcps_confirm);
+
+/**
+ * @brief Perform a MLME request. Join requests are queued if the radio is
+ *        in use
+ *
+ * @param[in] mux pointer to the multiplexer descriptor
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] mlme_request the MLME request
+ * @param[out] mlme_confirm the MLME confirm. Same as
+ *             @ref gnrc_lorawan_mlme_request. -EBUSY if there's already a
+ *             request queued for @p mac
+ */
+void gnrc_lorawan_mux_mlme_request(gnrc_lorawan_mux_t *mux, gnrc_lorawan_t *mac,
+                                   const mlme_request_t *mlme_request,
+                                   mlme_confirm_t *mlme_confirm);
+
+/**
+ * @brief Indicate the multiplexer when the transmission finished
+ *
+ * @param[in] mux pointer to the multiplexer descriptor
+ */
+void gnrc_lorawan_mux_event_tx_complete(gnrc_lorawan_mux_t *mux);
+
+/**
+ * @brief Indicate the multiplexer there was a radio timeout event
+ *
+ * @param[in] mux pointer to the multiplexer descriptor
+ */
+void gnrc_lorawan_mux_event_timeout(gnrc_lorawan_mux_t *mux);
+
+/**
+ * @brief Process a packet received by the radio
+ *
+ * @param[in] mux pointer to the multiplexer descriptor
+ * @param[in] data pointer to the received packet
+ * @param[in] size size of the received packet
+ * @param[in] info reception metadata reported by the radio, or NULL
+ */
+void gnrc_lorawan_mux_process_pkt(gnrc_lorawan_mux_t *mux, uint8_t *data, size_t size,
+                                  const gnrc_lorawan_rx_info_t *info);
+
+/**
+ * @brief Tell the multiplexer the timer of a MAC descriptor was fired
+ *
+ * @param[in] mux pointer to the multiplexer descriptor
+ * @param[in] mac pointer to the MAC descriptor
+ */
+void gnrc_lorawan_mux_timer_fired(gnrc_lorawan_mux_t *mux, gnrc_lorawan_t *mac);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_GNRC_LORAWAN_MUX_H */
+/** @} */
@@ -54,6 +54,17 @@ void gnrc_lorawan_process_cflist(gnrc_lorawan_t *mac, uint8_t *cflist);
  */
 uint8_t gnrc_lorawan_rx1_get_dr_offset(uint8_t dr_up, uint8_t dr_offset);
 
+/**
+ * @brief Get the duty cycle band of a frequency
+ *
+ * @param[in] freq frequency in Hz
+ * @param[out] duty_cycle inverse of the duty cycle of the band (100 => 1%).
+ *             May be NULL
+ *
+ * @return index of the band, lower than @ref GNRC_LORAWAN_BANDS_NUMOF
+ */
+uint8_t gnrc_lorawan_band_get(uint32_t freq, uint16_t *duty_cycle);
+
 /**
  * @brief Check if a datarate is valid in the current region
  *
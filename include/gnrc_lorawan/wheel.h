@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan
+ * @{
+ *
+ * @file
+ * @brief   GNRC LoRaWAN timer wheel
+ *
+ * The timer hooks (@ref gnrc_lorawan_timer_set, @ref gnrc_lorawan_timer_stop
+ * and @ref gnrc_lorawan_timer_fired) provide a single hardware timer per MAC
+ * descriptor. With @ref CONFIG_GNRC_LORAWAN_TIMER_WHEEL, the MAC multiplexes
+ * independent logical timers onto it:
+ *
+ * - the timer of the MAC state machine (reception windows, retransmissions,
+ *   join jitter, deferred and paced transmissions)
+ * - an hourly timer that ticks the duty cycle bands and the Join backoff.
+ *   @ref gnrc_lorawan_mlme_backoff_expire does nothing then
+ * - any number of timers of the application, e.g. aggregation deadlines
+ *
+ * Timers are kept in a hierarchical timer wheel with
+ * @ref CONFIG_GNRC_LORAWAN_TIMER_WHEEL_LEVELS levels of
+ * 2^@ref CONFIG_GNRC_LORAWAN_TIMER_WHEEL_BITS slots and a resolution of 1 ms.
+ * Arming and cancelling a timer is O(1). Finding the next deadline checks
+ * the first non empty slot of every level. Timers of a level are cascaded to
+ * the lower levels when the time reaches their slot. The hardware timer is
+ * always set to the next deadline, so the wheel doesn't tick.
+ *
+ * Time is taken from @ref gnrc_lorawan_timer_now, which must not wrap
+ * between two wheel operations. The hourly timer makes sure of that.
+ *
+ * @note The radio multiplexer (@ref gnrc_lorawan/mux.h) defers all expired
+ *       timers of a MAC descriptor while another descriptor owns the radio.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef NET_GNRC_LORAWAN_WHEEL_H
+#define NET_GNRC_LORAWAN_WHEEL_H
+
+#include "gnrc_lorawan/lorawan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL || defined(DOXYGEN)
+/**
+ * @brief longest delay of a timer in ms
+ */
+#define GNRC_LORAWAN_WHEEL_DELAY_MAX \
+    ((1UL << (CONFIG_GNRC_LORAWAN_TIMER_WHEEL_LEVELS * CONFIG_GNRC_LORAWAN_TIMER_WHEEL_BITS)) - 1)
+
+/**
+ * @brief Expiry callback of a timer
+ */
+typedef void (*gnrc_lorawan_timer_cb_t)(gnrc_lorawan_timer_t *timer);
+
+/**
+ * @brief Init a timer
+ *
+ * @param[out] timer pointer to the timer
+ * @param[in] cb expiry callback. Runs from @ref gnrc_lorawan_timer_fired
+ * @param[in] arg argument of the callback (@ref gnrc_lorawan_timer_t::arg)
+ */
+static inline void gnrc_lorawan_wheel_timer_init(gnrc_lorawan_timer_t *timer,
+                                                 gnrc_lorawan_timer_cb_t cb, void *arg)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->cb = cb;
+    timer->arg = arg;
+}
+
+/**
+ * @brief Check if a timer is armed
+ *
+ * @param[in] timer pointer to the timer
+ *
+ * @return true if the timer is armed
+ */
+static inline int gnrc_lorawan_wheel_armed(const gnrc_lorawan_timer_t *timer)
+{
+    return timer->prev != NULL;
+}
+
+/**
+ * @brief Arm a timer, or move it if it was armed already
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] timer pointer to an initialized timer
+ * @param[in] ms delay in ms, at most @ref GNRC_LORAWAN_WHEEL_DELAY_MAX
+ */
+void gnrc_lorawan_wheel_set(gnrc_lorawan_t *mac, gnrc_lorawan_timer_t *timer,
+                            uint32_t ms);
+
+/**
+ * @brief Cancel a timer. Does nothing if the timer is not armed
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] timer pointer to the timer
+ */
+void gnrc_lorawan_wheel_cancel(gnrc_lorawan_t *mac, gnrc_lorawan_timer_t *timer);
+
+/**
+ * @brief Get the time until the next timer expires
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[out] ms time until the next deadline in ms. 0 if a timer is due
+ *
+ * @return 0 on success
+ * @return -ENOENT if no timer is armed
+ */
+int gnrc_lorawan_wheel_next(gnrc_lorawan_t *mac, uint32_t *ms);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_GNRC_LORAWAN_WHEEL_H */
+/** @} */
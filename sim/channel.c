@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "gnrc_lorawan_sim/channel.h"
+
+/* SIR thresholds (dB) between the spreading factor of the wanted frame (row)
+ * and of the interferer (column). The diagonal is replaced by the capture
+ * threshold of the channel.
+ * See Croce et al., "Impact of LoRa Imperfect Orthogonality: Analysis of
+ * Link-Level Performance", IEEE Communications Letters, 2018 */
+static const int8_t _sir_threshold[GNRC_LORAWAN_SIM_SF_NUMOF][GNRC_LORAWAN_SIM_SF_NUMOF] = {
+    {   1,  -8,  -9,  -9,  -9,  -9 },
+    { -11,   1, -11, -12, -13, -13 },
+    { -15, -13,   1, -13, -14, -15 },
+    { -19, -18, -17,   1, -17, -18 },
+    { -22, -22, -21, -20,   1, -20 },
+    { -25, -25, -25, -24, -23,   1 },
+};
+
+/* Demodulation floor (dB) per spreading factor */
+static const float _snr_min[GNRC_LORAWAN_SIM_SF_NUMOF] = {
+    -7.5f, -10.0f, -12.5f, -15.0f, -17.5f, -20.0f
+};
+
+static inline gnrc_lorawan_sim_tx_t *_tx(gnrc_lorawan_sim_channel_t *ch, uint64_t id)
+{
+    return &ch->txs[id & (ch->txs_size - 1)];
+}
+
+static inline int _overlap_time(const gnrc_lorawan_sim_tx_t *a, const gnrc_lorawan_sim_tx_t *b)
+{
+    return a->start < b->end && b->start < a->end;
+}
+
+static inline int _overlap(const gnrc_lorawan_sim_tx_t *a, const gnrc_lorawan_sim_tx_t *b)
+{
+    uint32_t df = a->freq > b->freq ? a->freq - b->freq : b->freq - a->freq;
+
+    return _overlap_time(a, b) && 2 * df < ((uint32_t) a->bw + b->bw) * 1000;
+}
+
+/* First transmission that starts at or after `start` */
+static uint64_t _lower_bound(gnrc_lorawan_sim_channel_t *ch, uint64_t start)
+{
+    uint64_t lo = ch->tail;
+    uint64_t hi = ch->head;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (_tx(ch, mid)->start < start) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void gnrc_lorawan_sim_channel_init(gnrc_lorawan_sim_channel_t *ch,
+                                   gnrc_lorawan_sim_radio_t *radios,
+                                   size_t radios_numof,
+                                   gnrc_lorawan_sim_tx_t *txs, size_t txs_size)
+{
+    assert(txs_size && !(txs_size & (txs_size - 1)));
+
+    memset(ch, 0, sizeof(gnrc_lorawan_sim_channel_t));
+    ch->radios = radios;
+    ch->radios_numof = radios_numof;
+    ch->txs = txs;
+    ch->txs_size = txs_size;
+    ch->pl0 = CONFIG_GNRC_LORAWAN_SIM_PL0;
+    ch->d0 = CONFIG_GNRC_LORAWAN_SIM_D0;
+    ch->gamma = CONFIG_GNRC_LORAWAN_SIM_GAMMA;
+    ch->noise_figure = CONFIG_GNRC_LORAWAN_SIM_NOISE_FIGURE;
+    ch->capture = CONFIG_GNRC_LORAWAN_SIM_CAPTURE;
+}
+
+uint32_t gnrc_lorawan_sim_time_on_air(uint8_t len, uint8_t sf, uint16_t bw, uint8_t cr)
+{
+    /* Symbol time in us */
+    uint32_t t_sym = ((1000UL << sf) + bw / 2) / bw;
+    int de = t_sym >= 16000;
+    int num = 8 * len - 4 * sf + 44;
+    int den = 4 * (sf - 2 * de);
+    int n_payload = 8;
+
+    if (num > 0) {
+        n_payload += ((num + den - 1) / den) * (cr + 4);
+    }
+
+    /* 8 preamble symbols + 4.25 sync symbols, in quarters of a symbol */
+    uint64_t quarters = 4 * (8 + n_payload) + 17;
+    return (uint32_t) ((quarters * (1000ULL << sf) / bw + 2) / 4);
+}
+
+int64_t gnrc_lorawan_sim_channel_tx(gnrc_lorawan_sim_channel_t *ch,
+                                    const gnrc_lorawan_sim_tx_t *tx)
+{
+    assert(ch->head == ch->tail || tx->start >= _tx(ch, ch->head - 1)->start);
+
+    uint32_t toa = tx->end - tx->start;
+    if (toa > ch->max_toa) {
+        ch->max_toa = toa;
+    }
+
+    /* Nothing older than twice the longest Time on Air can overlap a
+     * transmission that is still pending */
+    while (ch->tail != ch->head &&
+           _tx(ch, ch->tail)->start + 2ULL * ch->max_toa < tx->start) {
+        ch->tail++;
+    }
+
+    if (ch->head - ch->tail == ch->txs_size) {
+        return -ENOBUFS;
+    }
+
+    *_tx(ch, ch->head) = *tx;
+    return ch->head++;
+}
+
+const gnrc_lorawan_sim_tx_t *gnrc_lorawan_sim_channel_get(gnrc_lorawan_sim_channel_t *ch,
+                                                          uint64_t id)
+{
+    if (id < ch->tail || id >= ch->head) {
+        return NULL;
+    }
+    return _tx(ch, id);
+}
+
+float gnrc_lorawan_sim_channel_rssi(const gnrc_lorawan_sim_channel_t *ch,
+                                    const gnrc_lorawan_sim_tx_t *tx, uint32_t radio)
+{
+    const gnrc_lorawan_sim_radio_t *src = &ch->radios[tx->radio];
+    const gnrc_lorawan_sim_radio_t *dst = &ch->radios[radio];
+    float dx = src->x - dst->x;
+    float dy = src->y - dst->y;
+    float d = sqrtf(dx * dx + dy * dy);
+
+    if (d < 1.0f) {
+        d = 1.0f;
+    }
+    return tx->tx_power - (ch->pl0 + 10.0f * ch->gamma * log10f(d / ch->d0));
+}
+
+int gnrc_lorawan_sim_channel_rx(gnrc_lorawan_sim_channel_t *ch, uint64_t id,
+                                uint32_t radio, gnrc_lorawan_sim_rx_t *rx)
+{
+    const gnrc_lorawan_sim_tx_t *tx = gnrc_lorawan_sim_channel_get(ch, id);
+    float interference[GNRC_LORAWAN_SIM_SF_NUMOF] = { 0 };
+    gnrc_lorawan_sim_rx_t _rx;
+
+    if (!tx) {
+        return -ENOENT;
+    }
+    assert(tx->sf >= GNRC_LORAWAN_SIM_SF_MIN && tx->sf <= GNRC_LORAWAN_SIM_SF_MAX);
+
+    if (!rx) {
+        rx = &_rx;
+    }
+
+    rx->rssi = gnrc_lorawan_sim_channel_rssi(ch, tx, radio);
+    rx->snr = rx->rssi - (-174.0f + 10.0f * log10f(tx->bw * 1000.0f) + ch->noise_figure);
+    rx->sir = INFINITY;
+
+    uint64_t first = _lower_bound(ch, tx->start > ch->max_toa ?
+                                      tx->start - ch->max_toa : 0);
+    for (uint64_t i = first; i < ch->head; i++) {
+        const gnrc_lorawan_sim_tx_t *other = _tx(ch, i);
+        if (other->start >= tx->end) {
+            break;
+        }
+        if (i == id) {
+            continue;
+        }
+        /* The radio can't receive while it transmits, on any frequency */
+        if (other->radio == radio && _overlap_time(tx, other)) {
+            return GNRC_LORAWAN_SIM_RX_HALF_DUPLEX;
+        }
+        if (!_overlap(tx, other)) {
+            continue;
+        }
+        if (other->sf >= GNRC_LORAWAN_SIM_SF_MIN && other->sf <= GNRC_LORAWAN_SIM_SF_MAX) {
+            interference[other->sf - GNRC_LORAWAN_SIM_SF_MIN] +=
+                powf(10.0f, gnrc_lorawan_sim_channel_rssi(ch, other, radio) / 10.0f);
+        }
+    }
+
+    int status = rx->snr < _snr_min[tx->sf - GNRC_LORAWAN_SIM_SF_MIN] ?
+                 GNRC_LORAWAN_SIM_RX_SENSITIVITY : GNRC_LORAWAN_SIM_RX_OK;
+    for (unsigned sf = 0; sf < GNRC_LORAWAN_SIM_SF_NUMOF; sf++) {
+        if (interference[sf] == 0.0f) {
+            continue;
+        }
+        float sir = rx->rssi - 10.0f * log10f(interference[sf]);
+        float threshold = sf == (unsigned) (tx->sf - GNRC_LORAWAN_SIM_SF_MIN) ?
+                          ch->capture :
+                          _sir_threshold[tx->sf - GNRC_LORAWAN_SIM_SF_MIN][sf];
+        if (sir < rx->sir) {
+            rx->sir = sir;
+        }
+        if (sir < threshold && status == GNRC_LORAWAN_SIM_RX_OK) {
+            status = GNRC_LORAWAN_SIM_RX_COLLISION;
+        }
+    }
+    return status;
+}
+
+/** @} */
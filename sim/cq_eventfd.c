@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include "gnrc_lorawan/lorawan.h"
+
+#if CONFIG_GNRC_LORAWAN_CQ && defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "gnrc_lorawan/cq.h"
+#include "gnrc_lorawan_sim/cq_eventfd.h"
+
+static int _fd = -1;
+
+int gnrc_lorawan_sim_cq_eventfd(void)
+{
+    if (_fd < 0) {
+        _fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (_fd < 0) {
+            return -errno;
+        }
+    }
+    return _fd;
+}
+
+int64_t gnrc_lorawan_sim_cq_wait(int timeout_ms)
+{
+    int fd = gnrc_lorawan_sim_cq_eventfd();
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    uint64_t count;
+
+    if (fd < 0) {
+        return fd;
+    }
+
+    int res = poll(&pfd, 1, timeout_ms);
+    if (res <= 0) {
+        return res < 0 ? -errno : 0;
+    }
+
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return errno == EAGAIN ? 0 : -errno;
+    }
+    return (int64_t) count;
+}
+
+void gnrc_lorawan_cq_notify(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+    const uint64_t one = 1;
+    int fd = gnrc_lorawan_sim_cq_eventfd();
+
+    if (fd >= 0) {
+        /* Can't fail before the counter reaches 2^64 - 2 */
+        ssize_t res = write(fd, &one, sizeof(one));
+        (void) res;
+    }
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
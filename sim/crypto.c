@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include "gnrc_lorawan_sim/crypto.h"
+
+#if CONFIG_GNRC_LORAWAN_SIM_CRYPTO
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gnrc_lorawan/lorawan.h"
+
+#if CONFIG_GNRC_LORAWAN_SIM_CRYPTO_AESNI && \
+    (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define AESNI (1)
+#include <wmmintrin.h>
+#else
+#define AESNI (0)
+#endif
+
+#define BLOCK_SIZE (16U)
+#define ROUNDS (10U)
+#define BATCH (8U)      /**< blocks interleaved by the AES-NI implementation */
+
+/* Expanded key. Same layout for both implementations */
+typedef struct {
+    uint8_t rk[ROUNDS + 1][BLOCK_SIZE] __attribute__((aligned(16)));
+} _aes_key_t;
+
+typedef struct {
+    _aes_key_t key;
+    uint8_t k1[BLOCK_SIZE];
+    uint8_t k2[BLOCK_SIZE];
+    uint8_t x[BLOCK_SIZE];
+    uint8_t buf[BLOCK_SIZE];
+    uint8_t len;
+} _cmac_t;
+
+typedef void (*_encrypt_fn)(const _aes_key_t *key, const uint8_t *in, uint8_t *out,
+                            size_t numof);
+
+static _Thread_local _aes_key_t _aes;
+static _Thread_local _cmac_t _cmac;
+
+static const uint8_t _sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static void _expand_key(_aes_key_t *key, const uint8_t *k)
+{
+    uint8_t rcon = 0x01;
+
+    memcpy(key->rk[0], k, BLOCK_SIZE);
+    for (unsigned r = 1; r <= ROUNDS; r++) {
+        const uint8_t *prev = key->rk[r - 1];
+        uint8_t *rk = key->rk[r];
+
+        rk[0] = prev[0] ^ _sbox[prev[13]] ^ rcon;
+        rk[1] = prev[1] ^ _sbox[prev[14]];
+        rk[2] = prev[2] ^ _sbox[prev[15]];
+        rk[3] = prev[3] ^ _sbox[prev[12]];
+        for (unsigned i = 4; i < BLOCK_SIZE; i++) {
+            rk[i] = prev[i] ^ rk[i - 4];
+        }
+        rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0);
+    }
+}
+
+static inline uint8_t _xtime(uint8_t x)
+{
+    return (x << 1) ^ ((x & 0x80) ? 0x1b : 0);
+}
+
+static void _portable_encrypt(const _aes_key_t *key, const uint8_t *in, uint8_t *out,
+                              size_t numof)
+{
+    for (size_t n = 0; n < numof; n++) {
+        uint8_t s[BLOCK_SIZE];
+        uint8_t t[BLOCK_SIZE];
+
+        for (unsigned i = 0; i < BLOCK_SIZE; i++) {
+            s[i] = in[i] ^ key->rk[0][i];
+        }
+
+        for (unsigned r = 1; r <= ROUNDS; r++) {
+            /* SubBytes and ShiftRows */
+            for (unsigned c = 0; c < 4; c++) {
+                for (unsigned row = 0; row < 4; row++) {
+                    t[4 * c + row] = _sbox[s[(4 * (c + row) + row) % BLOCK_SIZE]];
+                }
+            }
+            /* MixColumns, except in the last round */
+            for (unsigned c = 0; c < 4; c++) {
+                uint8_t *col = &t[4 * c];
+                if (r < ROUNDS) {
+                    uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+                    uint8_t first = col[0];
+                    s[4 * c + 0] = col[0] ^ all ^ _xtime(col[0] ^ col[1]);
+                    s[4 * c + 1] = col[1] ^ all ^ _xtime(col[1] ^ col[2]);
+                    s[4 * c + 2] = col[2] ^ all ^ _xtime(col[2] ^ col[3]);
+                    s[4 * c + 3] = col[3] ^ all ^ _xtime(col[3] ^ first);
+                }
+                else {
+                    memcpy(&s[4 * c], col, 4);
+                }
+            }
+            for (unsigned i = 0; i < BLOCK_SIZE; i++) {
+                s[i] ^= key->rk[r][i];
+            }
+        }
+
+        memcpy(out, s, BLOCK_SIZE);
+        in += BLOCK_SIZE;
+        out += BLOCK_SIZE;
+    }
+}
+
+#if AESNI
+/* Interleave the rounds of up to BATCH blocks, so the latency of one AESENC
+ * is hidden behind the ones of the other blocks */
+__attribute__((target("aes,sse2")))
+static void _aesni_encrypt(const _aes_key_t *key, const uint8_t *in, uint8_t *out,
+                           size_t numof)
+{
+    __m128i rk[ROUNDS + 1];
+
+    for (unsigned r = 0; r <= ROUNDS; r++) {
+        rk[r] = _mm_load_si128((const __m128i *) key->rk[r]);
+    }
+
+    while (numof) {
+        __m128i b[BATCH];
+        unsigned count = numof < BATCH ? numof : BATCH;
+
+        for (unsigned i = 0; i < count; i++) {
+            b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in + i), rk[0]);
+        }
+        for (unsigned r = 1; r < ROUNDS; r++) {
+            for (unsigned i = 0; i < count; i++) {
+                b[i] = _mm_aesenc_si128(b[i], rk[r]);
+            }
+        }
+        for (unsigned i = 0; i < count; i++) {
+            _mm_storeu_si128((__m128i *) out + i, _mm_aesenclast_si128(b[i], rk[ROUNDS]));
+        }
+
+        in += count * BLOCK_SIZE;
+        out += count * BLOCK_SIZE;
+        numof -= count;
+    }
+}
+
+static int _aesni_supported(void)
+{
+    return __builtin_cpu_supports("aes");
+}
+#endif
+
+/* Shared by all threads. Only written by gnrc_lorawan_sim_crypto_select(),
+ * before the simulation threads start */
+static _encrypt_fn _encrypt = _portable_encrypt;
+
+int gnrc_lorawan_sim_crypto_select(gnrc_lorawan_sim_crypto_t impl)
+{
+    switch (impl) {
+        case GNRC_LORAWAN_SIM_CRYPTO_AUTO:
+#if AESNI
+            if (_aesni_supported()) {
+                _encrypt = _aesni_encrypt;
+                return 0;
+            }
+#endif
+            /* fall through */
+        case GNRC_LORAWAN_SIM_CRYPTO_PORTABLE:
+            _encrypt = _portable_encrypt;
+            return 0;
+        case GNRC_LORAWAN_SIM_CRYPTO_AESNI:
+#if AESNI
+            if (_aesni_supported()) {
+                _encrypt = _aesni_encrypt;
+                return 0;
+            }
+#endif
+            break;
+    }
+    return -ENOTSUP;
+}
+
+const char *gnrc_lorawan_sim_crypto_name(void)
+{
+#if AESNI
+    if (_encrypt == _aesni_encrypt) {
+        return "aesni";
+    }
+#endif
+    return "portable";
+}
+
+static void _encrypt_blocks(const _aes_key_t *key, const uint8_t *in, uint8_t *out,
+                            size_t numof)
+{
+    _encrypt(key, in, out, numof);
+}
+
+void gnrc_lorawan_aes128_init(gnrc_lorawan_t *mac, const void *key)
+{
+    (void) mac;
+    _expand_key(&_aes, key);
+}
+
+void gnrc_lorawan_aes128_encrypt(gnrc_lorawan_t *mac, const void *in, void *out)
+{
+    (void) mac;
+    _encrypt_blocks(&_aes, in, out, 1);
+}
+
+void gnrc_lorawan_aes128_encrypt_blocks(gnrc_lorawan_t *mac, const void *in, void *out,
+                                        size_t numof)
+{
+    (void) mac;
+    _encrypt_blocks(&_aes, in, out, numof);
+}
+
+/* Multiply by x in GF(2^128), as used by the CMAC subkey generation */
+static void _cmac_dbl(uint8_t *out, const uint8_t *in)
+{
+    uint8_t carry = in[0] & 0x80;
+
+    for (unsigned i = 0; i < BLOCK_SIZE - 1; i++) {
+        out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+    }
+    out[BLOCK_SIZE - 1] = (in[BLOCK_SIZE - 1] << 1) ^ (carry ? 0x87 : 0);
+}
+
+static void _cmac_block(const uint8_t *block)
+{
+    for (unsigned i = 0; i < BLOCK_SIZE; i++) {
+        _cmac.x[i] ^= block[i];
+    }
+    _encrypt_blocks(&_cmac.key, _cmac.x, _cmac.x, 1);
+}
+
+void gnrc_lorawan_cmac_init(gnrc_lorawan_t *mac, const void *key)
+{
+    uint8_t l[BLOCK_SIZE] = { 0 };
+
+    (void) mac;
+    _expand_key(&_cmac.key, key);
+    _encrypt_blocks(&_cmac.key, l, l, 1);
+    _cmac_dbl(_cmac.k1, l);
+    _cmac_dbl(_cmac.k2, _cmac.k1);
+    memset(_cmac.x, 0, sizeof(_cmac.x));
+    _cmac.len = 0;
+}
+
+void gnrc_lorawan_cmac_update(gnrc_lorawan_t *mac, const void *buf, size_t len)
+{
+    const uint8_t *data = buf;
+
+    (void) mac;
+    while (len) {
+        /* The last block is processed by gnrc_lorawan_cmac_finish */
+        if (_cmac.len == BLOCK_SIZE) {
+            _cmac_block(_cmac.buf);
+            _cmac.len = 0;
+        }
+        size_t chunk = BLOCK_SIZE - _cmac.len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(&_cmac.buf[_cmac.len], data, chunk);
+        _cmac.len += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+void gnrc_lorawan_cmac_finish(gnrc_lorawan_t *mac, void *out)
+{
+    const uint8_t *subkey = _cmac.k1;
+
+    (void) mac;
+    if (_cmac.len < BLOCK_SIZE) {
+        _cmac.buf[_cmac.len] = 0x80;
+        memset(&_cmac.buf[_cmac.len + 1], 0, BLOCK_SIZE - _cmac.len - 1);
+        subkey = _cmac.k2;
+    }
+    for (unsigned i = 0; i < BLOCK_SIZE; i++) {
+        _cmac.buf[i] ^= subkey[i];
+    }
+    _cmac_block(_cmac.buf);
+    memcpy(out, _cmac.x, BLOCK_SIZE);
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include "gnrc_lorawan_sim/dedup.h"
+
+#if CONFIG_GNRC_LORAWAN_SIM_DEDUP
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gnrc_lorawan_internal.h"
+#include "net/lorawan/hdr.h"
+
+#define ENABLE_DEBUG (0)
+#include "debug.h"
+
+#define EMPTY (UINT32_MAX)
+
+/* Offsets of the key */
+#define DATA_DEV_ADDR   (1U)
+#define DATA_FCNT       (6U)
+#define JOIN_DEVEUI     (1U + LORAMAC_APPEUI_LEN)
+#define JOIN_DEV_NONCE  (JOIN_DEVEUI + LORAMAC_DEVEUI_LEN)
+
+static size_t _pow2(size_t n)
+{
+    size_t size = 1;
+
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+static inline uint32_t _le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static int _key(const gnrc_lorawan_sim_uplink_t *up, gnrc_lorawan_sim_dedup_entry_t *e)
+{
+    uint8_t mtype;
+
+    if (up->len < sizeof(lorawan_hdr_t) + MIC_SIZE) {
+        return -EBADMSG;
+    }
+
+    mtype = lorawan_hdr_get_mtype((lorawan_hdr_t *) up->data);
+    if (mtype == MTYPE_UNCNF_UPLINK || mtype == MTYPE_CNF_UPLINK) {
+        e->dev_addr = _le32(up->data + DATA_DEV_ADDR);
+        e->fcnt = up->data[DATA_FCNT] | (up->data[DATA_FCNT + 1] << 8);
+    }
+    else if (mtype == MTYPE_JOIN_REQUEST && up->len == JOIN_DEV_NONCE + 2 + MIC_SIZE) {
+        e->dev_addr = _le32(up->data + JOIN_DEVEUI);
+        e->fcnt = up->data[JOIN_DEV_NONCE] | (up->data[JOIN_DEV_NONCE + 1] << 8);
+    }
+    else {
+        return -EBADMSG;
+    }
+    e->mic = _le32(up->data + up->len - MIC_SIZE);
+
+    uint64_t h = ((uint64_t) e->dev_addr << 32) | ((uint64_t) e->fcnt << 16);
+    h = (h ^ e->mic) * 0x9E3779B97F4A7C15ULL;
+    e->hash = h ^ (h >> 29);
+    return 0;
+}
+
+static inline void _lock(gnrc_lorawan_sim_dedup_shard_t *shard)
+{
+    while (__atomic_test_and_set(&shard->lock, __ATOMIC_ACQUIRE)) {}
+}
+
+static inline void _unlock(gnrc_lorawan_sim_dedup_shard_t *shard)
+{
+    __atomic_clear(&shard->lock, __ATOMIC_RELEASE);
+}
+
+static inline size_t _home(const gnrc_lorawan_sim_dedup_t *dd, uint64_t hash)
+{
+    return (hash >> 32) & dd->table_mask;
+}
+
+/* Returns the table position of a key, or the empty position to insert it */
+static size_t _lookup(const gnrc_lorawan_sim_dedup_t *dd,
+                      const gnrc_lorawan_sim_dedup_shard_t *shard,
+                      const gnrc_lorawan_sim_dedup_entry_t *key)
+{
+    for (size_t pos = _home(dd, key->hash);; pos = (pos + 1) & dd->table_mask) {
+        uint32_t i = shard->table[pos];
+        if (i == EMPTY) {
+            return pos;
+        }
+        const gnrc_lorawan_sim_dedup_entry_t *e = &shard->entries[i];
+        if (e->hash == key->hash && e->dev_addr == key->dev_addr &&
+            e->fcnt == key->fcnt && e->mic == key->mic) {
+            return pos;
+        }
+    }
+}
+
+/* Backward shift deletion, so lookups never need tombstones */
+static void _remove(const gnrc_lorawan_sim_dedup_t *dd,
+                    gnrc_lorawan_sim_dedup_shard_t *shard, size_t pos)
+{
+    size_t next = pos;
+
+    shard->table[pos] = EMPTY;
+    for (;;) {
+        next = (next + 1) & dd->table_mask;
+        uint32_t i = shard->table[next];
+        if (i == EMPTY) {
+            return;
+        }
+        size_t home = _home(dd, shard->entries[i].hash);
+        /* Moves the entry if its home is not in (pos, next] */
+        if (((next - home) & dd->table_mask) >= ((next - pos) & dd->table_mask)) {
+            shard->table[pos] = i;
+            shard->table[next] = EMPTY;
+            pos = next;
+        }
+    }
+}
+
+/* Frees the released entries at the head of the ring that can't get copies
+ * anymore */
+static void _expire(const gnrc_lorawan_sim_dedup_t *dd,
+                    gnrc_lorawan_sim_dedup_shard_t *shard, uint64_t now)
+{
+    while (shard->head != shard->release) {
+        gnrc_lorawan_sim_dedup_entry_t *e = &shard->entries[shard->head & dd->ring_mask];
+        if (e->first + 2 * dd->window > now) {
+            return;
+        }
+        _remove(dd, shard, _lookup(dd, shard, e));
+        shard->head++;
+    }
+}
+
+int gnrc_lorawan_sim_dedup_init(gnrc_lorawan_sim_dedup_t *dd, size_t size,
+                                size_t shards_numof)
+{
+    size_t ring_size = _pow2(size);
+    size_t table_size = 2 * ring_size;
+
+    memset(dd, 0, sizeof(gnrc_lorawan_sim_dedup_t));
+    dd->shards_numof = _pow2(shards_numof);
+    dd->ring_mask = ring_size - 1;
+    dd->table_mask = table_size - 1;
+    dd->window = CONFIG_GNRC_LORAWAN_SIM_DEDUP_WINDOW;
+    dd->shards = calloc(dd->shards_numof, sizeof(gnrc_lorawan_sim_dedup_shard_t));
+    dd->out = malloc(dd->shards_numof * ring_size * sizeof(gnrc_lorawan_sim_uplink_t));
+    if (!dd->shards || !dd->out) {
+        gnrc_lorawan_sim_dedup_free(dd);
+        return -ENOMEM;
+    }
+
+    for (size_t s = 0; s < dd->shards_numof; s++) {
+        gnrc_lorawan_sim_dedup_shard_t *shard = &dd->shards[s];
+        shard->entries = malloc(ring_size * sizeof(gnrc_lorawan_sim_dedup_entry_t));
+        shard->table = malloc(table_size * sizeof(uint32_t));
+        if (!shard->entries || !shard->table) {
+            gnrc_lorawan_sim_dedup_free(dd);
+            return -ENOMEM;
+        }
+        memset(shard->table, 0xFF, table_size * sizeof(uint32_t));
+    }
+    return 0;
+}
+
+void gnrc_lorawan_sim_dedup_free(gnrc_lorawan_sim_dedup_t *dd)
+{
+    for (size_t s = 0; dd->shards && s < dd->shards_numof; s++) {
+        free(dd->shards[s].entries);
+        free(dd->shards[s].table);
+    }
+    free(dd->shards);
+    free(dd->out);
+    dd->shards = NULL;
+    dd->out = NULL;
+}
+
+int gnrc_lorawan_sim_dedup_add(gnrc_lorawan_sim_dedup_t *dd,
+                               const gnrc_lorawan_sim_uplink_t *copy, uint64_t now)
+{
+    gnrc_lorawan_sim_dedup_entry_t key;
+    int res;
+
+    if (_key(copy, &key) < 0) {
+        return -EBADMSG;
+    }
+    __atomic_fetch_add(&dd->stats.copies, 1, __ATOMIC_RELAXED);
+
+    gnrc_lorawan_sim_dedup_shard_t *shard = &dd->shards[key.hash & (dd->shards_numof - 1)];
+    _lock(shard);
+    _expire(dd, shard, now);
+
+    size_t pos = _lookup(dd, shard, &key);
+    if (shard->table[pos] != EMPTY) {
+        gnrc_lorawan_sim_dedup_entry_t *e = &shard->entries[shard->table[pos]];
+        if (e->released) {
+            DEBUG("gnrc_lorawan_sim_dedup: late copy of %08lx\n",
+                  (unsigned long) key.dev_addr);
+            __atomic_fetch_add(&dd->stats.late, 1, __ATOMIC_RELAXED);
+            res = -EALREADY;
+        }
+        else {
+            gnrc_lorawan_sim_net_add_gateway(&e->up, copy->gw, &copy->rx);
+            __atomic_fetch_add(&dd->stats.duplicates, 1, __ATOMIC_RELAXED);
+            res = 1;
+        }
+    }
+    else if (shard->tail - shard->head > dd->ring_mask) {
+        __atomic_fetch_add(&dd->stats.dropped, 1, __ATOMIC_RELAXED);
+        res = -ENOBUFS;
+    }
+    else {
+        uint32_t i = shard->tail++ & dd->ring_mask;
+        gnrc_lorawan_sim_dedup_entry_t *e = &shard->entries[i];
+        *e = key;
+        e->up = *copy;
+        e->first = now;
+        e->released = false;
+        shard->table[pos] = i;
+        __atomic_fetch_add(&dd->stats.uplinks, 1, __ATOMIC_RELAXED);
+        res = 0;
+    }
+
+    _unlock(shard);
+    return res;
+}
+
+static int _cmp_up(const void *a, const void *b)
+{
+    const gnrc_lorawan_sim_uplink_t *x = a;
+    const gnrc_lorawan_sim_uplink_t *y = b;
+
+    if (x->end != y->end) {
+        return x->end < y->end ? -1 : 1;
+    }
+    return (x->node > y->node) - (x->node < y->node);
+}
+
+size_t gnrc_lorawan_sim_dedup_flush(gnrc_lorawan_sim_dedup_t *dd, uint64_t now,
+                                   gnrc_lorawan_sim_dedup_cb_t cb, void *arg)
+{
+    size_t numof = 0;
+
+    for (size_t s = 0; s < dd->shards_numof; s++) {
+        gnrc_lorawan_sim_dedup_shard_t *shard = &dd->shards[s];
+        while (shard->release != shard->tail) {
+            gnrc_lorawan_sim_dedup_entry_t *e =
+                &shard->entries[shard->release & dd->ring_mask];
+            if (e->first + dd->window > now) {
+                break;
+            }
+            e->released = true;
+            dd->out[numof++] = e->up;
+            shard->release++;
+        }
+        _expire(dd, shard, now);
+    }
+
+    qsort(dd->out, numof, sizeof(gnrc_lorawan_sim_uplink_t), _cmp_up);
+    for (size_t i = 0; cb && i < numof; i++) {
+        cb(arg, &dd->out[i]);
+    }
+    return numof;
+}
+
+#else
+typedef int dont_be_pedantic;
+#endif /* CONFIG_GNRC_LORAWAN_SIM_DEDUP */
+
+/** @} */
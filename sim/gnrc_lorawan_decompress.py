@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2019 HAW Hamburg
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Decompress FRMPayloads of the GNRC LoRaWAN built-in codecs.
+
+Meant for application servers: call delta() or dictionary() on the decrypted
+payload of a FPort that has a codec on the device, with the same parameters.
+
+Usage:
+    gnrc_lorawan_decompress.py delta <width> <stride> <hex payload>
+    gnrc_lorawan_decompress.py dict <hex word>[,<hex word>...] <hex payload>
+"""
+
+import sys
+
+DICT_WORD_FLAG = 0x80
+
+
+def delta(payload, width, stride):
+    """Decode a delta + zigzag + varint payload into little endian values."""
+    if width not in (1, 2, 4) or not 1 <= stride <= 8:
+        raise ValueError("invalid codec parameters")
+    mask = (1 << (8 * width)) - 1
+    values = []
+    pos = 0
+    while pos < len(payload):
+        zigzag = 0
+        shift = 0
+        while True:
+            if pos >= len(payload) or shift > 28:
+                raise ValueError("truncated varint")
+            byte = payload[pos]
+            pos += 1
+            zigzag |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        diff = (zigzag >> 1) ^ -(zigzag & 1)
+        ref = values[-stride] if len(values) >= stride else 0
+        values.append((ref + diff) & mask)
+    return b"".join(v.to_bytes(width, "little") for v in values)
+
+
+def dictionary(payload, words):
+    """Decode a dictionary payload. `words` is the list of dictionary words."""
+    out = bytearray()
+    pos = 0
+    while pos < len(payload):
+        token = payload[pos]
+        pos += 1
+        if token & DICT_WORD_FLAG:
+            index = token & ~DICT_WORD_FLAG
+            if index >= len(words):
+                raise ValueError("unknown dictionary word %d" % index)
+            out += words[index]
+        else:
+            size = token + 1
+            if pos + size > len(payload):
+                raise ValueError("truncated literal")
+            out += payload[pos:pos + size]
+            pos += size
+    return bytes(out)
+
+
+def main(argv):
+    try:
+        if len(argv) == 5 and argv[1] == "delta":
+            out = delta(bytes.fromhex(argv[4]), int(argv[2]), int(argv[3]))
+        elif len(argv) == 4 and argv[1] == "dict":
+            words = [bytes.fromhex(w) for w in argv[2].split(",")]
+            out = dictionary(bytes.fromhex(argv[3]), words)
+        else:
+            print(__doc__.strip(), file=sys.stderr)
+            return 1
+    except ValueError as err:
+        print("malformed payload: %s" % err, file=sys.stderr)
+        return 1
+    print(out.hex())
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2019 HAW Hamburg
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Reassemble fragmented GNRC LoRaWAN uplinks.
+
+Meant for application servers: feed the decrypted FRMPayload of every uplink
+received on a FPort used for fragmented transfers (see
+CONFIG_GNRC_LORAWAN_UPLINK_FRAG) and get the original payload back once all
+fragments of a transfer arrived.
+
+Usage:
+    gnrc_lorawan_reassemble.py <hex fragment> [<hex fragment> ...]
+"""
+
+import sys
+
+HDR_SIZE = 2
+LAST = 0x1000
+INDEX_MASK = 0x0FFF
+SESSION_POS = 13
+
+
+def parse(payload):
+    """Return (session, index, last, data) of a fragment."""
+    if len(payload) < HDR_SIZE:
+        raise ValueError("fragment too short")
+    hdr = int.from_bytes(payload[:HDR_SIZE], "big")
+    return hdr >> SESSION_POS, hdr & INDEX_MASK, bool(hdr & LAST), \
+        bytes(payload[HDR_SIZE:])
+
+
+class Reassembler:
+    """Reassembles the transfers of any number of devices and FPorts.
+
+    A fragment of a new transfer drops the incomplete transfer of the same
+    device and FPort.
+    """
+
+    def __init__(self):
+        self._transfers = {}
+
+    def feed(self, dev_addr, port, payload):
+        """Add a fragment. Return the reassembled payload or None."""
+        session, index, last, data = parse(payload)
+        key = (dev_addr, port)
+        transfer = self._transfers.get(key)
+        if transfer is None or transfer["session"] != session:
+            transfer = {"session": session, "fragments": {}, "count": None}
+            self._transfers[key] = transfer
+
+        transfer["fragments"][index] = data
+        if last:
+            transfer["count"] = index + 1
+
+        count = transfer["count"]
+        if count is None or len(transfer["fragments"]) < count:
+            return None
+
+        del self._transfers[key]
+        return b"".join(transfer["fragments"][i] for i in range(count))
+
+    def missing(self, dev_addr, port):
+        """Return the indexes of the missing fragments known so far."""
+        transfer = self._transfers.get((dev_addr, port))
+        if transfer is None:
+            return []
+        fragments = transfer["fragments"]
+        end = transfer["count"] or (max(fragments) + 1)
+        return [i for i in range(end) if i not in fragments]
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 1
+    reassembler = Reassembler()
+    for arg in argv[1:]:
+        out = reassembler.feed(0, 0, bytes.fromhex(arg))
+        if out is not None:
+            print(out.hex())
+            return 0
+    print("missing fragments: %s" % reassembler.missing(0, 0), file=sys.stderr)
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
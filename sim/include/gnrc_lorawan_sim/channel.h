@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @defgroup    net_gnrc_lorawan_sim GNRC LoRaWAN simulation
+ * @ingroup     net_gnrc_lorawan
+ * @brief       Host side simulation of LoRa radios
+ * @{
+ *
+ * @file
+ * @brief   Physical layer channel model
+ *
+ * The channel model decides which receivers get a frame and with which RSSI
+ * and SNR:
+ *
+ * - The received power follows a log-distance path loss model between the
+ *   positions of the transmitter and the receiver.
+ * - A frame is lost if its SNR is below the demodulation floor of its
+ *   spreading factor.
+ * - Frames overlapping in time and frequency interfere. The power of the
+ *   interferers is summed per spreading factor and the resulting SIR is
+ *   compared against the co-channel capture threshold (same spreading factor)
+ *   or the quasi-orthogonality thresholds of Croce et al. (different
+ *   spreading factors).
+ * - Radios are half duplex and can't receive while transmitting.
+ *
+ * Transmissions must be added in non decreasing order of their start time.
+ * They are kept in a ring sorted by start time. Any transmission that
+ * overlaps an interval starts at most one maximum Time on Air before it, so
+ * overlaps are found with a binary search followed by a scan of the
+ * candidates (interval index).
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef GNRC_LORAWAN_SIM_CHANNEL_H
+#define GNRC_LORAWAN_SIM_CHANNEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GNRC_LORAWAN_SIM_SF_MIN     (7U)    /**< lowest supported spreading factor */
+#define GNRC_LORAWAN_SIM_SF_MAX     (12U)   /**< highest supported spreading factor */
+#define GNRC_LORAWAN_SIM_SF_NUMOF   (GNRC_LORAWAN_SIM_SF_MAX - GNRC_LORAWAN_SIM_SF_MIN + 1)  /**< number of spreading factors */
+
+/**
+ * @brief default path loss at the reference distance in dB
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_PL0
+#define CONFIG_GNRC_LORAWAN_SIM_PL0 127.41f
+#endif
+
+/**
+ * @brief default reference distance of the path loss model in m
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_D0
+#define CONFIG_GNRC_LORAWAN_SIM_D0 40.0f
+#endif
+
+/**
+ * @brief default path loss exponent
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_GAMMA
+#define CONFIG_GNRC_LORAWAN_SIM_GAMMA 2.08f
+#endif
+
+/**
+ * @brief default receiver noise figure in dB
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_NOISE_FIGURE
+#define CONFIG_GNRC_LORAWAN_SIM_NOISE_FIGURE 6.0f
+#endif
+
+/**
+ * @brief default co-channel capture threshold in dB
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_CAPTURE
+#define CONFIG_GNRC_LORAWAN_SIM_CAPTURE 6.0f
+#endif
+
+/**
+ * @brief Reception outcome
+ */
+typedef enum {
+    GNRC_LORAWAN_SIM_RX_OK,             /**< frame received */
+    GNRC_LORAWAN_SIM_RX_SENSITIVITY,    /**< SNR below the demodulation floor */
+    GNRC_LORAWAN_SIM_RX_COLLISION,      /**< SIR below the capture threshold */
+    GNRC_LORAWAN_SIM_RX_HALF_DUPLEX,    /**< receiver was transmitting */
+} gnrc_lorawan_sim_rx_status_t;
+
+/**
+ * @brief Simulated radio
+ */
+typedef struct {
+    float x;                /**< x position in m */
+    float y;                /**< y position in m */
+    int8_t tx_power;        /**< transmission power in dBm */
+} gnrc_lorawan_sim_radio_t;
+
+/**
+ * @brief Transmission on the channel
+ */
+typedef struct {
+    uint64_t start;         /**< start of the transmission in us */
+    uint64_t end;           /**< end of the transmission in us */
+    uint32_t freq;          /**< center frequency in Hz */
+    uint32_t radio;         /**< index of the transmitting radio */
+    uint16_t bw;            /**< bandwidth in kHz */
+    uint8_t sf;             /**< spreading factor */
+    int8_t tx_power;        /**< transmission power in dBm */
+} gnrc_lorawan_sim_tx_t;
+
+/**
+ * @brief Reception metadata
+ */
+typedef struct {
+    float rssi;             /**< received signal strength in dBm */
+    float snr;              /**< signal to noise ratio in dB */
+    float sir;              /**< worst signal to interference ratio in dB */
+} gnrc_lorawan_sim_rx_t;
+
+/**
+ * @brief Channel model descriptor
+ */
+typedef struct {
+    gnrc_lorawan_sim_radio_t *radios;   /**< radios of the simulation */
+    size_t radios_numof;                /**< number of radios */
+    gnrc_lorawan_sim_tx_t *txs;         /**< ring of transmissions */
+    size_t txs_size;                    /**< size of the ring (power of two) */
+    uint64_t head;                      /**< id of the next transmission */
+    uint64_t tail;                      /**< id of the oldest transmission */
+    uint32_t max_toa;                   /**< longest Time on Air in the ring */
+    float pl0;                          /**< path loss at d0 in dB */
+    float d0;                           /**< reference distance in m */
+    float gamma;                        /**< path loss exponent */
+    float noise_figure;                 /**< receiver noise figure in dB */
+    float capture;                      /**< co-channel capture threshold in dB */
+} gnrc_lorawan_sim_channel_t;
+
+/**
+ * @brief Init a channel model with the default propagation parameters
+ *
+ * @param[out] ch pointer to the channel descriptor
+ * @param[in] radios array of radios
+ * @param[in] radios_numof number of radios
+ * @param[in] txs buffer for the ring of transmissions
+ * @param[in] txs_size number of elements of @p txs. Must be a power of two
+ *            and hold all transmissions within twice the longest Time on Air
+ */
+void gnrc_lorawan_sim_channel_init(gnrc_lorawan_sim_channel_t *ch,
+                                   gnrc_lorawan_sim_radio_t *radios,
+                                   size_t radios_numof,
+                                   gnrc_lorawan_sim_tx_t *txs, size_t txs_size);
+
+/**
+ * @brief Calculate the Time on Air of a LoRa frame
+ *
+ * Assumes explicit header, CRC on and an 8 symbol preamble. Low data rate
+ * optimization is enabled for symbols of 16 ms or longer.
+ *
+ * @param[in] len size of the PHY payload
+ * @param[in] sf spreading factor
+ * @param[in] bw bandwidth in kHz
+ * @param[in] cr coding rate (1 for 4/5 to 4 for 4/8)
+ *
+ * @return Time on Air in us
+ */
+uint32_t gnrc_lorawan_sim_time_on_air(uint8_t len, uint8_t sf, uint16_t bw, uint8_t cr);
+
+/**
+ * @brief Add a transmission to the channel
+ *
+ * Transmissions older than twice the longest Time on Air are expired.
+ *
+ * @param[in] ch pointer to the channel descriptor
+ * @param[in] tx the transmission
+ *
+ * @return id of the transmission
+ * @return -ENOBUFS if the ring is full
+ */
+int64_t gnrc_lorawan_sim_channel_tx(gnrc_lorawan_sim_channel_t *ch,
+                                    const gnrc_lorawan_sim_tx_t *tx);
+
+/**
+ * @brief Get a transmission
+ *
+ * @param[in] ch pointer to the channel descriptor
+ * @param[in] id id of the transmission
+ *
+ * @return pointer to the transmission
+ * @return NULL if the transmission expired
+ */
+const gnrc_lorawan_sim_tx_t *gnrc_lorawan_sim_channel_get(gnrc_lorawan_sim_channel_t *ch,
+                                                          uint64_t id);
+
+/**
+ * @brief Calculate the received power of a transmission at a radio
+ *
+ * @param[in] ch pointer to the channel descriptor
+ * @param[in] tx the transmission
+ * @param[in] radio index of the receiving radio
+ *
+ * @return received power in dBm
+ */
+float gnrc_lorawan_sim_channel_rssi(const gnrc_lorawan_sim_channel_t *ch,
+                                    const gnrc_lorawan_sim_tx_t *tx, uint32_t radio);
+
+/**
+ * @brief Decide if a radio receives a transmission
+ *
+ * Should be called once the transmission ended and all transmissions that
+ * started before its end were added.
+ *
+ * @param[in] ch pointer to the channel descriptor
+ * @param[in] id id of the transmission
+ * @param[in] radio index of the receiving radio
+ * @param[out] rx reception metadata. May be NULL
+ *
+ * @return @ref gnrc_lorawan_sim_rx_status_t
+ * @return -ENOENT if the transmission expired
+ */
+int gnrc_lorawan_sim_channel_rx(gnrc_lorawan_sim_channel_t *ch, uint64_t id,
+                                uint32_t radio, gnrc_lorawan_sim_rx_t *rx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GNRC_LORAWAN_SIM_CHANNEL_H */
+/** @} */
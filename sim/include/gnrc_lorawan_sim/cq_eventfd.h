@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan
+ * @{
+ *
+ * @file
+ * @brief   Completion queue notification with a Linux eventfd
+ *
+ * Implements @ref gnrc_lorawan_cq_notify for host builds on Linux. Every
+ * event added to the completion queue of any MAC descriptor increments the
+ * counter of one eventfd. The application can wait for it with poll(),
+ * select() or epoll next to its other file descriptors, read() it once and
+ * then drain all queues with @ref gnrc_lorawan_cq_drain.
+ *
+ * Only available with @ref CONFIG_GNRC_LORAWAN_CQ.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef GNRC_LORAWAN_SIM_CQ_EVENTFD_H
+#define GNRC_LORAWAN_SIM_CQ_EVENTFD_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Get the completion queue eventfd
+ *
+ * The eventfd is non blocking and created on the first call.
+ *
+ * @return file descriptor on success
+ * @return -errno if the eventfd could not be created
+ */
+int gnrc_lorawan_sim_cq_eventfd(void);
+
+/**
+ * @brief Wait until at least one event was added to a completion queue
+ *
+ * @param[in] timeout_ms maximum time to wait (in ms), -1 to wait forever
+ *
+ * @return number of events added since the last call (may include events
+ *         that were already drained)
+ * @return 0 on timeout
+ * @return -errno on error
+ */
+int64_t gnrc_lorawan_sim_cq_wait(int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GNRC_LORAWAN_SIM_CQ_EVENTFD_H */
+/** @} */
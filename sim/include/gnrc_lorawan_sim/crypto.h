@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan
+ * @{
+ *
+ * @file
+ * @brief   Host crypto backend for simulations and network server stand-ins
+ *
+ * Implements @ref gnrc_lorawan_aes128_init, @ref gnrc_lorawan_aes128_encrypt,
+ * @ref gnrc_lorawan_aes128_encrypt_blocks and the `gnrc_lorawan_cmac_*`
+ * hooks. On x86 CPUs with AES-NI, independent blocks (the keystream of a
+ * frame with @ref CONFIG_GNRC_LORAWAN_AES128_BLOCKS) are encrypted in an
+ * interleaved batch of up to 8 blocks, so the latency of the AES rounds
+ * overlaps. A portable C implementation is used elsewhere.
+ *
+ * The key schedules live in thread local storage, so several simulation
+ * threads can use the backend at the same time.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef GNRC_LORAWAN_SIM_CRYPTO_H
+#define GNRC_LORAWAN_SIM_CRYPTO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief provide the crypto hooks of the MAC with this backend
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_CRYPTO
+#define CONFIG_GNRC_LORAWAN_SIM_CRYPTO 0
+#endif
+
+/**
+ * @brief build the AES-NI implementation (x86 with GCC or clang only)
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_CRYPTO_AESNI
+#define CONFIG_GNRC_LORAWAN_SIM_CRYPTO_AESNI 1
+#endif
+
+/**
+ * @brief Crypto implementations
+ */
+typedef enum {
+    GNRC_LORAWAN_SIM_CRYPTO_AUTO,       /**< fastest implementation supported by the CPU */
+    GNRC_LORAWAN_SIM_CRYPTO_PORTABLE,   /**< portable C implementation */
+    GNRC_LORAWAN_SIM_CRYPTO_AESNI,      /**< x86 AES-NI implementation */
+} gnrc_lorawan_sim_crypto_t;
+
+/**
+ * @brief Select the crypto implementation
+ *
+ * Affects all threads and is not thread safe: call it before the simulation
+ * threads start. Until then, the portable implementation is used.
+ *
+ * @param[in] impl implementation
+ *
+ * @return 0 on success
+ * @return -ENOTSUP if the implementation is not built or not supported by
+ *         the CPU
+ */
+int gnrc_lorawan_sim_crypto_select(gnrc_lorawan_sim_crypto_t impl);
+
+/**
+ * @brief Get the name of the crypto implementation in use
+ *
+ * @return "aesni" or "portable"
+ */
+const char *gnrc_lorawan_sim_crypto_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GNRC_LORAWAN_SIM_CRYPTO_H */
+/** @} */
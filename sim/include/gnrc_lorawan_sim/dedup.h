@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan_sim
+ * @{
+ *
+ * @file
+ * @brief   Deduplication of the uplink copies of several gateways
+ *
+ * Every gateway that receives an uplink forwards its own copy to the network
+ * server. The deduplication stage collapses the copies before the MIC is
+ * verified and the payload decrypted, so the crypto work is done once per
+ * uplink instead of once per gateway:
+ *
+ * - Copies are identified by (DevAddr, FCnt, MIC). Join Requests have no
+ *   DevAddr and use the lower 32 bits of the DevEUI and the DevNonce
+ *   instead.
+ * - The first copy opens an entry. Copies received within
+ *   @ref gnrc_lorawan_sim_dedup_t::window are merged into it: the entry
+ *   keeps the metadata of the copy with the best SNR and the best gateways
+ *   by SNR for the routing of the downlink.
+ * - @ref gnrc_lorawan_sim_dedup_flush releases the entries whose window
+ *   closed, ordered by the end of the uplink and then by node, so the order
+ *   doesn't depend on the threads of the gateways. Copies received up to one
+ *   window after that are dropped as late.
+ *
+ * The entries are split into shards by hash. Every shard is an open
+ * addressing table protected by a spin lock, so gateways of different
+ * threads rarely wait for each other. The entries of a shard are allocated
+ * from a ring in arrival order and freed from its head, which keeps the
+ * release in order without scanning the table.
+ *
+ * Only available with @ref CONFIG_GNRC_LORAWAN_SIM_DEDUP.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef GNRC_LORAWAN_SIM_DEDUP_H
+#define GNRC_LORAWAN_SIM_DEDUP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "gnrc_lorawan_sim/net.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief enable the deduplication stage
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_DEDUP
+#define CONFIG_GNRC_LORAWAN_SIM_DEDUP 0
+#endif
+
+/**
+ * @brief default deduplication window in us
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_DEDUP_WINDOW
+#define CONFIG_GNRC_LORAWAN_SIM_DEDUP_WINDOW (200000U)
+#endif
+
+/**
+ * @brief Uplink collected from the copies of several gateways
+ */
+typedef struct {
+    gnrc_lorawan_sim_uplink_t up;   /**< merged uplink */
+    uint64_t first;                 /**< arrival of the first copy in us */
+    uint64_t hash;                  /**< hash of the key */
+    uint32_t dev_addr;              /**< DevAddr */
+    uint32_t mic;                   /**< MIC */
+    uint16_t fcnt;                  /**< FCnt */
+    uint8_t released;               /**< passed to the network server */
+} gnrc_lorawan_sim_dedup_entry_t;
+
+/**
+ * @brief Shard of the deduplication table
+ */
+typedef struct {
+    gnrc_lorawan_sim_dedup_entry_t *entries;    /**< ring of entries */
+    uint32_t *table;                /**< hash table of entry indices */
+    uint32_t head;                  /**< oldest entry */
+    uint32_t release;               /**< oldest entry not released */
+    uint32_t tail;                  /**< next entry */
+    uint8_t lock;                   /**< spin lock */
+} gnrc_lorawan_sim_dedup_shard_t;
+
+/**
+ * @brief Deduplication counters
+ */
+typedef struct {
+    uint32_t copies;                /**< copies received */
+    uint32_t uplinks;               /**< entries opened */
+    uint32_t duplicates;            /**< copies merged into an entry */
+    uint32_t late;                  /**< copies received after the release */
+    uint32_t dropped;               /**< copies dropped because a shard was full */
+} gnrc_lorawan_sim_dedup_stats_t;
+
+/**
+ * @brief Deduplication stage descriptor
+ */
+struct gnrc_lorawan_sim_dedup {
+    gnrc_lorawan_sim_dedup_shard_t *shards; /**< shards */
+    size_t shards_numof;                    /**< number of shards */
+    size_t ring_mask;                       /**< size of a ring - 1 */
+    size_t table_mask;                      /**< size of a hash table - 1 */
+    gnrc_lorawan_sim_uplink_t *out;         /**< uplinks released by a flush */
+    uint64_t window;                        /**< deduplication window in us */
+    gnrc_lorawan_sim_dedup_stats_t stats;   /**< counters */
+};
+
+/**
+ * @brief Called for every released uplink
+ */
+typedef void (*gnrc_lorawan_sim_dedup_cb_t)(void *arg, const gnrc_lorawan_sim_uplink_t *up);
+
+/**
+ * @brief Init a deduplication stage
+ *
+ * The window is @ref CONFIG_GNRC_LORAWAN_SIM_DEDUP_WINDOW until
+ * @ref gnrc_lorawan_sim_dedup_t::window is changed.
+ *
+ * @param[out] dd pointer to the descriptor
+ * @param[in] size maximum number of entries of a shard
+ * @param[in] shards_numof number of shards, rounded up to a power of two
+ *
+ * @return 0 on success
+ * @return -ENOMEM if the buffers could not be allocated
+ */
+int gnrc_lorawan_sim_dedup_init(gnrc_lorawan_sim_dedup_t *dd, size_t size,
+                                size_t shards_numof);
+
+/**
+ * @brief Free the buffers of a deduplication stage
+ *
+ * @param[in] dd pointer to the descriptor
+ */
+void gnrc_lorawan_sim_dedup_free(gnrc_lorawan_sim_dedup_t *dd);
+
+/**
+ * @brief Add the copy of an uplink received by one gateway
+ *
+ * @p copy has one gateway in @ref gnrc_lorawan_sim_uplink_t::gw_list. Its
+ * PHY payload must stay valid until the uplink is released. Thread safe, but
+ * must not run concurrently with @ref gnrc_lorawan_sim_dedup_flush.
+ *
+ * @param[in] dd pointer to the descriptor
+ * @param[in] copy the copy
+ * @param[in] now arrival time in us
+ *
+ * @return 0 if the copy opened an entry
+ * @return 1 if the copy was merged into an entry
+ * @return -EALREADY if the entry was already released
+ * @return -EBADMSG if @p copy is neither a data uplink nor a Join Request
+ * @return -ENOBUFS if the shard is full
+ */
+int gnrc_lorawan_sim_dedup_add(gnrc_lorawan_sim_dedup_t *dd,
+                               const gnrc_lorawan_sim_uplink_t *copy, uint64_t now);
+
+/**
+ * @brief Release the uplinks whose window closed
+ *
+ * Calls @p cb for every released uplink, ordered by the end of the uplink
+ * and then by node.
+ *
+ * @param[in] dd pointer to the descriptor
+ * @param[in] now current time in us
+ * @param[in] cb callback
+ * @param[in] arg argument of @p cb
+ *
+ * @return number of released uplinks
+ */
+size_t gnrc_lorawan_sim_dedup_flush(gnrc_lorawan_sim_dedup_t *dd, uint64_t now,
+                                   gnrc_lorawan_sim_dedup_cb_t cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GNRC_LORAWAN_SIM_DEDUP_H */
+/** @} */
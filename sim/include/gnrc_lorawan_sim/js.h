@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan_sim
+ * @{
+ *
+ * @file
+ * @brief   Join server stand-in for OTAA end to end tests
+ *
+ * Server side of @ref gnrc_lorawan_mlme_process_join. Join Requests are
+ * queued with @ref gnrc_lorawan_sim_js_request together with the latest time
+ * they can be answered (usually the start of RX1) and processed as a batch by
+ * @ref gnrc_lorawan_sim_js_flush, earliest deadline first. For every request
+ * of the batch the join server:
+ *
+ * 1. Looks up the device by DevEUI in an open addressing hash table and
+ *    checks the AppEUI.
+ * 2. Verifies the MIC with the AppKey.
+ * 3. Rejects DevNonces already used by the device.
+ * 4. Derives the session keys and builds the Join Accept, with a CFList if
+ *    @ref gnrc_lorawan_sim_js_t::cflist_numof is not zero.
+ *
+ * Used DevNonces are stored in a bitmap per device. The 65536 bits are split
+ * into pages of 256 bits that are only allocated when a nonce of the page is
+ * used, so a device costs 4 bytes plus 40 bytes per join.
+ *
+ * Crypto goes through the `gnrc_lorawan_*` crypto hooks (e.g.
+ * @ref gnrc_lorawan_sim/crypto.h) and RIOT's AES for the encryption of the
+ * Join Accept. Not thread safe.
+ *
+ * Only available with @ref CONFIG_GNRC_LORAWAN_SIM_JS.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef GNRC_LORAWAN_SIM_JS_H
+#define GNRC_LORAWAN_SIM_JS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "gnrc_lorawan/lorawan.h"
+#include "net/loramac.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief enable the join server
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_JS
+#define CONFIG_GNRC_LORAWAN_SIM_JS 0
+#endif
+
+#define GNRC_LORAWAN_SIM_JS_REQUEST_SIZE    (23U)   /**< size of a Join Request */
+#define GNRC_LORAWAN_SIM_JS_ACCEPT_MAX      (33U)   /**< size of a Join Accept with CFList */
+#define GNRC_LORAWAN_SIM_JS_CFLIST_MAX      (5U)    /**< frequencies of a CFList */
+#define GNRC_LORAWAN_SIM_JS_PAGE_BITS       (256U)  /**< DevNonces per bitmap page */
+
+/**
+ * @brief Device known by the join server
+ */
+typedef struct {
+    uint8_t deveui[LORAMAC_DEVEUI_LEN];     /**< DevEUI */
+    uint8_t appeui[LORAMAC_APPEUI_LEN];     /**< AppEUI */
+    uint8_t appkey[LORAMAC_APPKEY_LEN];     /**< AppKey */
+    uint32_t nonces;                        /**< first bitmap page + 1, 0 if none */
+} gnrc_lorawan_sim_js_dev_t;
+
+/**
+ * @brief Page of the DevNonce bitmap of a device
+ */
+typedef struct {
+    uint32_t next;                  /**< next page + 1, 0 if last */
+    uint8_t high;                   /**< upper byte of the DevNonces of the page */
+    uint8_t bits[GNRC_LORAWAN_SIM_JS_PAGE_BITS / 8];    /**< used DevNonces */
+} gnrc_lorawan_sim_js_page_t;
+
+/**
+ * @brief Queued Join Request
+ */
+typedef struct {
+    uint64_t deadline;              /**< latest time to answer in us */
+    uint64_t arg;                   /**< argument of the request */
+    uint32_t seq;                   /**< arrival order */
+    uint8_t data[GNRC_LORAWAN_SIM_JS_REQUEST_SIZE];     /**< the Join Request */
+} gnrc_lorawan_sim_js_req_t;
+
+/**
+ * @brief Accepted join
+ */
+typedef struct {
+    uint64_t arg;                   /**< argument of the request */
+    uint32_t dev;                   /**< index of the device */
+    uint32_t dev_addr;              /**< assigned device address */
+    uint8_t nwkskey[LORAMAC_NWKSKEY_LEN];   /**< network session key */
+    uint8_t appskey[LORAMAC_APPSKEY_LEN];   /**< application session key */
+    uint8_t frame[GNRC_LORAWAN_SIM_JS_ACCEPT_MAX];      /**< encrypted Join Accept */
+    uint8_t len;                    /**< size of the Join Accept */
+    uint8_t late;                   /**< processed after the deadline */
+} gnrc_lorawan_sim_js_accept_t;
+
+/**
+ * @brief Join server counters
+ */
+typedef struct {
+    uint32_t accepted;              /**< Join Accepts generated */
+    uint32_t late;                  /**< Join Accepts generated after the deadline */
+    uint32_t unknown;               /**< unknown DevEUI or wrong AppEUI */
+    uint32_t mic_failures;          /**< wrong MIC */
+    uint32_t replays;               /**< DevNonce used before */
+    uint32_t dropped;               /**< batch or bitmap pages full */
+    uint32_t batches;               /**< non empty flushes */
+    uint32_t batch_max;             /**< largest batch */
+} gnrc_lorawan_sim_js_stats_t;
+
+typedef struct gnrc_lorawan_sim_js gnrc_lorawan_sim_js_t;
+
+/**
+ * @brief Called for every accepted join, in deadline order
+ */
+typedef void (*gnrc_lorawan_sim_js_accept_cb_t)(gnrc_lorawan_sim_js_t *js,
+                                                const gnrc_lorawan_sim_js_accept_t *acc);
+
+/**
+ * @brief Join server descriptor
+ */
+struct gnrc_lorawan_sim_js {
+    gnrc_lorawan_sim_js_dev_t *devs;        /**< devices */
+    size_t devs_numof;                      /**< number of devices */
+    size_t devs_size;                       /**< maximum number of devices */
+    uint32_t *table;                        /**< DevEUI hash table of device indices */
+    size_t table_mask;                      /**< size of the hash table - 1 */
+    gnrc_lorawan_sim_js_page_t *pages;      /**< DevNonce bitmap pages */
+    size_t pages_numof;                     /**< number of allocated pages */
+    size_t pages_size;                      /**< maximum number of pages */
+    gnrc_lorawan_sim_js_req_t *batch;       /**< queued Join Requests */
+    size_t batch_numof;                     /**< number of queued Join Requests */
+    size_t batch_size;                      /**< maximum number of queued Join Requests */
+    uint32_t seq;                           /**< number of queued Join Requests so far */
+    uint32_t app_nonce;                     /**< last AppNonce */
+    uint32_t net_id;                        /**< NetID */
+    uint32_t dev_addr_base;                 /**< DevAddr of the first device */
+    uint32_t cflist[GNRC_LORAWAN_SIM_JS_CFLIST_MAX];    /**< CFList frequencies in Hz */
+    uint8_t cflist_numof;                   /**< number of CFList frequencies, 0 for none */
+    uint8_t dl_settings;                    /**< DLSettings of the Join Accepts */
+    uint8_t rx_delay;                       /**< RxDelay of the Join Accepts */
+    gnrc_lorawan_sim_js_accept_cb_t accept; /**< accepted join callback */
+    void *arg;                              /**< user argument */
+    gnrc_lorawan_sim_js_stats_t stats;      /**< counters */
+    gnrc_lorawan_t mac;                     /**< only passed to the crypto hooks */
+};
+
+/**
+ * @brief Init a join server
+ *
+ * Devices get the DevAddr @p dev_addr_base + their index. The Join Accepts
+ * have no CFList, RX1DROffset 0 and RxDelay 1 s until the fields of the
+ * descriptor are changed.
+ *
+ * @param[out] js pointer to the descriptor
+ * @param[in] devs_size maximum number of devices
+ * @param[in] pages_size maximum number of DevNonce bitmap pages
+ * @param[in] batch_size maximum number of queued Join Requests
+ * @param[in] net_id NetID
+ * @param[in] dev_addr_base DevAddr of the first device
+ *
+ * @return 0 on success
+ * @return -ENOMEM if the buffers could not be allocated
+ */
+int gnrc_lorawan_sim_js_init(gnrc_lorawan_sim_js_t *js, size_t devs_size,
+                             size_t pages_size, size_t batch_size,
+                             uint32_t net_id, uint32_t dev_addr_base);
+
+/**
+ * @brief Free the buffers of a join server
+ *
+ * @param[in] js pointer to the descriptor
+ */
+void gnrc_lorawan_sim_js_free(gnrc_lorawan_sim_js_t *js);
+
+/**
+ * @brief Add a device
+ *
+ * @param[in] js pointer to the descriptor
+ * @param[in] deveui DevEUI
+ * @param[in] appeui AppEUI
+ * @param[in] appkey AppKey
+ *
+ * @return index of the device
+ * @return -EEXIST if the DevEUI is already known
+ * @return -ENOSPC if the device table is full
+ */
+int gnrc_lorawan_sim_js_add(gnrc_lorawan_sim_js_t *js, const uint8_t *deveui,
+                            const uint8_t *appeui, const uint8_t *appkey);
+
+/**
+ * @brief Queue a Join Request
+ *
+ * @param[in] js pointer to the descriptor
+ * @param[in] data PHY payload
+ * @param[in] len size of the PHY payload
+ * @param[in] deadline latest time to answer in us
+ * @param[in] arg argument passed back in @ref gnrc_lorawan_sim_js_accept_t
+ *
+ * @return 0 on success
+ * @return -EBADMSG if @p data is not a Join Request
+ * @return -ENOBUFS if the batch is full
+ */
+int gnrc_lorawan_sim_js_request(gnrc_lorawan_sim_js_t *js, const uint8_t *data,
+                                size_t len, uint64_t deadline, uint64_t arg);
+
+/**
+ * @brief Process all queued Join Requests
+ *
+ * Calls @ref gnrc_lorawan_sim_js_t::accept for every accepted join, earliest
+ * deadline first. Joins processed after their deadline are marked late.
+ *
+ * @param[in] js pointer to the descriptor
+ * @param[in] now current time in us
+ *
+ * @return number of accepted joins
+ */
+size_t gnrc_lorawan_sim_js_flush(gnrc_lorawan_sim_js_t *js, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GNRC_LORAWAN_SIM_JS_H */
+/** @} */
@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan_sim
+ * @{
+ *
+ * @file
+ * @brief   Discrete event simulation of LoRaWAN nodes and gateways
+ *
+ * Runs many MAC descriptors in one process against the channel model of
+ * @ref gnrc_lorawan_sim/channel.h. Implements the radio, timer and random
+ * hooks of the MAC on a virtual clock:
+ *
+ * - @ref gnrc_lorawan_radio_send puts the frame on the channel. Its end is an
+ *   event that reports the frame to the network server callback (with the
+ *   best gateway that received it) and then calls
+ *   @ref gnrc_lorawan_event_tx_complete.
+ * - @ref gnrc_lorawan_radio_rx_on opens a reception that locks on a downlink
+ *   starting within the symbol timeout (or up to
+ *   @ref GNRC_LORAWAN_SIM_PREAMBLE_LATE symbols before it), or calls
+ *   @ref gnrc_lorawan_event_timeout. Locked frames are passed to
+ *   @ref gnrc_lorawan_process_pkt with the RSSI and SNR of the channel model,
+ *   or reported as a timeout if they were lost.
+ * - @ref gnrc_lorawan_timer_set schedules @ref gnrc_lorawan_timer_fired.
+ *
+ * Gateways are radios of the channel model without a MAC. The network server
+ * is emulated by the application, which answers uplinks with
+ * @ref gnrc_lorawan_sim_net_downlink. Gateways are half duplex and transmit
+ * one downlink at a time. With a deduplication stage
+ * (@ref gnrc_lorawan_sim_net_t::dedup), every receiving gateway forwards its
+ * own copy of an uplink and the callback gets the merged uplink when the
+ * deduplication window closed.
+ *
+ * Events are kept in a binary heap ordered by time and insertion order, so
+ * a run is deterministic for a given seed. Cancelled timers and receptions
+ * stay in the heap until they expire and are skipped.
+ *
+ * Large simulations can be split into shards run by several threads with
+ * @ref gnrc_lorawan_sim/par.h.
+ *
+ * Only available with @ref CONFIG_GNRC_LORAWAN_SIM_NET. Can't be combined
+ * with other implementations of the radio and timer hooks.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef GNRC_LORAWAN_SIM_NET_H
+#define GNRC_LORAWAN_SIM_NET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan_sim/channel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief provide the radio, timer and random hooks of the MAC
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_NET
+#define CONFIG_GNRC_LORAWAN_SIM_NET 0
+#endif
+
+/**
+ * @brief RSSI threshold of @ref gnrc_lorawan_radio_cca in dBm
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_CCA_THRESHOLD
+#define CONFIG_GNRC_LORAWAN_SIM_CCA_THRESHOLD (-80)
+#endif
+
+/**
+ * @brief number of receiving gateways reported with an uplink
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS
+#define CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS (4U)
+#endif
+
+#define GNRC_LORAWAN_SIM_FRAME_MAX  (255U)  /**< maximum PHY payload size */
+#define GNRC_LORAWAN_SIM_PREAMBLE_LATE (3U) /**< preamble symbols a radio can miss and still lock */
+
+typedef struct gnrc_lorawan_sim_net gnrc_lorawan_sim_net_t;
+typedef struct gnrc_lorawan_sim_par gnrc_lorawan_sim_par_t;
+typedef struct gnrc_lorawan_sim_dedup gnrc_lorawan_sim_dedup_t;
+
+/**
+ * @brief Simulated node
+ */
+typedef struct {
+    gnrc_lorawan_t mac;             /**< MAC descriptor. Must be the first member */
+    gnrc_lorawan_sim_net_t *net;    /**< network of the node */
+    uint64_t airtime;               /**< accumulated Time on Air in us */
+    uint64_t rx_start;              /**< start of the current reception */
+    uint64_t tx_id;                 /**< channel id of the last transmission */
+    uint32_t radio;                 /**< index of the radio in the channel model */
+    uint32_t freq;                  /**< configured frequency in Hz */
+    uint32_t tx_count;              /**< number of transmitted frames */
+    uint32_t timer_gen;             /**< generation of the MAC timer, 0 if stopped */
+    uint32_t timer_seq;             /**< last generation of the MAC timer */
+    uint32_t timer_last_gen;        /**< generation of the latest timer event */
+    uint64_t timer_last;            /**< time of the latest timer event in us */
+    uint32_t rx_gen;                /**< generation of the reception */
+    uint32_t rng;                   /**< state of the random generator */
+    int32_t rx_frame;               /**< downlink slot being received, -1 if none */
+    int32_t rx_last;                /**< last downlink slot that started, -1 if none */
+    uint16_t rx_symbols;            /**< symbol timeout of the reception */
+    uint16_t bw;                    /**< configured bandwidth in kHz */
+    uint8_t sf;                     /**< configured spreading factor */
+    uint8_t cr;                     /**< configured coding rate */
+    uint8_t iq_invert;              /**< IQ inversion enabled */
+    uint8_t rx_on;                  /**< reception in progress */
+    uint8_t tx_len;                 /**< size of the frame in the air */
+    uint8_t tx_data[GNRC_LORAWAN_SIM_FRAME_MAX]; /**< frame in the air */
+} gnrc_lorawan_sim_node_t;
+
+/**
+ * @brief Scheduled event
+ */
+typedef struct {
+    uint64_t time;                  /**< time of the event in us */
+    uint64_t seq;                   /**< insertion order */
+    uint64_t arg;                   /**< argument of the event */
+    uint32_t node;                  /**< index of the node */
+    uint32_t gen;                   /**< generation the event belongs to */
+    uint8_t type;                   /**< type of the event */
+} gnrc_lorawan_sim_event_t;
+
+/**
+ * @brief Scheduled downlink
+ */
+typedef struct {
+    uint64_t start;                 /**< start of the transmission in us */
+    uint64_t end;                   /**< end of the transmission in us */
+    uint64_t tx;                    /**< id of the transmission on the channel */
+    uint32_t gw;                    /**< radio index of the gateway */
+    uint32_t freq;                  /**< frequency in Hz */
+    uint8_t sf;                     /**< spreading factor */
+    uint8_t used;                   /**< slot in use */
+    uint8_t len;                    /**< size of the frame */
+    uint8_t data[GNRC_LORAWAN_SIM_FRAME_MAX]; /**< frame */
+} gnrc_lorawan_sim_dl_t;
+
+/**
+ * @brief Uplink received by the network
+ */
+typedef struct {
+    const uint8_t *data;            /**< PHY payload */
+    uint64_t end;                   /**< end of the transmission in us */
+    uint32_t node;                  /**< index of the transmitting node */
+    uint32_t gw;                    /**< radio index of the gateway with the best SNR */
+    uint32_t gw_list[CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS];   /**< best gateways by SNR */
+    float snr[CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS];          /**< SNR at @p gw_list in dB */
+    uint32_t freq;                  /**< frequency in Hz */
+    gnrc_lorawan_sim_rx_t rx;       /**< reception metadata at @p gw */
+    uint8_t gws;                    /**< number of gateways that received it */
+    uint8_t sf;                     /**< spreading factor */
+    uint8_t len;                    /**< size of the PHY payload */
+} gnrc_lorawan_sim_uplink_t;
+
+/**
+ * @brief Network server callback, called for every uplink received by at
+ *        least one gateway
+ */
+typedef void (*gnrc_lorawan_sim_uplink_cb_t)(gnrc_lorawan_sim_net_t *net,
+                                            const gnrc_lorawan_sim_uplink_t *up);
+
+/**
+ * @brief Application callback of @ref gnrc_lorawan_sim_net_schedule
+ */
+typedef void (*gnrc_lorawan_sim_app_cb_t)(gnrc_lorawan_sim_net_t *net,
+                                         gnrc_lorawan_sim_node_t *node,
+                                         uint64_t arg);
+
+/**
+ * @brief Simulated network descriptor
+ */
+struct gnrc_lorawan_sim_net {
+    gnrc_lorawan_sim_channel_t *ch;     /**< channel model */
+    gnrc_lorawan_sim_node_t *nodes;     /**< nodes */
+    size_t nodes_numof;                 /**< number of nodes */
+    const uint32_t *gws;                /**< radio indices of the gateways */
+    size_t gws_numof;                   /**< number of gateways */
+    gnrc_lorawan_sim_event_t *events;   /**< event heap */
+    size_t events_size;                 /**< size of the event heap */
+    size_t events_numof;                /**< number of pending events */
+    gnrc_lorawan_sim_dl_t *dls;         /**< downlink slots */
+    size_t dls_size;                    /**< number of downlink slots */
+    gnrc_lorawan_sim_uplink_cb_t uplink;    /**< network server callback */
+    gnrc_lorawan_sim_app_cb_t app;      /**< application callback */
+    void *arg;                          /**< user argument */
+    gnrc_lorawan_sim_par_t *par;        /**< parallel engine of a shard, or NULL */
+    gnrc_lorawan_sim_dedup_t *dedup;    /**< deduplication stage, or NULL */
+    uint64_t now;                       /**< current time in us */
+    uint64_t seq;                       /**< next insertion order */
+    uint64_t processed;                 /**< number of processed events */
+    uint32_t lost;                      /**< events dropped because the heap was full */
+};
+
+/**
+ * @brief Init a simulated network
+ *
+ * The radio index of every node must be set before. The MAC descriptors are
+ * initialized by the application afterwards with @ref gnrc_lorawan_init.
+ *
+ * @param[out] net pointer to the network descriptor
+ * @param[in] ch initialized channel model
+ * @param[in] nodes array of nodes
+ * @param[in] nodes_numof number of nodes
+ * @param[in] gws radio indices of the gateways
+ * @param[in] gws_numof number of gateways
+ * @param[in] events buffer for the event heap. Should hold a few events per
+ *            node
+ * @param[in] events_size number of elements of @p events
+ * @param[in] dls buffer for the downlinks scheduled at the same time
+ * @param[in] dls_size number of elements of @p dls
+ * @param[in] seed seed of the random generators of the nodes
+ */
+void gnrc_lorawan_sim_net_init(gnrc_lorawan_sim_net_t *net,
+                               gnrc_lorawan_sim_channel_t *ch,
+                               gnrc_lorawan_sim_node_t *nodes, size_t nodes_numof,
+                               const uint32_t *gws, size_t gws_numof,
+                               gnrc_lorawan_sim_event_t *events, size_t events_size,
+                               gnrc_lorawan_sim_dl_t *dls, size_t dls_size,
+                               uint32_t seed);
+
+/**
+ * @brief Get the node of a MAC descriptor
+ *
+ * @param[in] mac pointer to the MAC descriptor of a simulated node
+ *
+ * @return pointer to the node
+ */
+static inline gnrc_lorawan_sim_node_t *gnrc_lorawan_sim_node(gnrc_lorawan_t *mac)
+{
+    return (gnrc_lorawan_sim_node_t *) mac;
+}
+
+/**
+ * @brief Schedule a call of the application callback
+ *
+ * @param[in] net pointer to the network descriptor
+ * @param[in] node index of the node
+ * @param[in] time time of the call in us. Not before the current time
+ * @param[in] arg argument of the callback
+ *
+ * @return 0 on success
+ * @return -ENOBUFS if the event heap is full
+ */
+int gnrc_lorawan_sim_net_schedule(gnrc_lorawan_sim_net_t *net, uint32_t node,
+                                  uint64_t time, uint64_t arg);
+
+/**
+ * @brief Schedule a downlink
+ *
+ * @param[in] net pointer to the network descriptor
+ * @param[in] gw radio index of the transmitting gateway
+ * @param[in] start start of the transmission in us. Not before the current
+ *            time
+ * @param[in] freq frequency in Hz
+ * @param[in] sf spreading factor (125 kHz bandwidth)
+ * @param[in] data PHY payload
+ * @param[in] len size of the PHY payload
+ *
+ * @return 0 on success
+ * @return -EBUSY if the gateway transmits another downlink at that time
+ * @return -ENOBUFS if all downlink slots are in use
+ */
+int gnrc_lorawan_sim_net_downlink(gnrc_lorawan_sim_net_t *net, uint32_t gw,
+                                  uint64_t start, uint32_t freq, uint8_t sf,
+                                  const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Schedule the start of a downlink for a single node
+ *
+ * Used by the parallel engine, which delivers every downlink only to the
+ * addressed node. The downlink slot must stay valid until the reception
+ * ended.
+ *
+ * @param[in] net pointer to the network descriptor
+ * @param[in] node index of the node
+ * @param[in] slot index of the downlink slot
+ *
+ * @return 0 on success
+ * @return -ENOBUFS if the event heap is full
+ */
+int gnrc_lorawan_sim_net_rx_start(gnrc_lorawan_sim_net_t *net, uint32_t node,
+                                  uint32_t slot);
+
+/**
+ * @brief Decide which gateways receive an uplink
+ *
+ * Sets @ref gnrc_lorawan_sim_uplink_t::gws, the best gateways by SNR and the
+ * reception metadata of the best one. All transmissions that started before
+ * the end of the uplink must be on the channel.
+ *
+ * @param[in] ch channel model
+ * @param[in] gws radio indices of the gateways
+ * @param[in] gws_numof number of gateways
+ * @param[in] id channel id of the uplink
+ * @param[out] up the uplink
+ */
+void gnrc_lorawan_sim_net_gateways(gnrc_lorawan_sim_channel_t *ch, const uint32_t *gws,
+                                   size_t gws_numof, uint64_t id,
+                                   gnrc_lorawan_sim_uplink_t *up);
+
+/**
+ * @brief Add a receiving gateway to an uplink
+ *
+ * Inserts the gateway into the best gateways by SNR and takes its reception
+ * metadata if it is the best one so far.
+ *
+ * @param[in,out] up the uplink
+ * @param[in] gw radio index of the gateway
+ * @param[in] rx reception metadata at @p gw
+ */
+void gnrc_lorawan_sim_net_add_gateway(gnrc_lorawan_sim_uplink_t *up, uint32_t gw,
+                                      const gnrc_lorawan_sim_rx_t *rx);
+
+/**
+ * @brief Forward the copies of an uplink of every receiving gateway to a
+ *        deduplication stage
+ *
+ * Only available with @ref CONFIG_GNRC_LORAWAN_SIM_DEDUP.
+ *
+ * @param[in] dd deduplication stage
+ * @param[in] ch channel model
+ * @param[in] gws radio indices of the gateways
+ * @param[in] gws_numof number of gateways
+ * @param[in] id channel id of the uplink
+ * @param[in] up the uplink, without gateways
+ *
+ * @return number of copies that opened an entry
+ */
+size_t gnrc_lorawan_sim_net_forward(gnrc_lorawan_sim_dedup_t *dd,
+                                    gnrc_lorawan_sim_channel_t *ch, const uint32_t *gws,
+                                    size_t gws_numof, uint64_t id,
+                                    const gnrc_lorawan_sim_uplink_t *up);
+
+/**
+ * @brief Finish the reception of a downlink at the current time
+ *
+ * Decides with the channel model if the node received the downlink and
+ * passes it to the MAC, or reports a reception timeout. All transmissions
+ * that started before the end of the downlink must be on the channel.
+ *
+ * @param[in] net pointer to the network descriptor
+ * @param[in] node index of the node
+ * @param[in] slot index of the downlink slot
+ */
+void gnrc_lorawan_sim_net_rx_end(gnrc_lorawan_sim_net_t *net, uint32_t node,
+                                 uint32_t slot);
+
+/**
+ * @brief Process all events up to a given time
+ *
+ * The current time is @p until afterwards.
+ *
+ * @param[in] net pointer to the network descriptor
+ * @param[in] until end of the run in us
+ *
+ * @return number of processed events
+ */
+uint64_t gnrc_lorawan_sim_net_run(gnrc_lorawan_sim_net_t *net, uint64_t until);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GNRC_LORAWAN_SIM_NET_H */
+/** @} */
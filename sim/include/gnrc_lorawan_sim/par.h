@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan_sim
+ * @{
+ *
+ * @file
+ * @brief   Parallel simulation of LoRaWAN nodes across threads
+ *
+ * Splits the nodes of a simulation into shards of consecutive nodes. Every
+ * shard is a @ref gnrc_lorawan_sim_net_t with its own event heap and is run
+ * by its own thread. The shards run independently during a time window and
+ * synchronize at its end:
+ *
+ * 1. The transmissions started in the window are added to the channel model
+ *    in start order.
+ * 2. In parallel, the gateways decide about the uplinks and the nodes about
+ *    the downlinks that ended in the window. Nodes get the outcome of a
+ *    downlink at the end of the window.
+ * 3. The network server callback is called for every received uplink in
+ *    order of their end. It schedules the answers with
+ *    @ref gnrc_lorawan_sim_par_downlink.
+ *
+ * With a deduplication stage (@ref gnrc_lorawan_sim_par_t::dedup), the
+ * gateways of step 2 forward their copies concurrently into its shards.
+ * All copies of an uplink arrive at its end, so the uplinks of a window are
+ * released at the end of the window instead of one deduplication window
+ * later.
+ *
+ * The window is not longer than the minimum RX1 delay, so answers always
+ * start after the window of their uplink (conservative synchronization).
+ * Transmissions and uplinks go from the shards to the coordinator, and
+ * downlinks from the coordinator to the shards, through bounded lock free
+ * MPSC queues.
+ *
+ * Compared to a single @ref gnrc_lorawan_sim_net_t:
+ * - The MAC gets the outcome of a downlink up to one window after its end.
+ * - Only the addressed node locks on a downlink.
+ * - @ref gnrc_lorawan_radio_cca only sees transmissions of previous windows.
+ *
+ * A run is deterministic for a given seed and doesn't depend on the number
+ * of shards if the application does not share state between nodes. The
+ * application callbacks of the nodes run in the thread of their shard and
+ * should only touch the state of their node or use atomic operations.
+ * Application events are scheduled on the shard of a node, see
+ * @ref gnrc_lorawan_sim_node_t::net. The network server callback runs in
+ * the thread that calls @ref gnrc_lorawan_sim_par_run while the shards wait.
+ *
+ * Only available with @ref CONFIG_GNRC_LORAWAN_SIM_PAR on hosts with POSIX
+ * threads.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef GNRC_LORAWAN_SIM_PAR_H
+#define GNRC_LORAWAN_SIM_PAR_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "gnrc_lorawan_sim/net.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief enable the parallel engine
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_PAR
+#define CONFIG_GNRC_LORAWAN_SIM_PAR 0
+#endif
+
+/**
+ * @brief length of a synchronization window in us
+ *
+ * Must not be longer than the minimum RX1 delay (1 s). Shorter windows
+ * deliver downlinks to the MAC closer to their end, at the cost of more
+ * synchronization.
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_PAR_WINDOW
+#define CONFIG_GNRC_LORAWAN_SIM_PAR_WINDOW (1000000U)
+#endif
+
+/**
+ * @brief Bounded lock free queue with multiple producers and one consumer
+ */
+typedef struct {
+    uint8_t *buf;               /**< elements */
+    uint64_t *seq;              /**< sequence number of every cell */
+    size_t elem;                /**< size of an element */
+    size_t mask;                /**< number of cells - 1 */
+    uint64_t head;              /**< next cell to consume */
+    uint64_t tail;              /**< next cell to produce */
+} gnrc_lorawan_sim_mpsc_t;
+
+/**
+ * @brief Reception that waits for the end of the window
+ */
+typedef struct {
+    uint32_t node;              /**< index of the node in the shard */
+    uint32_t gen;               /**< generation of the reception */
+    uint32_t slot;              /**< downlink slot */
+} gnrc_lorawan_sim_par_rx_t;
+
+/**
+ * @brief Shard of a parallel simulation
+ */
+typedef struct {
+    gnrc_lorawan_sim_net_t net;         /**< network of the shard. Must be the first member */
+    gnrc_lorawan_sim_mpsc_t inbox;      /**< downlinks of the nodes of the shard */
+    gnrc_lorawan_sim_par_rx_t *rxs;     /**< receptions to finish */
+    size_t rxs_numof;                   /**< number of receptions to finish */
+    pthread_t thread;                   /**< worker thread */
+} gnrc_lorawan_sim_shard_t;
+
+/**
+ * @brief Transmission started in the current window
+ */
+typedef struct {
+    gnrc_lorawan_sim_tx_t tx;   /**< the transmission */
+    uint32_t node;              /**< index of the node, UINT32_MAX for a downlink */
+    uint32_t slot;              /**< downlink slot */
+} gnrc_lorawan_sim_par_tx_t;
+
+/**
+ * @brief Parallel simulation descriptor
+ */
+struct gnrc_lorawan_sim_par {
+    gnrc_lorawan_sim_channel_t *ch;         /**< channel model */
+    gnrc_lorawan_sim_node_t *nodes;         /**< nodes */
+    size_t nodes_numof;                     /**< number of nodes */
+    const uint32_t *gws;                    /**< radio indices of the gateways */
+    size_t gws_numof;                       /**< number of gateways */
+    gnrc_lorawan_sim_shard_t *shards;       /**< shards */
+    size_t shards_numof;                    /**< number of shards */
+    gnrc_lorawan_sim_dl_t *dls;             /**< downlink slots */
+    size_t dls_size;                        /**< number of downlink slots */
+    uint8_t *dls_merged;                    /**< downlink is on the channel */
+    gnrc_lorawan_sim_uplink_cb_t uplink;    /**< network server callback */
+    gnrc_lorawan_sim_app_cb_t app;          /**< application callback */
+    void *arg;                              /**< user argument */
+    gnrc_lorawan_sim_dedup_t *dedup;        /**< deduplication stage, or NULL */
+    uint64_t now;                           /**< current time in us */
+    uint64_t window;                        /**< length of a window in us */
+    gnrc_lorawan_sim_mpsc_t txq;            /**< transmissions of the window */
+    gnrc_lorawan_sim_mpsc_t upq;            /**< uplinks that ended in the window */
+    gnrc_lorawan_sim_par_tx_t *txs;         /**< sorted transmissions */
+    gnrc_lorawan_sim_uplink_t *ups;         /**< sorted uplinks */
+    size_t txs_numof;                       /**< number of sorted transmissions */
+    size_t ups_numof;                       /**< number of sorted uplinks */
+    uint64_t until;                         /**< end of the current window */
+    void (*job)(gnrc_lorawan_sim_par_t *par, size_t shard);  /**< parallel job */
+    pthread_mutex_t lock;                   /**< protects the job state */
+    pthread_cond_t start;                   /**< a job was started */
+    pthread_cond_t done;                    /**< all workers finished the job */
+    uint64_t job_gen;                       /**< number of started jobs */
+    size_t workers;                         /**< number of running workers */
+    size_t pending;                         /**< workers busy with the job */
+    uint32_t lost;                          /**< transmissions and uplinks dropped */
+    uint8_t stop;                           /**< stop the workers */
+};
+
+/**
+ * @brief Init a parallel simulation and start its worker threads
+ *
+ * The radio index of every node must be set before. The MAC descriptors are
+ * initialized by the application afterwards with @ref gnrc_lorawan_init.
+ * The nodes are split into @p shards_numof shards of consecutive nodes.
+ *
+ * @param[out] par pointer to the descriptor
+ * @param[in] ch initialized channel model
+ * @param[in] nodes array of nodes
+ * @param[in] nodes_numof number of nodes
+ * @param[in] gws radio indices of the gateways
+ * @param[in] gws_numof number of gateways
+ * @param[in] shards_numof number of shards and threads
+ * @param[in] events_size size of the event heap of every shard
+ * @param[in] dls_size number of downlinks scheduled at the same time
+ * @param[in] seed seed of the random generators of the nodes
+ *
+ * @return 0 on success
+ * @return -ENOMEM if the buffers could not be allocated
+ * @return -EAGAIN if the threads could not be started
+ */
+int gnrc_lorawan_sim_par_init(gnrc_lorawan_sim_par_t *par,
+                              gnrc_lorawan_sim_channel_t *ch,
+                              gnrc_lorawan_sim_node_t *nodes, size_t nodes_numof,
+                              const uint32_t *gws, size_t gws_numof,
+                              size_t shards_numof, size_t events_size,
+                              size_t dls_size, uint32_t seed);
+
+/**
+ * @brief Stop the worker threads and free the buffers of a parallel simulation
+ *
+ * @param[in] par pointer to the descriptor
+ */
+void gnrc_lorawan_sim_par_free(gnrc_lorawan_sim_par_t *par);
+
+/**
+ * @brief Schedule a downlink to a node
+ *
+ * Only valid from the network server callback or between calls of
+ * @ref gnrc_lorawan_sim_par_run.
+ *
+ * @param[in] par pointer to the descriptor
+ * @param[in] gw radio index of the transmitting gateway
+ * @param[in] node index of the addressed node
+ * @param[in] start start of the transmission in us. Not before the end of
+ *            the current window
+ * @param[in] freq frequency in Hz
+ * @param[in] sf spreading factor (125 kHz bandwidth)
+ * @param[in] data PHY payload
+ * @param[in] len size of the PHY payload
+ *
+ * @return 0 on success
+ * @return -EBUSY if the gateway transmits another downlink at that time
+ * @return -ENOBUFS if all downlink slots are in use
+ */
+int gnrc_lorawan_sim_par_downlink(gnrc_lorawan_sim_par_t *par, uint32_t gw,
+                                  uint32_t node, uint64_t start, uint32_t freq,
+                                  uint8_t sf, const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Process all events before a given time
+ *
+ * The current time is @p until afterwards. Runs are split into windows that
+ * end at multiples of @ref CONFIG_GNRC_LORAWAN_SIM_PAR_WINDOW and at
+ * @p until.
+ *
+ * @param[in] par pointer to the descriptor
+ * @param[in] until end of the run in us
+ *
+ * @return number of processed events
+ */
+uint64_t gnrc_lorawan_sim_par_run(gnrc_lorawan_sim_par_t *par, uint64_t until);
+
+/**
+ * @brief Get the number of events dropped because an event heap was full
+ *
+ * @param[in] par pointer to the descriptor
+ *
+ * @return number of dropped events
+ */
+uint32_t gnrc_lorawan_sim_par_lost(const gnrc_lorawan_sim_par_t *par);
+
+/**
+ * @name Hooks of the shards, called by @ref gnrc_lorawan_sim_net_t
+ * @{
+ */
+/**
+ * @brief A node of a shard started a transmission
+ *
+ * @param[in] net network of the shard
+ * @param[in] node the node
+ * @param[in] tx the transmission
+ */
+void gnrc_lorawan_sim_par_tx(gnrc_lorawan_sim_net_t *net,
+                             gnrc_lorawan_sim_node_t *node,
+                             const gnrc_lorawan_sim_tx_t *tx);
+
+/**
+ * @brief The uplink of a node of a shard ended
+ *
+ * @param[in] net network of the shard
+ * @param[in] node the node
+ */
+void gnrc_lorawan_sim_par_uplink(gnrc_lorawan_sim_net_t *net,
+                                 gnrc_lorawan_sim_node_t *node);
+
+/**
+ * @brief A downlink locked by a node of a shard ended
+ *
+ * @param[in] net network of the shard
+ * @param[in] node the node
+ * @param[in] slot downlink slot
+ */
+void gnrc_lorawan_sim_par_rx_end(gnrc_lorawan_sim_net_t *net,
+                                 gnrc_lorawan_sim_node_t *node, uint32_t slot);
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GNRC_LORAWAN_SIM_PAR_H */
+/** @} */
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup net_gnrc_lorawan_sim
+ * @{
+ *
+ * @file
+ * @brief   Downlink scheduler of a network server stand-in
+ *
+ * Chooses the receive window and the gateway of class A downlinks:
+ *
+ * - RX1 starts the RX delay after the end of the uplink, on the uplink
+ *   frequency with the uplink datarate lowered by the RX1DROffset of the
+ *   DLSettings (see @ref gnrc_lorawan_rx1_get_dr_offset). RX2 starts one
+ *   second later on @ref LORAMAC_DEFAULT_RX2_FREQ with the RX2 datarate of
+ *   the DLSettings.
+ * - The gateways that received the uplink are tried by SNR. A gateway
+ *   transmits one downlink at a time and has an airtime budget per duty
+ *   cycle band and hour (see @ref gnrc_lorawan_band_get).
+ * - RX1 is preferred on any gateway, since it leaves RX2 to the others and
+ *   is usually faster.
+ *
+ * The scheduler also keeps the MAC commands and the acknowledgement pending
+ * for every device, so the network server sends them in a single frame with
+ * the application payload.
+ *
+ * Only available with @ref CONFIG_GNRC_LORAWAN_SIM_SCHED. Not thread safe.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef GNRC_LORAWAN_SIM_SCHED_H
+#define GNRC_LORAWAN_SIM_SCHED_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan_sim/net.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief enable the downlink scheduler
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_SCHED
+#define CONFIG_GNRC_LORAWAN_SIM_SCHED 0
+#endif
+
+/**
+ * @brief downlinks reserved per gateway at the same time
+ */
+#ifndef CONFIG_GNRC_LORAWAN_SIM_SCHED_GW_SLOTS
+#define CONFIG_GNRC_LORAWAN_SIM_SCHED_GW_SLOTS (32U)
+#endif
+
+#define GNRC_LORAWAN_SIM_SCHED_FOPTS_MAX    (15U)   /**< maximum size of FOpts */
+
+/**
+ * @brief Transmission reserved by a gateway
+ */
+typedef struct {
+    uint64_t start;                 /**< start in us */
+    uint64_t end;                   /**< end in us */
+} gnrc_lorawan_sim_sched_busy_t;
+
+/**
+ * @brief State of a gateway
+ */
+typedef struct {
+    gnrc_lorawan_sim_sched_busy_t busy[CONFIG_GNRC_LORAWAN_SIM_SCHED_GW_SLOTS]; /**< reserved */
+    uint64_t used[GNRC_LORAWAN_BANDS_NUMOF][2];     /**< airtime per band of two hours in us */
+    uint32_t hour[GNRC_LORAWAN_BANDS_NUMOF][2];     /**< hours of @p used */
+} gnrc_lorawan_sim_sched_gw_t;
+
+/**
+ * @brief Pending answers to a device
+ */
+typedef struct {
+    uint8_t fopts[GNRC_LORAWAN_SIM_SCHED_FOPTS_MAX];    /**< pending MAC commands */
+    uint8_t fopts_len;              /**< size of the pending MAC commands */
+    uint8_t ack;                    /**< last uplink was confirmed */
+} gnrc_lorawan_sim_sched_dev_t;
+
+/**
+ * @brief Scheduled downlink
+ */
+typedef struct {
+    uint64_t start;                 /**< start of the transmission in us */
+    uint32_t gw;                    /**< radio index of the gateway */
+    uint32_t freq;                  /**< frequency in Hz */
+    uint8_t sf;                     /**< spreading factor */
+    uint8_t window;                 /**< 1 for RX1, 2 for RX2 */
+} gnrc_lorawan_sim_sched_tx_t;
+
+/**
+ * @brief Scheduler counters
+ */
+typedef struct {
+    uint32_t rx1;                   /**< downlinks in RX1 */
+    uint32_t rx2;                   /**< downlinks in RX2 */
+    uint32_t busy;                  /**< no gateway free in both windows */
+    uint32_t duty_cycle;            /**< gateways skipped for lack of duty cycle budget */
+    uint32_t missed;                /**< both windows already started */
+    uint32_t merged;                /**< frames with an ACK and MAC commands */
+} gnrc_lorawan_sim_sched_stats_t;
+
+/**
+ * @brief Downlink scheduler descriptor
+ */
+typedef struct {
+    const uint32_t *gws;                    /**< radio indices of the gateways */
+    size_t gws_numof;                       /**< number of gateways */
+    gnrc_lorawan_sim_sched_gw_t *gw_state;  /**< state of the gateways */
+    gnrc_lorawan_sim_sched_dev_t *devs;     /**< pending answers of the devices */
+    size_t devs_numof;                      /**< number of devices */
+    gnrc_lorawan_sim_sched_stats_t stats;   /**< counters */
+} gnrc_lorawan_sim_sched_t;
+
+/**
+ * @brief Init a downlink scheduler
+ *
+ * @param[out] sched pointer to the descriptor
+ * @param[in] gws radio indices of the gateways
+ * @param[in] gws_numof number of gateways
+ * @param[in] devs_numof number of devices
+ *
+ * @return 0 on success
+ * @return -ENOMEM if the buffers could not be allocated
+ */
+int gnrc_lorawan_sim_sched_init(gnrc_lorawan_sim_sched_t *sched, const uint32_t *gws,
+                                size_t gws_numof, size_t devs_numof);
+
+/**
+ * @brief Free the buffers of a downlink scheduler
+ *
+ * @param[in] sched pointer to the descriptor
+ */
+void gnrc_lorawan_sim_sched_free(gnrc_lorawan_sim_sched_t *sched);
+
+/**
+ * @brief Register an uplink of a device
+ *
+ * Replaces the pending acknowledgement. MAC commands stay pending until they
+ * are sent.
+ *
+ * @param[in] sched pointer to the descriptor
+ * @param[in] dev index of the device
+ * @param[in] confirmed the uplink must be acknowledged
+ */
+void gnrc_lorawan_sim_sched_uplink(gnrc_lorawan_sim_sched_t *sched, uint32_t dev,
+                                   int confirmed);
+
+/**
+ * @brief Queue a MAC command for a device
+ *
+ * @param[in] sched pointer to the descriptor
+ * @param[in] dev index of the device
+ * @param[in] cmd the MAC command, CID first
+ * @param[in] len size of the MAC command
+ *
+ * @return 0 on success
+ * @return -ENOBUFS if the command does not fit into FOpts
+ */
+int gnrc_lorawan_sim_sched_mac_cmd(gnrc_lorawan_sim_sched_t *sched, uint32_t dev,
+                                   const uint8_t *cmd, size_t len);
+
+/**
+ * @brief Get the pending answers of a device
+ *
+ * @param[in] sched pointer to the descriptor
+ * @param[in] dev index of the device
+ *
+ * @return the pending answers
+ */
+static inline const gnrc_lorawan_sim_sched_dev_t *gnrc_lorawan_sim_sched_pending(
+    const gnrc_lorawan_sim_sched_t *sched, uint32_t dev)
+{
+    return &sched->devs[dev];
+}
+
+/**
+ * @brief Reserve a gateway and a receive window for the answer to an uplink
+ *
+ * @param[in] sched pointer to the descriptor
+ * @param[in] up the uplink
+ * @param[in] rx_delay RX1 delay of the device in s
+ * @param[in] dl_settings DLSettings of the device
+ * @param[in] len size of the downlink
+ * @param[in] now current time in us. Windows starting before are skipped
+ * @param[out] tx the scheduled downlink
+ *
+ * @return 0 on success
+ * @return -EBUSY if no gateway can transmit in any window
+ * @return -ETIMEDOUT if both windows started before @p now
+ */
+int gnrc_lorawan_sim_sched_pick(gnrc_lorawan_sim_sched_t *sched,
+                                const gnrc_lorawan_sim_uplink_t *up, uint8_t rx_delay,
+                                uint8_t dl_settings, uint8_t len, uint64_t now,
+                                gnrc_lorawan_sim_sched_tx_t *tx);
+
+/**
+ * @brief Mark the pending answers of a device as sent
+ *
+ * Call after the frame built from @ref gnrc_lorawan_sim_sched_pending was
+ * scheduled.
+ *
+ * @param[in] sched pointer to the descriptor
+ * @param[in] dev index of the device
+ */
+void gnrc_lorawan_sim_sched_sent(gnrc_lorawan_sim_sched_t *sched, uint32_t dev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GNRC_LORAWAN_SIM_SCHED_H */
+/** @} */
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include "gnrc_lorawan_sim/js.h"
+
+#if CONFIG_GNRC_LORAWAN_SIM_JS
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crypto/ciphers.h"
+#include "gnrc_lorawan_internal.h"
+#include "net/lorawan/hdr.h"
+
+#define ENABLE_DEBUG (0)
+#include "debug.h"
+
+#define EMPTY (UINT32_MAX)
+
+/* Offsets in a Join Request */
+#define REQ_APPEUI      (1U)
+#define REQ_DEVEUI      (REQ_APPEUI + LORAMAC_APPEUI_LEN)
+#define REQ_DEV_NONCE   (REQ_DEVEUI + LORAMAC_DEVEUI_LEN)
+
+static size_t _pow2(size_t n)
+{
+    size_t size = 1;
+
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+static inline size_t _hash(const gnrc_lorawan_sim_js_t *js, const uint8_t *deveui)
+{
+    uint64_t h = 0;
+
+    memcpy(&h, deveui, LORAMAC_DEVEUI_LEN);
+    h *= 0x9E3779B97F4A7C15ULL;
+    return (size_t) (h >> 32) & js->table_mask;
+}
+
+static uint32_t _lookup(const gnrc_lorawan_sim_js_t *js, const uint8_t *deveui)
+{
+    for (size_t h = _hash(js, deveui);; h = (h + 1) & js->table_mask) {
+        uint32_t i = js->table[h];
+        if (i == EMPTY || !memcmp(js->devs[i].deveui, deveui, LORAMAC_DEVEUI_LEN)) {
+            return i;
+        }
+    }
+}
+
+int gnrc_lorawan_sim_js_init(gnrc_lorawan_sim_js_t *js, size_t devs_size,
+                             size_t pages_size, size_t batch_size,
+                             uint32_t net_id, uint32_t dev_addr_base)
+{
+    size_t table_size = _pow2(2 * devs_size);
+
+    memset(js, 0, sizeof(gnrc_lorawan_sim_js_t));
+    js->devs = malloc(devs_size * sizeof(gnrc_lorawan_sim_js_dev_t));
+    js->table = malloc(table_size * sizeof(uint32_t));
+    js->pages = malloc(pages_size * sizeof(gnrc_lorawan_sim_js_page_t));
+    js->batch = malloc(batch_size * sizeof(gnrc_lorawan_sim_js_req_t));
+    if (!js->devs || !js->table || !js->pages || !js->batch) {
+        gnrc_lorawan_sim_js_free(js);
+        return -ENOMEM;
+    }
+    memset(js->table, 0xFF, table_size * sizeof(uint32_t));
+
+    js->devs_size = devs_size;
+    js->table_mask = table_size - 1;
+    js->pages_size = pages_size;
+    js->batch_size = batch_size;
+    js->net_id = net_id;
+    js->dev_addr_base = dev_addr_base;
+    js->rx_delay = 1;
+    return 0;
+}
+
+void gnrc_lorawan_sim_js_free(gnrc_lorawan_sim_js_t *js)
+{
+    free(js->devs);
+    free(js->table);
+    free(js->pages);
+    free(js->batch);
+    js->devs = NULL;
+    js->table = NULL;
+    js->pages = NULL;
+    js->batch = NULL;
+}
+
+int gnrc_lorawan_sim_js_add(gnrc_lorawan_sim_js_t *js, const uint8_t *deveui,
+                            const uint8_t *appeui, const uint8_t *appkey)
+{
+    if (js->devs_numof == js->devs_size) {
+        return -ENOSPC;
+    }
+
+    size_t h = _hash(js, deveui);
+    while (js->table[h] != EMPTY) {
+        if (!memcmp(js->devs[js->table[h]].deveui, deveui, LORAMAC_DEVEUI_LEN)) {
+            return -EEXIST;
+        }
+        h = (h + 1) & js->table_mask;
+    }
+
+    gnrc_lorawan_sim_js_dev_t *dev = &js->devs[js->devs_numof];
+    memcpy(dev->deveui, deveui, LORAMAC_DEVEUI_LEN);
+    memcpy(dev->appeui, appeui, LORAMAC_APPEUI_LEN);
+    memcpy(dev->appkey, appkey, LORAMAC_APPKEY_LEN);
+    dev->nonces = 0;
+    js->table[h] = js->devs_numof;
+    return js->devs_numof++;
+}
+
+int gnrc_lorawan_sim_js_request(gnrc_lorawan_sim_js_t *js, const uint8_t *data,
+                                size_t len, uint64_t deadline, uint64_t arg)
+{
+    if (len != GNRC_LORAWAN_SIM_JS_REQUEST_SIZE ||
+        lorawan_hdr_get_mtype((lorawan_hdr_t *) data) != MTYPE_JOIN_REQUEST) {
+        return -EBADMSG;
+    }
+    if (js->batch_numof == js->batch_size) {
+        js->stats.dropped++;
+        return -ENOBUFS;
+    }
+
+    gnrc_lorawan_sim_js_req_t *req = &js->batch[js->batch_numof++];
+    req->deadline = deadline;
+    req->arg = arg;
+    req->seq = js->seq++;
+    memcpy(req->data, data, len);
+    return 0;
+}
+
+/* Marks a DevNonce as used. Returns 1 if it was used before, 0 if not and
+ * -ENOMEM if there is no free page */
+static int _nonce_use(gnrc_lorawan_sim_js_t *js, gnrc_lorawan_sim_js_dev_t *dev,
+                      uint16_t nonce)
+{
+    uint8_t high = nonce >> 8;
+    uint8_t low = nonce & 0xFF;
+    gnrc_lorawan_sim_js_page_t *page = NULL;
+
+    for (uint32_t p = dev->nonces; p; p = js->pages[p - 1].next) {
+        if (js->pages[p - 1].high == high) {
+            page = &js->pages[p - 1];
+            break;
+        }
+    }
+
+    if (!page) {
+        if (js->pages_numof == js->pages_size) {
+            return -ENOMEM;
+        }
+        page = &js->pages[js->pages_numof++];
+        memset(page, 0, sizeof(gnrc_lorawan_sim_js_page_t));
+        page->high = high;
+        page->next = dev->nonces;
+        dev->nonces = js->pages_numof;
+    }
+
+    uint8_t mask = 1 << (low & 7);
+    if (page->bits[low >> 3] & mask) {
+        return 1;
+    }
+    page->bits[low >> 3] |= mask;
+    return 0;
+}
+
+static void _accept(gnrc_lorawan_sim_js_t *js, const gnrc_lorawan_sim_js_req_t *req,
+                    uint32_t i, gnrc_lorawan_sim_js_accept_t *acc)
+{
+    const gnrc_lorawan_sim_js_dev_t *dev = &js->devs[i];
+    lorawan_join_accept_t *ja = (lorawan_join_accept_t *) acc->frame;
+    uint32_t app_nonce = js->app_nonce = (js->app_nonce + 1) & 0xFFFFFF;
+    size_t len = sizeof(lorawan_join_accept_t);
+    le_uint32_t mic;
+
+    acc->arg = req->arg;
+    acc->dev = i;
+    acc->dev_addr = js->dev_addr_base + i;
+
+    memset(acc->frame, 0, sizeof(acc->frame));
+    lorawan_hdr_set_mtype((lorawan_hdr_t *) ja, MTYPE_JOIN_ACCEPT);
+    lorawan_hdr_set_maj((lorawan_hdr_t *) ja, MAJOR_LRWAN_R1);
+    for (unsigned b = 0; b < 3; b++) {
+        ja->app_nonce[b] = app_nonce >> (8 * b);
+        ja->net_id[b] = js->net_id >> (8 * b);
+    }
+    for (unsigned b = 0; b < 4; b++) {
+        ja->dev_addr[b] = acc->dev_addr >> (8 * b);
+    }
+    ja->dl_settings = js->dl_settings;
+    ja->rx_delay = js->rx_delay;
+
+    if (js->cflist_numof) {
+        /* CFListType 0: up to five frequencies in steps of 100 Hz */
+        for (unsigned c = 0; c < js->cflist_numof; c++) {
+            uint32_t freq = js->cflist[c] / GNRC_LORAWAN_CHANNEL_STEP;
+            for (unsigned b = 0; b < 3; b++) {
+                acc->frame[len + 3 * c + b] = freq >> (8 * b);
+            }
+        }
+        len += CFLIST_SIZE;
+    }
+
+    gnrc_lorawan_calculate_join_mic(&js->mac, acc->frame, len, dev->appkey, &mic);
+    memcpy(acc->frame + len, &mic, MIC_SIZE);
+    len += MIC_SIZE;
+    acc->len = len;
+
+    gnrc_lorawan_generate_session_keys(&js->mac, ja->app_nonce,
+                                       req->data + REQ_DEV_NONCE, dev->appkey,
+                                       acc->nwkskey, acc->appskey);
+
+    /* The device "decrypts" with AES encrypt */
+    cipher_t cipher;
+    cipher_init(&cipher, CIPHER_AES_128, dev->appkey, LORAMAC_APPKEY_LEN);
+    for (size_t b = 1; b < len; b += LORAMAC_APPKEY_LEN) {
+        cipher_decrypt(&cipher, acc->frame + b, acc->frame + b);
+    }
+}
+
+static int _cmp_deadline(const void *a, const void *b)
+{
+    const gnrc_lorawan_sim_js_req_t *ra = a;
+    const gnrc_lorawan_sim_js_req_t *rb = b;
+
+    if (ra->deadline != rb->deadline) {
+        return ra->deadline < rb->deadline ? -1 : 1;
+    }
+    return ra->seq < rb->seq ? -1 : ra->seq > rb->seq;
+}
+
+size_t gnrc_lorawan_sim_js_flush(gnrc_lorawan_sim_js_t *js, uint64_t now)
+{
+    gnrc_lorawan_sim_js_accept_t acc;
+    size_t accepted = 0;
+
+    if (!js->batch_numof) {
+        return 0;
+    }
+    js->stats.batches++;
+    if (js->batch_numof > js->stats.batch_max) {
+        js->stats.batch_max = js->batch_numof;
+    }
+
+    qsort(js->batch, js->batch_numof, sizeof(gnrc_lorawan_sim_js_req_t), _cmp_deadline);
+
+    for (size_t r = 0; r < js->batch_numof; r++) {
+        const gnrc_lorawan_sim_js_req_t *req = &js->batch[r];
+        uint32_t i = _lookup(js, req->data + REQ_DEVEUI);
+        le_uint32_t mic;
+
+        if (i == EMPTY || memcmp(js->devs[i].appeui, req->data + REQ_APPEUI,
+                                 LORAMAC_APPEUI_LEN)) {
+            js->stats.unknown++;
+            continue;
+        }
+
+        gnrc_lorawan_sim_js_dev_t *dev = &js->devs[i];
+        gnrc_lorawan_calculate_join_mic(&js->mac, req->data,
+                                        GNRC_LORAWAN_SIM_JS_REQUEST_SIZE - MIC_SIZE,
+                                        dev->appkey, &mic);
+        if (memcmp(&mic, req->data + GNRC_LORAWAN_SIM_JS_REQUEST_SIZE - MIC_SIZE,
+                   MIC_SIZE)) {
+            DEBUG("gnrc_lorawan_sim_js: wrong MIC\n");
+            js->stats.mic_failures++;
+            continue;
+        }
+
+        /* Only authentic requests consume a DevNonce */
+        uint16_t nonce = req->data[REQ_DEV_NONCE] | (req->data[REQ_DEV_NONCE + 1] << 8);
+        int res = _nonce_use(js, dev, nonce);
+        if (res < 0) {
+            js->stats.dropped++;
+            continue;
+        }
+        if (res) {
+            DEBUG("gnrc_lorawan_sim_js: DevNonce %u replayed\n", nonce);
+            js->stats.replays++;
+            continue;
+        }
+
+        _accept(js, req, i, &acc);
+        acc.late = now > req->deadline;
+        js->stats.accepted++;
+        js->stats.late += acc.late;
+        accepted++;
+        if (js->accept) {
+            js->accept(js, &acc);
+        }
+    }
+
+    js->batch_numof = 0;
+    return accepted;
+}
+
+#else
+typedef int dont_be_pedantic;
+#endif /* CONFIG_GNRC_LORAWAN_SIM_JS */
+
+/** @} */
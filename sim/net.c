@@ -0,0 +1,657 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include "gnrc_lorawan_sim/net.h"
+#include "gnrc_lorawan_sim/par.h"
+#include "gnrc_lorawan_sim/dedup.h"
+
+#if CONFIG_GNRC_LORAWAN_SIM_NET
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include "net/lora.h"
+#include "timex.h"
+
+#define ENABLE_DEBUG (0)
+#include "debug.h"
+
+enum {
+    EVENT_TIMER,            /**< MAC timer expired */
+    EVENT_TX_END,           /**< uplink left the antenna */
+    EVENT_RX_TIMEOUT,       /**< no preamble within the symbol timeout */
+    EVENT_RX_END,           /**< locked downlink ended */
+    EVENT_DL_START,         /**< gateway starts a downlink */
+    EVENT_DL_END,           /**< downlink slot can be reused */
+    EVENT_APP,              /**< application callback */
+    EVENT_DEDUP,            /**< deduplication window closed */
+};
+
+static inline int _before(const gnrc_lorawan_sim_event_t *a,
+                          const gnrc_lorawan_sim_event_t *b)
+{
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static int _push(gnrc_lorawan_sim_net_t *net, uint8_t type, uint32_t node,
+                 uint32_t gen, uint64_t time, uint64_t arg)
+{
+    if (net->events_numof == net->events_size) {
+        DEBUG("gnrc_lorawan_sim_net: event heap full\n");
+        net->lost++;
+        return -ENOBUFS;
+    }
+
+    gnrc_lorawan_sim_event_t ev = {
+        .time = time, .seq = net->seq++, .arg = arg,
+        .node = node, .gen = gen, .type = type
+    };
+    size_t i = net->events_numof++;
+
+    while (i) {
+        size_t parent = (i - 1) / 2;
+        if (!_before(&ev, &net->events[parent])) {
+            break;
+        }
+        net->events[i] = net->events[parent];
+        i = parent;
+    }
+    net->events[i] = ev;
+    return 0;
+}
+
+static void _pop(gnrc_lorawan_sim_net_t *net, gnrc_lorawan_sim_event_t *out)
+{
+    gnrc_lorawan_sim_event_t *heap = net->events;
+    gnrc_lorawan_sim_event_t last = heap[--net->events_numof];
+    size_t numof = net->events_numof;
+    size_t i = 0;
+
+    *out = heap[0];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= numof) {
+            break;
+        }
+        if (child + 1 < numof && _before(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+        if (!_before(&heap[child], &last)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+}
+
+static inline uint32_t _index(gnrc_lorawan_sim_node_t *node)
+{
+    return node - node->net->nodes;
+}
+
+void gnrc_lorawan_sim_net_init(gnrc_lorawan_sim_net_t *net,
+                               gnrc_lorawan_sim_channel_t *ch,
+                               gnrc_lorawan_sim_node_t *nodes, size_t nodes_numof,
+                               const uint32_t *gws, size_t gws_numof,
+                               gnrc_lorawan_sim_event_t *events, size_t events_size,
+                               gnrc_lorawan_sim_dl_t *dls, size_t dls_size,
+                               uint32_t seed)
+{
+    memset(net, 0, sizeof(*net));
+    net->ch = ch;
+    net->nodes = nodes;
+    net->nodes_numof = nodes_numof;
+    net->gws = gws;
+    net->gws_numof = gws_numof;
+    net->events = events;
+    net->events_size = events_size;
+    net->dls = dls;
+    net->dls_size = dls_size;
+
+    for (size_t i = 0; i < dls_size; i++) {
+        dls[i].used = false;
+    }
+
+    for (size_t i = 0; i < nodes_numof; i++) {
+        gnrc_lorawan_sim_node_t *node = &nodes[i];
+        uint32_t radio = node->radio;
+
+        memset(node, 0, sizeof(*node));
+        node->net = net;
+        node->radio = radio;
+        node->rx_frame = -1;
+        node->rx_last = -1;
+        node->bw = 125;
+        node->sf = LORA_SF12;
+        node->cr = LORA_CR_4_5;
+        /* Seeded by the radio so shards of a parallel run get the same
+         * sequences. xorshift32 must not start at 0 */
+        node->rng = (seed * 2654435761U) ^ (radio + 1) * 0x9E3779B9U;
+        if (!node->rng) {
+            node->rng = 1;
+        }
+    }
+}
+
+int gnrc_lorawan_sim_net_schedule(gnrc_lorawan_sim_net_t *net, uint32_t node,
+                                  uint64_t time, uint64_t arg)
+{
+    assert(time >= net->now && node < net->nodes_numof);
+    return _push(net, EVENT_APP, node, 0, time, arg);
+}
+
+int gnrc_lorawan_sim_net_downlink(gnrc_lorawan_sim_net_t *net, uint32_t gw,
+                                  uint64_t start, uint32_t freq, uint8_t sf,
+                                  const uint8_t *data, uint8_t len)
+{
+    gnrc_lorawan_sim_dl_t *slot = NULL;
+    uint64_t end = start + gnrc_lorawan_sim_time_on_air(len, sf, 125, LORA_CR_4_5);
+
+    assert(start >= net->now);
+
+    for (size_t i = 0; i < net->dls_size; i++) {
+        gnrc_lorawan_sim_dl_t *dl = &net->dls[i];
+        if (!dl->used) {
+            slot = slot ? slot : dl;
+        }
+        else if (dl->gw == gw && dl->start < end && start < dl->end) {
+            return -EBUSY;
+        }
+    }
+
+    if (!slot) {
+        return -ENOBUFS;
+    }
+    if (_push(net, EVENT_DL_START, 0, 0, start, slot - net->dls) < 0) {
+        return -ENOBUFS;
+    }
+
+    slot->start = start;
+    slot->end = end;
+    slot->gw = gw;
+    slot->freq = freq;
+    slot->sf = sf;
+    slot->len = len;
+    memcpy(slot->data, data, len);
+    slot->used = true;
+    return 0;
+}
+
+void gnrc_lorawan_sim_net_gateways(gnrc_lorawan_sim_channel_t *ch, const uint32_t *gws,
+                                   size_t gws_numof, uint64_t id,
+                                   gnrc_lorawan_sim_uplink_t *up)
+{
+    up->gws = 0;
+    for (size_t i = 0; i < gws_numof; i++) {
+        gnrc_lorawan_sim_rx_t rx;
+        if (gnrc_lorawan_sim_channel_rx(ch, id, gws[i], &rx) == GNRC_LORAWAN_SIM_RX_OK) {
+            gnrc_lorawan_sim_net_add_gateway(up, gws[i], &rx);
+        }
+    }
+}
+
+void gnrc_lorawan_sim_net_add_gateway(gnrc_lorawan_sim_uplink_t *up, uint32_t gw,
+                                      const gnrc_lorawan_sim_rx_t *rx)
+{
+    /* Insertion into the list of the best gateways */
+    size_t n = up->gws < CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS ?
+               up->gws : CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS;
+    size_t pos = n;
+
+    while (pos && up->snr[pos - 1] < rx->snr) {
+        pos--;
+    }
+    if (pos < CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS) {
+        size_t last = n < CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS ?
+                      n : CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS - 1;
+        for (size_t j = last; j > pos; j--) {
+            up->gw_list[j] = up->gw_list[j - 1];
+            up->snr[j] = up->snr[j - 1];
+        }
+        up->gw_list[pos] = gw;
+        up->snr[pos] = rx->snr;
+    }
+    if (pos == 0) {
+        up->gw = gw;
+        up->rx = *rx;
+    }
+    if (up->gws < UINT8_MAX) {
+        up->gws++;
+    }
+}
+
+#if CONFIG_GNRC_LORAWAN_SIM_DEDUP
+size_t gnrc_lorawan_sim_net_forward(gnrc_lorawan_sim_dedup_t *dd,
+                                    gnrc_lorawan_sim_channel_t *ch, const uint32_t *gws,
+                                    size_t gws_numof, uint64_t id,
+                                    const gnrc_lorawan_sim_uplink_t *up)
+{
+    size_t opened = 0;
+
+    for (size_t i = 0; i < gws_numof; i++) {
+        gnrc_lorawan_sim_uplink_t copy = *up;
+        gnrc_lorawan_sim_rx_t rx;
+
+        if (gnrc_lorawan_sim_channel_rx(ch, id, gws[i], &rx) != GNRC_LORAWAN_SIM_RX_OK) {
+            continue;
+        }
+        copy.gws = 0;
+        gnrc_lorawan_sim_net_add_gateway(&copy, gws[i], &rx);
+        if (gnrc_lorawan_sim_dedup_add(dd, &copy, up->end) == 0) {
+            opened++;
+        }
+    }
+    return opened;
+}
+
+static void _dedup_uplink(void *arg, const gnrc_lorawan_sim_uplink_t *up)
+{
+    gnrc_lorawan_sim_net_t *net = arg;
+
+    if (net->uplink) {
+        net->uplink(net, up);
+    }
+}
+#endif
+
+
+static void _tx_end(gnrc_lorawan_sim_net_t *net, gnrc_lorawan_sim_node_t *node,
+                    uint64_t id)
+{
+    const gnrc_lorawan_sim_tx_t *tx = gnrc_lorawan_sim_channel_get(net->ch, id);
+    gnrc_lorawan_sim_uplink_t up = { .gws = 0 };
+
+    /* The MAC starts the RX1 delay before the network server answers, so a
+     * downlink starting with the window is not missed */
+    gnrc_lorawan_event_tx_complete(&node->mac);
+
+#if CONFIG_GNRC_LORAWAN_SIM_PAR
+    if (net->par) {
+        gnrc_lorawan_sim_par_uplink(net, node);
+        return;
+    }
+#endif
+
+    if (!tx) {
+        return;
+    }
+
+    up.data = node->tx_data;
+    up.len = node->tx_len;
+    up.end = tx->end;
+    up.node = _index(node);
+    up.freq = tx->freq;
+    up.sf = tx->sf;
+
+#if CONFIG_GNRC_LORAWAN_SIM_DEDUP
+    if (net->dedup) {
+        /* Released when the window of the first copy closed */
+        if (gnrc_lorawan_sim_net_forward(net->dedup, net->ch, net->gws, net->gws_numof,
+                                         id, &up)) {
+            _push(net, EVENT_DEDUP, up.node, 0, up.end + net->dedup->window, 0);
+        }
+        return;
+    }
+#endif
+
+    gnrc_lorawan_sim_net_gateways(net->ch, net->gws, net->gws_numof, id, &up);
+    if (up.gws && net->uplink) {
+        net->uplink(net, &up);
+    }
+}
+
+static void _lock(gnrc_lorawan_sim_net_t *net, uint32_t i, uint32_t slot)
+{
+    gnrc_lorawan_sim_dl_t *dl = &net->dls[slot];
+    gnrc_lorawan_sim_node_t *node = &net->nodes[i];
+
+    if (!node->rx_on) {
+        /* A reception opening during the preamble can still lock on it */
+        node->rx_last = slot;
+        return;
+    }
+    if (node->rx_frame < 0 && node->iq_invert &&
+        node->freq == dl->freq && node->sf == dl->sf && node->bw == 125) {
+        node->rx_frame = slot;
+        _push(net, EVENT_RX_END, i, node->rx_gen, dl->end, slot);
+    }
+}
+
+static void _dl_start(gnrc_lorawan_sim_net_t *net, uint32_t slot)
+{
+    gnrc_lorawan_sim_dl_t *dl = &net->dls[slot];
+    gnrc_lorawan_sim_tx_t tx = {
+        .start = dl->start, .end = dl->end, .freq = dl->freq,
+        .radio = dl->gw, .bw = 125, .sf = dl->sf,
+        .tx_power = net->ch->radios[dl->gw].tx_power
+    };
+    int64_t id = gnrc_lorawan_sim_channel_tx(net->ch, &tx);
+
+    if (id < 0) {
+        DEBUG("gnrc_lorawan_sim_net: channel ring full. Drop downlink\n");
+        dl->used = false;
+        return;
+    }
+    dl->tx = id;
+
+    /* Every listening radio with the same settings locks on the preamble */
+    for (size_t i = 0; i < net->nodes_numof; i++) {
+        _lock(net, i, slot);
+    }
+    _push(net, EVENT_DL_END, 0, 0, dl->end, slot);
+}
+
+int gnrc_lorawan_sim_net_rx_start(gnrc_lorawan_sim_net_t *net, uint32_t node,
+                                  uint32_t slot)
+{
+    assert(net->dls[slot].start >= net->now && node < net->nodes_numof);
+    return _push(net, EVENT_DL_START, node, 0, net->dls[slot].start, slot);
+}
+
+void gnrc_lorawan_sim_net_rx_end(gnrc_lorawan_sim_net_t *net, uint32_t i, uint32_t slot)
+{
+    gnrc_lorawan_sim_node_t *node = &net->nodes[i];
+    gnrc_lorawan_sim_dl_t *dl = &net->dls[slot];
+    gnrc_lorawan_sim_rx_t rx;
+    uint8_t frame[GNRC_LORAWAN_SIM_FRAME_MAX];
+
+    node->rx_on = false;
+    node->rx_frame = -1;
+
+    if (gnrc_lorawan_sim_channel_rx(net->ch, dl->tx, node->radio, &rx) !=
+        GNRC_LORAWAN_SIM_RX_OK) {
+        /* Reported by the radio like a reception timeout */
+        gnrc_lorawan_event_timeout(&node->mac);
+        return;
+    }
+
+    gnrc_lorawan_rx_info_t info = {
+        .timestamp = (uint32_t) net->now,
+        .rssi = (int16_t) rx.rssi,
+        .snr = (int8_t) (rx.snr < INT8_MIN ? INT8_MIN :
+                         rx.snr > INT8_MAX ? INT8_MAX : rx.snr),
+    };
+    /* The MAC decrypts in place and other nodes may receive the same frame */
+    memcpy(frame, dl->data, dl->len);
+    gnrc_lorawan_process_pkt(&node->mac, frame, dl->len, &info);
+}
+
+uint64_t gnrc_lorawan_sim_net_run(gnrc_lorawan_sim_net_t *net, uint64_t until)
+{
+    uint64_t processed = 0;
+    gnrc_lorawan_sim_event_t ev;
+
+    while (net->events_numof && net->events[0].time <= until) {
+        _pop(net, &ev);
+        net->now = ev.time;
+
+        gnrc_lorawan_sim_node_t *node = &net->nodes[ev.node];
+        switch (ev.type) {
+            case EVENT_TIMER:
+                if (!ev.gen || ev.gen != node->timer_gen) {
+                    continue;
+                }
+                node->timer_gen = 0;
+                gnrc_lorawan_timer_fired(&node->mac);
+                break;
+            case EVENT_TX_END:
+                _tx_end(net, node, ev.arg);
+                break;
+            case EVENT_RX_TIMEOUT:
+                if (ev.gen != node->rx_gen || !node->rx_on || node->rx_frame >= 0) {
+                    continue;
+                }
+                node->rx_on = false;
+                gnrc_lorawan_event_timeout(&node->mac);
+                break;
+            case EVENT_RX_END:
+                if (ev.gen != node->rx_gen || node->rx_frame != (int32_t) ev.arg) {
+                    continue;
+                }
+#if CONFIG_GNRC_LORAWAN_SIM_PAR
+                if (net->par) {
+                    /* Decided once the other shards reached the end of the
+                     * frame. The radio stays locked until then */
+                    gnrc_lorawan_sim_par_rx_end(net, node, ev.arg);
+                    break;
+                }
+#endif
+                gnrc_lorawan_sim_net_rx_end(net, ev.node, ev.arg);
+                break;
+            case EVENT_DL_START:
+#if CONFIG_GNRC_LORAWAN_SIM_PAR
+                if (net->par) {
+                    _lock(net, ev.node, ev.arg);
+                    break;
+                }
+#endif
+                _dl_start(net, ev.arg);
+                break;
+            case EVENT_DL_END:
+                net->dls[ev.arg].used = false;
+                break;
+            case EVENT_APP:
+                if (net->app) {
+                    net->app(net, node, ev.arg);
+                }
+                break;
+#if CONFIG_GNRC_LORAWAN_SIM_DEDUP
+            case EVENT_DEDUP:
+                gnrc_lorawan_sim_dedup_flush(net->dedup, net->now, _dedup_uplink, net);
+                break;
+#endif
+            default:
+                assert(false);
+                continue;
+        }
+        processed++;
+    }
+
+    net->now = until > net->now ? until : net->now;
+    net->processed += processed;
+    return processed;
+}
+
+void gnrc_lorawan_timer_set(gnrc_lorawan_t *mac, uint32_t msecs)
+{
+    gnrc_lorawan_sim_node_t *node = gnrc_lorawan_sim_node(mac);
+    gnrc_lorawan_sim_net_t *net = node->net;
+
+    uint64_t time = net->now + (uint64_t) msecs * US_PER_MS;
+
+    /* The event of a timer that was moved to an earlier time stays in the
+     * heap. Reuse it if the timer moves back, as the timer wheel does with
+     * its hourly timer after every reception window. The delay has a
+     * resolution of 1 ms, so the times may differ by less than that */
+    if (node->timer_last > net->now &&
+        time + US_PER_MS > node->timer_last && node->timer_last + US_PER_MS > time) {
+        node->timer_gen = node->timer_last_gen;
+        return;
+    }
+
+    node->timer_gen = ++node->timer_seq;
+    if (_push(net, EVENT_TIMER, _index(node), node->timer_gen, time, 0) == 0 &&
+        time >= node->timer_last) {
+        node->timer_last = time;
+        node->timer_last_gen = node->timer_gen;
+    }
+}
+
+void gnrc_lorawan_timer_stop(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_sim_node(mac)->timer_gen = 0;
+}
+
+uint32_t gnrc_lorawan_timer_now(gnrc_lorawan_t *mac)
+{
+    return (uint32_t) gnrc_lorawan_sim_node(mac)->net->now;
+}
+
+uint32_t gnrc_lorawan_random_get(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_sim_node_t *node = gnrc_lorawan_sim_node(mac);
+    uint32_t x = node->rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return node->rng = x;
+}
+
+void gnrc_lorawan_radio_sleep(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_sim_node_t *node = gnrc_lorawan_sim_node(mac);
+
+    node->rx_on = false;
+    node->rx_frame = -1;
+    node->rx_gen++;
+}
+
+void gnrc_lorawan_radio_set_cr(gnrc_lorawan_t *mac, uint8_t cr)
+{
+    gnrc_lorawan_sim_node(mac)->cr = cr;
+}
+
+void gnrc_lorawan_radio_set_syncword(gnrc_lorawan_t *mac, uint8_t syncword)
+{
+    (void) mac;
+    (void) syncword;
+}
+
+void gnrc_lorawan_radio_set_frequency(gnrc_lorawan_t *mac, uint32_t channel)
+{
+    gnrc_lorawan_sim_node(mac)->freq = channel;
+}
+
+void gnrc_lorawan_radio_set_iq_invert(gnrc_lorawan_t *mac, int invert)
+{
+    gnrc_lorawan_sim_node(mac)->iq_invert = !!invert;
+}
+
+void gnrc_lorawan_radio_set_rx_symbol_timeout(gnrc_lorawan_t *mac, uint16_t timeout)
+{
+    gnrc_lorawan_sim_node(mac)->rx_symbols = timeout;
+}
+
+void gnrc_lorawan_radio_set_sf(gnrc_lorawan_t *mac, uint8_t sf)
+{
+    gnrc_lorawan_sim_node(mac)->sf = sf;
+}
+
+void gnrc_lorawan_radio_set_bw(gnrc_lorawan_t *mac, uint8_t bw)
+{
+    static const uint16_t khz[] = {
+        [LORA_BW_125_KHZ] = 125, [LORA_BW_250_KHZ] = 250, [LORA_BW_500_KHZ] = 500
+    };
+
+    assert(bw < sizeof(khz) / sizeof(khz[0]));
+    gnrc_lorawan_sim_node(mac)->bw = khz[bw];
+}
+
+void gnrc_lorawan_radio_rx_on(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_sim_node_t *node = gnrc_lorawan_sim_node(mac);
+    gnrc_lorawan_sim_net_t *net = node->net;
+    uint64_t t_sym = (1000ULL << node->sf) / node->bw;
+
+    /* The MAC reopens RX1 when the RX2 timer fires during a long downlink.
+     * The radio keeps receiving the frame it locked on */
+    if (node->rx_on && node->rx_frame >= 0) {
+        return;
+    }
+
+    node->rx_on = true;
+    node->rx_frame = -1;
+    node->rx_start = net->now;
+    node->rx_gen++;
+    _push(net, EVENT_RX_TIMEOUT, _index(node), node->rx_gen,
+          net->now + t_sym * node->rx_symbols, 0);
+
+    if (node->rx_last >= 0) {
+        const gnrc_lorawan_sim_dl_t *dl = &net->dls[node->rx_last];
+        if (dl->used && dl->start <= net->now && dl->end > net->now &&
+            net->now - dl->start <= t_sym * GNRC_LORAWAN_SIM_PREAMBLE_LATE) {
+            _lock(net, _index(node), node->rx_last);
+        }
+        node->rx_last = -1;
+    }
+}
+
+void gnrc_lorawan_radio_send(gnrc_lorawan_t *mac, iolist_t *io)
+{
+    gnrc_lorawan_sim_node_t *node = gnrc_lorawan_sim_node(mac);
+    gnrc_lorawan_sim_net_t *net = node->net;
+    size_t len = 0;
+
+    for (; io; io = io->iol_next) {
+        assert(len + io->iol_len <= GNRC_LORAWAN_SIM_FRAME_MAX);
+        memcpy(node->tx_data + len, io->iol_base, io->iol_len);
+        len += io->iol_len;
+    }
+    node->tx_len = len;
+
+    uint32_t toa = gnrc_lorawan_sim_time_on_air(len, node->sf, node->bw, node->cr);
+    gnrc_lorawan_sim_tx_t tx = {
+        .start = net->now, .end = net->now + toa, .freq = node->freq,
+        .radio = node->radio, .bw = node->bw, .sf = node->sf,
+        .tx_power = net->ch->radios[node->radio].tx_power
+    };
+
+    node->rx_on = false;
+    node->airtime += toa;
+    node->tx_count++;
+
+#if CONFIG_GNRC_LORAWAN_SIM_PAR
+    if (net->par) {
+        /* Added to the channel at the end of the window */
+        gnrc_lorawan_sim_par_tx(net, node, &tx);
+        _push(net, EVENT_TX_END, _index(node), 0, tx.end, 0);
+        return;
+    }
+#endif
+
+    int64_t id = gnrc_lorawan_sim_channel_tx(net->ch, &tx);
+    if (id < 0) {
+        DEBUG("gnrc_lorawan_sim_net: channel ring full. Drop uplink\n");
+        id = INT64_MAX;
+    }
+    node->tx_id = id;
+    _push(net, EVENT_TX_END, _index(node), 0, tx.end, id);
+}
+
+#if CONFIG_GNRC_LORAWAN_LBT
+int gnrc_lorawan_radio_cca(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_sim_node_t *node = gnrc_lorawan_sim_node(mac);
+    gnrc_lorawan_sim_channel_t *ch = node->net->ch;
+    uint64_t now = node->net->now;
+
+    for (uint64_t id = ch->tail; id < ch->head; id++) {
+        const gnrc_lorawan_sim_tx_t *tx = gnrc_lorawan_sim_channel_get(ch, id);
+        if (tx->start <= now && now < tx->end && tx->freq == node->freq &&
+            gnrc_lorawan_sim_channel_rssi(ch, tx, node->radio) >=
+            CONFIG_GNRC_LORAWAN_SIM_CCA_THRESHOLD) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+#else
+typedef int dont_be_pedantic;
+#endif /* CONFIG_GNRC_LORAWAN_SIM_NET */
+
+/** @} */
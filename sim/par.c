@@ -0,0 +1,558 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include "gnrc_lorawan_sim/par.h"
+#include "gnrc_lorawan_sim/dedup.h"
+
+#if CONFIG_GNRC_LORAWAN_SIM_PAR
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "net/loramac.h"
+#include "timex.h"
+
+#define ENABLE_DEBUG (0)
+#include "debug.h"
+
+/* Downlink to a node of a shard */
+typedef struct {
+    uint32_t node;
+    uint32_t slot;
+} _dl_msg_t;
+
+static size_t _pow2(size_t n)
+{
+    size_t size = 1;
+
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+static int _mpsc_init(gnrc_lorawan_sim_mpsc_t *q, size_t elem, size_t numof)
+{
+    size_t size = _pow2(numof);
+
+    q->buf = malloc(size * elem);
+    q->seq = malloc(size * sizeof(uint64_t));
+    if (!q->buf || !q->seq) {
+        return -ENOMEM;
+    }
+    for (size_t i = 0; i < size; i++) {
+        q->seq[i] = i;
+    }
+    q->elem = elem;
+    q->mask = size - 1;
+    q->head = 0;
+    q->tail = 0;
+    return 0;
+}
+
+static void _mpsc_free(gnrc_lorawan_sim_mpsc_t *q)
+{
+    free(q->buf);
+    free(q->seq);
+}
+
+/* A cell can be produced when its sequence number equals the ticket, and
+ * consumed when it is one more */
+static int _mpsc_push(gnrc_lorawan_sim_mpsc_t *q, const void *elem)
+{
+    uint64_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+
+    for (;;) {
+        uint64_t seq = __atomic_load_n(&q->seq[pos & q->mask], __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t) (seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return -ENOBUFS;
+        }
+        else {
+            pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(q->buf + (pos & q->mask) * q->elem, elem, q->elem);
+    __atomic_store_n(&q->seq[pos & q->mask], pos + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static int _mpsc_pop(gnrc_lorawan_sim_mpsc_t *q, void *elem)
+{
+    uint64_t pos = q->head;
+
+    if (__atomic_load_n(&q->seq[pos & q->mask], __ATOMIC_ACQUIRE) != pos + 1) {
+        return -EAGAIN;
+    }
+    memcpy(elem, q->buf + (pos & q->mask) * q->elem, q->elem);
+    __atomic_store_n(&q->seq[pos & q->mask], pos + q->mask + 1, __ATOMIC_RELEASE);
+    q->head = pos + 1;
+    return 0;
+}
+
+static inline gnrc_lorawan_sim_shard_t *_shard(gnrc_lorawan_sim_net_t *net)
+{
+    return (gnrc_lorawan_sim_shard_t *) net;
+}
+
+static void _run_job(gnrc_lorawan_sim_par_t *par,
+                     void (*job)(gnrc_lorawan_sim_par_t *par, size_t shard))
+{
+    pthread_mutex_lock(&par->lock);
+    par->job = job;
+    par->job_gen++;
+    par->pending = par->workers;
+    pthread_cond_broadcast(&par->start);
+    pthread_mutex_unlock(&par->lock);
+
+    job(par, 0);
+
+    pthread_mutex_lock(&par->lock);
+    while (par->pending) {
+        pthread_cond_wait(&par->done, &par->lock);
+    }
+    pthread_mutex_unlock(&par->lock);
+}
+
+static void *_worker(void *arg)
+{
+    gnrc_lorawan_sim_shard_t *shard = arg;
+    gnrc_lorawan_sim_par_t *par = shard->net.par;
+    size_t index = shard - par->shards;
+    uint64_t job_gen = 0;
+
+    pthread_mutex_lock(&par->lock);
+    for (;;) {
+        while (par->job_gen == job_gen && !par->stop) {
+            pthread_cond_wait(&par->start, &par->lock);
+        }
+        if (par->stop) {
+            break;
+        }
+        job_gen = par->job_gen;
+        pthread_mutex_unlock(&par->lock);
+
+        par->job(par, index);
+
+        pthread_mutex_lock(&par->lock);
+        if (--par->pending == 0) {
+            pthread_cond_signal(&par->done);
+        }
+    }
+    pthread_mutex_unlock(&par->lock);
+    return NULL;
+}
+
+static void _stop(gnrc_lorawan_sim_par_t *par)
+{
+    pthread_mutex_lock(&par->lock);
+    par->stop = true;
+    pthread_cond_broadcast(&par->start);
+    pthread_mutex_unlock(&par->lock);
+
+    for (size_t s = 1; s <= par->workers; s++) {
+        pthread_join(par->shards[s].thread, NULL);
+    }
+    par->workers = 0;
+}
+
+static void _free(gnrc_lorawan_sim_par_t *par)
+{
+    for (size_t s = 0; par->shards && s < par->shards_numof; s++) {
+        free(par->shards[s].net.events);
+        free(par->shards[s].rxs);
+        _mpsc_free(&par->shards[s].inbox);
+    }
+    free(par->shards);
+    free(par->dls);
+    free(par->dls_merged);
+    free(par->txs);
+    free(par->ups);
+    _mpsc_free(&par->txq);
+    _mpsc_free(&par->upq);
+}
+
+int gnrc_lorawan_sim_par_init(gnrc_lorawan_sim_par_t *par,
+                              gnrc_lorawan_sim_channel_t *ch,
+                              gnrc_lorawan_sim_node_t *nodes, size_t nodes_numof,
+                              const uint32_t *gws, size_t gws_numof,
+                              size_t shards_numof, size_t events_size,
+                              size_t dls_size, uint32_t seed)
+{
+    /* Every node starts at most one transmission and ends at most one
+     * uplink per window */
+    size_t txs_size = nodes_numof + dls_size;
+    int res = -ENOMEM;
+
+    assert(shards_numof && shards_numof <= nodes_numof);
+    assert(CONFIG_GNRC_LORAWAN_SIM_PAR_WINDOW <= LORAMAC_DEFAULT_RX1_DELAY * US_PER_MS);
+
+    memset(par, 0, sizeof(*par));
+    par->ch = ch;
+    par->nodes = nodes;
+    par->nodes_numof = nodes_numof;
+    par->gws = gws;
+    par->gws_numof = gws_numof;
+    par->shards_numof = shards_numof;
+    par->dls_size = dls_size;
+    par->window = CONFIG_GNRC_LORAWAN_SIM_PAR_WINDOW;
+
+    par->shards = calloc(shards_numof, sizeof(gnrc_lorawan_sim_shard_t));
+    par->dls = calloc(dls_size, sizeof(gnrc_lorawan_sim_dl_t));
+    par->dls_merged = calloc(dls_size, 1);
+    /* Sized for full queues plus the downlinks */
+    par->txs = malloc((_pow2(txs_size) + dls_size) * sizeof(gnrc_lorawan_sim_par_tx_t));
+    par->ups = malloc(_pow2(nodes_numof) * sizeof(gnrc_lorawan_sim_uplink_t));
+    if (!par->shards || !par->dls || !par->dls_merged || !par->txs || !par->ups ||
+        _mpsc_init(&par->txq, sizeof(gnrc_lorawan_sim_par_tx_t), txs_size) < 0 ||
+        _mpsc_init(&par->upq, sizeof(gnrc_lorawan_sim_uplink_t), nodes_numof) < 0) {
+        goto error;
+    }
+
+    for (size_t s = 0; s < shards_numof; s++) {
+        gnrc_lorawan_sim_shard_t *shard = &par->shards[s];
+        size_t first = nodes_numof * s / shards_numof;
+        size_t numof = nodes_numof * (s + 1) / shards_numof - first;
+        gnrc_lorawan_sim_event_t *events = malloc(events_size * sizeof(*events));
+
+        shard->rxs = malloc(numof * sizeof(gnrc_lorawan_sim_par_rx_t));
+        if (!events || !shard->rxs ||
+            _mpsc_init(&shard->inbox, sizeof(_dl_msg_t), dls_size) < 0) {
+            free(events);
+            goto error;
+        }
+        /* Downlinks are shared by all shards and owned by the coordinator */
+        gnrc_lorawan_sim_net_init(&shard->net, ch, nodes + first, numof, gws, gws_numof,
+                                  events, events_size, NULL, 0, seed);
+        shard->net.dls = par->dls;
+        shard->net.dls_size = dls_size;
+        shard->net.par = par;
+    }
+
+    pthread_mutex_init(&par->lock, NULL);
+    pthread_cond_init(&par->start, NULL);
+    pthread_cond_init(&par->done, NULL);
+
+    /* Keep the signals of the host (e.g. the timers of RIOT native) in the
+     * calling thread */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (size_t s = 1; s < shards_numof; s++) {
+        if (pthread_create(&par->shards[s].thread, NULL, _worker, &par->shards[s])) {
+            res = -EAGAIN;
+            break;
+        }
+        par->workers++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (par->workers + 1 < shards_numof) {
+        gnrc_lorawan_sim_par_free(par);
+        return res;
+    }
+    return 0;
+
+error:
+    DEBUG("gnrc_lorawan_sim_par: out of memory\n");
+    _free(par);
+    return res;
+}
+
+void gnrc_lorawan_sim_par_free(gnrc_lorawan_sim_par_t *par)
+{
+    _stop(par);
+    pthread_cond_destroy(&par->start);
+    pthread_cond_destroy(&par->done);
+    pthread_mutex_destroy(&par->lock);
+    _free(par);
+}
+
+int gnrc_lorawan_sim_par_downlink(gnrc_lorawan_sim_par_t *par, uint32_t gw,
+                                  uint32_t node, uint64_t start, uint32_t freq,
+                                  uint8_t sf, const uint8_t *data, uint8_t len)
+{
+    gnrc_lorawan_sim_dl_t *slot = NULL;
+    uint64_t end = start + gnrc_lorawan_sim_time_on_air(len, sf, 125, LORA_CR_4_5);
+
+    assert(start >= par->until && node < par->nodes_numof);
+
+    for (size_t i = 0; i < par->dls_size; i++) {
+        gnrc_lorawan_sim_dl_t *dl = &par->dls[i];
+        if (!dl->used) {
+            slot = slot ? slot : dl;
+        }
+        else if (dl->gw == gw && dl->start < end && start < dl->end) {
+            return -EBUSY;
+        }
+    }
+    if (!slot) {
+        return -ENOBUFS;
+    }
+
+    gnrc_lorawan_sim_net_t *net = par->nodes[node].net;
+    _dl_msg_t msg = { .node = &par->nodes[node] - net->nodes, .slot = slot - par->dls };
+    if (_mpsc_push(&_shard(net)->inbox, &msg) < 0) {
+        return -ENOBUFS;
+    }
+
+    slot->start = start;
+    slot->end = end;
+    slot->gw = gw;
+    slot->freq = freq;
+    slot->sf = sf;
+    slot->len = len;
+    memcpy(slot->data, data, len);
+    slot->used = true;
+    par->dls_merged[msg.slot] = false;
+    return 0;
+}
+
+void gnrc_lorawan_sim_par_tx(gnrc_lorawan_sim_net_t *net,
+                             gnrc_lorawan_sim_node_t *node,
+                             const gnrc_lorawan_sim_tx_t *tx)
+{
+    gnrc_lorawan_sim_par_t *par = net->par;
+    gnrc_lorawan_sim_par_tx_t msg = { .tx = *tx, .node = node - par->nodes };
+
+    node->tx_id = INT64_MAX;
+    if (_mpsc_push(&par->txq, &msg) < 0) {
+        __atomic_fetch_add(&par->lost, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void gnrc_lorawan_sim_par_uplink(gnrc_lorawan_sim_net_t *net,
+                                 gnrc_lorawan_sim_node_t *node)
+{
+    gnrc_lorawan_sim_par_t *par = net->par;
+    gnrc_lorawan_sim_uplink_t up = {
+        .data = node->tx_data, .len = node->tx_len, .end = net->now,
+        .node = node - par->nodes, .freq = node->freq, .sf = node->sf,
+    };
+
+    if (_mpsc_push(&par->upq, &up) < 0) {
+        __atomic_fetch_add(&par->lost, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void gnrc_lorawan_sim_par_rx_end(gnrc_lorawan_sim_net_t *net,
+                                 gnrc_lorawan_sim_node_t *node, uint32_t slot)
+{
+    gnrc_lorawan_sim_shard_t *shard = _shard(net);
+
+    shard->rxs[shard->rxs_numof++] = (gnrc_lorawan_sim_par_rx_t) {
+        .node = node - net->nodes, .gen = node->rx_gen, .slot = slot
+    };
+}
+
+static int _cmp_tx(const void *a, const void *b)
+{
+    const gnrc_lorawan_sim_tx_t *x = &((const gnrc_lorawan_sim_par_tx_t *) a)->tx;
+    const gnrc_lorawan_sim_tx_t *y = &((const gnrc_lorawan_sim_par_tx_t *) b)->tx;
+
+    if (x->start != y->start) {
+        return x->start < y->start ? -1 : 1;
+    }
+    return (x->radio > y->radio) - (x->radio < y->radio);
+}
+
+static int _cmp_up(const void *a, const void *b)
+{
+    const gnrc_lorawan_sim_uplink_t *x = a;
+    const gnrc_lorawan_sim_uplink_t *y = b;
+
+    if (x->end != y->end) {
+        return x->end < y->end ? -1 : 1;
+    }
+    return (x->node > y->node) - (x->node < y->node);
+}
+
+/* Runs the events of a shard up to the end of the window */
+static void _job_window(gnrc_lorawan_sim_par_t *par, size_t s)
+{
+    gnrc_lorawan_sim_shard_t *shard = &par->shards[s];
+    _dl_msg_t msg;
+
+    while (_mpsc_pop(&shard->inbox, &msg) == 0) {
+        if (gnrc_lorawan_sim_net_rx_start(&shard->net, msg.node, msg.slot) < 0) {
+            DEBUG("gnrc_lorawan_sim_par: event heap full. Drop downlink\n");
+        }
+    }
+    gnrc_lorawan_sim_net_run(&shard->net, par->until - 1);
+}
+
+/* Adds the transmissions of the window to the channel in start order */
+static void _merge(gnrc_lorawan_sim_par_t *par)
+{
+    size_t numof = 0;
+
+    while (_mpsc_pop(&par->txq, &par->txs[numof]) == 0) {
+        numof++;
+    }
+    for (size_t i = 0; i < par->dls_size; i++) {
+        gnrc_lorawan_sim_dl_t *dl = &par->dls[i];
+        if (dl->used && !par->dls_merged[i] && dl->start < par->until) {
+            par->txs[numof++] = (gnrc_lorawan_sim_par_tx_t) {
+                .tx = {
+                    .start = dl->start, .end = dl->end, .freq = dl->freq,
+                    .radio = dl->gw, .bw = 125, .sf = dl->sf,
+                    .tx_power = par->ch->radios[dl->gw].tx_power
+                },
+                .node = UINT32_MAX, .slot = i,
+            };
+            par->dls_merged[i] = true;
+        }
+    }
+    qsort(par->txs, numof, sizeof(par->txs[0]), _cmp_tx);
+
+    for (size_t i = 0; i < numof; i++) {
+        int64_t id = gnrc_lorawan_sim_channel_tx(par->ch, &par->txs[i].tx);
+        if (id < 0) {
+            DEBUG("gnrc_lorawan_sim_par: channel ring full. Drop transmission\n");
+            id = INT64_MAX;
+        }
+        if (par->txs[i].node != UINT32_MAX) {
+            par->nodes[par->txs[i].node].tx_id = id;
+        }
+        else {
+            par->dls[par->txs[i].slot].tx = id;
+        }
+    }
+
+    numof = 0;
+    while (_mpsc_pop(&par->upq, &par->ups[numof]) == 0) {
+        numof++;
+    }
+    qsort(par->ups, numof, sizeof(par->ups[0]), _cmp_up);
+    par->ups_numof = numof;
+}
+
+/* Decides about the downlinks of the nodes of a shard and about a share of
+ * the uplinks of the window. The channel isn't modified meanwhile */
+static void _job_rx(gnrc_lorawan_sim_par_t *par, size_t s)
+{
+    gnrc_lorawan_sim_shard_t *shard = &par->shards[s];
+    gnrc_lorawan_sim_net_t *net = &shard->net;
+    size_t first = par->ups_numof * s / par->shards_numof;
+    size_t last = par->ups_numof * (s + 1) / par->shards_numof;
+
+    for (size_t i = first; i < last; i++) {
+        gnrc_lorawan_sim_uplink_t *up = &par->ups[i];
+#if CONFIG_GNRC_LORAWAN_SIM_DEDUP
+        if (par->dedup) {
+            gnrc_lorawan_sim_net_forward(par->dedup, par->ch, par->gws, par->gws_numof,
+                                         par->nodes[up->node].tx_id, up);
+            continue;
+        }
+#endif
+        gnrc_lorawan_sim_net_gateways(par->ch, par->gws, par->gws_numof,
+                                      par->nodes[up->node].tx_id, up);
+    }
+
+    net->now = par->until;
+    for (size_t i = 0; i < shard->rxs_numof; i++) {
+        gnrc_lorawan_sim_par_rx_t *rx = &shard->rxs[i];
+        gnrc_lorawan_sim_node_t *node = &net->nodes[rx->node];
+        if (node->rx_gen == rx->gen && node->rx_frame == (int32_t) rx->slot) {
+            gnrc_lorawan_sim_net_rx_end(net, rx->node, rx->slot);
+        }
+    }
+    shard->rxs_numof = 0;
+}
+
+#if CONFIG_GNRC_LORAWAN_SIM_DEDUP
+static void _dedup_uplink(void *arg, const gnrc_lorawan_sim_uplink_t *up)
+{
+    gnrc_lorawan_sim_par_t *par = arg;
+
+    if (par->uplink) {
+        par->uplink(par->nodes[up->node].net, up);
+    }
+}
+#endif
+
+uint64_t gnrc_lorawan_sim_par_run(gnrc_lorawan_sim_par_t *par, uint64_t until)
+{
+    uint64_t processed = 0;
+
+    for (size_t s = 0; s < par->shards_numof; s++) {
+        processed -= par->shards[s].net.processed;
+        par->shards[s].net.app = par->app;
+        par->shards[s].net.arg = par->arg;
+    }
+
+    while (par->now < until) {
+        par->until = (par->now / par->window + 1) * par->window;
+        if (par->until > until) {
+            par->until = until;
+        }
+
+        _run_job(par, _job_window);
+        _merge(par);
+        _run_job(par, _job_rx);
+
+        /* Answers start after the window, so the shards can't miss them */
+#if CONFIG_GNRC_LORAWAN_SIM_DEDUP
+        if (par->dedup) {
+            gnrc_lorawan_sim_dedup_flush(par->dedup, par->until + par->dedup->window,
+                                         _dedup_uplink, par);
+        }
+#endif
+        for (size_t i = 0; !par->dedup && par->uplink && i < par->ups_numof; i++) {
+            gnrc_lorawan_sim_uplink_t *up = &par->ups[i];
+            if (up->gws) {
+                par->uplink(par->nodes[up->node].net, up);
+            }
+        }
+
+        for (size_t i = 0; i < par->dls_size; i++) {
+            gnrc_lorawan_sim_dl_t *dl = &par->dls[i];
+            if (dl->used && par->dls_merged[i] && dl->end < par->until) {
+                dl->used = false;
+            }
+        }
+        par->now = par->until;
+    }
+
+    for (size_t s = 0; s < par->shards_numof; s++) {
+        processed += par->shards[s].net.processed;
+        par->shards[s].net.now = par->now;
+    }
+    return processed;
+}
+
+uint32_t gnrc_lorawan_sim_par_lost(const gnrc_lorawan_sim_par_t *par)
+{
+    uint32_t lost = par->lost;
+
+    for (size_t s = 0; s < par->shards_numof; s++) {
+        lost += par->shards[s].net.lost;
+    }
+    return lost;
+}
+
+#else
+typedef int dont_be_pedantic;
+#endif /* CONFIG_GNRC_LORAWAN_SIM_PAR */
+
+/** @} */
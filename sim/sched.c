@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include "gnrc_lorawan_sim/sched.h"
+
+#if CONFIG_GNRC_LORAWAN_SIM_SCHED
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gnrc_lorawan/region.h"
+#include "net/loramac.h"
+#include "timex.h"
+
+#define ENABLE_DEBUG (0)
+#include "debug.h"
+
+#define HOUR_US         (3600ULL * US_PER_SEC)
+#define DR_SF(dr)       (12U - (dr))    /**< EU868 datarates with 125 kHz */
+
+int gnrc_lorawan_sim_sched_init(gnrc_lorawan_sim_sched_t *sched, const uint32_t *gws,
+                                size_t gws_numof, size_t devs_numof)
+{
+    memset(sched, 0, sizeof(gnrc_lorawan_sim_sched_t));
+    sched->gw_state = calloc(gws_numof, sizeof(gnrc_lorawan_sim_sched_gw_t));
+    sched->devs = calloc(devs_numof, sizeof(gnrc_lorawan_sim_sched_dev_t));
+    if (!sched->gw_state || !sched->devs) {
+        gnrc_lorawan_sim_sched_free(sched);
+        return -ENOMEM;
+    }
+    sched->gws = gws;
+    sched->gws_numof = gws_numof;
+    sched->devs_numof = devs_numof;
+    return 0;
+}
+
+void gnrc_lorawan_sim_sched_free(gnrc_lorawan_sim_sched_t *sched)
+{
+    free(sched->gw_state);
+    free(sched->devs);
+    sched->gw_state = NULL;
+    sched->devs = NULL;
+}
+
+void gnrc_lorawan_sim_sched_uplink(gnrc_lorawan_sim_sched_t *sched, uint32_t dev,
+                                   int confirmed)
+{
+    sched->devs[dev].ack = confirmed;
+}
+
+int gnrc_lorawan_sim_sched_mac_cmd(gnrc_lorawan_sim_sched_t *sched, uint32_t dev,
+                                   const uint8_t *cmd, size_t len)
+{
+    gnrc_lorawan_sim_sched_dev_t *d = &sched->devs[dev];
+
+    if (d->fopts_len + len > GNRC_LORAWAN_SIM_SCHED_FOPTS_MAX) {
+        return -ENOBUFS;
+    }
+    memcpy(d->fopts + d->fopts_len, cmd, len);
+    d->fopts_len += len;
+    return 0;
+}
+
+void gnrc_lorawan_sim_sched_sent(gnrc_lorawan_sim_sched_t *sched, uint32_t dev)
+{
+    gnrc_lorawan_sim_sched_dev_t *d = &sched->devs[dev];
+
+    if (d->ack && d->fopts_len) {
+        sched->stats.merged++;
+    }
+    d->ack = false;
+    d->fopts_len = 0;
+}
+
+static gnrc_lorawan_sim_sched_gw_t *_gw(gnrc_lorawan_sim_sched_t *sched, uint32_t radio)
+{
+    for (size_t g = 0; g < sched->gws_numof; g++) {
+        if (sched->gws[g] == radio) {
+            return &sched->gw_state[g];
+        }
+    }
+    return NULL;
+}
+
+/* Airtime of a band in the hour of start, 0 if the hour isn't tracked */
+static uint64_t *_used(gnrc_lorawan_sim_sched_gw_t *gw, uint8_t band, uint64_t start)
+{
+    uint32_t hour = start / HOUR_US;
+    unsigned i = hour & 1;
+
+    if (gw->hour[band][i] != hour) {
+        gw->hour[band][i] = hour;
+        gw->used[band][i] = 0;
+    }
+    return &gw->used[band][i];
+}
+
+/* Returns a free reservation, or NULL if the gateway transmits in
+ * [start, end) */
+static gnrc_lorawan_sim_sched_busy_t *_free_slot(gnrc_lorawan_sim_sched_gw_t *gw,
+                                                 uint64_t start, uint64_t end,
+                                                 uint64_t now)
+{
+    gnrc_lorawan_sim_sched_busy_t *slot = NULL;
+
+    for (unsigned i = 0; i < CONFIG_GNRC_LORAWAN_SIM_SCHED_GW_SLOTS; i++) {
+        gnrc_lorawan_sim_sched_busy_t *b = &gw->busy[i];
+        if (b->end <= now) {
+            slot = slot ? slot : b;
+        }
+        else if (b->start < end && start < b->end) {
+            return NULL;
+        }
+    }
+    return slot;
+}
+
+static int _try(gnrc_lorawan_sim_sched_t *sched, const gnrc_lorawan_sim_uplink_t *up,
+                uint8_t len, uint64_t now, gnrc_lorawan_sim_sched_tx_t *tx)
+{
+    uint32_t toa = gnrc_lorawan_sim_time_on_air(len, tx->sf, 125, LORA_CR_4_5);
+    uint16_t duty_cycle;
+    uint8_t band = gnrc_lorawan_band_get(tx->freq, &duty_cycle);
+    uint64_t budget = HOUR_US / duty_cycle;
+    size_t numof = up->gws < CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS ?
+                   up->gws : CONFIG_GNRC_LORAWAN_SIM_UPLINK_GWS;
+
+    for (size_t c = 0; c < numof; c++) {
+        gnrc_lorawan_sim_sched_gw_t *gw = _gw(sched, up->gw_list[c]);
+        if (!gw) {
+            continue;
+        }
+
+        uint64_t *used = _used(gw, band, tx->start);
+        if (*used + toa > budget) {
+            sched->stats.duty_cycle++;
+            continue;
+        }
+
+        gnrc_lorawan_sim_sched_busy_t *slot = _free_slot(gw, tx->start,
+                                                         tx->start + toa, now);
+        if (!slot) {
+            continue;
+        }
+
+        slot->start = tx->start;
+        slot->end = tx->start + toa;
+        *used += toa;
+        tx->gw = up->gw_list[c];
+        return 0;
+    }
+    return -EBUSY;
+}
+
+int gnrc_lorawan_sim_sched_pick(gnrc_lorawan_sim_sched_t *sched,
+                                const gnrc_lorawan_sim_uplink_t *up, uint8_t rx_delay,
+                                uint8_t dl_settings, uint8_t len, uint64_t now,
+                                gnrc_lorawan_sim_sched_tx_t *tx)
+{
+    uint64_t rx1 = up->end + (uint64_t) rx_delay * US_PER_SEC;
+    uint8_t dr_offset = (dl_settings >> 4) & 0x7;
+    uint8_t rx2_dr = dl_settings & 0xF;
+    int res = -ETIMEDOUT;
+
+    if (rx1 >= now) {
+        tx->start = rx1;
+        tx->freq = up->freq;
+        tx->sf = DR_SF(gnrc_lorawan_rx1_get_dr_offset(DR_SF(up->sf), dr_offset));
+        tx->window = 1;
+        if ((res = _try(sched, up, len, now, tx)) == 0) {
+            sched->stats.rx1++;
+            return 0;
+        }
+    }
+
+    if (rx1 + US_PER_SEC >= now) {
+        tx->start = rx1 + US_PER_SEC;
+        tx->freq = LORAMAC_DEFAULT_RX2_FREQ;
+        tx->sf = DR_SF(rx2_dr);
+        tx->window = 2;
+        if ((res = _try(sched, up, len, now, tx)) == 0) {
+            sched->stats.rx2++;
+            return 0;
+        }
+    }
+
+    if (res == -ETIMEDOUT) {
+        sched->stats.missed++;
+    }
+    else {
+        DEBUG("gnrc_lorawan_sim_sched: no gateway for node %lu\n",
+              (unsigned long) up->node);
+        sched->stats.busy++;
+    }
+    return res;
+}
+
+#else
+typedef int dont_be_pedantic;
+#endif /* CONFIG_GNRC_LORAWAN_SIM_SCHED */
+
+/** @} */
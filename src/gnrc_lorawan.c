@@ -24,6 +24,12 @@
 #include "net/lorawan/hdr.h"
 #include "net/loramac.h"
 
+#if defined(MODULE_XTIMER)
+#include "xtimer.h"
+#elif defined(MODULE_ZTIMER_USEC)
+#include "ztimer.h"
+#endif
+
 #define ENABLE_DEBUG    (0)
 #include "debug.h"
 
@@ -32,6 +38,28 @@
 #define GNRC_LORAWAN_DL_DR_OFFSET_MASK    (0x70)  /**< DL Settings RX2 DR mask */
 #define GNRC_LORAWAN_DL_DR_OFFSET_POS     (4)     /**< DL Settings RX2 DR pos */
 
+#if CONFIG_GNRC_LORAWAN_SIZE_MAX
+_Static_assert(sizeof(gnrc_lorawan_t) <= CONFIG_GNRC_LORAWAN_SIZE_MAX,
+               "gnrc_lorawan_t exceeds CONFIG_GNRC_LORAWAN_SIZE_MAX");
+#endif
+
+static inline void _set_state(gnrc_lorawan_t *mac, int state)
+{
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_STATE, mac->state, state);
+    mac->state = state;
+}
+
+static void _radio_sleep(gnrc_lorawan_t *mac)
+{
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_RADIO_SLEEP, mac->state, 0);
+    gnrc_lorawan_energy_account(mac, GNRC_LORAWAN_RADIO_MODE_SLEEP);
+    gnrc_lorawan_radio_sleep(mac);
+}
+
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+static void _mac_timer_cb(gnrc_lorawan_timer_t *timer);
+#endif
+
 static inline void gnrc_lorawan_mlme_reset(gnrc_lorawan_t *mac)
 {
     mac->mlme.activation = MLME_ACTIVATION_NONE;
@@ -51,6 +79,21 @@ static inline void gnrc_lorawan_mcps_reset(gnrc_lorawan_t *mac)
     mac->mcps.waiting_for_ack = false;
     mac->mcps.fcnt = 0;
     mac->mcps.fcnt_down = 0;
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    mac->drain.count = 0;
+    mac->drain.pending = false;
+    mac->drain.active = false;
+#endif
+    gnrc_lorawan_keystream_invalidate(mac);
+}
+
+/* The MAC stays busy if the end of the transaction scheduled the next
+ * transmission of the MAC itself */
+static void _end_transaction(gnrc_lorawan_t *mac)
+{
+    if (mac->state != LORAWAN_STATE_TX_WAIT) {
+        gnrc_lorawan_mac_release(mac);
+    }
 }
 
 void gnrc_lorawan_init(gnrc_lorawan_t *mac, uint8_t *nwkskey, uint8_t *appskey,
@@ -60,7 +103,36 @@ void gnrc_lorawan_init(gnrc_lorawan_t *mac, uint8_t *nwkskey, uint8_t *appskey,
     mac->appskey = appskey;
     mac->tx_buf = tx_buf;
     mac->busy = false;
+#if CONFIG_GNRC_LORAWAN_STATS
+    memset(&mac->stats, 0, sizeof(mac->stats));
+#endif
+#if CONFIG_GNRC_LORAWAN_TRACE
+    atomic_init(&mac->trace.head, 0);
+    atomic_init(&mac->trace.tail, 0);
+    mac->trace.lost = 0;
+#endif
+#if CONFIG_GNRC_LORAWAN_CQ
+    mac->cq.entries = NULL;
+#endif
+#if CONFIG_GNRC_LORAWAN_COMPRESS
+    memset(mac->codecs, 0, sizeof(mac->codecs));
+#endif
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG
+    mac->ufrag.pkt = NULL;
+#endif
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    mac->drain.policy = 0;
+    mac->drain.active = false;
+#endif
+    gnrc_lorawan_energy_init(mac);
+    gnrc_lorawan_bands_init(mac);
+    gnrc_lorawan_frag_init(mac);
     gnrc_lorawan_mlme_backoff_init(mac);
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+    gnrc_lorawan_wheel_init(mac);
+    gnrc_lorawan_wheel_timer_init(&mac->timer, _mac_timer_cb, mac);
+    gnrc_lorawan_mlme_backoff_tick(mac);
+#endif
     gnrc_lorawan_reset(mac);
 }
 
@@ -72,8 +144,24 @@ void gnrc_lorawan_set_rx2_dr(gnrc_lorawan_t *mac, uint8_t rx2_dr)
 }
 
 
+void gnrc_lorawan_stop(gnrc_lorawan_t *mac)
+{
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_TIMER_STOP, mac->state, 0);
+    gnrc_lorawan_mac_timer_stop(mac);
+    _radio_sleep(mac);
+    _set_state(mac, LORAWAN_STATE_IDLE);
+    gnrc_lorawan_mac_release(mac);
+}
+
 void gnrc_lorawan_reset(gnrc_lorawan_t *mac)
 {
+    /* Stop the transmissions the MAC started on its own and the ones
+     * waiting for the timer (e.g. the jitter of a Join Request), which would
+     * send the cleared TX buffer */
+    if (gnrc_lorawan_mcps_abort(mac) || mac->state == LORAWAN_STATE_TX_WAIT) {
+        gnrc_lorawan_stop(mac);
+    }
+
     gnrc_lorawan_radio_set_cr(mac, LORA_CR_4_5);
     gnrc_lorawan_radio_set_syncword(mac, LORAMAC_DEFAULT_PUBLIC_NETWORK ? LORA_SYNCWORD_PUBLIC
                                                       : LORA_SYNCWORD_PRIVATE);
@@ -95,43 +183,70 @@ static void _config_radio(gnrc_lorawan_t *mac, uint32_t channel_freq, uint8_t dr
     gnrc_lorawan_radio_set_iq_invert(mac, rx);
 
     gnrc_lorawan_set_dr(mac, dr);
-
-    if (rx) {
-        /* Switch to single listen mode */
-        gnrc_lorawan_radio_set_rx_symbol_timeout(mac, CONFIG_GNRC_LORAWAN_MIN_SYMBOLS_TIMEOUT);
-    }
 }
 
-static void _configure_rx_window(gnrc_lorawan_t *mac, uint32_t channel_freq, uint8_t dr)
+/* Configure a reception window that times out within `max_us` */
+static void _configure_rx_window(gnrc_lorawan_t *mac, uint32_t channel_freq, uint8_t dr,
+                                 uint32_t max_us)
 {
+    uint32_t symbols = max_us / gnrc_lorawan_region_symbol_time(dr) - 1;
+
     _config_radio(mac, channel_freq, dr, true);
+
+    /* Switch to single listen mode */
+    if (symbols > CONFIG_GNRC_LORAWAN_MIN_SYMBOLS_TIMEOUT) {
+        symbols = CONFIG_GNRC_LORAWAN_MIN_SYMBOLS_TIMEOUT;
+    }
+    gnrc_lorawan_radio_set_rx_symbol_timeout(mac, symbols);
 }
 
 void gnrc_lorawan_open_rx_window(gnrc_lorawan_t *mac)
 {
     /* Switch to RX state */
     if (mac->state == LORAWAN_STATE_RX_1) {
-        gnrc_lorawan_timer_set(mac, 1000);
+        GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_TIMER_SET, mac->state, 1000);
+        gnrc_lorawan_mac_timer_set(mac, 1000);
     }
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_RADIO_RX_ON, mac->state, 0);
+    gnrc_lorawan_energy_account(mac, GNRC_LORAWAN_RADIO_MODE_RX);
     gnrc_lorawan_radio_rx_on(mac);
 }
 
 void gnrc_lorawan_event_tx_complete(gnrc_lorawan_t *mac)
 {
-    mac->state = LORAWAN_STATE_RX_1;
+    _set_state(mac, LORAWAN_STATE_RX_1);
+
+    /* The ACK is on air. Until then, it goes out with the next uplink, also
+     * if LBT gave up this one */
+    mac->mcps.ack_requested = false;
 
     int rx_1;
     /* if the MAC is not activated, then this is a Join Request */
     rx_1 = mac->mlme.activation == MLME_ACTIVATION_NONE ?
            LORAMAC_DEFAULT_JOIN_DELAY1 : mac->rx_delay;
 
-    gnrc_lorawan_timer_set(mac, rx_1*1000);
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_TIMER_SET, mac->state, rx_1*1000);
+    gnrc_lorawan_mac_timer_set(mac, rx_1*1000);
 
     uint8_t dr_offset = (mac->dl_settings & GNRC_LORAWAN_DL_DR_OFFSET_MASK) >>
         GNRC_LORAWAN_DL_DR_OFFSET_POS;
-    _configure_rx_window(mac, 0, gnrc_lorawan_rx1_get_dr_offset(mac->last_dr, dr_offset));
-
-    gnrc_lorawan_radio_sleep(mac);
+    /* RX1 has to time out before RX2 opens one second later */
+    _configure_rx_window(mac, 0, gnrc_lorawan_rx1_get_dr_offset(mac->last_dr, dr_offset),
+                         US_PER_SEC);
+
+    _radio_sleep(mac);
+
+#if CONFIG_GNRC_LORAWAN_KEYSTREAM
+    /* Use the RX1 delay to prepare the keystream of the expected downlink
+     * and of the next uplink. Downlinks are decrypted with the 16 bit FCnt
+     * of the header */
+    if (mac->mlme.activation != MLME_ACTIVATION_NONE) {
+        gnrc_lorawan_keystream_precompute(mac, (uint16_t)(mac->mcps.fcnt_down + 1),
+                                          GNRC_LORAWAN_DIR_DOWNLINK, mac->appskey);
+        gnrc_lorawan_keystream_precompute(mac, mac->mcps.fcnt + 1,
+                                          GNRC_LORAWAN_DIR_UPLINK, mac->appskey);
+    }
+#endif
 }
 
 void gnrc_lorawan_event_timeout(gnrc_lorawan_t *mac)
@@ -139,24 +254,26 @@ void gnrc_lorawan_event_timeout(gnrc_lorawan_t *mac)
     (void) mac;
     switch (mac->state) {
         case LORAWAN_STATE_RX_1:
-            _configure_rx_window(mac, LORAMAC_DEFAULT_RX2_FREQ, mac->dl_settings & GNRC_LORAWAN_DL_RX2_DR_MASK);
-            mac->state = LORAWAN_STATE_RX_2;
+            _configure_rx_window(mac, LORAMAC_DEFAULT_RX2_FREQ,
+                                 mac->dl_settings & GNRC_LORAWAN_DL_RX2_DR_MASK, UINT32_MAX);
+            _set_state(mac, LORAWAN_STATE_RX_2);
             break;
         case LORAWAN_STATE_RX_2:
+            GNRC_LORAWAN_STATS_INC(mac, no_rx);
+            _set_state(mac, LORAWAN_STATE_IDLE);
             gnrc_lorawan_mlme_no_rx(mac);
             gnrc_lorawan_mcps_event(mac, MCPS_EVENT_NO_RX, 0);
-            mac->state = LORAWAN_STATE_IDLE;
-            gnrc_lorawan_mac_release(mac);
+            _end_transaction(mac);
             break;
         default:
             assert(false);
     }
-    gnrc_lorawan_radio_sleep(mac);
+    _radio_sleep(mac);
 }
 
 /* This function uses a precomputed table to calculate time on air without
  * using floating point arithmetics */
-static uint32_t lora_time_on_air(size_t payload_size, uint8_t dr, uint8_t cr)
+uint32_t gnrc_lorawan_time_on_air(size_t payload_size, uint8_t dr, uint8_t cr)
 {
     assert(dr <= LORAMAC_DR_6);
     uint8_t _K[6][4] = {    { 0, 1, 5, 5 },
@@ -189,55 +306,231 @@ static uint32_t lora_time_on_air(size_t payload_size, uint8_t dr, uint8_t cr)
     return t_preamble + t_payload;
 }
 
-void gnrc_lorawan_send_pkt(gnrc_lorawan_t *mac, iolist_t *io, uint8_t dr)
+
+#if CONFIG_GNRC_LORAWAN_LBT
+/* Returns the frequency of a clear channel, or 0 if all checked channels
+ * were busy */
+static uint32_t _pick_clear_channel(gnrc_lorawan_t *mac, uint8_t dr)
 {
-    mac->state = LORAWAN_STATE_TX;
+    uint16_t busy = 0;
 
-    uint32_t chan = gnrc_lorawan_pick_channel(mac);
-    _config_radio(mac, chan, dr, false);
+    for (unsigned i = 0; i < CONFIG_GNRC_LORAWAN_LBT_CHANNELS_MAX; i++) {
+        uint32_t chan = gnrc_lorawan_pick_channel(mac, busy);
+        if (!chan) {
+            break;
+        }
+
+        _config_radio(mac, chan, dr, false);
+        int clear = gnrc_lorawan_radio_cca(mac);
+        GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_CCA, mac->last_chan, clear);
+        if (clear) {
+            GNRC_LORAWAN_STATS_INC(mac, cca_clear);
+            return chan;
+        }
+        GNRC_LORAWAN_STATS_INC(mac, cca_busy);
+        busy |= 1 << mac->last_chan;
+    }
+    return 0;
+}
+
+/* Retry the transmission of the packet in the TX buffer after a random
+ * backoff, or give up. A Join Request fails like one without Join Accept,
+ * a data frame is reported through the MCPS confirm only */
+static void _defer_tx(gnrc_lorawan_t *mac)
+{
+    _radio_sleep(mac);
+
+    if (mac->lbt_deferrals++ < CONFIG_GNRC_LORAWAN_LBT_DEFER_MAX) {
+        uint32_t backoff = 1 + gnrc_lorawan_random_get(mac) %
+                           (CONFIG_GNRC_LORAWAN_LBT_BACKOFF * mac->lbt_deferrals);
+        DEBUG("gnrc_lorawan: channels busy. Defer TX by %u ms\n", (unsigned) backoff);
+        GNRC_LORAWAN_STATS_INC(mac, tx_deferred);
+        gnrc_lorawan_schedule_tx(mac, mac->last_dr, backoff);
+        return;
+    }
+
+    DEBUG("gnrc_lorawan: channels busy. Give up TX\n");
+    _set_state(mac, LORAWAN_STATE_IDLE);
+    mac->lbt_deferrals = 0;
+    GNRC_LORAWAN_STATS_INC(mac, tx_aborted);
+    /* Pending MAC commands go out with the next uplink */
+    if (mac->mlme.activation == MLME_ACTIVATION_NONE) {
+        gnrc_lorawan_mlme_no_rx(mac);
+    }
+    else {
+        gnrc_lorawan_mcps_event(mac, MCPS_EVENT_CHANNEL_BUSY, 0);
+    }
+    _end_transaction(mac);
+}
+#endif
+
+void gnrc_lorawan_schedule_tx(gnrc_lorawan_t *mac, uint8_t dr, uint32_t delay)
+{
+    _set_state(mac, LORAWAN_STATE_TX_WAIT);
+    mac->last_dr = dr;
+    mac->toa = gnrc_lorawan_time_on_air(mac->tx_len, dr, LORA_CR_4_5 + 4);
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_TIMER_SET, mac->state, delay);
+    gnrc_lorawan_mac_timer_set(mac, delay);
+}
+
+void gnrc_lorawan_send_pkt(gnrc_lorawan_t *mac, iolist_t *io, uint8_t dr)
+{
+    _set_state(mac, LORAWAN_STATE_TX);
 
     mac->last_dr = dr;
-    mac->toa = lora_time_on_air(iolist_size(io), dr, LORA_CR_4_5 + 4);
+    mac->toa = gnrc_lorawan_time_on_air(iolist_size(io), dr, LORA_CR_4_5 + 4);
 
+#if CONFIG_GNRC_LORAWAN_LBT
+    uint32_t chan = _pick_clear_channel(mac, dr);
+    if (!chan) {
+        _defer_tx(mac);
+        return;
+    }
+    mac->lbt_deferrals = 0;
+#else
+    uint32_t chan = gnrc_lorawan_pick_channel(mac, 0);
+    _config_radio(mac, chan, dr, false);
+#endif
+    gnrc_lorawan_band_register_tx(mac, chan, mac->toa);
+    GNRC_LORAWAN_STATS_ADD(mac, toa_dr[dr], mac->toa / US_PER_MS);
+    GNRC_LORAWAN_STATS_ADD(mac, toa_channel[mac->last_chan], mac->toa / US_PER_MS);
+
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_RADIO_SEND, dr, iolist_size(io));
+    gnrc_lorawan_energy_account(mac, GNRC_LORAWAN_RADIO_MODE_TX);
     gnrc_lorawan_radio_send(mac, io);
 }
 
-void gnrc_lorawan_process_pkt(gnrc_lorawan_t *mac, uint8_t *data, size_t size)
+#if CONFIG_GNRC_LORAWAN_LINK_QUALITY
+static int16_t _ewma(int16_t estimate, int16_t sample, int first)
 {
-    gnrc_lorawan_radio_sleep(mac);
-    mac->state = LORAWAN_STATE_IDLE;
-    gnrc_lorawan_timer_stop(mac);
+    /* Fixed point with 4 fractional bits */
+    int32_t value = (int32_t) sample * 16;
+
+    if (first) {
+        return value;
+    }
+    return estimate + (value - estimate) / (1 << CONFIG_GNRC_LORAWAN_LINK_QUALITY_SHIFT);
+}
+
+void gnrc_lorawan_link_update(gnrc_lorawan_t *mac, const gnrc_lorawan_rx_info_t *rx)
+{
+    /* RX1 uses the uplink channel */
+    unsigned chan = rx->window == 1 ? mac->last_chan : GNRC_LORAWAN_LINK_RX2;
+    gnrc_lorawan_link_t *link = &mac->link[chan];
+
+    link->rssi = _ewma(link->rssi, rx->rssi, !link->count);
+    link->snr = _ewma(link->snr, rx->snr, !link->count);
+    if (link->count < UINT16_MAX) {
+        link->count++;
+    }
+    link->last = rx->timestamp;
+}
+#endif
+
+void gnrc_lorawan_rx_accepted(gnrc_lorawan_t *mac, const gnrc_lorawan_rx_info_t *rx)
+{
+    if (rx->window == 1) {
+        GNRC_LORAWAN_STATS_INC(mac, rx1);
+    }
+    else {
+        GNRC_LORAWAN_STATS_INC(mac, rx2);
+    }
+    if (rx->radio) {
+        gnrc_lorawan_link_update(mac, rx);
+    }
+}
+
+void gnrc_lorawan_process_pkt(gnrc_lorawan_t *mac, uint8_t *data, size_t size,
+                              const gnrc_lorawan_rx_info_t *info)
+{
+    gnrc_lorawan_rx_info_t rx = { 0 };
+
+    if (info) {
+        rx = *info;
+    }
+    rx.radio = info != NULL;
+
+    _radio_sleep(mac);
+    if (mac->state == LORAWAN_STATE_RX_1) {
+        uint8_t dr_offset = (mac->dl_settings & GNRC_LORAWAN_DL_DR_OFFSET_MASK) >>
+            GNRC_LORAWAN_DL_DR_OFFSET_POS;
+        rx.window = 1;
+        rx.freq = gnrc_lorawan_channel_get(mac, mac->last_chan);
+        rx.dr = gnrc_lorawan_rx1_get_dr_offset(mac->last_dr, dr_offset);
+    }
+    else {
+        rx.window = 2;
+        rx.freq = LORAMAC_DEFAULT_RX2_FREQ;
+        rx.dr = mac->dl_settings & GNRC_LORAWAN_DL_RX2_DR_MASK;
+    }
+    _set_state(mac, LORAWAN_STATE_IDLE);
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_TIMER_STOP, mac->state, 0);
+    gnrc_lorawan_mac_timer_stop(mac);
 
     uint8_t mtype = (*data & MTYPE_MASK) >> 5;
     switch (mtype) {
         case MTYPE_JOIN_ACCEPT:
-            gnrc_lorawan_mlme_process_join(mac, data, size);
+            gnrc_lorawan_mlme_process_join(mac, data, size, &rx);
             break;
         case MTYPE_CNF_DOWNLINK:
         case MTYPE_UNCNF_DOWNLINK:
-            gnrc_lorawan_mcps_process_downlink(mac, data, size);
+            gnrc_lorawan_mcps_process_downlink(mac, data, size, &rx);
             break;
         default:
             break;
     }
 
-    gnrc_lorawan_mac_release(mac);
+    _end_transaction(mac);
 }
 
-void gnrc_lorawan_timer_fired(gnrc_lorawan_t *mac)
+static void _timer_fired(gnrc_lorawan_t *mac)
 {
-    if(mac->state == LORAWAN_STATE_IDLE)
-    {
-        iolist_t pkt = {
-            .iol_base = mac->tx_buf,
-            .iol_len = mac->tx_len,
-            .iol_next = NULL
-        };
-        gnrc_lorawan_send_pkt(mac, &pkt, mac->last_dr);
-    }
-    else {
-        gnrc_lorawan_open_rx_window(mac);
+    iolist_t pkt = {
+        .iol_base = mac->tx_buf,
+        .iol_len = mac->tx_len,
+        .iol_next = NULL
+    };
+
+    switch (mac->state) {
+        case LORAWAN_STATE_IDLE:
+            DEBUG("gnrc_lorawan: timer fired while idle\n");
+            break;
+        case LORAWAN_STATE_TX_WAIT:
+            gnrc_lorawan_send_pkt(mac, &pkt, mac->last_dr);
+            break;
+        default:
+            gnrc_lorawan_open_rx_window(mac);
+            break;
     }
 }
 
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+static void _mac_timer_cb(gnrc_lorawan_timer_t *timer)
+{
+    _timer_fired(timer->arg);
+}
+#endif
+
+#if defined(MODULE_XTIMER) || defined(MODULE_ZTIMER_USEC)
+/* Ports written before the hook existed keep linking */
+__attribute__((weak)) uint32_t gnrc_lorawan_timer_now(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+#if defined(MODULE_XTIMER)
+    return xtimer_now_usec();
+#else
+    return ztimer_now(ZTIMER_USEC);
+#endif
+}
+#endif
+
+void gnrc_lorawan_timer_fired(gnrc_lorawan_t *mac)
+{
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+    gnrc_lorawan_wheel_expire(mac);
+#else
+    _timer_fired(mac);
+#endif
+}
+
 /** @} */
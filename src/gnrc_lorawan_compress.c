@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <errno.h>
+#include <string.h>
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/compress.h"
+#include "gnrc_lorawan_internal.h"
+
+#define ENABLE_DEBUG (0)
+#include "debug.h"
+
+#define DICT_WORD_FLAG (0x80)   /**< token is a dictionary word */
+#define DICT_LITERAL_MAX (128U) /**< maximum length of a literal run */
+
+/* Byte reader over an iolist */
+typedef struct {
+    const iolist_t *io;
+    size_t pos;
+} _reader_t;
+
+static int _read(_reader_t *r)
+{
+    while (r->io && r->pos >= r->io->iol_len) {
+        r->io = r->io->iol_next;
+        r->pos = 0;
+    }
+    if (!r->io) {
+        return -1;
+    }
+    return ((const uint8_t *) r->io->iol_base)[r->pos++];
+}
+
+static int _delta_valid(const gnrc_lorawan_codec_t *codec)
+{
+    uint8_t width = codec->delta.width;
+    uint8_t stride = codec->delta.stride;
+
+    return (width == 1 || width == 2 || width == 4) &&
+           stride && stride <= GNRC_LORAWAN_CODEC_DELTA_STRIDE_MAX;
+}
+
+static int32_t _sign_extend(uint32_t value, unsigned width)
+{
+    unsigned shift = 32 - 8 * width;
+
+    return (int32_t)(value << shift) >> shift;
+}
+
+ssize_t gnrc_lorawan_codec_delta_compress(const gnrc_lorawan_codec_t *codec,
+                                          const iolist_t *in, uint8_t *out, size_t max)
+{
+    unsigned width = codec->delta.width;
+    unsigned stride = codec->delta.stride;
+    uint32_t prev[GNRC_LORAWAN_CODEC_DELTA_STRIDE_MAX] = { 0 };
+    _reader_t r = { .io = in };
+    size_t len = 0;
+
+    if (!_delta_valid(codec) || iolist_size(in) % width) {
+        return -EINVAL;
+    }
+
+    size_t count = iolist_size(in) / width;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = 0;
+        for (unsigned b = 0; b < width; b++) {
+            value |= (uint32_t) _read(&r) << (8 * b);
+        }
+
+        /* The difference is taken modulo the width, so it always fits */
+        int32_t diff = _sign_extend(value - prev[i % stride], width);
+        uint32_t zigzag = ((uint32_t) diff << 1) ^ (uint32_t)(diff >> 31);
+        prev[i % stride] = value;
+
+        do {
+            if (len >= max) {
+                return -EMSGSIZE;
+            }
+            out[len] = zigzag & 0x7F;
+            zigzag >>= 7;
+            out[len++] |= zigzag ? 0x80 : 0;
+        } while (zigzag);
+    }
+
+    return len;
+}
+
+ssize_t gnrc_lorawan_codec_delta_decompress(const gnrc_lorawan_codec_t *codec,
+                                            const uint8_t *in, size_t len,
+                                            uint8_t *out, size_t max)
+{
+    unsigned width = codec->delta.width;
+    unsigned stride = codec->delta.stride;
+    size_t pos = 0;
+    size_t olen = 0;
+
+    if (!_delta_valid(codec)) {
+        return -EINVAL;
+    }
+
+    while (pos < len) {
+        uint32_t zigzag = 0;
+        unsigned shift = 0;
+        uint8_t byte;
+
+        do {
+            if (pos >= len || shift > 28) {
+                return -EINVAL;
+            }
+            byte = in[pos++];
+            zigzag |= (uint32_t)(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        if (olen + width > max) {
+            return -EMSGSIZE;
+        }
+
+        uint32_t value = (zigzag >> 1) ^ -(zigzag & 1);
+        if (olen >= stride * width) {
+            const uint8_t *ref = &out[olen - stride * width];
+            for (unsigned b = 0; b < width; b++) {
+                value += (uint32_t) ref[b] << (8 * b);
+            }
+        }
+        for (unsigned b = 0; b < width; b++) {
+            out[olen++] = value >> (8 * b);
+        }
+    }
+
+    return olen;
+}
+
+static int _dict_match(const _reader_t *r, const gnrc_lorawan_codec_word_t *word)
+{
+    _reader_t tmp = *r;
+    const uint8_t *data = word->data;
+
+    for (unsigned i = 0; i < word->len; i++) {
+        if (_read(&tmp) != data[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ssize_t gnrc_lorawan_codec_dict_compress(const gnrc_lorawan_codec_t *codec,
+                                         const iolist_t *in, uint8_t *out, size_t max)
+{
+    _reader_t r = { .io = in };
+    size_t remaining = iolist_size(in);
+    size_t len = 0;
+    /* Position of the length byte of the current literal run, 0 if none */
+    size_t literal = 0;
+
+    if (codec->dict.numof > GNRC_LORAWAN_CODEC_DICT_NUMOF_MAX) {
+        return -EINVAL;
+    }
+
+    while (remaining) {
+        int best = -1;
+        unsigned best_len = 1;
+
+        /* Greedy longest match. A one byte word doesn't save anything */
+        for (unsigned i = 0; i < codec->dict.numof; i++) {
+            const gnrc_lorawan_codec_word_t *word = &codec->dict.words[i];
+            if (word->len > best_len && word->len <= remaining &&
+                _dict_match(&r, word)) {
+                best = i;
+                best_len = word->len;
+            }
+        }
+
+        if (best >= 0) {
+            if (len >= max) {
+                return -EMSGSIZE;
+            }
+            out[len++] = DICT_WORD_FLAG | best;
+            for (unsigned i = 0; i < best_len; i++) {
+                _read(&r);
+            }
+            remaining -= best_len;
+            literal = 0;
+            continue;
+        }
+
+        if (!literal || out[literal - 1] == DICT_LITERAL_MAX - 1) {
+            if (len + 2 > max) {
+                return -EMSGSIZE;
+            }
+            out[len++] = 0;
+            literal = len;
+        }
+        else {
+            if (len >= max) {
+                return -EMSGSIZE;
+            }
+            out[literal - 1]++;
+        }
+        out[len++] = _read(&r);
+        remaining--;
+    }
+
+    return len;
+}
+
+ssize_t gnrc_lorawan_codec_dict_decompress(const gnrc_lorawan_codec_t *codec,
+                                           const uint8_t *in, size_t len,
+                                           uint8_t *out, size_t max)
+{
+    size_t pos = 0;
+    size_t olen = 0;
+
+    while (pos < len) {
+        uint8_t token = in[pos++];
+        const uint8_t *src;
+        size_t size;
+
+        if (token & DICT_WORD_FLAG) {
+            token &= ~DICT_WORD_FLAG;
+            if (token >= codec->dict.numof) {
+                return -EINVAL;
+            }
+            src = codec->dict.words[token].data;
+            size = codec->dict.words[token].len;
+        }
+        else {
+            size = token + 1;
+            if (pos + size > len) {
+                return -EINVAL;
+            }
+            src = &in[pos];
+            pos += size;
+        }
+
+        if (olen + size > max) {
+            return -EMSGSIZE;
+        }
+        memcpy(&out[olen], src, size);
+        olen += size;
+    }
+
+    return olen;
+}
+
+#if CONFIG_GNRC_LORAWAN_COMPRESS
+int gnrc_lorawan_codec_set(gnrc_lorawan_t *mac, uint8_t port,
+                           const gnrc_lorawan_codec_t *codec)
+{
+    gnrc_lorawan_codec_slot_t *empty = NULL;
+
+    if (port < LORAMAC_PORT_MIN || port > LORAMAC_PORT_MAX) {
+        return -EINVAL;
+    }
+
+    for (unsigned i = 0; i < CONFIG_GNRC_LORAWAN_COMPRESS_PORTS; i++) {
+        gnrc_lorawan_codec_slot_t *slot = &mac->codecs[i];
+        if (slot->codec && slot->port == port) {
+            slot->codec = codec;
+            return 0;
+        }
+        if (!slot->codec && !empty) {
+            empty = slot;
+        }
+    }
+
+    if (!codec) {
+        return 0;
+    }
+    if (!empty) {
+        return -ENOMEM;
+    }
+
+    empty->port = port;
+    empty->codec = codec;
+    return 0;
+}
+
+const gnrc_lorawan_codec_t *gnrc_lorawan_codec_get(gnrc_lorawan_t *mac, uint8_t port)
+{
+    for (unsigned i = 0; i < CONFIG_GNRC_LORAWAN_COMPRESS_PORTS; i++) {
+        if (mac->codecs[i].codec && mac->codecs[i].port == port) {
+            return mac->codecs[i].codec;
+        }
+    }
+    return NULL;
+}
+#endif
+
+/** @} */
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/cq.h"
+#include "gnrc_lorawan_internal.h"
+
+#define ENABLE_DEBUG (0)
+#include "debug.h"
+
+#if CONFIG_GNRC_LORAWAN_CQ
+void gnrc_lorawan_cq_init(gnrc_lorawan_t *mac, gnrc_lorawan_cq_entry_t *entries,
+                          size_t numof)
+{
+    assert(!mac->busy);
+    assert(!(numof & (numof - 1)) && numof <= (1U << 15));
+
+    mac->cq.entries = numof ? entries : NULL;
+    mac->cq.mask = numof - 1;
+    atomic_init(&mac->cq.head, 0);
+    atomic_init(&mac->cq.tail, 0);
+    mac->cq.lost = 0;
+}
+
+/* Returns the next free entry, or NULL if the ring is full */
+static gnrc_lorawan_cq_entry_t *_reserve(gnrc_lorawan_t *mac, uint8_t type)
+{
+    gnrc_lorawan_cq_t *cq = &mac->cq;
+    uint16_t head = atomic_load_explicit(&cq->head, memory_order_relaxed);
+    uint16_t tail = atomic_load_explicit(&cq->tail, memory_order_acquire);
+
+    if ((uint16_t)(head - tail) > cq->mask) {
+        DEBUG("gnrc_lorawan_cq: queue full, dropping event %u\n", type);
+        cq->lost++;
+        return NULL;
+    }
+
+    gnrc_lorawan_cq_entry_t *entry = &cq->entries[head & cq->mask];
+    entry->type = type;
+    return entry;
+}
+
+static void _commit(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_cq_t *cq = &mac->cq;
+    uint16_t head = atomic_load_explicit(&cq->head, memory_order_relaxed);
+
+    atomic_store_explicit(&cq->head, (uint16_t)(head + 1), memory_order_release);
+    gnrc_lorawan_cq_notify(mac);
+}
+
+void gnrc_lorawan_deliver_mcps_confirm(gnrc_lorawan_t *mac, mcps_confirm_t *confirm)
+{
+    gnrc_lorawan_cq_entry_t *entry;
+
+    if (!mac->cq.entries) {
+        gnrc_lorawan_mcps_confirm(mac, confirm);
+        return;
+    }
+
+    if ((entry = _reserve(mac, GNRC_LORAWAN_CQ_MCPS_CONFIRM))) {
+        entry->mcps_confirm = *confirm;
+        _commit(mac);
+    }
+}
+
+void gnrc_lorawan_deliver_mcps_indication(gnrc_lorawan_t *mac, mcps_indication_t *ind)
+{
+    gnrc_lorawan_cq_entry_t *entry;
+
+    if (!mac->cq.entries) {
+        gnrc_lorawan_mcps_indication(mac, ind);
+        return;
+    }
+
+    size_t len = iolist_size(ind->data.pkt);
+    if (len > CONFIG_GNRC_LORAWAN_CQ_PAYLOAD_MAX) {
+        DEBUG("gnrc_lorawan_cq: downlink too long (%u bytes)\n", (unsigned) len);
+        mac->cq.lost++;
+        return;
+    }
+
+    if ((entry = _reserve(mac, GNRC_LORAWAN_CQ_MCPS_INDICATION))) {
+        uint8_t *dst = entry->payload;
+        for (const iolist_t *io = ind->data.pkt; io; io = io->iol_next) {
+            memcpy(dst, io->iol_base, io->iol_len);
+            dst += io->iol_len;
+        }
+        entry->mcps_indication = *ind;
+        entry->pkt.iol_next = NULL;
+        entry->pkt.iol_len = len;
+        _commit(mac);
+    }
+}
+
+void gnrc_lorawan_deliver_mlme_confirm(gnrc_lorawan_t *mac, mlme_confirm_t *confirm)
+{
+    gnrc_lorawan_cq_entry_t *entry;
+
+    if (!mac->cq.entries) {
+        gnrc_lorawan_mlme_confirm(mac, confirm);
+        return;
+    }
+
+    if ((entry = _reserve(mac, GNRC_LORAWAN_CQ_MLME_CONFIRM))) {
+        entry->mlme_confirm = *confirm;
+        _commit(mac);
+    }
+}
+
+void gnrc_lorawan_deliver_mlme_indication(gnrc_lorawan_t *mac, mlme_indication_t *ind)
+{
+    gnrc_lorawan_cq_entry_t *entry;
+
+    if (!mac->cq.entries) {
+        gnrc_lorawan_mlme_indication(mac, ind);
+        return;
+    }
+
+    if ((entry = _reserve(mac, GNRC_LORAWAN_CQ_MLME_INDICATION))) {
+        entry->mlme_indication = *ind;
+        _commit(mac);
+    }
+}
+
+size_t gnrc_lorawan_cq_drain(gnrc_lorawan_t *mac, gnrc_lorawan_cq_entry_t *entries,
+                             size_t max)
+{
+    gnrc_lorawan_cq_t *cq = &mac->cq;
+    uint16_t tail = atomic_load_explicit(&cq->tail, memory_order_relaxed);
+    uint16_t head = atomic_load_explicit(&cq->head, memory_order_acquire);
+    size_t count = 0;
+
+    if (!cq->entries) {
+        return 0;
+    }
+
+    while (tail != head && count < max) {
+        const gnrc_lorawan_cq_entry_t *src = &cq->entries[tail & cq->mask];
+        gnrc_lorawan_cq_entry_t *dst = &entries[count++];
+
+        /* Only copy the payload bytes in use */
+        memcpy(dst, src, offsetof(gnrc_lorawan_cq_entry_t, payload));
+        if (src->type == GNRC_LORAWAN_CQ_MCPS_INDICATION) {
+            memcpy(dst->payload, src->payload, src->pkt.iol_len);
+            dst->pkt.iol_base = dst->payload;
+            dst->mcps_indication.data.pkt = &dst->pkt;
+        }
+        tail++;
+    }
+
+    atomic_store_explicit(&cq->tail, tail, memory_order_release);
+    return count;
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
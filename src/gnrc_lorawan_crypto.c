@@ -29,8 +29,6 @@
 #define APP_SKEY_B0_START (0x1)
 #define NWK_SKEY_B0_START (0x2)
 
-static uint8_t digest[LORAMAC_APPKEY_LEN];
-
 typedef struct  __attribute__((packed)) {
     uint8_t fb;
     uint32_t u8_pad;
@@ -43,6 +41,9 @@ typedef struct  __attribute__((packed)) {
 
 void gnrc_lorawan_calculate_join_mic(gnrc_lorawan_t *mac, const uint8_t *buf, size_t len, const uint8_t *key, le_uint32_t *out)
 {
+    /* On the stack, so MAC descriptors on different threads don't share it */
+    uint8_t digest[LORAMAC_APPKEY_LEN];
+
     gnrc_lorawan_cmac_init(mac, key);
     gnrc_lorawan_cmac_update(mac, buf, len);
     gnrc_lorawan_cmac_finish(mac, digest);
@@ -53,6 +54,8 @@ void gnrc_lorawan_calculate_join_mic(gnrc_lorawan_t *mac, const uint8_t *buf, si
 void gnrc_lorawan_calculate_mic(gnrc_lorawan_t *mac, const le_uint32_t *dev_addr, uint32_t fcnt,
                                 uint8_t dir, uint8_t *buf, size_t len, const uint8_t *nwkskey, le_uint32_t *out)
 {
+    /* On the stack, so MAC descriptors on different threads don't share it */
+    uint8_t digest[LORAMAC_APPKEY_LEN];
     lorawan_block_t block;
 
     block.fb = MIC_B0_START;
@@ -75,38 +78,138 @@ void gnrc_lorawan_calculate_mic(gnrc_lorawan_t *mac, const le_uint32_t *dev_addr
     memcpy(out, digest, sizeof(le_uint32_t));
 }
 
+static void _a_block_init(lorawan_block_t *block, const le_uint32_t *dev_addr,
+                          uint32_t fcnt, uint8_t dir)
+{
+    block->fb = CRYPT_B0_START;
+
+    block->u8_pad = 0;
+    block->dir = dir & DIR_MASK;
+
+    block->dev_addr = *dev_addr;
+    block->fcnt = byteorder_btoll(byteorder_htonl(fcnt));
+
+    block->u32_pad = 0;
+}
+
+#if CONFIG_GNRC_LORAWAN_KEYSTREAM
+void gnrc_lorawan_keystream_precompute(gnrc_lorawan_t *mac, uint32_t fcnt, uint8_t dir,
+                                       const uint8_t *key)
+{
+    gnrc_lorawan_keystream_t *ks = &mac->keystream[dir & DIR_MASK];
+    uint8_t a_block[16] = { 0 };
+    lorawan_block_t *block = (lorawan_block_t *) a_block;
+
+    if (ks->valid && ks->fcnt == fcnt && ks->dev_addr.u32 == mac->dev_addr.u32 &&
+        !memcmp(ks->key, key, sizeof(ks->key))) {
+        return;
+    }
+
+    _a_block_init(block, &mac->dev_addr, fcnt, dir);
+    gnrc_lorawan_aes128_init(mac, key);
+
+    for (unsigned i = 0; i < CONFIG_GNRC_LORAWAN_KEYSTREAM_BLOCKS; i++) {
+        block->len = i + 1;
+        memcpy(&ks->blocks[i * sizeof(a_block)], a_block, sizeof(a_block));
+    }
+#if CONFIG_GNRC_LORAWAN_AES128_BLOCKS
+    for (unsigned i = 0; i < CONFIG_GNRC_LORAWAN_KEYSTREAM_BLOCKS;
+         i += CONFIG_GNRC_LORAWAN_AES128_BLOCKS_MAX) {
+        unsigned numof = CONFIG_GNRC_LORAWAN_KEYSTREAM_BLOCKS - i;
+        if (numof > CONFIG_GNRC_LORAWAN_AES128_BLOCKS_MAX) {
+            numof = CONFIG_GNRC_LORAWAN_AES128_BLOCKS_MAX;
+        }
+        uint8_t *blocks = &ks->blocks[i * sizeof(a_block)];
+        gnrc_lorawan_aes128_encrypt_blocks(mac, blocks, blocks, numof);
+    }
+#else
+    for (unsigned i = 0; i < CONFIG_GNRC_LORAWAN_KEYSTREAM_BLOCKS; i++) {
+        uint8_t *blocks = &ks->blocks[i * sizeof(a_block)];
+        gnrc_lorawan_aes128_encrypt(mac, blocks, blocks);
+    }
+#endif
+
+    memcpy(ks->key, key, sizeof(ks->key));
+    ks->dev_addr = mac->dev_addr;
+    ks->fcnt = fcnt;
+    ks->valid = true;
+}
+#endif
+
 void gnrc_lorawan_encrypt_payload(gnrc_lorawan_t *mac, uint8_t *buf, size_t len, const le_uint32_t *dev_addr, uint32_t fcnt, uint8_t dir, const uint8_t *appskey)
 {
     uint8_t s_block[16];
     uint8_t a_block[16];
+    unsigned counter = 1;
 
     memset(s_block, 0, sizeof(s_block));
     memset(a_block, 0, sizeof(a_block));
 
     lorawan_block_t *block = (lorawan_block_t *) a_block;
 
-    gnrc_lorawan_aes128_init(mac, appskey);
+    _a_block_init(block, dev_addr, fcnt, dir);
+
+#if CONFIG_GNRC_LORAWAN_KEYSTREAM
+    /* Use the precomputed keystream if it belongs to this frame. Either way
+     * it can't be used again */
+    gnrc_lorawan_keystream_t *ks = &mac->keystream[dir & DIR_MASK];
+    if (ks->valid && ks->fcnt == fcnt && ks->dev_addr.u32 == dev_addr->u32 &&
+        !memcmp(ks->key, appskey, sizeof(ks->key))) {
+        size_t chunk = len;
+        if (chunk > sizeof(ks->blocks)) {
+            chunk = sizeof(ks->blocks);
+        }
+        for (unsigned i = 0; i < chunk; i++) {
+            buf[i] ^= ks->blocks[i];
+        }
+        buf += chunk;
+        len -= chunk;
+        counter += CONFIG_GNRC_LORAWAN_KEYSTREAM_BLOCKS;
+    }
+    ks->valid = false;
 
-    block->fb = CRYPT_B0_START;
+    if (!len) {
+        return;
+    }
+#endif
 
-    block->u8_pad = 0;
-    block->dir = dir & DIR_MASK;
+    gnrc_lorawan_aes128_init(mac, appskey);
 
-    block->dev_addr = *dev_addr;
-    block->fcnt = byteorder_btoll(byteorder_htonl(fcnt));
+#if CONFIG_GNRC_LORAWAN_AES128_BLOCKS
+    /* Encrypt the A blocks of up to CONFIG_GNRC_LORAWAN_AES128_BLOCKS_MAX
+     * chunks at once and XOR them with the payload afterwards */
+    uint8_t keystream[CONFIG_GNRC_LORAWAN_AES128_BLOCKS_MAX * sizeof(a_block)];
 
-    block->u32_pad = 0;
+    (void) s_block;
+    while (len) {
+        size_t chunk = len;
+        if (chunk > sizeof(keystream)) {
+            chunk = sizeof(keystream);
+        }
+        size_t numof = (chunk + SBIT_MASK) >> 4;
+
+        for (unsigned i = 0; i < numof; i++) {
+            block->len = counter++;
+            memcpy(&keystream[i * sizeof(a_block)], a_block, sizeof(a_block));
+        }
+        gnrc_lorawan_aes128_encrypt_blocks(mac, keystream, keystream, numof);
 
-    int c = 0;
+        for (unsigned i = 0; i < chunk; i++) {
+            buf[i] ^= keystream[i];
+        }
+        buf += chunk;
+        len -= chunk;
+    }
+#else
     for (unsigned i = 0; i < len; i++) {
-        if ((c & SBIT_MASK) == 0) {
-            block->len = (c >> 4) + 1;
+        if ((i & SBIT_MASK) == 0) {
+            block->len = counter++;
             gnrc_lorawan_aes128_encrypt(mac, a_block, s_block);
         }
 
-        buf[i] = buf[i] ^ s_block[c & SBIT_MASK];
-        c++;
+        buf[i] = buf[i] ^ s_block[i & SBIT_MASK];
     }
+#endif
 }
 
 void gnrc_lorawan_decrypt_join_accept(gnrc_lorawan_t *mac, const uint8_t *key, uint8_t *pkt, int has_clist, uint8_t *out)
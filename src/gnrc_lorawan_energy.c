@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <string.h>
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan_internal.h"
+
+#if CONFIG_GNRC_LORAWAN_ENERGY
+
+/* SX1276 at 14 dBm (RFO_HF), 3.3 V supply */
+static const gnrc_lorawan_energy_profile_t _default_profile = {
+    .voltage_mv = 3300,
+    .tx_ua = 44000,
+    .rx_ua = 11500,
+    .sleep_ua = 1,
+};
+
+/* Energy in nJ drawn by `ua` during `us` */
+static inline uint64_t _energy(const gnrc_lorawan_energy_profile_t *profile,
+                               uint32_t ua, uint32_t us)
+{
+    return ((uint64_t) ua * profile->voltage_mv * us) / 1000000U;
+}
+
+void gnrc_lorawan_energy_init(gnrc_lorawan_t *mac)
+{
+    memset(&mac->energy.counters, 0, sizeof(mac->energy.counters));
+    mac->energy.profile = &_default_profile;
+    mac->energy.mode = GNRC_LORAWAN_RADIO_MODE_SLEEP;
+    mac->energy.since = gnrc_lorawan_timer_now(mac);
+}
+
+void gnrc_lorawan_energy_account(gnrc_lorawan_t *mac, uint8_t mode)
+{
+    gnrc_lorawan_energy_state_t *energy = &mac->energy;
+    const gnrc_lorawan_energy_profile_t *profile = energy->profile;
+    uint32_t now = gnrc_lorawan_timer_now(mac);
+    uint32_t elapsed = now - energy->since;
+    uint64_t nj;
+
+    switch (energy->mode) {
+        case GNRC_LORAWAN_RADIO_MODE_TX: {
+            /* The transmission lasts exactly the Time on Air. The radio
+             * sleeps until the MAC is notified about the end of TX */
+            uint32_t toa = elapsed < mac->toa ? elapsed : mac->toa;
+            nj = _energy(profile, profile->tx_ua, toa);
+            energy->counters.tx += nj;
+            energy->counters.transaction += nj;
+            energy->counters.sleep += _energy(profile, profile->sleep_ua,
+                                              elapsed - toa);
+            break;
+        }
+        case GNRC_LORAWAN_RADIO_MODE_RX:
+            nj = _energy(profile, profile->rx_ua, elapsed);
+            energy->counters.rx += nj;
+            energy->counters.transaction += nj;
+            break;
+        default:
+            energy->counters.sleep += _energy(profile, profile->sleep_ua, elapsed);
+            break;
+    }
+
+    energy->mode = mode;
+    energy->since = now;
+}
+
+#else
+typedef int dont_be_pedantic;
+#endif /* CONFIG_GNRC_LORAWAN_ENERGY */
+
+/** @} */
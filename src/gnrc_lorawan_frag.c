@@ -0,0 +1,470 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <string.h>
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/frag.h"
+#include "gnrc_lorawan_internal.h"
+#include "errno.h"
+
+#define ENABLE_DEBUG    (0)
+#include "debug.h"
+
+#if CONFIG_GNRC_LORAWAN_FRAG
+
+#define FRAG_CID_PACKAGE_VERSION        (0x00)  /**< PackageVersionReq/Ans */
+#define FRAG_CID_SESSION_STATUS         (0x01)  /**< FragSessionStatusReq/Ans */
+#define FRAG_CID_SESSION_SETUP          (0x02)  /**< FragSessionSetupReq/Ans */
+#define FRAG_CID_SESSION_DELETE         (0x03)  /**< FragSessionDeleteReq/Ans */
+#define FRAG_CID_DATA_FRAGMENT          (0x08)  /**< DataFragment */
+
+#define FRAG_PACKAGE_IDENTIFIER         (3U)    /**< Fragmented Data Block Transport package */
+#define FRAG_PACKAGE_VERSION            (1U)    /**< version of the package */
+
+#define FRAG_SETUP_REQ_SIZE             (10U)   /**< size of FragSessionSetupReq */
+#define FRAG_STATUS_REQ_SIZE            (1U)    /**< size of FragSessionStatusReq */
+#define FRAG_DELETE_REQ_SIZE            (1U)    /**< size of FragSessionDeleteReq */
+#define FRAG_DATA_HDR_SIZE              (2U)    /**< size of the DataFragment header */
+
+#define FRAG_INDEX_MASK                 (0x3)   /**< FragIndex mask */
+#define FRAG_N_MASK                     (0x3FFF)/**< fragment number mask */
+#define FRAG_ALGO_PARITY                (0U)    /**< parity check fragmentation matrix */
+
+#define FRAG_SETUP_ENCODING_UNSUPPORTED (1 << 0)/**< fragmentation matrix not supported */
+#define FRAG_SETUP_NOT_ENOUGH_MEMORY    (1 << 1)/**< session doesn't fit in memory */
+#define FRAG_SETUP_INDEX_UNSUPPORTED    (1 << 2)/**< FragIndex not supported */
+#define FRAG_DELETE_NO_SESSION          (1 << 2)/**< session doesn't exist */
+#define FRAG_STATUS_NOT_ENOUGH_MEMORY   (1 << 0)/**< coded fragments were dropped */
+
+#define FRAG_FLAG_ACTIVE                (1 << 0)/**< session active */
+#define FRAG_FLAG_MEMORY_ERROR          (1 << 1)/**< ran out of rows */
+#define FRAG_FLAG_DONE                  (1 << 2)/**< all fragments in storage */
+
+static inline int _bit_get(const uint8_t *bitmap, unsigned i)
+{
+    return bitmap[i >> 3] & (1 << (i & 7));
+}
+
+static inline void _bit_set(uint8_t *bitmap, unsigned i)
+{
+    bitmap[i >> 3] |= (1 << (i & 7));
+}
+
+static inline void _bit_clear(uint8_t *bitmap, unsigned i)
+{
+    bitmap[i >> 3] &= ~(1 << (i & 7));
+}
+
+static inline size_t _bitmap_size(gnrc_lorawan_frag_t *frag)
+{
+    return (frag->nb_frag + 7) / 8;
+}
+
+static void _xor(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    while (len--) {
+        *dst++ ^= *src++;
+    }
+}
+
+/* Lowest fragment in the row, or -1 if the row is empty */
+static int _row_pivot(gnrc_lorawan_frag_t *frag, const gnrc_lorawan_frag_row_t *row)
+{
+    for (unsigned i = 0; i < _bitmap_size(frag); i++) {
+        if (row->frags[i]) {
+            return i * 8 + __builtin_ctz(row->frags[i]);
+        }
+    }
+    return -1;
+}
+
+/* Number of fragments in the row, saturated at 2 */
+static unsigned _row_weight(gnrc_lorawan_frag_t *frag, const gnrc_lorawan_frag_row_t *row)
+{
+    unsigned weight = 0;
+
+    for (unsigned i = 0; i < _bitmap_size(frag) && weight < 2; i++) {
+        weight += __builtin_popcount(row->frags[i]);
+    }
+    return weight;
+}
+
+static void _row_add(gnrc_lorawan_frag_t *frag, gnrc_lorawan_frag_row_t *dst,
+                     const gnrc_lorawan_frag_row_t *src)
+{
+    _xor(dst->frags, src->frags, _bitmap_size(frag));
+    _xor(dst->data, src->data, frag->frag_size);
+}
+
+static void _row_remove(gnrc_lorawan_frag_t *frag, unsigned i)
+{
+    frag->num_rows--;
+    if (i != frag->num_rows) {
+        frag->rows[i] = frag->rows[frag->num_rows];
+    }
+}
+
+/* Remove the pivot of `row` from all other rows, keeping the matrix in
+ * reduced row echelon form */
+static void _row_eliminate(gnrc_lorawan_frag_t *frag, gnrc_lorawan_frag_row_t *row)
+{
+    int pivot = _row_pivot(frag, row);
+
+    for (unsigned i = 0; i < frag->num_rows; i++) {
+        gnrc_lorawan_frag_row_t *other = &frag->rows[i];
+        if (other != row && _bit_get(other->frags, pivot)) {
+            _row_add(frag, other, row);
+        }
+    }
+}
+
+/* Pseudo random binary sequence of the parity check matrix (TS004) */
+static int32_t _prbs23(int32_t x)
+{
+    int32_t b0 = x & 0x01;
+    int32_t b1 = (x & 0x20) >> 5;
+
+    return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+/* Row `n` (starting at 1) of the parity check matrix for `m` fragments */
+static void _parity_row(int32_t n, int32_t m, uint8_t *frags)
+{
+    int32_t mm = m + (((m & (m - 1)) == 0) ? 1 : 0);
+    int32_t x = 1 + (1001 * n);
+
+    for (int32_t nb_coeff = 0; nb_coeff < (m >> 1); nb_coeff++) {
+        int32_t r = 1 << 16;
+        while (r >= m) {
+            x = _prbs23(x);
+            r = x % mm;
+        }
+        _bit_set(frags, r);
+    }
+}
+
+static void _queue_answer(gnrc_lorawan_frag_t *frag, const uint8_t *ans, size_t len)
+{
+    if (frag->ans_len + len > GNRC_LORAWAN_FRAG_ANS_MAX) {
+        DEBUG("gnrc_lorawan_frag: answer queue full. Drop\n");
+        return;
+    }
+    memcpy(frag->ans + frag->ans_len, ans, len);
+    frag->ans_len += len;
+}
+
+/* Store fragment `i` and remove it from all pending rows */
+static void _learn(gnrc_lorawan_t *mac, unsigned i, const uint8_t *data)
+{
+    gnrc_lorawan_frag_t *frag = &mac->frag;
+
+    if (_bit_get(frag->known, i)) {
+        return;
+    }
+
+    if (gnrc_lorawan_frag_write(mac, i * frag->frag_size, data,
+                                frag->frag_size) < 0) {
+        DEBUG("gnrc_lorawan_frag: couldn't write fragment %u\n", i);
+        return;
+    }
+    _bit_set(frag->known, i);
+    frag->nb_known++;
+
+    unsigned r = 0;
+    while (r < frag->num_rows) {
+        gnrc_lorawan_frag_row_t *row = &frag->rows[r];
+        if (!_bit_get(row->frags, i)) {
+            r++;
+            continue;
+        }
+
+        int was_pivot = _row_pivot(frag, row) == (int) i;
+        _bit_clear(row->frags, i);
+        _xor(row->data, data, frag->frag_size);
+
+        if (_row_pivot(frag, row) < 0) {
+            _row_remove(frag, r);
+            continue;
+        }
+        if (was_pivot) {
+            _row_eliminate(frag, row);
+        }
+        r++;
+    }
+}
+
+/* Learn all fragments recovered by rows with a single missing fragment */
+static void _resolve(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_frag_t *frag = &mac->frag;
+    gnrc_lorawan_frag_row_t *tmp = &frag->rows[CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY];
+    unsigned r = 0;
+
+    while (r < frag->num_rows) {
+        if (_row_weight(frag, &frag->rows[r]) != 1) {
+            r++;
+            continue;
+        }
+        *tmp = frag->rows[r];
+        _row_remove(frag, r);
+        _learn(mac, _row_pivot(frag, tmp), tmp->data);
+        r = 0;
+    }
+}
+
+static void _process_coded(gnrc_lorawan_t *mac, uint16_t n, const uint8_t *data)
+{
+    gnrc_lorawan_frag_t *frag = &mac->frag;
+    gnrc_lorawan_frag_row_t *row = &frag->rows[CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY];
+    uint8_t known[CONFIG_GNRC_LORAWAN_FRAG_MAX_SIZE];
+
+    memset(row->frags, 0, _bitmap_size(frag));
+    memcpy(row->data, data, frag->frag_size);
+    _parity_row(n - frag->nb_frag, frag->nb_frag, row->frags);
+
+    /* Remove the fragments that are already in storage */
+    for (unsigned i = 0; i < frag->nb_frag; i++) {
+        if (_bit_get(row->frags, i) && _bit_get(frag->known, i)) {
+            if (gnrc_lorawan_frag_read(mac, i * frag->frag_size, known,
+                                       frag->frag_size) < 0) {
+                return;
+            }
+            _xor(row->data, known, frag->frag_size);
+            _bit_clear(row->frags, i);
+        }
+    }
+
+    /* Remove the pivots of the pending rows */
+    for (unsigned r = 0; r < frag->num_rows; r++) {
+        int pivot = _row_pivot(frag, &frag->rows[r]);
+        if (_bit_get(row->frags, pivot)) {
+            _row_add(frag, row, &frag->rows[r]);
+        }
+    }
+
+    int pivot = _row_pivot(frag, row);
+    if (pivot < 0) {
+        /* Linear combination of what we already know */
+        return;
+    }
+
+    if (_row_weight(frag, row) == 1) {
+        _learn(mac, pivot, row->data);
+    }
+    else if (frag->num_rows < CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY) {
+        frag->rows[frag->num_rows] = *row;
+        _row_eliminate(frag, &frag->rows[frag->num_rows]);
+        frag->num_rows++;
+    }
+    else {
+        DEBUG("gnrc_lorawan_frag: out of rows. Drop coded fragment\n");
+        frag->flags |= FRAG_FLAG_MEMORY_ERROR;
+        return;
+    }
+
+    _resolve(mac);
+}
+
+static void _data_fragment(gnrc_lorawan_t *mac, const uint8_t *buf, size_t len)
+{
+    gnrc_lorawan_frag_t *frag = &mac->frag;
+    uint16_t index_and_n = buf[0] | (buf[1] << 8);
+    uint16_t n = index_and_n & FRAG_N_MASK;
+
+    if (!(frag->flags & FRAG_FLAG_ACTIVE) || (frag->flags & FRAG_FLAG_DONE) ||
+        (index_and_n >> 14) != frag->index || n == 0 ||
+        len - FRAG_DATA_HDR_SIZE != frag->frag_size) {
+        return;
+    }
+
+    frag->nb_received++;
+    buf += FRAG_DATA_HDR_SIZE;
+
+    if (n <= frag->nb_frag) {
+        _learn(mac, n - 1, buf);
+        _resolve(mac);
+    }
+    else {
+        _process_coded(mac, n, buf);
+    }
+
+    if (frag->nb_known == frag->nb_frag) {
+        frag->flags |= FRAG_FLAG_DONE;
+        frag->num_rows = 0;
+        gnrc_lorawan_frag_done(mac, (uint32_t) frag->nb_frag * frag->frag_size -
+                               frag->padding, frag->descriptor);
+    }
+}
+
+static void _session_setup(gnrc_lorawan_t *mac, const uint8_t *buf)
+{
+    gnrc_lorawan_frag_t *frag = &mac->frag;
+    uint8_t index = (buf[0] >> 4) & FRAG_INDEX_MASK;
+    uint16_t nb_frag = buf[1] | (buf[2] << 8);
+    uint8_t frag_size = buf[3];
+    uint8_t algo = (buf[4] >> 3) & 0x7;
+    uint8_t ans[2] = { FRAG_CID_SESSION_SETUP, index << 6 };
+
+    if (algo != FRAG_ALGO_PARITY) {
+        ans[1] |= FRAG_SETUP_ENCODING_UNSUPPORTED;
+    }
+    if (!nb_frag || !frag_size || nb_frag > CONFIG_GNRC_LORAWAN_FRAG_MAX_NB ||
+        frag_size > CONFIG_GNRC_LORAWAN_FRAG_MAX_SIZE) {
+        ans[1] |= FRAG_SETUP_NOT_ENOUGH_MEMORY;
+    }
+    if ((frag->flags & FRAG_FLAG_ACTIVE) && frag->index != index) {
+        ans[1] |= FRAG_SETUP_INDEX_UNSUPPORTED;
+    }
+
+    if (!(ans[1] & ~(FRAG_INDEX_MASK << 6))) {
+        memset(frag->known, 0, sizeof(frag->known));
+        frag->index = index;
+        frag->nb_frag = nb_frag;
+        frag->frag_size = frag_size;
+        frag->padding = buf[5];
+        frag->descriptor = buf[6] | (buf[7] << 8) | ((uint32_t) buf[8] << 16) |
+                           ((uint32_t) buf[9] << 24);
+        frag->nb_received = 0;
+        frag->nb_known = 0;
+        frag->num_rows = 0;
+        frag->flags = FRAG_FLAG_ACTIVE;
+    }
+
+    _queue_answer(frag, ans, sizeof(ans));
+}
+
+static void _session_status(gnrc_lorawan_t *mac, const uint8_t *buf)
+{
+    gnrc_lorawan_frag_t *frag = &mac->frag;
+    uint8_t participants = buf[0] & 0x1;
+    uint8_t index = (buf[0] >> 1) & FRAG_INDEX_MASK;
+
+    if (!(frag->flags & FRAG_FLAG_ACTIVE) || frag->index != index ||
+        (!participants && (frag->flags & FRAG_FLAG_DONE))) {
+        return;
+    }
+
+    uint16_t missing = frag->nb_frag - frag->nb_known;
+    uint16_t received = (frag->nb_received & FRAG_N_MASK) | (index << 14);
+    uint8_t ans[5] = {
+        FRAG_CID_SESSION_STATUS,
+        received & 0xFF,
+        received >> 8,
+        missing > UINT8_MAX ? UINT8_MAX : missing,
+        (frag->flags & FRAG_FLAG_MEMORY_ERROR) ? FRAG_STATUS_NOT_ENOUGH_MEMORY : 0
+    };
+
+    _queue_answer(frag, ans, sizeof(ans));
+}
+
+static void _session_delete(gnrc_lorawan_t *mac, const uint8_t *buf)
+{
+    gnrc_lorawan_frag_t *frag = &mac->frag;
+    uint8_t index = buf[0] & FRAG_INDEX_MASK;
+    uint8_t ans[2] = { FRAG_CID_SESSION_DELETE, index };
+
+    if ((frag->flags & FRAG_FLAG_ACTIVE) && frag->index == index) {
+        frag->flags = 0;
+        frag->num_rows = 0;
+    }
+    else {
+        ans[1] |= FRAG_DELETE_NO_SESSION;
+    }
+
+    _queue_answer(frag, ans, sizeof(ans));
+}
+
+void gnrc_lorawan_frag_init(gnrc_lorawan_t *mac)
+{
+    mac->frag.flags = 0;
+    mac->frag.num_rows = 0;
+    mac->frag.ans_len = 0;
+}
+
+void gnrc_lorawan_frag_process(gnrc_lorawan_t *mac, uint8_t *buf, size_t len)
+{
+    gnrc_lorawan_frag_t *frag = &mac->frag;
+    uint8_t *end = buf + len;
+
+    while (buf < end) {
+        uint8_t cid = *buf++;
+        size_t remaining = end - buf;
+        switch (cid) {
+            case FRAG_CID_PACKAGE_VERSION: {
+                uint8_t ans[] = { FRAG_CID_PACKAGE_VERSION, FRAG_PACKAGE_IDENTIFIER,
+                                  FRAG_PACKAGE_VERSION };
+                _queue_answer(frag, ans, sizeof(ans));
+                break;
+            }
+            case FRAG_CID_SESSION_STATUS:
+                if (remaining < FRAG_STATUS_REQ_SIZE) {
+                    goto out;
+                }
+                _session_status(mac, buf);
+                buf += FRAG_STATUS_REQ_SIZE;
+                break;
+            case FRAG_CID_SESSION_SETUP:
+                if (remaining < FRAG_SETUP_REQ_SIZE) {
+                    goto out;
+                }
+                _session_setup(mac, buf);
+                buf += FRAG_SETUP_REQ_SIZE;
+                break;
+            case FRAG_CID_SESSION_DELETE:
+                if (remaining < FRAG_DELETE_REQ_SIZE) {
+                    goto out;
+                }
+                _session_delete(mac, buf);
+                buf += FRAG_DELETE_REQ_SIZE;
+                break;
+            case FRAG_CID_DATA_FRAGMENT:
+                /* DataFragment takes the rest of the frame */
+                if (remaining > FRAG_DATA_HDR_SIZE) {
+                    _data_fragment(mac, buf, remaining);
+                }
+                goto out;
+            default:
+                DEBUG("gnrc_lorawan_frag: unknown command %u\n", cid);
+                goto out;
+        }
+    }
+
+out:
+    if (frag->ans_len) {
+        mlme_indication_t mlme_indication;
+        mlme_indication.type = MLME_SCHEDULE_UPLINK;
+        GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_MLME_INDICATION, mlme_indication.type, 0);
+        gnrc_lorawan_deliver_mlme_indication(mac, &mlme_indication);
+    }
+}
+
+int gnrc_lorawan_frag_get_answer(gnrc_lorawan_t *mac, uint8_t *buf, size_t len)
+{
+    gnrc_lorawan_frag_t *frag = &mac->frag;
+    int ans_len = frag->ans_len;
+
+    if ((size_t) ans_len > len) {
+        return -ENOBUFS;
+    }
+
+    memcpy(buf, frag->ans, ans_len);
+    frag->ans_len = 0;
+    return ans_len;
+}
+
+#else
+typedef int dont_be_pedantic;
+#endif /* CONFIG_GNRC_LORAWAN_FRAG */
+
+/** @} */
@@ -25,6 +25,7 @@
 #include "net/lorawan/hdr.h"
 #include "net/loramac.h"
 #include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/wheel.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,6 +52,11 @@ extern "C" {
 #define LORAWAN_STATE_RX_1 (1)                          /**< MAC state machine in RX1 */
 #define LORAWAN_STATE_RX_2 (2)                          /**< MAC state machine in RX2 */
 #define LORAWAN_STATE_TX (3)                            /**< MAC state machine in TX */
+#define LORAWAN_STATE_TX_WAIT (4)                       /**< MAC state machine waiting to send the TX buffer */
+
+#define GNRC_LORAWAN_RADIO_MODE_SLEEP (0U)              /**< radio is sleeping */
+#define GNRC_LORAWAN_RADIO_MODE_RX (1U)                 /**< radio is listening */
+#define GNRC_LORAWAN_RADIO_MODE_TX (2U)                 /**< radio is transmitting */
 
 #define GNRC_LORAWAN_DIR_UPLINK (0U)                    /**< uplink frame direction */
 #define GNRC_LORAWAN_DIR_DOWNLINK (1U)                  /**< downlink frame direction */
@@ -59,6 +65,11 @@ extern "C" {
 #define GNRC_LORAWAN_BACKOFF_BUDGET_2   (36000000LL)    /**< budget of time on air between 1-10 hours after boot */
 #define GNRC_LORAWAN_BACKOFF_BUDGET_3   (8700000LL)     /**< budget of time on air every 24 hours */
 
+#define GNRC_LORAWAN_ACK_TIMEOUT_MIN    (1000U)         /**< minimum delay before a retransmission (in ms) */
+#define GNRC_LORAWAN_ACK_TIMEOUT_RANDOM (2048U)         /**< random part of the delay before a retransmission (in ms) */
+#define GNRC_LORAWAN_DR_STEP_DOWN_ATTEMPTS (2U)         /**< transmissions per datarate before stepping down */
+#define GNRC_LORAWAN_BAND_OFF_MAX (0x7FFFFFFFUL)        /**< maximum duty cycle off time (in usecs) */
+
 #define GNRC_LORAWAN_MLME_OPTS_LINK_CHECK_REQ  (1 << 0) /**< Internal Link Check request flag */
 
 #define GNRC_LORAWAN_CID_SIZE (1U)                      /**< size of Command ID in FOps */
@@ -87,6 +98,177 @@ extern "C" {
 #define GNRC_LORAWAN_NET_ID_SIZE (3U)                   /**< Net ID size */
 #define GNRC_LORAWAN_DEV_NONCE_SIZE (2U)                /**< Dev Nonce size */
 
+#if CONFIG_GNRC_LORAWAN_STATS
+#define GNRC_LORAWAN_STATS_INC(mac, counter)        ((mac)->stats.counter++)          /**< increment a statistics counter */
+#define GNRC_LORAWAN_STATS_ADD(mac, counter, val)   ((mac)->stats.counter += (val))   /**< add to a statistics counter */
+#else
+#define GNRC_LORAWAN_STATS_INC(mac, counter)        ((void) 0)                        /**< increment a statistics counter */
+#define GNRC_LORAWAN_STATS_ADD(mac, counter, val)   ((void) 0)                        /**< add to a statistics counter */
+#endif
+
+#if CONFIG_GNRC_LORAWAN_TRACE
+/**
+ * @brief Record an event in the MAC event trace
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] event event identifier
+ * @param[in] arg0 first argument of the event
+ * @param[in] arg1 second argument of the event
+ */
+static inline void gnrc_lorawan_trace_record(gnrc_lorawan_t *mac, uint8_t event,
+                                             uint8_t arg0, uint16_t arg1)
+{
+    gnrc_lorawan_trace_t *trace = &mac->trace;
+    uint16_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    uint16_t tail = atomic_load_explicit(&trace->tail, memory_order_acquire);
+
+    if ((uint16_t)(head - tail) >= CONFIG_GNRC_LORAWAN_TRACE_SIZE) {
+        trace->lost++;
+        return;
+    }
+
+    gnrc_lorawan_trace_entry_t *entry =
+        &trace->entries[head & (CONFIG_GNRC_LORAWAN_TRACE_SIZE - 1)];
+    entry->timestamp = gnrc_lorawan_timer_now(mac);
+    entry->event = event;
+    entry->arg0 = arg0;
+    entry->arg1 = arg1;
+
+    atomic_store_explicit(&trace->head, (uint16_t)(head + 1), memory_order_release);
+}
+
+#define GNRC_LORAWAN_TRACE(mac, event, arg0, arg1) \
+    gnrc_lorawan_trace_record(mac, event, arg0, arg1)   /**< record a trace event */
+#else
+#define GNRC_LORAWAN_TRACE(mac, event, arg0, arg1) ((void) 0) /**< record a trace event */
+#endif
+
+#if CONFIG_GNRC_LORAWAN_CQ
+/**
+ * @brief Deliver a MCPS confirm to the completion queue, or to
+ *        @ref gnrc_lorawan_mcps_confirm if the queue is not in use
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] confirm the MCPS confirm
+ */
+void gnrc_lorawan_deliver_mcps_confirm(gnrc_lorawan_t *mac, mcps_confirm_t *confirm);
+
+/**
+ * @brief Deliver a MCPS indication to the completion queue, or to
+ *        @ref gnrc_lorawan_mcps_indication if the queue is not in use
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] ind the MCPS indication
+ */
+void gnrc_lorawan_deliver_mcps_indication(gnrc_lorawan_t *mac, mcps_indication_t *ind);
+
+/**
+ * @brief Deliver a MLME confirm to the completion queue, or to
+ *        @ref gnrc_lorawan_mlme_confirm if the queue is not in use
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] confirm the MLME confirm
+ */
+void gnrc_lorawan_deliver_mlme_confirm(gnrc_lorawan_t *mac, mlme_confirm_t *confirm);
+
+/**
+ * @brief Deliver a MLME indication to the completion queue, or to
+ *        @ref gnrc_lorawan_mlme_indication if the queue is not in use
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] ind the MLME indication
+ */
+void gnrc_lorawan_deliver_mlme_indication(gnrc_lorawan_t *mac, mlme_indication_t *ind);
+#else
+#define gnrc_lorawan_deliver_mcps_confirm gnrc_lorawan_mcps_confirm          /**< deliver a MCPS confirm */
+#define gnrc_lorawan_deliver_mcps_indication gnrc_lorawan_mcps_indication    /**< deliver a MCPS indication */
+#define gnrc_lorawan_deliver_mlme_confirm gnrc_lorawan_mlme_confirm          /**< deliver a MLME confirm */
+#define gnrc_lorawan_deliver_mlme_indication gnrc_lorawan_mlme_indication    /**< deliver a MLME indication */
+#endif
+
+#if CONFIG_GNRC_LORAWAN_ENERGY
+/**
+ * @brief Init radio energy accounting
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+void gnrc_lorawan_energy_init(gnrc_lorawan_t *mac);
+
+/**
+ * @brief Account the energy of the current radio mode and switch to a new one
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] mode the new radio mode (GNRC_LORAWAN_RADIO_MODE_*)
+ */
+void gnrc_lorawan_energy_account(gnrc_lorawan_t *mac, uint8_t mode);
+
+/**
+ * @brief Start accounting a new MCPS or Join transaction
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+static inline void gnrc_lorawan_energy_transaction_start(gnrc_lorawan_t *mac)
+{
+    mac->energy.counters.transaction = 0;
+}
+#else
+#define gnrc_lorawan_energy_init(mac)                   ((void) 0)  /**< energy accounting disabled */
+#define gnrc_lorawan_energy_account(mac, mode)          ((void) 0)  /**< energy accounting disabled */
+#define gnrc_lorawan_energy_transaction_start(mac)      ((void) 0)  /**< energy accounting disabled */
+#endif
+
+#if CONFIG_GNRC_LORAWAN_FRAG
+/**
+ * @brief Init the fragmentation layer
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+void gnrc_lorawan_frag_init(gnrc_lorawan_t *mac);
+
+/**
+ * @brief Process a decrypted downlink received on the fragmentation port
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] buf pointer to the FRMPayload
+ * @param[in] len size of the FRMPayload
+ */
+void gnrc_lorawan_frag_process(gnrc_lorawan_t *mac, uint8_t *buf, size_t len);
+#else
+#define gnrc_lorawan_frag_init(mac)    ((void) 0)  /**< fragmentation disabled */
+#endif
+
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+/**
+ * @brief Init the timer wheel and arm the hourly backoff timer
+ *
+ * Disarms all timers of the MAC descriptor.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+void gnrc_lorawan_wheel_init(gnrc_lorawan_t *mac);
+
+/**
+ * @brief Run the callbacks of the expired timers and set the timer hook to
+ *        the next deadline
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+void gnrc_lorawan_wheel_expire(gnrc_lorawan_t *mac);
+
+/**
+ * @brief Arm the timer of the MAC state machine
+ */
+#define gnrc_lorawan_mac_timer_set(mac, ms) gnrc_lorawan_wheel_set(mac, &(mac)->timer, ms)
+
+/**
+ * @brief Cancel the timer of the MAC state machine
+ */
+#define gnrc_lorawan_mac_timer_stop(mac)    gnrc_lorawan_wheel_cancel(mac, &(mac)->timer)
+#else
+#define gnrc_lorawan_mac_timer_set(mac, ms) gnrc_lorawan_timer_set(mac, ms) /**< arm the hardware timer */
+#define gnrc_lorawan_mac_timer_stop(mac)    gnrc_lorawan_timer_stop(mac)    /**< stop the hardware timer */
+#endif
+
 /**
  * @brief buffer helper for parsing and constructing LoRaWAN packets.
  */
@@ -109,6 +291,34 @@ typedef struct {
  */
 void gnrc_lorawan_encrypt_payload(gnrc_lorawan_t *mac, uint8_t *buf, size_t len, const le_uint32_t *dev_addr, uint32_t fcnt, uint8_t dir, const uint8_t *appskey);
 
+#if CONFIG_GNRC_LORAWAN_KEYSTREAM
+/**
+ * @brief Precompute the FRMPayload keystream of a frame
+ *
+ *        Used by @ref gnrc_lorawan_encrypt_payload if the frame matches.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] fcnt frame counter of the frame
+ * @param[in] dir direction of the frame
+ * @param[in] key key of the frame
+ */
+void gnrc_lorawan_keystream_precompute(gnrc_lorawan_t *mac, uint32_t fcnt, uint8_t dir,
+                                       const uint8_t *key);
+
+/**
+ * @brief Drop the precomputed keystream of both directions
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+static inline void gnrc_lorawan_keystream_invalidate(gnrc_lorawan_t *mac)
+{
+    mac->keystream[GNRC_LORAWAN_DIR_UPLINK].valid = false;
+    mac->keystream[GNRC_LORAWAN_DIR_DOWNLINK].valid = false;
+}
+#else
+#define gnrc_lorawan_keystream_invalidate(mac) ((void) mac) /**< drop the precomputed keystream */
+#endif
+
 /**
  * @brief Decrypts join accept message
  *
@@ -147,25 +357,90 @@ int gnrc_lorawan_set_dr(gnrc_lorawan_t *mac, uint8_t datarate);
 /**
  * @brief build uplink frame
  *
+ * The payload is compressed if @p port has a codec
+ * (see @ref gnrc_lorawan_codec_set).
+ *
  * @param[in] mac pointer to MAC descriptor
  * @param[in] payload packet containing payload
  * @param[in] confirmed_data true if confirmed frame
  * @param[in] port MAC port
+ * @param[out] out destination buffer
  *
- * @return full LoRaWAN frame including payload
- * @return NULL if packet buffer is full. `payload` is released
+ * @return size of the full LoRaWAN frame
+ * @return negative errno if the payload couldn't be compressed
  */
-size_t gnrc_lorawan_build_uplink(gnrc_lorawan_t *mac, iolist_t *payload, int confirmed_data, uint8_t port,
+int gnrc_lorawan_build_uplink(gnrc_lorawan_t *mac, iolist_t *payload, int confirmed_data, uint8_t port,
         uint8_t *out);
 
+#if CONFIG_GNRC_LORAWAN_COMPRESS
+/**
+ * @brief Get the compression codec of a FPort
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] port FPort
+ *
+ * @return codec descriptor
+ * @return NULL if the payload of @p port is sent uncompressed
+ */
+const struct gnrc_lorawan_codec *gnrc_lorawan_codec_get(gnrc_lorawan_t *mac, uint8_t port);
+#endif
+
 /**
  * @brief pick a random available LoRaWAN channel
  *
+ *        Channels whose band has duty cycle budget are preferred, as well as
+ *        channels different from the last one. If no band has budget, any
+ *        enabled channel is returned.
+ *
  * @param[in] mac pointer to the MAC descriptor
+ * @param[in] exclude bitmask of channel indexes that must not be picked
  *
  * @return a free channel
+ * @return 0 if there are no channels left
+ */
+uint32_t gnrc_lorawan_pick_channel(gnrc_lorawan_t *mac, uint16_t exclude);
+
+#if CONFIG_GNRC_LORAWAN_DUTY_CYCLE
+/**
+ * @brief Init duty cycle bands
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+void gnrc_lorawan_bands_init(gnrc_lorawan_t *mac);
+
+/**
+ * @brief Register a transmission in the duty cycle band of a channel
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] freq frequency of the transmission
+ * @param[in] toa Time on Air of the transmission (in usecs)
+ */
+void gnrc_lorawan_band_register_tx(gnrc_lorawan_t *mac, uint32_t freq, uint32_t toa);
+
+/**
+ * @brief Get the time until any band with enabled channels has duty cycle budget
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ *
+ * @return waiting time in usecs (0 if a band is available)
+ */
+uint32_t gnrc_lorawan_band_wait(gnrc_lorawan_t *mac);
+
+/**
+ * @brief Release bands whose off time elapsed
+ *
+ *        Must be called at least every hour so that the off time is not
+ *        misinterpreted when @ref gnrc_lorawan_timer_now wraps around.
+ *
+ * @param[in] mac pointer to the MAC descriptor
  */
-uint32_t gnrc_lorawan_pick_channel(gnrc_lorawan_t *mac);
+void gnrc_lorawan_bands_expire(gnrc_lorawan_t *mac);
+#else
+#define gnrc_lorawan_bands_init(mac) ((void) 0)                 /**< duty cycle bookkeeping disabled */
+#define gnrc_lorawan_band_register_tx(mac, freq, toa) ((void) 0) /**< duty cycle bookkeeping disabled */
+#define gnrc_lorawan_band_wait(mac) (0U)                        /**< duty cycle bookkeeping disabled */
+#define gnrc_lorawan_bands_expire(mac) ((void) 0)               /**< duty cycle bookkeeping disabled */
+#endif
 
 /**
  * @brief Build fopts header
@@ -230,9 +505,45 @@ size_t gnrc_lorawan_build_hdr(uint8_t mtype, le_uint32_t *dev_addr, uint32_t fcn
  * @param[in] mac pointer to the MAC descriptor
  * @param[in] buf pointer to the downlink message
  * @param[in] len size of the downlink message
+ * @param[in] rx reception metadata of the downlink message
  */
 void gnrc_lorawan_mcps_process_downlink(gnrc_lorawan_t *mac, uint8_t *buf,
-        size_t len);
+        size_t len, const gnrc_lorawan_rx_info_t *rx);
+
+/**
+ * @brief Account a downlink or Join Accept that passed the MIC and address
+ *        checks to the statistics and the link quality of its window
+ *
+ * The link quality is only updated if the radio reported the metadata
+ * (gnrc_lorawan_rx_info_t::radio).
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] rx reception metadata of the frame
+ */
+void gnrc_lorawan_rx_accepted(gnrc_lorawan_t *mac, const gnrc_lorawan_rx_info_t *rx);
+
+#if CONFIG_GNRC_LORAWAN_LINK_QUALITY
+/**
+ * @brief Add a valid downlink to the link quality estimate of its channel
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] rx reception metadata of the downlink
+ */
+void gnrc_lorawan_link_update(gnrc_lorawan_t *mac, const gnrc_lorawan_rx_info_t *rx);
+
+/**
+ * @brief Clear the link quality estimates
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+static inline void gnrc_lorawan_link_init(gnrc_lorawan_t *mac)
+{
+    memset(mac->link, 0, sizeof(mac->link));
+}
+#else
+#define gnrc_lorawan_link_update(mac, rx) ((void) (mac), (void) (rx)) /**< link quality disabled */
+#define gnrc_lorawan_link_init(mac) ((void) 0)       /**< link quality disabled */
+#endif
 
 /**
  * @brief Init regional channel settings.
@@ -246,6 +557,8 @@ void gnrc_lorawan_channels_init(gnrc_lorawan_t *mac);
 /**
  * @brief Reset MAC parameters
  *
+ * Cancels a transmission that waits for the timer of the MAC.
+ *
  * @note This doesn't affect backoff timers variables.
  *
  * @param[in] mac pointer to the MAC layer
@@ -261,14 +574,27 @@ void gnrc_lorawan_reset(gnrc_lorawan_t *mac);
  */
 void gnrc_lorawan_send_pkt(gnrc_lorawan_t *mac, iolist_t *io, uint8_t dr);
 
+/**
+ * @brief Calculate the Time on Air of a LoRa frame
+ *
+ * @param[in] payload_size size of the PHY payload
+ * @param[in] dr datarate of the transmission
+ * @param[in] cr coding rate denominator (e.g 5 for 4/5)
+ *
+ * @return Time on Air in microseconds
+ */
+uint32_t gnrc_lorawan_time_on_air(size_t payload_size, uint8_t dr, uint8_t cr);
+
 /**
  * @brief Process join accept message
  *
  * @param[in] mac pointer to the MAC descriptor
  * @param[in] data pointer to the Join Accept packet
  * @param[in] size size of the Join Accept packet
+ * @param[in] rx reception metadata of the Join Accept packet
  */
-void gnrc_lorawan_mlme_process_join(gnrc_lorawan_t *mac, uint8_t *data, size_t size);
+void gnrc_lorawan_mlme_process_join(gnrc_lorawan_t *mac, uint8_t *data, size_t size,
+                                    const gnrc_lorawan_rx_info_t *rx);
 
 /**
  * @brief Inform the MAC layer that no packet was received during reception.
@@ -280,6 +606,16 @@ void gnrc_lorawan_mlme_process_join(gnrc_lorawan_t *mac, uint8_t *data, size_t s
  */
 void gnrc_lorawan_mlme_no_rx(gnrc_lorawan_t *mac);
 
+/**
+ * @brief Hourly tick of the duty cycle bands and the Join backoff
+ *
+ *        Called by @ref gnrc_lorawan_mlme_backoff_expire, or by the hourly
+ *        timer of the timer wheel
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+void gnrc_lorawan_mlme_backoff_tick(gnrc_lorawan_t *mac);
+
 /**
  * @brief Trigger a MCPS event
  *
@@ -289,9 +625,26 @@ void gnrc_lorawan_mlme_no_rx(gnrc_lorawan_t *mac);
  */
 void gnrc_lorawan_mcps_event(gnrc_lorawan_t *mac, int event, int data);
 
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG || CONFIG_GNRC_LORAWAN_DRAIN
+/**
+ * @brief Stop the fragmented uplink transfer or the automatic uplink
+ *
+ *        A transfer completes with a MCPS confirm with status -ECANCELED.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ *
+ * @return true if the MAC owned a transaction that has to be stopped
+ */
+int gnrc_lorawan_mcps_abort(gnrc_lorawan_t *mac);
+#else
+#define gnrc_lorawan_mcps_abort(mac)    (false)  /**< nothing to stop */
+#endif
+
 /**
  * @brief Get the maximum MAC payload (M value) for a given datarate.
  *
+ *        Limited by @ref CONFIG_GNRC_LORAWAN_DWELL_TIME_MAX if set.
+ *
  * @note This function is region specific
  *
  * @param[in] datarate datarate
@@ -300,6 +653,31 @@ void gnrc_lorawan_mcps_event(gnrc_lorawan_t *mac, int event, int data);
  */
 uint8_t gnrc_lorawan_region_mac_payload_max(uint8_t datarate);
 
+/**
+ * @brief Get the LoRa symbol time of a datarate
+ *
+ * @note This function is region specific
+ *
+ * @param[in] datarate datarate
+ *
+ * @return symbol time in microseconds
+ */
+uint32_t gnrc_lorawan_region_symbol_time(uint8_t datarate);
+
+/**
+ * @brief Choose the datarate of a @ref GNRC_LORAWAN_DR_AUTO request
+ *
+ * @note This function is region specific
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] size MAC payload size of the request, as checked against
+ *                 @ref gnrc_lorawan_region_mac_payload_max
+ *
+ * @return the datarate. The payload might not fit if it's too long for any
+ *         datarate
+ */
+uint8_t gnrc_lorawan_region_auto_dr(const gnrc_lorawan_t *mac, size_t size);
+
 /**
  * @brief Open a reception window
  *
@@ -345,6 +723,74 @@ static inline void gnrc_lorawan_mac_release(gnrc_lorawan_t *mac)
 
 void gnrc_lorawan_set_rx2_dr(gnrc_lorawan_t *mac, uint8_t rx2_dr);
 
+/**
+ * @brief Stop the current transaction and release the MAC
+ *
+ *        Puts the radio to sleep and cancels the timer of the MAC.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ */
+void gnrc_lorawan_stop(gnrc_lorawan_t *mac);
+
+/**
+ * @brief Send the packet in the TX buffer after a delay
+ *
+ *        The MAC stays in @ref LORAWAN_STATE_TX_WAIT without using the radio
+ *        until the timer fires. It isn't released at the end of the current
+ *        transaction, so retransmissions and the fragments of an uplink
+ *        transfer don't interleave with other requests.
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] dr datarate of the transmission
+ * @param[in] delay delay in ms
+ */
+void gnrc_lorawan_schedule_tx(gnrc_lorawan_t *mac, uint8_t dr, uint32_t delay);
+
+/**
+ * @brief Check if the MAC is using the radio
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ *
+ * @return true if the MAC is transmitting or in a reception window
+ */
+static inline int gnrc_lorawan_radio_in_use(const gnrc_lorawan_t *mac)
+{
+    return mac->state != LORAWAN_STATE_IDLE && mac->state != LORAWAN_STATE_TX_WAIT;
+}
+
+/**
+ * @brief Get the frequency of a channel
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] i index of the channel
+ *
+ * @return frequency of the channel in Hz
+ * @return 0 if the channel is disabled
+ */
+static inline uint32_t gnrc_lorawan_channel_get(const gnrc_lorawan_t *mac, unsigned i)
+{
+    const uint8_t *c = mac->channel[i];
+
+    return (c[0] | (c[1] << 8) | ((uint32_t) c[2] << 16)) * GNRC_LORAWAN_CHANNEL_STEP;
+}
+
+/**
+ * @brief Set the frequency of a channel
+ *
+ * @param[in] mac pointer to the MAC descriptor
+ * @param[in] i index of the channel
+ * @param[in] freq frequency of the channel in Hz. 0 disables the channel
+ */
+static inline void gnrc_lorawan_channel_set(gnrc_lorawan_t *mac, unsigned i, uint32_t freq)
+{
+    uint8_t *c = mac->channel[i];
+
+    freq /= GNRC_LORAWAN_CHANNEL_STEP;
+    c[0] = freq & 0xFF;
+    c[1] = (freq >> 8) & 0xFF;
+    c[2] = (freq >> 16) & 0xFF;
+}
+
 #ifdef __cplusplus
 }
 #endif
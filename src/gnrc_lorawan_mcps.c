@@ -18,7 +18,10 @@
 #include "gnrc_lorawan_internal.h"
 #include "gnrc_lorawan/lorawan.h"
 #include "gnrc_lorawan/region.h"
+#include "gnrc_lorawan/frag.h"
+#include "gnrc_lorawan/compress.h"
 #include "errno.h"
+#include "timex.h"
 
 #include "net/lorawan/hdr.h"
 
@@ -75,6 +78,7 @@ int gnrc_lorawan_parse_dl(gnrc_lorawan_t *mac, uint8_t *buf, size_t len,
     /* Validate header */
     if (_hdr->addr.u32 != mac->dev_addr.u32) {
         DEBUG("gnrc_lorawan: received packet with wrong dev addr. Drop\n");
+        GNRC_LORAWAN_STATS_INC(mac, addr_drops);
         return -1;
     }
 
@@ -82,6 +86,7 @@ int gnrc_lorawan_parse_dl(gnrc_lorawan_t *mac, uint8_t *buf, size_t len,
     if (mac->mcps.fcnt_down > _fcnt || mac->mcps.fcnt_down +
         LORAMAC_DEFAULT_MAX_FCNT_GAP < _fcnt) {
         DEBUG("gnrc_lorawan: wrong frame counter\n");
+        GNRC_LORAWAN_STATS_INC(mac, fcnt_drops);
         return -1;
     }
 
@@ -113,14 +118,25 @@ int gnrc_lorawan_parse_dl(gnrc_lorawan_t *mac, uint8_t *buf, size_t len,
     return 0;
 }
 
+#if CONFIG_GNRC_LORAWAN_DRAIN
+/* Returns true if the MAC sends the uplink for the reason itself */
+static inline int _drain_wants(const gnrc_lorawan_t *mac, uint8_t reason)
+{
+    return (mac->drain.policy & reason) && mac->drain.count < CONFIG_GNRC_LORAWAN_DRAIN_MAX;
+}
+#else
+#define _drain_wants(mac, reason) (false)
+#endif
+
 void gnrc_lorawan_mcps_process_downlink(gnrc_lorawan_t *mac, uint8_t *buf,
-        size_t len)
+        size_t len, const gnrc_lorawan_rx_info_t *rx)
 {
     struct parsed_packet _pkt;
 
     /* NOTE: MIC is in pkt */
     if (!gnrc_lorawan_mic_is_valid(mac, buf, len, mac->nwkskey)) {
         DEBUG("gnrc_lorawan: invalid MIC\n");
+        GNRC_LORAWAN_STATS_INC(mac, mic_failures);
         gnrc_lorawan_mcps_event(mac, MCPS_EVENT_NO_RX, 0);
         return;
     }
@@ -131,6 +147,8 @@ void gnrc_lorawan_mcps_process_downlink(gnrc_lorawan_t *mac, uint8_t *buf,
         return;
     }
 
+    gnrc_lorawan_rx_accepted(mac, rx);
+
     iolist_t *fopts = NULL;
     if(_pkt.fopts.iol_base) {
         fopts = &_pkt.fopts;
@@ -160,34 +178,48 @@ void gnrc_lorawan_mcps_process_downlink(gnrc_lorawan_t *mac, uint8_t *buf,
         gnrc_lorawan_process_fopts(mac, fopts->iol_base, fopts->iol_len);
     }
 
+    /* The upper layer schedules the uplink, unless the MAC drains the
+     * downlinks itself */
+    int schedule_uplink = _pkt.frame_pending &&
+                          !_drain_wants(mac, GNRC_LORAWAN_DRAIN_FPENDING);
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    mac->drain.pending = _pkt.frame_pending;
+#endif
+
     gnrc_lorawan_mcps_event(mac, MCPS_EVENT_RX, _pkt.ack);
 
-    if (_pkt.frame_pending) {
+    if (schedule_uplink) {
         mlme_indication_t mlme_indication;
         mlme_indication.type = MLME_SCHEDULE_UPLINK;
-        gnrc_lorawan_mlme_indication(mac, &mlme_indication);
+        GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_MLME_INDICATION, mlme_indication.type, 0);
+        gnrc_lorawan_deliver_mlme_indication(mac, &mlme_indication);
     }
 
+#if CONFIG_GNRC_LORAWAN_FRAG
+    if (_pkt.port == GNRC_LORAWAN_FRAG_PORT) {
+        gnrc_lorawan_frag_process(mac, _pkt.enc_payload.iol_base,
+                                  _pkt.enc_payload.iol_len);
+        return;
+    }
+#endif
+
     if (_pkt.port) {
         mcps_indication_t mcps_indication;
         mcps_indication.type = _pkt.ack_req;
-        mcps_indication.data.pkt = &_pkt.enc_payload;;
+        mcps_indication.data.pkt = &_pkt.enc_payload;
         mcps_indication.data.port = _pkt.port;
-        gnrc_lorawan_mcps_indication(mac, &mcps_indication);
+        mcps_indication.rx = *rx;
+        GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_MCPS_INDICATION, _pkt.port,
+                           _pkt.enc_payload.iol_len);
+        gnrc_lorawan_deliver_mcps_indication(mac, &mcps_indication);
     }
 }
 
-size_t gnrc_lorawan_build_uplink(gnrc_lorawan_t *mac, iolist_t *payload, int confirmed_data, uint8_t port,
-        uint8_t *out)
+/* Write the frame header, the FOpts and the FPort of an uplink */
+static void _build_uplink_hdr(gnrc_lorawan_t *mac, lorawan_buffer_t *buf,
+                              int confirmed_data, uint8_t port)
 {
-
-    lorawan_buffer_t buf = {
-        .data = (uint8_t *) out,
-        .size = 250,
-        .index = 0
-    };
-
-    lorawan_hdr_t *lw_hdr = (lorawan_hdr_t *) out;
+    lorawan_hdr_t *lw_hdr = (lorawan_hdr_t *) buf->data;
 
     lw_hdr->mt_maj = 0;
     lorawan_hdr_set_mtype(lw_hdr, confirmed_data ? MTYPE_CNF_UPLINK : MTYPE_UNCNF_UPLINK);
@@ -200,60 +232,356 @@ size_t gnrc_lorawan_build_uplink(gnrc_lorawan_t *mac, iolist_t *payload, int con
 
     lw_hdr->fcnt = byteorder_btols(byteorder_htons(mac->mcps.fcnt));
 
-    buf.index += sizeof(lorawan_hdr_t);
+    buf->index += sizeof(lorawan_hdr_t);
 
-    int fopts_length = gnrc_lorawan_build_options(mac, &buf);
+    int fopts_length = gnrc_lorawan_build_options(mac, buf);
     assert(fopts_length < 16);
     lorawan_hdr_set_frame_opts_len(lw_hdr, fopts_length);
 
-    //assert(buf.index == mac_hdr->size - 1);
+    buf->data[buf->index++] = port;
+}
+
+/* Encrypt the FRMPayload and append the MIC */
+static size_t _seal_uplink(gnrc_lorawan_t *mac, lorawan_buffer_t *buf,
+                           uint8_t *pl, size_t psize, uint8_t port)
+{
+    gnrc_lorawan_encrypt_payload(mac, pl, psize, &mac->dev_addr, mac->mcps.fcnt, GNRC_LORAWAN_DIR_UPLINK, port ? mac->appskey : mac->nwkskey);
+
+    gnrc_lorawan_calculate_mic(mac, &mac->dev_addr, mac->mcps.fcnt, GNRC_LORAWAN_DIR_UPLINK,
+                               buf->data, buf->index, mac->nwkskey, (le_uint32_t*) &buf->data[buf->index]);
+    buf->index += MIC_SIZE;
+    return buf->index;
+}
+
+int gnrc_lorawan_build_uplink(gnrc_lorawan_t *mac, iolist_t *payload, int confirmed_data, uint8_t port,
+        uint8_t *out)
+{
+
+    lorawan_buffer_t buf = {
+        .data = (uint8_t *) out,
+        .size = 250,
+        .index = 0
+    };
 
-    buf.data[buf.index++] = port;
+    _build_uplink_hdr(mac, &buf, confirmed_data, port);
 
     size_t psize = 0;
     uint8_t *pl = &buf.data[buf.index];
+#if CONFIG_GNRC_LORAWAN_COMPRESS
+    const gnrc_lorawan_codec_t *codec = gnrc_lorawan_codec_get(mac, port);
+    if (codec) {
+        ssize_t res = codec->compress(codec, payload, pl,
+                                      buf.size - buf.index - MIC_SIZE);
+        if (res < 0) {
+            DEBUG("gnrc_lorawan_mcps: compression failed (%d)\n", (int) res);
+            return res;
+        }
+        psize = res;
+        buf.index += psize;
+        payload = NULL;
+    }
+#endif
     /* Copy raw payload into tx_buf */
     for(iolist_t *io = payload; io != NULL; io = io->iol_next) {
         memcpy(&buf.data[buf.index], io->iol_base, io->iol_len);
         psize += io->iol_len;
-        buf.index += psize;
+        buf.index += io->iol_len;
     }
 
-    gnrc_lorawan_encrypt_payload(mac, pl, psize, &mac->dev_addr, mac->mcps.fcnt, GNRC_LORAWAN_DIR_UPLINK, port ? mac->appskey : mac->nwkskey);
+    return _seal_uplink(mac, &buf, pl, psize, port);
+}
 
-    gnrc_lorawan_calculate_mic(mac, &mac->dev_addr, mac->mcps.fcnt, GNRC_LORAWAN_DIR_UPLINK,
-                               out, buf.index, mac->nwkskey, (le_uint32_t*) &buf.data[buf.index]);
-    buf.index += MIC_SIZE;
-    return buf.index;
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG
+/* Copy `len` bytes of `io` starting at `offset` */
+static void _iolist_copy(uint8_t *dst, const iolist_t *io, size_t offset, size_t len)
+{
+    for (; io && len; io = io->iol_next) {
+        if (offset >= io->iol_len) {
+            offset -= io->iol_len;
+            continue;
+        }
+        size_t chunk = io->iol_len - offset;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(dst, (const uint8_t *) io->iol_base + offset, chunk);
+        dst += chunk;
+        len -= chunk;
+        offset = 0;
+    }
+}
+
+/* Build the next fragment of the uplink transfer into the TX buffer and
+ * prepare the MCPS descriptor to send it */
+static void _ufrag_build(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_uplink_frag_t *ufrag = &mac->ufrag;
+    lorawan_buffer_t buf = {
+        .data = mac->tx_buf,
+        .size = 250,
+        .index = 0
+    };
+
+    _build_uplink_hdr(mac, &buf, ufrag->confirmed, ufrag->port);
+
+    /* Same MAC payload size as checked by gnrc_lorawan_mcps_request */
+    size_t room = gnrc_lorawan_region_mac_payload_max(ufrag->dr) - (buf.index - 1) -
+                  GNRC_LORAWAN_UPLINK_FRAG_HDR_SIZE;
+    size_t len = ufrag->size - ufrag->offset;
+    if (len > room) {
+        len = room;
+    }
+
+    uint16_t hdr = (ufrag->session << GNRC_LORAWAN_UPLINK_FRAG_SESSION_POS) |
+                   (ufrag->index & GNRC_LORAWAN_UPLINK_FRAG_INDEX_MASK);
+    if (ufrag->offset + len == ufrag->size) {
+        hdr |= GNRC_LORAWAN_UPLINK_FRAG_LAST;
+    }
+
+    uint8_t *pl = &buf.data[buf.index];
+    pl[0] = hdr >> 8;
+    pl[1] = hdr & 0xFF;
+    _iolist_copy(&pl[GNRC_LORAWAN_UPLINK_FRAG_HDR_SIZE], ufrag->pkt, ufrag->offset, len);
+    buf.index += GNRC_LORAWAN_UPLINK_FRAG_HDR_SIZE + len;
+
+    mac->tx_len = _seal_uplink(mac, &buf, pl, GNRC_LORAWAN_UPLINK_FRAG_HDR_SIZE + len,
+                               ufrag->port);
+    ufrag->offset += len;
+    ufrag->index++;
+
+    mac->mcps.waiting_for_ack = ufrag->confirmed;
+    mac->mcps.nb_trials = LORAMAC_DEFAULT_RETX;
+    mac->mcps.attempts = 1;
+    GNRC_LORAWAN_STATS_INC(mac, uplinks);
+}
+
+/* Returns true if the transfer goes on with the next fragment */
+static int _ufrag_next(gnrc_lorawan_t *mac, int status)
+{
+    gnrc_lorawan_uplink_frag_t *ufrag = &mac->ufrag;
+    unsigned attempts = ufrag->attempts + mac->mcps.attempts;
+
+    ufrag->attempts = attempts > UINT8_MAX ? UINT8_MAX : attempts;
+    if (status == GNRC_LORAWAN_REQ_STATUS_SUCCESS && ufrag->offset < ufrag->size) {
+        mac->mcps.fcnt += 1;
+        _ufrag_build(mac);
+
+        /* Pace the fragments against the duty cycle budget */
+        uint32_t delay = 1 + gnrc_lorawan_band_wait(mac) / US_PER_MS;
+        gnrc_lorawan_schedule_tx(mac, ufrag->dr, delay);
+        return true;
+    }
+
+    DEBUG("gnrc_lorawan_mcps: uplink transfer done (%d)\n", status);
+    mac->mcps.attempts = ufrag->attempts;
+    ufrag->pkt = NULL;
+    return false;
 }
 
+static int _ufrag_start(gnrc_lorawan_t *mac, const mcps_request_t *mcps_request)
+{
+    gnrc_lorawan_uplink_frag_t *ufrag = &mac->ufrag;
+    size_t size = iolist_size(mcps_request->data.pkt);
+
+    if (size > CONFIG_GNRC_LORAWAN_UPLINK_FRAG_SIZE_MAX) {
+        return -EMSGSIZE;
+    }
+
+    /* Every fragment must carry data next to the longest FOpts (15 bytes),
+     * which might not be the case under a dwell time limit */
+    if (gnrc_lorawan_region_mac_payload_max(mcps_request->data.dr) <=
+        sizeof(lorawan_hdr_t) + 15 + GNRC_LORAWAN_UPLINK_FRAG_HDR_SIZE) {
+        return -EMSGSIZE;
+    }
+
+    DEBUG("gnrc_lorawan_mcps: fragmenting %u bytes\n", (unsigned) size);
+    ufrag->pkt = mcps_request->data.pkt;
+    ufrag->size = size;
+    ufrag->offset = 0;
+    ufrag->index = 0;
+    ufrag->attempts = 0;
+    ufrag->port = mcps_request->data.port;
+    ufrag->dr = mcps_request->data.dr;
+    ufrag->confirmed = mcps_request->type == MCPS_CONFIRMED;
+    ufrag->session++;
+    _ufrag_build(mac);
+    return 0;
+}
+#endif
+
+static void _send_uplink(gnrc_lorawan_t *mac, uint8_t dr)
+{
+    gnrc_lorawan_energy_transaction_start(mac);
+    iolist_t pkt = {
+        .iol_base = mac->tx_buf,
+        .iol_len = mac->tx_len,
+        .iol_next = NULL
+    };
+
+    gnrc_lorawan_send_pkt(mac, (iolist_t*) &pkt, dr);
+}
+
+#if CONFIG_GNRC_LORAWAN_DRAIN
+/* Schedule an automatic uplink if the network server has more downlinks or
+ * waits for an ACK. Called at the end of a transaction, so the MAC is still
+ * busy */
+static void _drain_schedule(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_drain_t *drain = &mac->drain;
+    int fpending = drain->pending && _drain_wants(mac, GNRC_LORAWAN_DRAIN_FPENDING);
+    int ack = mac->mcps.ack_requested && _drain_wants(mac, GNRC_LORAWAN_DRAIN_ACK);
+    lorawan_buffer_t buf = {
+        .data = mac->tx_buf,
+        .size = 250,
+        .index = 0
+    };
+
+    drain->pending = false;
+    if (!fpending && !ack) {
+        /* Done, or the upper layer takes over after too many uplinks */
+        drain->count = 0;
+        return;
+    }
+
+    /* Without FRMPayload there's no FPort */
+    _build_uplink_hdr(mac, &buf, false, 0);
+    buf.index--;
+    mac->tx_len = _seal_uplink(mac, &buf, &buf.data[buf.index], 0, 0);
+
+    drain->count++;
+    drain->active = true;
+    mac->mcps.waiting_for_ack = false;
+    mac->mcps.nb_trials = LORAMAC_DEFAULT_RETX;
+    mac->mcps.attempts = 1;
+    GNRC_LORAWAN_STATS_INC(mac, drain_uplinks);
+    gnrc_lorawan_energy_transaction_start(mac);
+
+    /* Right after the reception windows, as soon as a band has duty cycle
+     * budget */
+    uint32_t delay = 1 + gnrc_lorawan_band_wait(mac) / US_PER_MS;
+    DEBUG("gnrc_lorawan_mcps: automatic uplink in %u ms\n", (unsigned) delay);
+    gnrc_lorawan_schedule_tx(mac, mac->last_dr, delay);
+}
+#endif
+
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG || CONFIG_GNRC_LORAWAN_DRAIN
+int gnrc_lorawan_mcps_abort(gnrc_lorawan_t *mac)
+{
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    /* Automatic uplinks have no MCPS confirm */
+    if (mac->drain.active) {
+        DEBUG("gnrc_lorawan_mcps: automatic uplink canceled\n");
+        mac->drain.active = false;
+        mac->drain.count = 0;
+        return true;
+    }
+#endif
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG
+    gnrc_lorawan_uplink_frag_t *ufrag = &mac->ufrag;
+    mcps_confirm_t mcps_confirm;
+
+    if (ufrag->pkt) {
+        DEBUG("gnrc_lorawan_mcps: uplink transfer canceled\n");
+        ufrag->pkt = NULL;
+        mcps_confirm.type = ufrag->confirmed ? MCPS_CONFIRMED : MCPS_UNCONFIRMED;
+        mcps_confirm.status = -ECANCELED;
+        /* Transmissions of the fragments that completed */
+        mcps_confirm.attempts = ufrag->attempts;
+        GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_MCPS_CONFIRM, mcps_confirm.type,
+                           mcps_confirm.status);
+        gnrc_lorawan_deliver_mcps_confirm(mac, &mcps_confirm);
+        return true;
+    }
+#endif
+    return false;
+}
+#endif
+
 static void _end_of_tx(gnrc_lorawan_t *mac, int type, int status)
 {
     mac->mcps.waiting_for_ack = false;
 
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG
+    if (mac->ufrag.pkt && _ufrag_next(mac, status)) {
+        return;
+    }
+#endif
+
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    /* Automatic uplinks have no MCPS confirm */
+    if (mac->drain.active) {
+        mac->drain.active = false;
+        mac->mcps.fcnt += 1;
+        _drain_schedule(mac);
+        return;
+    }
+#endif
+
     mcps_confirm_t mcps_confirm;
 
     mcps_confirm.type = type;
     mcps_confirm.status = status;
-    gnrc_lorawan_mcps_confirm(mac, &mcps_confirm);
+    mcps_confirm.attempts = mac->mcps.attempts;
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_MCPS_CONFIRM, type, status);
+    gnrc_lorawan_deliver_mcps_confirm(mac, &mcps_confirm);
 
     mac->mcps.fcnt += 1;
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    _drain_schedule(mac);
+#endif
+}
+
+static void _retransmission_step_down_dr(gnrc_lorawan_t *mac)
+{
+    if (mac->mcps.attempts % GNRC_LORAWAN_DR_STEP_DOWN_ATTEMPTS || !mac->last_dr) {
+        return;
+    }
+
+    /* Same MAC payload size as checked by gnrc_lorawan_mcps_request */
+    size_t mac_payload_size = mac->tx_len - MIC_SIZE - 1;
+    if (mac_payload_size <= gnrc_lorawan_region_mac_payload_max(mac->last_dr - 1)) {
+        mac->last_dr--;
+    }
+}
+
+static uint32_t _retransmission_delay(gnrc_lorawan_t *mac)
+{
+    uint32_t toa_ms = mac->toa / US_PER_MS;
+
+    /* Spread the retransmissions of colliding devices over a window that
+     * grows with the Time on Air and the number of attempts */
+    uint32_t delay = GNRC_LORAWAN_ACK_TIMEOUT_MIN + gnrc_lorawan_random_get(mac) %
+                     (GNRC_LORAWAN_ACK_TIMEOUT_RANDOM + toa_ms * mac->mcps.attempts);
+
+    /* Don't wake up before a band has duty cycle budget */
+    uint32_t band_wait = gnrc_lorawan_band_wait(mac) / US_PER_MS;
+    if (band_wait >= delay) {
+        delay = band_wait + 1 + gnrc_lorawan_random_get(mac) % (toa_ms + 1);
+    }
+
+    return delay;
 }
 
 void gnrc_lorawan_mcps_event(gnrc_lorawan_t *mac, int event, int data)
 {
     int state = mac->mcps.waiting_for_ack ? MCPS_CONFIRMED : MCPS_UNCONFIRMED;
     if (state == MCPS_CONFIRMED && ((event == MCPS_EVENT_RX && !data) ||
-                                    event == MCPS_EVENT_NO_RX)) {
+                                    event == MCPS_EVENT_NO_RX ||
+                                    event == MCPS_EVENT_CHANNEL_BUSY)) {
         if (mac->mcps.nb_trials-- > 0) {
-            gnrc_lorawan_timer_set(mac, 1000 + (gnrc_lorawan_random_get(mac) & 0x7FF));
+            _retransmission_step_down_dr(mac);
+            uint32_t timeout = _retransmission_delay(mac);
+            GNRC_LORAWAN_STATS_INC(mac, retransmissions);
+            mac->mcps.attempts++;
+            gnrc_lorawan_schedule_tx(mac, mac->last_dr, timeout);
         }
         else {
             _end_of_tx(mac, MCPS_CONFIRMED, -ETIMEDOUT);
         }
     }
     else {
-        _end_of_tx(mac, state, GNRC_LORAWAN_REQ_STATUS_SUCCESS);
+        _end_of_tx(mac, state, event == MCPS_EVENT_CHANNEL_BUSY ?
+                   -EBUSY : GNRC_LORAWAN_REQ_STATUS_SUCCESS);
     }
 }
 
@@ -262,12 +590,13 @@ void gnrc_lorawan_mcps_request(gnrc_lorawan_t *mac, const mcps_request_t *mcps_r
     if (mac->mlme.activation == MLME_ACTIVATION_NONE) {
         DEBUG("gnrc_lorawan_mcps: LoRaWAN not activated\n");
         mcps_confirm->status = -ENOTCONN;
-        goto out;
+        return;
     }
 
+    /* Don't release the MAC on failure if it's owned by another request */
     if (!gnrc_lorawan_mac_acquire(mac)) {
         mcps_confirm->status = -EBUSY;
-        goto out;
+        return;
     }
 
     if (mcps_request->data.port < LORAMAC_PORT_MIN ||
@@ -276,41 +605,69 @@ void gnrc_lorawan_mcps_request(gnrc_lorawan_t *mac, const mcps_request_t *mcps_r
         goto out;
     }
 
+    mcps_request_t auto_request;
+    if (mcps_request->data.dr == GNRC_LORAWAN_DR_AUTO) {
+        size_t size = sizeof(lorawan_hdr_t) + gnrc_lorawan_build_options(mac, NULL) +
+            iolist_size(mcps_request->data.pkt);
+        auto_request = *mcps_request;
+        auto_request.data.dr = gnrc_lorawan_region_auto_dr(mac, size);
+        mcps_request = &auto_request;
+    }
+
     if (!gnrc_lorawan_validate_dr(mcps_request->data.dr)) {
         mcps_confirm->status = -EINVAL;
         goto out;
     }
 
-    uint8_t fopts_length = gnrc_lorawan_build_options(mac, NULL);
-    size_t mac_payload_size = sizeof(lorawan_hdr_t) + fopts_length + 
-        iolist_size(mcps_request->data.pkt);
-
-    if (mac_payload_size > gnrc_lorawan_region_mac_payload_max(mcps_request->data.dr)) {
-        mcps_confirm->status = -EMSGSIZE;
-        goto out;
+    size_t max_size = gnrc_lorawan_region_mac_payload_max(mcps_request->data.dr);
+    int compressed = false;
+#if CONFIG_GNRC_LORAWAN_COMPRESS
+    compressed = gnrc_lorawan_codec_get(mac, mcps_request->data.port) != NULL;
+#endif
+
+    /* The size of compressed payloads is checked once they are built */
+    if (!compressed) {
+        uint8_t fopts_length = gnrc_lorawan_build_options(mac, NULL);
+        size_t mac_payload_size = sizeof(lorawan_hdr_t) + fopts_length +
+            iolist_size(mcps_request->data.pkt);
+
+        if (mac_payload_size > max_size) {
+#if CONFIG_GNRC_LORAWAN_UPLINK_FRAG
+            if (_ufrag_start(mac, mcps_request) == 0) {
+                _send_uplink(mac, mcps_request->data.dr);
+                mcps_confirm->status = GNRC_LORAWAN_REQ_STATUS_DEFERRED;
+                goto out;
+            }
+#endif
+            mcps_confirm->status = -EMSGSIZE;
+            goto out;
+        }
     }
 
     int waiting_for_ack = mcps_request->type == MCPS_CONFIRMED;
     /* We try to allocate the whole header with fopts at once */
 
-    size_t pkt_size = gnrc_lorawan_build_uplink(mac, mcps_request->data.pkt, waiting_for_ack, mcps_request->data.port, mac->tx_buf);
+    int pkt_size = gnrc_lorawan_build_uplink(mac, mcps_request->data.pkt, waiting_for_ack, mcps_request->data.port, mac->tx_buf);
+    if (pkt_size < 0) {
+        mcps_confirm->status = pkt_size;
+        goto out;
+    }
+    if (compressed && (size_t) pkt_size - MIC_SIZE - 1 > max_size) {
+        mcps_confirm->status = -EMSGSIZE;
+        goto out;
+    }
 
     mac->mcps.waiting_for_ack = waiting_for_ack;
-    mac->mcps.ack_requested = false;
 
     mac->mcps.nb_trials = LORAMAC_DEFAULT_RETX;
+    mac->mcps.attempts = 1;
 
     //assert(mac->mcps.outgoing_pkt == NULL);
     //mac->mcps.outgoing_pkt = pkt;
 
     mac->tx_len = pkt_size;
-    iolist_t pkt = {
-        .iol_base = mac->tx_buf,
-        .iol_len = pkt_size,
-        .iol_next = NULL
-    };
-
-    gnrc_lorawan_send_pkt(mac, (iolist_t*) &pkt, mcps_request->data.dr);
+    GNRC_LORAWAN_STATS_INC(mac, uplinks);
+    _send_uplink(mac, mcps_request->data.dr);
     mcps_confirm->status = GNRC_LORAWAN_REQ_STATUS_DEFERRED;
 out:
 
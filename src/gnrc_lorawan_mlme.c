@@ -19,6 +19,7 @@
 #include "gnrc_lorawan/region.h"
 #include "gnrc_lorawan_internal.h"
 #include "errno.h"
+#include "timex.h"
 
 #include "net/lorawan/hdr.h"
 
@@ -46,8 +47,9 @@ static int gnrc_lorawan_send_join_request(gnrc_lorawan_t *mac, uint8_t *deveui,
     mac->mlme.dev_nonce[0] = random_number & 0xFF;
     mac->mlme.dev_nonce[1] = (random_number >> 8) & 0xFF;
 
-    /* build join request */
-    uint8_t pkt[sizeof(lorawan_join_request_t)];
+    /* build join request in the TX buffer, so it can be sent again if the
+     * transmission gets deferred */
+    uint8_t *pkt = mac->tx_buf;
     lorawan_join_request_t *hdr = (lorawan_join_request_t*) pkt;
 
     hdr->mt_maj = 0;
@@ -65,24 +67,23 @@ static int gnrc_lorawan_send_join_request(gnrc_lorawan_t *mac, uint8_t *deveui,
 
     gnrc_lorawan_calculate_join_mic(mac, pkt, JOIN_REQUEST_SIZE - MIC_SIZE, appkey, &hdr->mic);
 
-    /* We need a random delay for join request. Otherwise there might be
-     * network congestion if a group of nodes start at the same time */
-    gnrc_lorawan_timer_usleep(mac, gnrc_lorawan_random_get(mac) & GNRC_LORAWAN_JOIN_DELAY_U32_MASK);
+    mac->tx_len = sizeof(lorawan_join_request_t);
 
-    iolist_t io = {
-        .iol_base = pkt,
-        .iol_len = sizeof(lorawan_join_request_t),
-        .iol_next = NULL
-    };
+    GNRC_LORAWAN_STATS_INC(mac, join_attempts);
+    gnrc_lorawan_energy_transaction_start(mac);
 
-    gnrc_lorawan_send_pkt(mac, &io, dr);
+    /* We need a random delay for join request. Otherwise there might be
+     * network congestion if a group of nodes start at the same time */
+    uint32_t jitter = gnrc_lorawan_random_get(mac) & GNRC_LORAWAN_JOIN_DELAY_U32_MASK;
+    gnrc_lorawan_schedule_tx(mac, dr, jitter / US_PER_MS);
 
     mac->mlme.backoff_budget -= mac->toa;
 
     return GNRC_LORAWAN_REQ_STATUS_DEFERRED;
 }
 
-void gnrc_lorawan_mlme_process_join(gnrc_lorawan_t *mac, uint8_t *data, size_t size)
+void gnrc_lorawan_mlme_process_join(gnrc_lorawan_t *mac, uint8_t *data, size_t size,
+                                    const gnrc_lorawan_rx_info_t *rx)
 {
     int status;
     mlme_confirm_t mlme_confirm;
@@ -92,6 +93,7 @@ void gnrc_lorawan_mlme_process_join(gnrc_lorawan_t *mac, uint8_t *data, size_t s
         goto out;
     }
 
+    /* Only a Join Accept with or without a CFList is valid */
     if (size != GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE - CFLIST_SIZE &&
         size != GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE) {
         status = -EBADMSG;
@@ -100,7 +102,7 @@ void gnrc_lorawan_mlme_process_join(gnrc_lorawan_t *mac, uint8_t *data, size_t s
 
     /* Substract 1 from join accept max size, since the MHDR was already read */
     uint8_t out[GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE - 1];
-    uint8_t has_cflist = (size - 1) >= CFLIST_SIZE;
+    uint8_t has_cflist = size == GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE;
     gnrc_lorawan_decrypt_join_accept(mac, mac->appskey, ((uint8_t *) data) + 1,
                                      has_cflist, out);
     memcpy(((uint8_t *) data) + 1, out, size - 1);
@@ -110,10 +112,13 @@ void gnrc_lorawan_mlme_process_join(gnrc_lorawan_t *mac, uint8_t *data, size_t s
     gnrc_lorawan_calculate_join_mic(mac, data, size - MIC_SIZE, mac->appskey, &mic);
     if (mic.u32 != expected_mic->u32) {
         DEBUG("gnrc_lorawan_mlme: wrong MIC.\n");
+        GNRC_LORAWAN_STATS_INC(mac, mic_failures);
         status = -EBADMSG;
         goto out;
     }
 
+    gnrc_lorawan_rx_accepted(mac, rx);
+
     lorawan_join_accept_t *ja_hdr = (lorawan_join_accept_t *) data;
     gnrc_lorawan_generate_session_keys(mac, ja_hdr->app_nonce, mac->mlme.dev_nonce, mac->appskey, mac->nwkskey, mac->appskey);
 
@@ -129,7 +134,9 @@ void gnrc_lorawan_mlme_process_join(gnrc_lorawan_t *mac, uint8_t *data, size_t s
     /* delay 0 maps to 1 second */
     mac->rx_delay = ja_hdr->rx_delay ? ja_hdr->rx_delay : 1;
 
-    gnrc_lorawan_process_cflist(mac, out + sizeof(lorawan_join_accept_t) - 1);
+    if (has_cflist) {
+        gnrc_lorawan_process_cflist(mac, out + sizeof(lorawan_join_accept_t) - 1);
+    }
     mac->mlme.activation = MLME_ACTIVATION_OTAA;
     status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
 
@@ -137,11 +144,32 @@ out:
     mlme_confirm.type = MLME_JOIN;
     mlme_confirm.status = status;
 
-    gnrc_lorawan_mlme_confirm(mac, &mlme_confirm);
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_MLME_CONFIRM, mlme_confirm.type,
+                       mlme_confirm.status);
+    gnrc_lorawan_deliver_mlme_confirm(mac, &mlme_confirm);
 }
 
 void gnrc_lorawan_mlme_backoff_expire(gnrc_lorawan_t *mac)
 {
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+    /* The timer wheel ticks already, a second tick would release the bands
+     * and the backoff budget early */
+    (void) mac;
+    DEBUG("gnrc_lorawan_mlme: ignore external backoff tick\n");
+#else
+    gnrc_lorawan_mlme_backoff_tick(mac);
+#endif
+}
+
+void gnrc_lorawan_mlme_backoff_tick(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_bands_expire(mac);
+
+#if CONFIG_GNRC_LORAWAN_ENERGY
+    /* Close the current accounting period before the time source wraps */
+    gnrc_lorawan_energy_account(mac, mac->energy.mode);
+#endif
+
     uint8_t counter = mac->mlme.backoff_state & 0x1F;
     uint8_t state = mac->mlme.backoff_state >> 5;
 
@@ -189,6 +217,37 @@ static void _mlme_set(gnrc_lorawan_t *mac, const mlme_request_t *mlme_request,
             mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
             gnrc_lorawan_set_rx2_dr(mac, mlme_request->mib.rx2_dr);
             break;
+#if CONFIG_GNRC_LORAWAN_STATS
+        case MIB_STATS:
+            mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
+            memset(&mac->stats, 0, sizeof(mac->stats));
+            break;
+#endif
+#if CONFIG_GNRC_LORAWAN_ENERGY
+        case MIB_ENERGY:
+            mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
+            memset(&mac->energy.counters, 0, sizeof(mac->energy.counters));
+            break;
+        case MIB_ENERGY_PROFILE:
+            if (mlme_request->mib.energy_profile) {
+                mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
+                gnrc_lorawan_energy_account(mac, mac->energy.mode);
+                mac->energy.profile = mlme_request->mib.energy_profile;
+            }
+            break;
+#endif
+#if CONFIG_GNRC_LORAWAN_DRAIN
+        case MIB_DRAIN_POLICY:
+            mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
+            mac->drain.policy = mlme_request->mib.drain_policy;
+            /* Cancel an automatic uplink that didn't start yet */
+            if (!mac->drain.policy && mac->drain.active &&
+                mac->state == LORAWAN_STATE_TX_WAIT) {
+                gnrc_lorawan_mcps_abort(mac);
+                gnrc_lorawan_stop(mac);
+            }
+            break;
+#endif
         default:
             break;
     }
@@ -206,6 +265,29 @@ static void _mlme_get(gnrc_lorawan_t *mac, const mlme_request_t *mlme_request,
             mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
             mlme_confirm->mib.dev_addr = &mac->dev_addr;
             break;
+#if CONFIG_GNRC_LORAWAN_STATS
+        case MIB_STATS:
+            mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
+            mlme_confirm->mib.stats = &mac->stats;
+            break;
+#endif
+#if CONFIG_GNRC_LORAWAN_ENERGY
+        case MIB_ENERGY:
+            mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
+            gnrc_lorawan_energy_account(mac, mac->energy.mode);
+            mlme_confirm->mib.energy = &mac->energy.counters;
+            break;
+        case MIB_ENERGY_PROFILE:
+            mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
+            mlme_confirm->mib.energy_profile = mac->energy.profile;
+            break;
+#endif
+#if CONFIG_GNRC_LORAWAN_DRAIN
+        case MIB_DRAIN_POLICY:
+            mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
+            mlme_confirm->mib.drain_policy = mac->drain.policy;
+            break;
+#endif
         default:
             mlme_confirm->status = -EINVAL;
             break;
@@ -276,7 +358,9 @@ static int _mlme_link_check_ans(gnrc_lorawan_t *mac, lorawan_buffer_t *fopt)
 
     mlme_confirm.type = MLME_LINK_CHECK;
     mlme_confirm.status = GNRC_LORAWAN_REQ_STATUS_SUCCESS;
-    gnrc_lorawan_mlme_confirm(mac, &mlme_confirm);
+    GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_MLME_CONFIRM, mlme_confirm.type,
+                       mlme_confirm.status);
+    gnrc_lorawan_deliver_mlme_confirm(mac, &mlme_confirm);
 
     mac->mlme.pending_mlme_opts &= ~GNRC_LORAWAN_MLME_OPTS_LINK_CHECK_REQ;
 
@@ -322,11 +406,15 @@ void gnrc_lorawan_mlme_no_rx(gnrc_lorawan_t *mac)
 
     if (mac->mlme.activation == MLME_ACTIVATION_NONE) {
         mlme_confirm.type = MLME_JOIN;
-        gnrc_lorawan_mlme_confirm(mac, &mlme_confirm);
+        GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_MLME_CONFIRM, mlme_confirm.type,
+                           mlme_confirm.status);
+        gnrc_lorawan_deliver_mlme_confirm(mac, &mlme_confirm);
     }
     else if (mac->mlme.pending_mlme_opts & GNRC_LORAWAN_MLME_OPTS_LINK_CHECK_REQ) {
         mlme_confirm.type = MLME_LINK_CHECK;
-        gnrc_lorawan_mlme_confirm(mac, &mlme_confirm);
+        GNRC_LORAWAN_TRACE(mac, GNRC_LORAWAN_TRACE_MLME_CONFIRM, mlme_confirm.type,
+                           mlme_confirm.status);
+        gnrc_lorawan_deliver_mlme_confirm(mac, &mlme_confirm);
         mac->mlme.pending_mlme_opts &= ~GNRC_LORAWAN_MLME_OPTS_LINK_CHECK_REQ;
     }
 }
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <string.h>
+#include <assert.h>
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/mux.h"
+#include "gnrc_lorawan_internal.h"
+#include "errno.h"
+
+#define ENABLE_DEBUG    (0)
+#include "debug.h"
+
+static gnrc_lorawan_mux_slot_t *_get_slot(gnrc_lorawan_mux_t *mux,
+                                          gnrc_lorawan_t *mac)
+{
+    for (unsigned i = 0; i < mux->numof; i++) {
+        if (mux->slots[i].mac == mac) {
+            return &mux->slots[i];
+        }
+    }
+    return NULL;
+}
+
+static inline int _radio_free(gnrc_lorawan_mux_t *mux)
+{
+    return mux->owner == NULL;
+}
+
+/* The MAC owns the radio from the start of a transmission until the end of
+ * the last reception window */
+static void _update_owner(gnrc_lorawan_mux_t *mux, gnrc_lorawan_t *mac)
+{
+    if (gnrc_lorawan_radio_in_use(mac)) {
+        mux->owner = mac;
+    }
+    else if (mux->owner == mac) {
+        mux->owner = NULL;
+    }
+}
+
+static void _run(gnrc_lorawan_mux_t *mux, gnrc_lorawan_mux_slot_t *slot)
+{
+    gnrc_lorawan_t *mac = slot->mac;
+    uint8_t pending = slot->pending;
+
+    if (pending & GNRC_LORAWAN_MUX_PENDING_TIMER) {
+        slot->pending &= ~GNRC_LORAWAN_MUX_PENDING_TIMER;
+        gnrc_lorawan_timer_fired(mac);
+    }
+    else if (pending & GNRC_LORAWAN_MUX_PENDING_MCPS) {
+        mcps_confirm_t mcps_confirm;
+        slot->pending &= ~GNRC_LORAWAN_MUX_PENDING_MCPS;
+        gnrc_lorawan_mcps_request(mac, &slot->req.mcps, &mcps_confirm);
+        if (mcps_confirm.status != GNRC_LORAWAN_REQ_STATUS_DEFERRED) {
+            mcps_confirm.type = slot->req.mcps.type;
+            mcps_confirm.attempts = 0;
+            _update_owner(mux, mac);
+            gnrc_lorawan_deliver_mcps_confirm(mac, &mcps_confirm);
+        }
+    }
+    else if (pending & GNRC_LORAWAN_MUX_PENDING_MLME) {
+        mlme_confirm_t mlme_confirm;
+        slot->pending &= ~GNRC_LORAWAN_MUX_PENDING_MLME;
+        gnrc_lorawan_mlme_request(mac, &slot->req.mlme, &mlme_confirm);
+        if (mlme_confirm.status != GNRC_LORAWAN_REQ_STATUS_DEFERRED) {
+            mlme_confirm.type = MLME_JOIN;
+            _update_owner(mux, mac);
+            gnrc_lorawan_deliver_mlme_confirm(mac, &mlme_confirm);
+        }
+    }
+
+    _update_owner(mux, mac);
+}
+
+/* Dispatch queued operations in round robin order until one of them
+ * takes the radio */
+static void _dispatch(gnrc_lorawan_mux_t *mux)
+{
+    unsigned idle = 0;
+
+    while (_radio_free(mux) && idle < mux->numof) {
+        unsigned i = mux->next;
+        gnrc_lorawan_mux_slot_t *slot = &mux->slots[i];
+
+        mux->next = (i + 1) % mux->numof;
+        if (!slot->pending) {
+            idle++;
+            continue;
+        }
+
+        idle = 0;
+        DEBUG("gnrc_lorawan_mux: dispatch slot %u (0x%x)\n", i, slot->pending);
+        _run(mux, slot);
+    }
+}
+
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+static void _dispatch_cb(gnrc_lorawan_timer_t *timer)
+{
+    /* gnrc_lorawan_mux_timer_fired dispatches after the expiry */
+    (void) timer;
+}
+#endif
+
+/* Requests don't dispatch the operations of other MAC descriptors, so their
+ * confirms are only delivered from the MAC event functions. If a request
+ * freed the radio (e.g. a reset of the owner), a timer event of the next
+ * waiting MAC descriptor dispatches them instead. The state timer of that
+ * MAC is never moved for it */
+static void _dispatch_later(gnrc_lorawan_mux_t *mux)
+{
+    if (!_radio_free(mux)) {
+        return;
+    }
+
+    for (unsigned n = 0; n < mux->numof; n++) {
+        gnrc_lorawan_mux_slot_t *slot = &mux->slots[(mux->next + n) % mux->numof];
+
+        if (!slot->pending) {
+            continue;
+        }
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+        gnrc_lorawan_wheel_set(slot->mac, &slot->dispatch, 0);
+        return;
+#else
+        /* The hardware timer is only free if the MAC is idle or its timer
+         * already fired */
+        if (slot->mac->state == LORAWAN_STATE_IDLE ||
+            (slot->pending & GNRC_LORAWAN_MUX_PENDING_TIMER)) {
+            gnrc_lorawan_timer_set(slot->mac, 0);
+            return;
+        }
+#endif
+    }
+}
+
+void gnrc_lorawan_mux_init(gnrc_lorawan_mux_t *mux)
+{
+    memset(mux, 0, sizeof(gnrc_lorawan_mux_t));
+}
+
+int gnrc_lorawan_mux_add(gnrc_lorawan_mux_t *mux, gnrc_lorawan_t *mac)
+{
+    if (mux->numof == CONFIG_GNRC_LORAWAN_MUX_NUMOF) {
+        return -ENOMEM;
+    }
+
+    gnrc_lorawan_mux_slot_t *slot = &mux->slots[mux->numof++];
+    slot->mac = mac;
+    slot->pending = 0;
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+    gnrc_lorawan_wheel_timer_init(&slot->dispatch, _dispatch_cb, mux);
+#endif
+    _update_owner(mux, mac);
+    return 0;
+}
+
+void gnrc_lorawan_mux_mcps_request(gnrc_lorawan_mux_t *mux, gnrc_lorawan_t *mac,
+                                   const mcps_request_t *mcps_request,
+                                   mcps_confirm_t *mcps_confirm)
+{
+    gnrc_lorawan_mux_slot_t *slot = _get_slot(mux, mac);
+
+    assert(slot);
+    if (slot->pending & (GNRC_LORAWAN_MUX_PENDING_MCPS | GNRC_LORAWAN_MUX_PENDING_MLME)) {
+        mcps_confirm->status = -EBUSY;
+        return;
+    }
+
+    /* A busy MAC rejects the request without touching the radio */
+    if (_radio_free(mux) || mac->busy) {
+        gnrc_lorawan_mcps_request(mac, mcps_request, mcps_confirm);
+        _update_owner(mux, mac);
+        _dispatch_later(mux);
+        return;
+    }
+
+    DEBUG("gnrc_lorawan_mux: radio in use. Queue MCPS request\n");
+    slot->req.mcps = *mcps_request;
+    slot->pending |= GNRC_LORAWAN_MUX_PENDING_MCPS;
+    mcps_confirm->status = GNRC_LORAWAN_REQ_STATUS_DEFERRED;
+}
+
+void gnrc_lorawan_mux_mlme_request(gnrc_lorawan_mux_t *mux, gnrc_lorawan_t *mac,
+                                   const mlme_request_t *mlme_request,
+                                   mlme_confirm_t *mlme_confirm)
+{
+    gnrc_lorawan_mux_slot_t *slot = _get_slot(mux, mac);
+
+    assert(slot);
+    if (mlme_request->type == MLME_JOIN && !_radio_free(mux) && !mac->busy) {
+        if (slot->pending & (GNRC_LORAWAN_MUX_PENDING_MCPS | GNRC_LORAWAN_MUX_PENDING_MLME)) {
+            mlme_confirm->status = -EBUSY;
+            return;
+        }
+        DEBUG("gnrc_lorawan_mux: radio in use. Queue join request\n");
+        slot->req.mlme = *mlme_request;
+        slot->pending |= GNRC_LORAWAN_MUX_PENDING_MLME;
+        mlme_confirm->status = GNRC_LORAWAN_REQ_STATUS_DEFERRED;
+        return;
+    }
+
+    gnrc_lorawan_mlme_request(mac, mlme_request, mlme_confirm);
+    _update_owner(mux, mac);
+    _dispatch_later(mux);
+}
+
+void gnrc_lorawan_mux_event_tx_complete(gnrc_lorawan_mux_t *mux)
+{
+    gnrc_lorawan_t *mac = mux->owner;
+
+    if (!mac) {
+        DEBUG("gnrc_lorawan_mux: TX complete without owner\n");
+        return;
+    }
+    gnrc_lorawan_event_tx_complete(mac);
+    _update_owner(mux, mac);
+    _dispatch(mux);
+}
+
+void gnrc_lorawan_mux_event_timeout(gnrc_lorawan_mux_t *mux)
+{
+    gnrc_lorawan_t *mac = mux->owner;
+
+    if (!mac) {
+        DEBUG("gnrc_lorawan_mux: timeout without owner\n");
+        return;
+    }
+    gnrc_lorawan_event_timeout(mac);
+    _update_owner(mux, mac);
+    _dispatch(mux);
+}
+
+void gnrc_lorawan_mux_process_pkt(gnrc_lorawan_mux_t *mux, uint8_t *data, size_t size,
+                                  const gnrc_lorawan_rx_info_t *info)
+{
+    gnrc_lorawan_t *mac = mux->owner;
+
+    if (!mac) {
+        DEBUG("gnrc_lorawan_mux: packet without owner. Drop\n");
+        return;
+    }
+    gnrc_lorawan_process_pkt(mac, data, size, info);
+    _update_owner(mux, mac);
+    _dispatch(mux);
+}
+
+void gnrc_lorawan_mux_timer_fired(gnrc_lorawan_mux_t *mux, gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_mux_slot_t *slot = _get_slot(mux, mac);
+
+    assert(slot);
+    /* Outside of a transaction the timer only starts transmissions */
+    if (!gnrc_lorawan_radio_in_use(mac) && !_radio_free(mux)) {
+        DEBUG("gnrc_lorawan_mux: radio in use. Queue transmission\n");
+        slot->pending |= GNRC_LORAWAN_MUX_PENDING_TIMER;
+        return;
+    }
+
+    /* A queued timer event is delivered with this one */
+    slot->pending &= ~GNRC_LORAWAN_MUX_PENDING_TIMER;
+    gnrc_lorawan_timer_fired(mac);
+    _update_owner(mux, mac);
+    _dispatch(mux);
+}
+
+/** @} */
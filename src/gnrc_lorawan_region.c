@@ -14,8 +14,7 @@
  */
 #include "gnrc_lorawan_internal.h"
 #include "gnrc_lorawan/region.h"
-
-#define GNRC_LORAWAN_DATARATES_NUMOF 6
+#include "timex.h"
 
 static uint8_t dr_sf[GNRC_LORAWAN_DATARATES_NUMOF] = { LORA_SF12, LORA_SF11, LORA_SF10, LORA_SF9, LORA_SF8, LORA_SF7 };
 static uint8_t dr_bw[GNRC_LORAWAN_DATARATES_NUMOF] = { LORA_BW_125_KHZ, LORA_BW_125_KHZ, LORA_BW_125_KHZ, LORA_BW_125_KHZ, LORA_BW_125_KHZ, LORA_BW_125_KHZ };
@@ -32,69 +31,198 @@ int gnrc_lorawan_set_dr(gnrc_lorawan_t *mac, uint8_t datarate)
     return 0;
 }
 
+uint32_t gnrc_lorawan_region_symbol_time(uint8_t datarate)
+{
+    uint32_t bw_khz;
+
+    /* Invalid datarates are not set on the radio. Assume the slowest one */
+    if (!gnrc_lorawan_validate_dr(datarate)) {
+        datarate = 0;
+    }
+    switch (dr_bw[datarate]) {
+        case LORA_BW_250_KHZ:
+            bw_khz = 250;
+            break;
+        case LORA_BW_500_KHZ:
+            bw_khz = 500;
+            break;
+        default:
+            bw_khz = 125;
+            break;
+    }
+    return (US_PER_MS << dr_sf[datarate]) / bw_khz;
+}
+
 uint8_t gnrc_lorawan_rx1_get_dr_offset(uint8_t dr_up, uint8_t dr_offset)
 {
     return (dr_up > dr_offset) ? (dr_up - dr_offset) : 0;
 }
 
-static size_t _get_num_used_channels(gnrc_lorawan_t *mac)
+/**
+ * @brief EU868 sub-bands (ETSI EN 300 220)
+ */
+typedef struct {
+    uint32_t min;           /**< lowest frequency of the band */
+    uint32_t max;           /**< highest frequency of the band */
+    uint16_t duty_cycle;    /**< inverse of the duty cycle (100 => 1%) */
+} gnrc_lorawan_band_t;
+
+static const gnrc_lorawan_band_t _bands[GNRC_LORAWAN_BANDS_NUMOF] = {
+    { 863000000UL, 864999999UL, 1000 },
+    { 865000000UL, 868000000UL, 100 },
+    { 868000001UL, 868600000UL, 100 },
+    { 868700000UL, 869200000UL, 1000 },
+    { 869400000UL, 869650000UL, 10 },
+    { 869700000UL, 870000000UL, 100 },
+};
+
+/* Frequencies outside of the known bands are assumed to be in a 1% band */
+#define GNRC_LORAWAN_BAND_DEFAULT (1U)
+
+static uint8_t _get_band(uint32_t freq)
+{
+    for (unsigned i = 0; i < GNRC_LORAWAN_BANDS_NUMOF; i++) {
+        if (freq >= _bands[i].min && freq <= _bands[i].max) {
+            return i;
+        }
+    }
+    return GNRC_LORAWAN_BAND_DEFAULT;
+}
+
+uint8_t gnrc_lorawan_band_get(uint32_t freq, uint16_t *duty_cycle)
 {
-    size_t count = 0;
+    uint8_t band = _get_band(freq);
+
+    if (duty_cycle) {
+        *duty_cycle = _bands[band].duty_cycle;
+    }
+    return band;
+}
+
+#if CONFIG_GNRC_LORAWAN_DUTY_CYCLE
+static inline uint32_t _band_remaining(gnrc_lorawan_t *mac, uint8_t band,
+                                       uint32_t now)
+{
+    uint32_t elapsed = now - mac->band_last_tx[band];
+
+    return elapsed >= mac->band_off[band] ? 0 : mac->band_off[band] - elapsed;
+}
+
+void gnrc_lorawan_bands_init(gnrc_lorawan_t *mac)
+{
+    memset(mac->band_last_tx, 0, sizeof(mac->band_last_tx));
+    memset(mac->band_off, 0, sizeof(mac->band_off));
+}
+
+void gnrc_lorawan_band_register_tx(gnrc_lorawan_t *mac, uint32_t freq, uint32_t toa)
+{
+    uint8_t band = _get_band(freq);
+    uint64_t off = (uint64_t) toa * (_bands[band].duty_cycle - 1);
+
+    mac->band_last_tx[band] = gnrc_lorawan_timer_now(mac);
+    mac->band_off[band] = off > GNRC_LORAWAN_BAND_OFF_MAX ?
+                          GNRC_LORAWAN_BAND_OFF_MAX : off;
+}
+
+uint32_t gnrc_lorawan_band_wait(gnrc_lorawan_t *mac)
+{
+    uint32_t now = gnrc_lorawan_timer_now(mac);
+    uint32_t wait = UINT32_MAX;
 
     for (unsigned i = 0; i < GNRC_LORAWAN_MAX_CHANNELS; i++) {
-        if (mac->channel[i]) {
-            count++;
+        uint32_t freq = gnrc_lorawan_channel_get(mac, i);
+        if (freq) {
+            uint32_t remaining = _band_remaining(mac, _get_band(freq), now);
+            if (remaining < wait) {
+                wait = remaining;
+            }
         }
     }
-    return count;
+    return wait == UINT32_MAX ? 0 : wait;
 }
 
-static uint32_t _get_nth_channel(gnrc_lorawan_t *mac, size_t n)
+void gnrc_lorawan_bands_expire(gnrc_lorawan_t *mac)
 {
-    int i = 0;
-    uint32_t channel = 0;
+    uint32_t now = gnrc_lorawan_timer_now(mac);
 
-    while (n) {
-        if (mac->channel[i]) {
-            n--;
-            channel = mac->channel[i];
-            i++;
+    for (unsigned i = 0; i < GNRC_LORAWAN_BANDS_NUMOF; i++) {
+        if (!_band_remaining(mac, i, now)) {
+            mac->band_off[i] = 0;
         }
     }
-    return channel;
+}
+#endif
+
+static size_t _get_candidates(gnrc_lorawan_t *mac, uint8_t *candidates,
+                              int check_band, uint16_t exclude)
+{
+#if CONFIG_GNRC_LORAWAN_DUTY_CYCLE
+    uint32_t now = gnrc_lorawan_timer_now(mac);
+#else
+    (void) check_band;
+#endif
+    size_t count = 0;
+
+    for (unsigned i = 0; i < GNRC_LORAWAN_MAX_CHANNELS; i++) {
+        uint32_t freq = gnrc_lorawan_channel_get(mac, i);
+        if (!freq || (exclude & (1 << i))) {
+            continue;
+        }
+#if CONFIG_GNRC_LORAWAN_DUTY_CYCLE
+        if (check_band && _band_remaining(mac, _get_band(freq), now)) {
+            continue;
+        }
+#endif
+        candidates[count++] = i;
+    }
+    return count;
 }
 
 void gnrc_lorawan_channels_init(gnrc_lorawan_t *mac)
 {
     for(unsigned i = 0; i<GNRC_LORAWAN_DEFAULT_CHANNELS_NUMOF; i++) {
-        mac->channel[i] = gnrc_lorawan_default_channels[i];
+        gnrc_lorawan_channel_set(mac, i, gnrc_lorawan_default_channels[i]);
     }
 
-    for (unsigned i = GNRC_LORAWAN_DEFAULT_CHANNELS_NUMOF; i < GNRC_LORAWAN_MAX_CHANNELS; i++) {
-        mac->channel[i] = 0;
-    }
+    memset(mac->channel[GNRC_LORAWAN_DEFAULT_CHANNELS_NUMOF], 0,
+           (GNRC_LORAWAN_MAX_CHANNELS - GNRC_LORAWAN_DEFAULT_CHANNELS_NUMOF) *
+           GNRC_LORAWAN_CHANNEL_SIZE);
+
+    gnrc_lorawan_link_init(mac);
 }
 
-uint32_t gnrc_lorawan_pick_channel(gnrc_lorawan_t *mac)
+uint32_t gnrc_lorawan_pick_channel(gnrc_lorawan_t *mac, uint16_t exclude)
 {
-    uint32_t random_number = gnrc_lorawan_random_get(mac);
+    uint8_t candidates[GNRC_LORAWAN_MAX_CHANNELS];
+    size_t count;
+
+    /* Prefer a different channel with duty cycle budget, then any channel
+     * with budget and finally any enabled channel */
+    if (!(count = _get_candidates(mac, candidates, true,
+                                  exclude | (1 << mac->last_chan))) &&
+        !(count = _get_candidates(mac, candidates, true, exclude))) {
+        count = _get_candidates(mac, candidates, false, exclude);
+    }
 
-    return _get_nth_channel(mac, 1 + (random_number % _get_num_used_channels(mac)));
+    if (!count) {
+        return 0;
+    }
+
+    mac->last_chan = candidates[gnrc_lorawan_random_get(mac) % count];
+    return gnrc_lorawan_channel_get(mac, mac->last_chan);
 }
 
 void gnrc_lorawan_process_cflist(gnrc_lorawan_t *mac, uint8_t *cflist)
 {
     /* TODO: Check CFListType to 0 */
+    /* CFList entries have the same encoding as the channel array */
     for (unsigned i = GNRC_LORAWAN_DEFAULT_CHANNELS_NUMOF; i < 8; i++) {
-        le_uint32_t cl;
-        cl.u32 = 0;
-        memcpy(&cl, cflist, GNRC_LORAWAN_CFLIST_ENTRY_SIZE);
-        mac->channel[i] = byteorder_ntohl(byteorder_ltobl(cl))*100;
+        memcpy(mac->channel[i], cflist, GNRC_LORAWAN_CFLIST_ENTRY_SIZE);
         cflist += GNRC_LORAWAN_CFLIST_ENTRY_SIZE;
     }
 }
 
-uint8_t gnrc_lorawan_region_mac_payload_max(uint8_t datarate)
+static uint8_t _mac_payload_max(uint8_t datarate)
 {
     if (datarate < 3) {
         return GNRC_LORAWAN_MAX_PAYLOAD_1;
@@ -107,6 +235,86 @@ uint8_t gnrc_lorawan_region_mac_payload_max(uint8_t datarate)
     }
 }
 
+#if CONFIG_GNRC_LORAWAN_DWELL_TIME_MAX
+static int _within_dwell_time(size_t mac_payload_size, uint8_t datarate)
+{
+    /* The PHY payload adds the FPort and the MIC */
+    uint32_t toa = gnrc_lorawan_time_on_air(mac_payload_size + 1 + MIC_SIZE,
+                                            datarate, LORA_CR_4_5 + 4);
+
+    return toa <= CONFIG_GNRC_LORAWAN_DWELL_TIME_MAX * US_PER_MS;
+}
+#endif
+
+uint8_t gnrc_lorawan_region_mac_payload_max(uint8_t datarate)
+{
+    uint8_t max = _mac_payload_max(datarate);
+
+#if CONFIG_GNRC_LORAWAN_DWELL_TIME_MAX
+    /* Binary search of the longest payload within the dwell time. 0 if not
+     * even an empty frame fits */
+    if (!_within_dwell_time(max, datarate)) {
+        unsigned lo = 0;
+        unsigned hi = max;
+        while (lo < hi) {
+            unsigned mid = (lo + hi + 1) / 2;
+            if (_within_dwell_time(mid, datarate)) {
+                lo = mid;
+            }
+            else {
+                hi = mid - 1;
+            }
+        }
+        max = _within_dwell_time(lo, datarate) ? lo : 0;
+    }
+#endif
+
+    return max;
+}
+
+/* Demodulation floor of every datarate in 1/16 dB, from -20 dB (SF12) to
+ * -7.5 dB (SF7) */
+static const int16_t dr_snr_min[GNRC_LORAWAN_DATARATES_NUMOF] = {
+    -320, -280, -240, -200, -160, -120
+};
+
+uint8_t gnrc_lorawan_region_auto_dr(const gnrc_lorawan_t *mac, size_t size)
+{
+    int16_t snr = INT16_MAX;
+    int fit = -1;
+    int chosen = -1;
+
+#if CONFIG_GNRC_LORAWAN_LINK_QUALITY
+    for (unsigned i = 0; i <= GNRC_LORAWAN_LINK_RX2; i++) {
+        const gnrc_lorawan_link_t *link = gnrc_lorawan_link_get(mac, i);
+        if (link->count && link->snr < snr) {
+            snr = link->snr;
+        }
+    }
+#else
+    (void) mac;
+#endif
+
+    /* Faster datarates take less airtime but need a stronger link */
+    for (unsigned dr = 0; dr < GNRC_LORAWAN_DATARATES_NUMOF; dr++) {
+        if (size > gnrc_lorawan_region_mac_payload_max(dr)) {
+            continue;
+        }
+        if (fit < 0) {
+            fit = dr;
+        }
+        if (snr == INT16_MAX ||
+            snr >= dr_snr_min[dr] + CONFIG_GNRC_LORAWAN_AUTO_DR_MARGIN * 16) {
+            chosen = dr;
+        }
+    }
+
+    if (chosen >= 0) {
+        return chosen;
+    }
+    return fit >= 0 ? fit : (int) GNRC_LORAWAN_DATARATES_NUMOF - 1;
+}
+
 int gnrc_lorawan_validate_dr(uint8_t dr)
 {
     if (dr < GNRC_LORAWAN_DATARATES_NUMOF) {
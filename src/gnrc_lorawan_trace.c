@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <string.h>
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan_internal.h"
+
+#if CONFIG_GNRC_LORAWAN_TRACE
+size_t gnrc_lorawan_trace_drain(gnrc_lorawan_t *mac,
+                                gnrc_lorawan_trace_entry_t *entries, size_t max)
+{
+    gnrc_lorawan_trace_t *trace = &mac->trace;
+    uint16_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+    uint16_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    size_t count = 0;
+
+    while (tail != head && count < max) {
+        entries[count++] = trace->entries[tail & (CONFIG_GNRC_LORAWAN_TRACE_SIZE - 1)];
+        tail++;
+    }
+
+    atomic_store_explicit(&trace->tail, tail, memory_order_release);
+    return count;
+}
+#else
+size_t gnrc_lorawan_trace_drain(gnrc_lorawan_t *mac,
+                                gnrc_lorawan_trace_entry_t *entries, size_t max)
+{
+    (void) mac;
+    (void) entries;
+    (void) max;
+    return 0;
+}
+#endif
+
+/** @} */
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/wheel.h"
+#include "gnrc_lorawan_internal.h"
+#include "timex.h"
+
+#define ENABLE_DEBUG (0)
+#include "debug.h"
+
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+#define BITS            (CONFIG_GNRC_LORAWAN_TIMER_WHEEL_BITS)
+#define LEVELS          (CONFIG_GNRC_LORAWAN_TIMER_WHEEL_LEVELS)
+#define SLOT_MASK       (GNRC_LORAWAN_WHEEL_SLOTS - 1)
+#define OCCUPIED_MASK   ((uint32_t) ((1ULL << GNRC_LORAWAN_WHEEL_SLOTS) - 1))
+#define BACKOFF_PERIOD  (3600UL * MS_PER_SEC)
+
+_Static_assert(BITS >= 1 && BITS <= 5,
+               "CONFIG_GNRC_LORAWAN_TIMER_WHEEL_BITS must be between 1 and 5");
+_Static_assert(LEVELS * BITS < 32,
+               "the timer wheel must cover less than 2^32 ms");
+_Static_assert(GNRC_LORAWAN_WHEEL_DELAY_MAX >= BACKOFF_PERIOD,
+               "the timer wheel must cover the backoff period");
+
+static inline unsigned _digit(uint32_t t, unsigned level)
+{
+    return (t >> (level * BITS)) & SLOT_MASK;
+}
+
+/* Advances the clock by the whole milliseconds since the last update */
+static void _clock(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_wheel_t *w = &mac->wheel;
+    uint32_t ms = (gnrc_lorawan_timer_now(mac) - w->stamp) / US_PER_MS;
+
+    w->clock += ms;
+    w->stamp += ms * US_PER_MS;
+}
+
+/* The level is given by the delay and the slot by the expiry, so a slot of
+ * level n holds the timers of one 2^(n * BITS) ms block */
+static void _insert(gnrc_lorawan_wheel_t *w, gnrc_lorawan_timer_t *timer)
+{
+    uint32_t delta = timer->expiry - w->now;
+    unsigned level = 0;
+
+    while (level < LEVELS - 1 && (delta >> ((level + 1) * BITS))) {
+        level++;
+    }
+
+    gnrc_lorawan_timer_t **head = &w->slots[level][_digit(timer->expiry, level)];
+    timer->level = level;
+    timer->slot = _digit(timer->expiry, level);
+    timer->next = *head;
+    if (*head) {
+        (*head)->prev = &timer->next;
+    }
+    timer->prev = head;
+    *head = timer;
+    w->occupied[level] |= 1UL << timer->slot;
+}
+
+static void _unlink(gnrc_lorawan_wheel_t *w, gnrc_lorawan_timer_t *timer)
+{
+    *timer->prev = timer->next;
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    if (!w->slots[timer->level][timer->slot]) {
+        w->occupied[timer->level] &= ~(1UL << timer->slot);
+    }
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+/* First non empty slot of a level in time order, or -1. The current slot of
+ * level 0 holds the due timers, the one of the other levels the timers one
+ * rotation ahead */
+static int _first(const gnrc_lorawan_wheel_t *w, unsigned level)
+{
+    uint32_t occupied = w->occupied[level];
+
+    if (!occupied) {
+        return -1;
+    }
+
+    unsigned start = (_digit(w->now, level) + (level ? 1 : 0)) & SLOT_MASK;
+    uint32_t rotated = occupied >> start;
+    if (start) {
+        rotated |= occupied << (GNRC_LORAWAN_WHEEL_SLOTS - start);
+    }
+    return (start + __builtin_ctz(rotated & OCCUPIED_MASK)) & SLOT_MASK;
+}
+
+/* Returns false if no timer is armed */
+static bool _next(const gnrc_lorawan_wheel_t *w, uint32_t *deadline)
+{
+    bool found = false;
+
+    for (unsigned level = 0; level < LEVELS; level++) {
+        int slot = _first(w, level);
+        if (slot < 0) {
+            continue;
+        }
+        for (const gnrc_lorawan_timer_t *t = w->slots[level][slot]; t; t = t->next) {
+            if (!found || (int32_t)(t->expiry - *deadline) < 0) {
+                *deadline = t->expiry;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+/* Moves the slots to a new time, which must not be past the next deadline.
+ * The slots entered on every level are cascaded to the lower levels */
+static void _advance(gnrc_lorawan_wheel_t *w, uint32_t t)
+{
+    uint32_t old = w->now;
+
+    w->now = t;
+    for (unsigned level = LEVELS - 1; level > 0; level--) {
+        if ((t >> (level * BITS)) == (old >> (level * BITS))) {
+            continue;
+        }
+
+        unsigned slot = _digit(t, level);
+        gnrc_lorawan_timer_t *timer = w->slots[level][slot];
+        w->slots[level][slot] = NULL;
+        w->occupied[level] &= ~(1UL << slot);
+        while (timer) {
+            gnrc_lorawan_timer_t *next = timer->next;
+            _insert(w, timer);
+            timer = next;
+        }
+    }
+}
+
+/* Sets the timer hook to the next deadline */
+static void _program(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_wheel_t *w = &mac->wheel;
+    uint32_t deadline;
+
+    if (w->expiring) {
+        return;
+    }
+    if (!_next(w, &deadline)) {
+        if (w->is_armed) {
+            w->is_armed = false;
+            gnrc_lorawan_timer_stop(mac);
+        }
+        return;
+    }
+    if (w->is_armed && w->armed == deadline) {
+        return;
+    }
+
+    w->armed = deadline;
+    w->is_armed = true;
+    gnrc_lorawan_timer_set(mac, (int32_t)(deadline - w->clock) > 0 ?
+                           deadline - w->clock : 0);
+}
+
+static void _backoff_expire(gnrc_lorawan_timer_t *timer)
+{
+    gnrc_lorawan_t *mac = timer->arg;
+
+    /* Relative to the last expiry, so late wake ups don't add up */
+    timer->expiry += BACKOFF_PERIOD;
+    _insert(&mac->wheel, timer);
+    gnrc_lorawan_mlme_backoff_tick(mac);
+}
+
+void gnrc_lorawan_wheel_init(gnrc_lorawan_t *mac)
+{
+    memset(&mac->wheel, 0, sizeof(mac->wheel));
+    mac->wheel.stamp = gnrc_lorawan_timer_now(mac);
+    gnrc_lorawan_wheel_timer_init(&mac->backoff_timer, _backoff_expire, mac);
+    gnrc_lorawan_wheel_set(mac, &mac->backoff_timer, BACKOFF_PERIOD);
+}
+
+void gnrc_lorawan_wheel_set(gnrc_lorawan_t *mac, gnrc_lorawan_timer_t *timer,
+                            uint32_t ms)
+{
+    gnrc_lorawan_wheel_t *w = &mac->wheel;
+    uint32_t deadline;
+
+    assert(ms <= GNRC_LORAWAN_WHEEL_DELAY_MAX);
+    if (timer->prev) {
+        _unlink(w, timer);
+    }
+
+    /* Keep the slots close to the clock, so long delays fit into the wheel.
+     * Due timers that were not dispatched yet stop the slots. While they are
+     * dispatched, the slots stay at the current deadline */
+    _clock(mac);
+    if (!w->expiring) {
+        if (!_next(w, &deadline) || (int32_t)(deadline - w->clock) > 0) {
+            deadline = w->clock;
+        }
+        _advance(w, deadline);
+    }
+
+    timer->expiry = w->clock + ms;
+    _insert(w, timer);
+    _program(mac);
+}
+
+void gnrc_lorawan_wheel_cancel(gnrc_lorawan_t *mac, gnrc_lorawan_timer_t *timer)
+{
+    if (!timer->prev) {
+        return;
+    }
+    _unlink(&mac->wheel, timer);
+    _clock(mac);
+    _program(mac);
+}
+
+int gnrc_lorawan_wheel_next(gnrc_lorawan_t *mac, uint32_t *ms)
+{
+    gnrc_lorawan_wheel_t *w = &mac->wheel;
+    uint32_t deadline;
+
+    _clock(mac);
+    if (!_next(w, &deadline)) {
+        return -ENOENT;
+    }
+    *ms = (int32_t)(deadline - w->clock) > 0 ? deadline - w->clock : 0;
+    return 0;
+}
+
+void gnrc_lorawan_wheel_expire(gnrc_lorawan_t *mac)
+{
+    gnrc_lorawan_wheel_t *w = &mac->wheel;
+    uint32_t deadline;
+
+    _clock(mac);
+    w->is_armed = false;
+    w->expiring = true;
+
+    while (_next(w, &deadline) && (int32_t)(deadline - w->clock) <= 0) {
+        _advance(w, deadline);
+
+        /* All timers of the slot expire at the deadline */
+        gnrc_lorawan_timer_t **head = &w->slots[0][_digit(deadline, 0)];
+        while (*head) {
+            gnrc_lorawan_timer_t *timer = *head;
+            _unlink(w, timer);
+            DEBUG("gnrc_lorawan_wheel: timer %p expired\n", (void *) timer);
+            timer->cb(timer);
+        }
+    }
+    _advance(w, w->clock);
+
+    w->expiring = false;
+    _program(mac);
+}
+#else
+typedef int dont_be_pedantic;
+#endif /* CONFIG_GNRC_LORAWAN_TIMER_WHEEL */
+
+/** @} */
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2019 HAW Hamburg
+#
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Compare two bench_gnrc_lorawan outputs and report ns/op and size changes.
+
+Usage: compare.py <baseline.txt> <candidate.txt> [threshold_percent]
+"""
+
+import sys
+
+
+def parse(path):
+    results = {}
+    sizes = {}
+    with open(path) as f:
+        for line in f:
+            fields = line.strip().split(",")
+            if fields[0] == "size" and len(fields) == 3 and fields[1] != "name":
+                sizes[fields[1]] = int(fields[2])
+            if len(fields) != 7 or fields[0] != "bench" or fields[1] == "name":
+                continue
+            results[(fields[1], int(fields[2]))] = int(fields[4])
+    return results, sizes
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__)
+        return 1
+
+    base, base_sizes = parse(sys.argv[1])
+    cand, cand_sizes = parse(sys.argv[2])
+    threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 5.0
+    regressions = 0
+
+    print("struct,base_bytes,cand_bytes,delta_bytes")
+    for key in sorted(base_sizes.keys() & cand_sizes.keys()):
+        old, new = base_sizes[key], cand_sizes[key]
+        print("%s,%d,%d,%d" % (key, old, new, new - old))
+
+    print("name,size,base_ns,cand_ns,delta_percent")
+    for key in sorted(base.keys() & cand.keys()):
+        old, new = base[key], cand[key]
+        delta = ((new - old) * 100.0 / old) if old else 0.0
+        marker = ""
+        if delta > threshold:
+            marker = ",REGRESSION"
+            regressions += 1
+        print("%s,%d,%d,%d,%.1f%s" % (key[0], key[1], old, new, delta, marker))
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
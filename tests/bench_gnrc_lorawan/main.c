@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @brief   Microbenchmarks for the GNRC LoRaWAN MAC hot paths
+ *
+ * Every measured point is printed as a CSV line prefixed with "bench," so
+ * the output can be captured with `make term > bench_output.txt` and
+ * compared between commits with `compare.py`.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "xtimer.h"
+#include "random.h"
+#include "crypto/ciphers.h"
+#include "hashes/aes128_cmac.h"
+
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/frag.h"
+#include "gnrc_lorawan/region.h"
+#include "gnrc_lorawan_internal.h"
+#include "net/lorawan/hdr.h"
+
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS    (2000U)
+#endif
+
+#define BENCH_PHY_MAX       (255U)  /**< maximum PHY payload size */
+#define BENCH_PAYLOAD_MAX   (242U)  /**< maximum FRMPayload size */
+
+static const uint8_t _payload_sizes[] = {
+    1, 2, 4, 8, 11, 16, 17, 32, 33, 51, 64, 115, 128, 222, 242
+};
+
+static const uint8_t _nwkskey[LORAMAC_NWKSKEY_LEN] = {
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+    0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+static const uint8_t _appskey[LORAMAC_APPSKEY_LEN] = {
+    0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB,
+    0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B
+};
+
+static gnrc_lorawan_t _mac;
+static uint8_t _nwkskey_buf[LORAMAC_NWKSKEY_LEN];
+static uint8_t _appskey_buf[LORAMAC_APPSKEY_LEN];
+static uint8_t _tx_buf[BENCH_PHY_MAX];
+static uint8_t _payload[BENCH_PHY_MAX];
+static uint8_t _frame[BENCH_PHY_MAX];
+static uint8_t _work[BENCH_PHY_MAX];
+static const gnrc_lorawan_rx_info_t _rx_info = { .rssi = -90, .snr = 5 };
+
+static cipher_t _cipher;
+static aes128_cmac_context_t _cmac;
+
+/* Sink used to keep the compiler from optimizing the measured calls away */
+static volatile uint32_t _sink;
+
+static inline uint64_t _cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void _report(const char *name, unsigned size, uint64_t usecs,
+                    uint64_t cycles)
+{
+    uint64_t ns_per_op = (usecs * NS_PER_US) / BENCH_ITERATIONS;
+    uint64_t cycles_per_op = cycles / BENCH_ITERATIONS;
+    uint64_t bytes_per_sec = usecs ?
+        ((uint64_t)size * BENCH_ITERATIONS * US_PER_SEC) / usecs : 0;
+
+#if !(defined(__x86_64__) || defined(__i386__)) && defined(CLOCK_CORECLOCK)
+    cycles_per_op = (ns_per_op * (CLOCK_CORECLOCK / US_PER_SEC)) / NS_PER_US;
+#endif
+
+    printf("bench,%s,%u,%u,%lu,%lu,%lu\n", name, size,
+           (unsigned)BENCH_ITERATIONS, (unsigned long)ns_per_op,
+           (unsigned long)cycles_per_op, (unsigned long)bytes_per_sec);
+}
+
+/* Runs `op` BENCH_ITERATIONS times and accumulates wall time and cycles */
+#define BENCH_LOOP(usecs, cycles, op)                           \
+    do {                                                        \
+        uint64_t _t0 = xtimer_now_usec64();                     \
+        uint64_t _c0 = _cycles();                               \
+        for (unsigned _i = 0; _i < BENCH_ITERATIONS; _i++) {    \
+            op;                                                 \
+        }                                                       \
+        cycles = _cycles() - _c0;                               \
+        usecs = xtimer_now_usec64() - _t0;                      \
+    } while (0)
+
+#define BENCH_RUN(name, size, op)                               \
+    do {                                                        \
+        uint64_t _usecs, _cyc;                                  \
+        BENCH_LOOP(_usecs, _cyc, op);                           \
+        _report(name, size, _usecs, _cyc);                      \
+    } while (0)
+
+static size_t _build_downlink(uint8_t *out, size_t len, uint32_t fcnt)
+{
+    lorawan_hdr_t *hdr = (lorawan_hdr_t *) out;
+    size_t index = sizeof(lorawan_hdr_t);
+
+    hdr->mt_maj = 0;
+    lorawan_hdr_set_mtype(hdr, MTYPE_UNCNF_DOWNLINK);
+    lorawan_hdr_set_maj(hdr, MAJOR_LRWAN_R1);
+    hdr->addr = _mac.dev_addr;
+    hdr->fctrl = 0;
+    hdr->fcnt = byteorder_btols(byteorder_htons(fcnt));
+
+    out[index++] = LORAMAC_PORT_MIN;
+    memcpy(out + index, _payload, len);
+    gnrc_lorawan_encrypt_payload(&_mac, out + index, len, &_mac.dev_addr, fcnt,
+                                 GNRC_LORAWAN_DIR_DOWNLINK, _appskey);
+    index += len;
+    gnrc_lorawan_calculate_mic(&_mac, &_mac.dev_addr, fcnt,
+                               GNRC_LORAWAN_DIR_DOWNLINK, out, index,
+                               _nwkskey, (le_uint32_t *) (out + index));
+    return index + MIC_SIZE;
+}
+
+static void _bench_crypto(unsigned size)
+{
+    le_uint32_t mic;
+
+    BENCH_RUN("encrypt_payload", size,
+              gnrc_lorawan_encrypt_payload(&_mac, _work, size, &_mac.dev_addr,
+                                           _mac.mcps.fcnt,
+                                           GNRC_LORAWAN_DIR_UPLINK, _appskey));
+
+    BENCH_RUN("calculate_mic", size,
+              gnrc_lorawan_calculate_mic(&_mac, &_mac.dev_addr, _mac.mcps.fcnt,
+                                         GNRC_LORAWAN_DIR_UPLINK, _work, size,
+                                         _nwkskey, &mic));
+    _sink = mic.u32;
+}
+
+static void _bench_uplink(unsigned size)
+{
+    iolist_t io = {
+        .iol_base = _payload,
+        .iol_len = size,
+        .iol_next = NULL
+    };
+    size_t len = 0;
+
+    BENCH_RUN("build_uplink", size,
+              len = gnrc_lorawan_build_uplink(&_mac, &io, false,
+                                              LORAMAC_PORT_MIN, _tx_buf));
+    _sink = len;
+}
+
+static void _bench_downlink(unsigned size)
+{
+    size_t len = _build_downlink(_frame, size, 1);
+    uint64_t setup_usecs, setup_cycles, usecs, cycles;
+
+    /* The downlink is decrypted in place, so the frame is restored and the
+     * frame counter rewound before every iteration. The cost of doing so is
+     * measured separately and subtracted */
+    BENCH_LOOP(setup_usecs, setup_cycles,
+               (memcpy(_work, _frame, len), _mac.mcps.fcnt_down = 0));
+    BENCH_LOOP(usecs, cycles,
+               (memcpy(_work, _frame, len), _mac.mcps.fcnt_down = 0,
+                gnrc_lorawan_mcps_process_downlink(&_mac, _work, len, &_rx_info)));
+
+    usecs = usecs > setup_usecs ? usecs - setup_usecs : 0;
+    cycles = cycles > setup_cycles ? cycles - setup_cycles : 0;
+    _report("process_downlink", size, usecs, cycles);
+}
+
+static void _bench_join_accept(void)
+{
+    uint8_t out[GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE - 1];
+
+    BENCH_RUN("decrypt_join_accept", LORAMAC_APPKEY_LEN,
+              gnrc_lorawan_decrypt_join_accept(&_mac, _appskey, _work, false,
+                                               out));
+    BENCH_RUN("decrypt_join_accept", 2 * LORAMAC_APPKEY_LEN,
+              gnrc_lorawan_decrypt_join_accept(&_mac, _appskey, _work, true,
+                                               out));
+    _sink = out[0];
+}
+
+static void _bench_toa(unsigned size)
+{
+    uint32_t toa = 0;
+
+    for (uint8_t dr = LORAMAC_DR_0; dr <= LORAMAC_DR_5; dr++) {
+        char name[sizeof("time_on_air_dr0")];
+        snprintf(name, sizeof(name), "time_on_air_dr%u", dr);
+        BENCH_RUN(name, size,
+                  toa += gnrc_lorawan_time_on_air(size, dr, LORA_CR_4_5 + 4));
+    }
+    _sink = toa;
+}
+
+static void _bench_pick_channel(void)
+{
+    uint32_t chan = 0;
+
+    BENCH_RUN("pick_channel", 0,
+              chan = gnrc_lorawan_pick_channel(&_mac, 0));
+    _sink = chan;
+}
+
+int main(void)
+{
+    uint8_t dev_addr[LORAMAC_DEVADDR_LEN] = { 0x01, 0x02, 0x03, 0x04 };
+    mlme_request_t mlme_request;
+    mlme_confirm_t mlme_confirm;
+
+    gnrc_lorawan_init(&_mac, _nwkskey_buf, _appskey_buf, _tx_buf);
+    memcpy(_nwkskey_buf, _nwkskey, sizeof(_nwkskey));
+    memcpy(_appskey_buf, _appskey, sizeof(_appskey));
+
+    mlme_request.type = MLME_SET;
+    mlme_request.mib.type = MIB_DEV_ADDR;
+    mlme_request.mib.dev_addr = dev_addr;
+    gnrc_lorawan_mlme_request(&_mac, &mlme_request, &mlme_confirm);
+
+    mlme_request.mib.type = MIB_ACTIVATION_METHOD;
+    mlme_request.mib.activation = MLME_ACTIVATION_ABP;
+    gnrc_lorawan_mlme_request(&_mac, &mlme_request, &mlme_confirm);
+
+    random_bytes(_payload, sizeof(_payload));
+    memcpy(_work, _payload, sizeof(_work));
+
+    puts("size,name,bytes");
+    printf("size,gnrc_lorawan_t,%u\n", (unsigned) sizeof(gnrc_lorawan_t));
+    printf("size,gnrc_lorawan_mcps_t,%u\n", (unsigned) sizeof(gnrc_lorawan_mcps_t));
+    printf("size,gnrc_lorawan_mlme_t,%u\n", (unsigned) sizeof(gnrc_lorawan_mlme_t));
+
+    puts("bench,name,size,iterations,ns_per_op,cycles_per_op,bytes_per_sec");
+
+    for (unsigned i = 0; i < ARRAY_SIZE(_payload_sizes); i++) {
+        unsigned size = _payload_sizes[i];
+        _bench_crypto(size);
+        _bench_uplink(size);
+        _bench_downlink(size);
+        _bench_toa(size);
+    }
+
+    _bench_join_accept();
+    _bench_pick_channel();
+
+    puts("bench,done");
+    return 0;
+}
+
+/* MAC hooks on top of the defaults of test_gnrc_lorawan.h. Crypto uses
+ * RIOT's software AES */
+uint32_t gnrc_lorawan_timer_now(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+    return (uint32_t) xtimer_now_usec64();
+}
+
+uint32_t gnrc_lorawan_random_get(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+    return random_uint32();
+}
+
+void gnrc_lorawan_mcps_indication(gnrc_lorawan_t *mac, mcps_indication_t *ind)
+{
+    (void) mac;
+    _sink = ind->data.port;
+}
+
+void gnrc_lorawan_radio_send(gnrc_lorawan_t *mac, iolist_t *io)
+{
+    (void) mac;
+    _sink = io->iol_len;
+}
+
+void gnrc_lorawan_cmac_init(gnrc_lorawan_t *mac, const void *key)
+{
+    (void) mac;
+    aes128_cmac_init(&_cmac, key, LORAMAC_APPKEY_LEN);
+}
+
+void gnrc_lorawan_cmac_update(gnrc_lorawan_t *mac, const void *buf, size_t len)
+{
+    (void) mac;
+    aes128_cmac_update(&_cmac, buf, len);
+}
+
+void gnrc_lorawan_cmac_finish(gnrc_lorawan_t *mac, void *out)
+{
+    (void) mac;
+    aes128_cmac_final(&_cmac, out);
+}
+
+void gnrc_lorawan_aes128_init(gnrc_lorawan_t *mac, const void *key)
+{
+    (void) mac;
+    cipher_init(&_cipher, CIPHER_AES_128, key, LORAMAC_APPKEY_LEN);
+}
+
+void gnrc_lorawan_aes128_encrypt(gnrc_lorawan_t *mac, const void *in, void *out)
+{
+    (void) mac;
+    cipher_encrypt(&_cipher, in, out);
+}
+
+#if CONFIG_GNRC_LORAWAN_AES128_BLOCKS
+void gnrc_lorawan_aes128_encrypt_blocks(gnrc_lorawan_t *mac, const void *in, void *out,
+                                        size_t numof)
+{
+    (void) mac;
+    for (size_t i = 0; i < numof; i++) {
+        cipher_encrypt(&_cipher, (const uint8_t *) in + 16 * i, (uint8_t *) out + 16 * i);
+    }
+}
+#endif
+
+/** @} */
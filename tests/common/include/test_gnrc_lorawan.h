@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @brief   Shared helpers of the GNRC LoRaWAN test applications
+ *
+ * Provides weak default implementations of all MAC hooks, so a test
+ * application only implements the hooks it is interested in. The defaults
+ * record what the MAC did in @ref test_gnrc_lorawan_hooks: the radio is a
+ * sink, the clock is @ref test_gnrc_lorawan_hooks_t::now and the crypto
+ * hooks are placeholders (AES is the identity, CMAC is all zeros), so frames
+ * are not valid on air.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#ifndef TEST_GNRC_LORAWAN_H
+#define TEST_GNRC_LORAWAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gnrc_lorawan/lorawan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What the MAC did through the default hooks
+ */
+typedef struct {
+    uint32_t now;           /**< value of gnrc_lorawan_timer_now in us */
+    uint32_t timer_ms;      /**< delay of the last gnrc_lorawan_timer_set */
+    bool timer_armed;       /**< the timer is armed */
+    unsigned sends;         /**< frames sent */
+    size_t sent_len;        /**< size of the last frame */
+    unsigned mcps_confirms; /**< MCPS confirms */
+    int mcps_status;        /**< status of the last MCPS confirm */
+    unsigned mlme_confirms; /**< MLME confirms */
+    int mlme_status;        /**< status of the last MLME confirm */
+} test_gnrc_lorawan_hooks_t;
+
+extern test_gnrc_lorawan_hooks_t test_gnrc_lorawan_hooks;   /**< hook records */
+extern unsigned test_gnrc_lorawan_failures;                 /**< failed checks */
+
+/**
+ * @brief Check a condition and report it if it doesn't hold. The test goes
+ *        on either way
+ */
+#define TEST_CHECK(cond)                                                \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("[FAILED] %s:%d: %s\n", __func__, __LINE__, #cond);  \
+            test_gnrc_lorawan_failures++;                               \
+        }                                                               \
+    } while (0)
+
+/**
+ * @brief Print the result of the test application
+ *
+ * @return 0 if all checks passed
+ * @return 1 otherwise
+ */
+int test_gnrc_lorawan_result(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_GNRC_LORAWAN_H */
+/** @} */
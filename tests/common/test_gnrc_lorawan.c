@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <string.h>
+
+#include "net/loramac.h"
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/cq.h"
+#include "gnrc_lorawan/frag.h"
+#include "test_gnrc_lorawan.h"
+
+#define WEAK __attribute__((weak))
+
+test_gnrc_lorawan_hooks_t test_gnrc_lorawan_hooks;
+unsigned test_gnrc_lorawan_failures;
+
+int test_gnrc_lorawan_result(void)
+{
+    if (test_gnrc_lorawan_failures) {
+        printf("[FAILED] %u checks\n", test_gnrc_lorawan_failures);
+        return 1;
+    }
+    puts("[SUCCESS]");
+    return 0;
+}
+
+WEAK void gnrc_lorawan_timer_set(gnrc_lorawan_t *mac, uint32_t ms)
+{
+    (void) mac;
+    test_gnrc_lorawan_hooks.timer_armed = true;
+    test_gnrc_lorawan_hooks.timer_ms = ms;
+}
+
+WEAK void gnrc_lorawan_timer_stop(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+    test_gnrc_lorawan_hooks.timer_armed = false;
+}
+
+WEAK void gnrc_lorawan_timer_usleep(gnrc_lorawan_t *mac, uint32_t us)
+{
+    (void) mac;
+    test_gnrc_lorawan_hooks.now += us;
+}
+
+WEAK uint32_t gnrc_lorawan_timer_now(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+    return test_gnrc_lorawan_hooks.now;
+}
+
+WEAK uint32_t gnrc_lorawan_random_get(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+    return 0;
+}
+
+WEAK void gnrc_lorawan_mcps_indication(gnrc_lorawan_t *mac, mcps_indication_t *ind)
+{
+    (void) mac;
+    (void) ind;
+}
+
+WEAK void gnrc_lorawan_mlme_indication(gnrc_lorawan_t *mac, mlme_indication_t *ind)
+{
+    (void) mac;
+    (void) ind;
+}
+
+WEAK void gnrc_lorawan_mcps_confirm(gnrc_lorawan_t *mac, mcps_confirm_t *confirm)
+{
+    (void) mac;
+    test_gnrc_lorawan_hooks.mcps_confirms++;
+    test_gnrc_lorawan_hooks.mcps_status = confirm->status;
+}
+
+WEAK void gnrc_lorawan_mlme_confirm(gnrc_lorawan_t *mac, mlme_confirm_t *confirm)
+{
+    (void) mac;
+    test_gnrc_lorawan_hooks.mlme_confirms++;
+    test_gnrc_lorawan_hooks.mlme_status = confirm->status;
+}
+
+WEAK void gnrc_lorawan_radio_sleep(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+}
+
+WEAK void gnrc_lorawan_radio_set_cr(gnrc_lorawan_t *mac, uint8_t cr)
+{
+    (void) mac;
+    (void) cr;
+}
+
+WEAK void gnrc_lorawan_radio_set_syncword(gnrc_lorawan_t *mac, uint8_t syncword)
+{
+    (void) mac;
+    (void) syncword;
+}
+
+WEAK void gnrc_lorawan_radio_set_frequency(gnrc_lorawan_t *mac, uint32_t channel)
+{
+    (void) mac;
+    (void) channel;
+}
+
+WEAK void gnrc_lorawan_radio_set_iq_invert(gnrc_lorawan_t *mac, int invert)
+{
+    (void) mac;
+    (void) invert;
+}
+
+WEAK void gnrc_lorawan_radio_set_rx_symbol_timeout(gnrc_lorawan_t *mac, uint16_t timeout)
+{
+    (void) mac;
+    (void) timeout;
+}
+
+WEAK void gnrc_lorawan_radio_rx_on(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+}
+
+WEAK void gnrc_lorawan_radio_set_sf(gnrc_lorawan_t *mac, uint8_t sf)
+{
+    (void) mac;
+    (void) sf;
+}
+
+WEAK void gnrc_lorawan_radio_set_bw(gnrc_lorawan_t *mac, uint8_t bw)
+{
+    (void) mac;
+    (void) bw;
+}
+
+WEAK void gnrc_lorawan_radio_send(gnrc_lorawan_t *mac, iolist_t *io)
+{
+    (void) mac;
+    test_gnrc_lorawan_hooks.sends++;
+    test_gnrc_lorawan_hooks.sent_len = iolist_size(io);
+}
+
+WEAK int gnrc_lorawan_radio_cca(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+    return true;
+}
+
+WEAK void gnrc_lorawan_cmac_init(gnrc_lorawan_t *mac, const void *key)
+{
+    (void) mac;
+    (void) key;
+}
+
+WEAK void gnrc_lorawan_cmac_update(gnrc_lorawan_t *mac, const void *buf, size_t len)
+{
+    (void) mac;
+    (void) buf;
+    (void) len;
+}
+
+WEAK void gnrc_lorawan_cmac_finish(gnrc_lorawan_t *mac, void *out)
+{
+    (void) mac;
+    memset(out, 0, LORAMAC_APPKEY_LEN);
+}
+
+WEAK void gnrc_lorawan_aes128_init(gnrc_lorawan_t *mac, const void *key)
+{
+    (void) mac;
+    (void) key;
+}
+
+WEAK void gnrc_lorawan_aes128_encrypt(gnrc_lorawan_t *mac, const void *in, void *out)
+{
+    (void) mac;
+    memcpy(out, in, LORAMAC_APPKEY_LEN);
+}
+
+#if CONFIG_GNRC_LORAWAN_AES128_BLOCKS
+WEAK void gnrc_lorawan_aes128_encrypt_blocks(gnrc_lorawan_t *mac, const void *in, void *out,
+                                             size_t numof)
+{
+    for (size_t i = 0; i < numof; i++) {
+        gnrc_lorawan_aes128_encrypt(mac, (const uint8_t *) in + 16 * i,
+                                    (uint8_t *) out + 16 * i);
+    }
+}
+#endif
+
+#if CONFIG_GNRC_LORAWAN_CQ
+WEAK void gnrc_lorawan_cq_notify(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+}
+#endif
+
+#if CONFIG_GNRC_LORAWAN_FRAG
+WEAK int gnrc_lorawan_frag_write(gnrc_lorawan_t *mac, uint32_t offset,
+                                 const uint8_t *buf, size_t len)
+{
+    (void) mac;
+    (void) offset;
+    (void) buf;
+    (void) len;
+    return 0;
+}
+
+WEAK int gnrc_lorawan_frag_read(gnrc_lorawan_t *mac, uint32_t offset,
+                                uint8_t *buf, size_t len)
+{
+    (void) mac;
+    (void) offset;
+    memset(buf, 0, len);
+    return 0;
+}
+
+WEAK void gnrc_lorawan_frag_done(gnrc_lorawan_t *mac, uint32_t size,
+                                 uint32_t descriptor)
+{
+    (void) mac;
+    (void) size;
+    (void) descriptor;
+}
+#endif
+
+/** @} */
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @brief   Tests for the GNRC LoRaWAN Fragmented Data Block Transport
+ *
+ * A data block is sent to the fragmentation layer as uncoded fragments
+ * followed by coded fragments of the TS004 parity check matrix. Uncoded
+ * fragments are dropped on the way and the block must still be complete in
+ * storage once enough coded fragments arrived.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/frag.h"
+#include "gnrc_lorawan_internal.h"
+#include "test_gnrc_lorawan.h"
+
+#define TEST_NB_FRAG        (64U)   /**< uncoded fragments of the data block */
+#define TEST_FRAG_SIZE      (16U)   /**< size of a fragment */
+#define TEST_PADDING        (5U)    /**< padding of the last fragment */
+#define TEST_DESCRIPTOR     (0x12345678UL)
+
+#define TEST_CID_SESSION_STATUS (0x01)
+#define TEST_CID_SESSION_SETUP  (0x02)
+#define TEST_CID_DATA_FRAGMENT  (0x08)
+
+#define TEST_STATUS_SIZE        (5U)    /**< size of FragSessionStatusAns */
+#define TEST_NOT_ENOUGH_MEMORY  (1 << 0)
+
+/* Uncoded fragments lost by a test */
+#define LOSS_LIMIT          (CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY)
+#define LOSS_BEYOND_LIMIT   (TEST_NB_FRAG / 2)
+
+_Static_assert(3 * LOSS_LIMIT <= TEST_NB_FRAG,
+               "the test needs more fragments for this redundancy");
+
+static gnrc_lorawan_t _mac;
+static uint8_t _nwkskey[LORAMAC_NWKSKEY_LEN];
+static uint8_t _appskey[LORAMAC_APPSKEY_LEN];
+static uint8_t _tx_buf[GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE];
+
+static uint8_t _block[TEST_NB_FRAG * TEST_FRAG_SIZE];
+static uint8_t _storage[TEST_NB_FRAG * TEST_FRAG_SIZE];
+static unsigned _done;
+static unsigned _rows_max;      /* most coded fragments pending at once */
+static uint32_t _done_size;
+static uint32_t _done_descriptor;
+
+/* Row `n` (starting at 1) of the parity check matrix of TS004 */
+static int32_t _prbs23(int32_t x)
+{
+    int32_t b0 = x & 0x01;
+    int32_t b1 = (x & 0x20) >> 5;
+
+    return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+static void _coded_fragment(int32_t n, int32_t m, uint8_t *out)
+{
+    uint8_t row[(TEST_NB_FRAG + 7) / 8] = { 0 };
+    int32_t mm = m + (((m & (m - 1)) == 0) ? 1 : 0);
+    int32_t x = 1 + (1001 * n);
+
+    for (int32_t nb_coeff = 0; nb_coeff < (m >> 1); nb_coeff++) {
+        int32_t r = 1 << 16;
+        while (r >= m) {
+            x = _prbs23(x);
+            r = x % mm;
+        }
+        row[r >> 3] |= 1 << (r & 7);
+    }
+
+    memset(out, 0, TEST_FRAG_SIZE);
+    for (int32_t i = 0; i < m; i++) {
+        if (row[i >> 3] & (1 << (i & 7))) {
+            for (unsigned b = 0; b < TEST_FRAG_SIZE; b++) {
+                out[b] ^= _block[i * TEST_FRAG_SIZE + b];
+            }
+        }
+    }
+}
+
+static void _session_setup(uint8_t seed)
+{
+    uint8_t buf[] = {
+        TEST_CID_SESSION_SETUP, 0, TEST_NB_FRAG & 0xFF, TEST_NB_FRAG >> 8,
+        TEST_FRAG_SIZE, 0, TEST_PADDING,
+        TEST_DESCRIPTOR & 0xFF, (TEST_DESCRIPTOR >> 8) & 0xFF,
+        (TEST_DESCRIPTOR >> 16) & 0xFF, TEST_DESCRIPTOR >> 24
+    };
+    uint8_t ans[GNRC_LORAWAN_FRAG_ANS_MAX];
+
+    for (unsigned i = 0; i < sizeof(_block); i++) {
+        _block[i] = (i * 7 + seed) & 0xFF;
+    }
+    memset(_storage, 0, sizeof(_storage));
+    _done = 0;
+
+    gnrc_lorawan_frag_process(&_mac, buf, sizeof(buf));
+    TEST_CHECK(gnrc_lorawan_frag_get_answer(&_mac, ans, sizeof(ans)) == 2);
+    TEST_CHECK(ans[0] == TEST_CID_SESSION_SETUP && ans[1] == 0);
+}
+
+/* Sends fragment `n`. Fragments after TEST_NB_FRAG are coded */
+static void _send(uint16_t n)
+{
+    uint8_t buf[3 + TEST_FRAG_SIZE] = {
+        TEST_CID_DATA_FRAGMENT, n & 0xFF, (n >> 8) & 0x3F
+    };
+
+    if (n <= TEST_NB_FRAG) {
+        memcpy(buf + 3, &_block[(n - 1) * TEST_FRAG_SIZE], TEST_FRAG_SIZE);
+    }
+    else {
+        _coded_fragment(n - TEST_NB_FRAG, TEST_NB_FRAG, buf + 3);
+    }
+    gnrc_lorawan_frag_process(&_mac, buf, sizeof(buf));
+}
+
+/* Sends the uncoded fragments but the `lost` ones spread over the block,
+ * then coded fragments until the block is done. Returns the number of coded
+ * fragments */
+static unsigned _transfer(unsigned lost, unsigned max_coded)
+{
+    unsigned stride = lost ? TEST_NB_FRAG / lost : 0;
+    unsigned coded = 0;
+
+    _rows_max = 0;
+    for (unsigned n = 1; n <= TEST_NB_FRAG; n++) {
+        if (!lost || (n - 1) % stride != 0 || (n - 1) / stride >= lost) {
+            _send(n);
+        }
+    }
+    TEST_CHECK(_done == !lost);
+
+    while (!_done && coded < max_coded) {
+        _send(TEST_NB_FRAG + ++coded);
+        if (_mac.frag.num_rows > _rows_max) {
+            _rows_max = _mac.frag.num_rows;
+        }
+    }
+    return coded;
+}
+
+/* Returns the status byte of FragSessionStatusAns and checks the rest */
+static uint8_t _session_status(unsigned received, unsigned missing)
+{
+    uint8_t buf[] = { TEST_CID_SESSION_STATUS, 1 };
+    uint8_t ans[GNRC_LORAWAN_FRAG_ANS_MAX];
+
+    gnrc_lorawan_frag_process(&_mac, buf, sizeof(buf));
+    TEST_CHECK(gnrc_lorawan_frag_get_answer(&_mac, ans, sizeof(ans)) == TEST_STATUS_SIZE);
+    TEST_CHECK(ans[0] == TEST_CID_SESSION_STATUS);
+    TEST_CHECK((unsigned) (ans[1] | (ans[2] << 8)) == received);
+    TEST_CHECK(ans[3] == missing);
+    return ans[4];
+}
+
+static void _check_block(void)
+{
+    TEST_CHECK(_done == 1);
+    TEST_CHECK(_done_size == sizeof(_block) - TEST_PADDING);
+    TEST_CHECK(_done_descriptor == TEST_DESCRIPTOR);
+    TEST_CHECK(memcmp(_storage, _block, sizeof(_block)) == 0);
+}
+
+static void _test_no_loss(void)
+{
+    _session_setup(1);
+    TEST_CHECK(_transfer(0, TEST_NB_FRAG) == 0);
+    _check_block();
+    TEST_CHECK(_session_status(TEST_NB_FRAG, 0) == 0);
+    puts("frag,no_loss,done");
+}
+
+/* With as many missing fragments as there are rows, a row is always free
+ * for the next coded fragment */
+static void _test_loss_limit(void)
+{
+    _session_setup(2);
+    unsigned coded = _transfer(LOSS_LIMIT, 2 * TEST_NB_FRAG);
+
+    _check_block();
+    TEST_CHECK(coded >= LOSS_LIMIT);
+    TEST_CHECK(_rows_max < CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY);
+    TEST_CHECK(_session_status(TEST_NB_FRAG - LOSS_LIMIT + coded, 0) == 0);
+
+    /* Fragments after the end of the session are ignored */
+    _send(TEST_NB_FRAG + coded + 1);
+    TEST_CHECK(_done == 1);
+    printf("frag,loss_limit,done,%u,%u\n", LOSS_LIMIT, coded);
+}
+
+/* Coded fragments are dropped once all rows are in use */
+static void _test_beyond_limit(void)
+{
+    _session_setup(3);
+    unsigned coded = _transfer(LOSS_BEYOND_LIMIT, TEST_NB_FRAG);
+    unsigned received = TEST_NB_FRAG - LOSS_BEYOND_LIMIT + coded;
+
+    TEST_CHECK(_done == 0);
+    TEST_CHECK(_rows_max == CONFIG_GNRC_LORAWAN_FRAG_MAX_REDUNDANCY);
+    TEST_CHECK(_session_status(received, _mac.frag.nb_frag - _mac.frag.nb_known) &
+           TEST_NOT_ENOUGH_MEMORY);
+    printf("frag,beyond_limit,done,%u,%u\n", LOSS_BEYOND_LIMIT, coded);
+}
+
+int main(void)
+{
+    gnrc_lorawan_init(&_mac, _nwkskey, _appskey, _tx_buf);
+
+    _test_no_loss();
+    _test_loss_limit();
+    _test_beyond_limit();
+
+    return test_gnrc_lorawan_result();
+}
+
+int gnrc_lorawan_frag_write(gnrc_lorawan_t *mac, uint32_t offset,
+                            const uint8_t *buf, size_t len)
+{
+    (void) mac;
+    if (offset + len > sizeof(_storage)) {
+        return -EINVAL;
+    }
+    memcpy(_storage + offset, buf, len);
+    return 0;
+}
+
+int gnrc_lorawan_frag_read(gnrc_lorawan_t *mac, uint32_t offset,
+                           uint8_t *buf, size_t len)
+{
+    (void) mac;
+    if (offset + len > sizeof(_storage)) {
+        return -EINVAL;
+    }
+    memcpy(buf, _storage + offset, len);
+    return 0;
+}
+
+void gnrc_lorawan_frag_done(gnrc_lorawan_t *mac, uint32_t size,
+                            uint32_t descriptor)
+{
+    (void) mac;
+    _done++;
+    _done_size = size;
+    _done_descriptor = descriptor;
+}
+
+/** @} */
@@ -0,0 +1,404 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @brief   Tests for the GNRC LoRaWAN MAC state machine
+ *
+ * The MAC runs on the default hooks (test_gnrc_lorawan.h). The test fires
+ * the timer of the MAC by hand, so it checks what the MAC sends and which
+ * state it is in after every step.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "timex.h"
+
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/wheel.h"
+#include "gnrc_lorawan_internal.h"
+#include "test_gnrc_lorawan.h"
+
+#define TEST_JOIN_JITTER_MS     (1000U)         /**< random delay of a Join Request */
+#define TEST_CFLIST_FREQ        (867100000UL)   /**< first frequency of the CFList */
+#define TEST_CFLIST_FIRST       (3U)            /**< first channel of the CFList */
+#define TEST_CFLIST_CHANNELS    (5U)            /**< channels of the CFList */
+
+static gnrc_lorawan_t _mac;
+static uint8_t _nwkskey[LORAMAC_NWKSKEY_LEN];
+static uint8_t _appskey[LORAMAC_APPSKEY_LEN];
+static uint8_t _tx_buf[GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE];
+static uint8_t _deveui[LORAMAC_DEVEUI_LEN] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+static uint8_t _appeui[LORAMAC_APPEUI_LEN];
+static uint8_t _appkey[LORAMAC_APPKEY_LEN];
+static test_gnrc_lorawan_hooks_t *_hooks = &test_gnrc_lorawan_hooks;
+static uint16_t _fcnt_down;
+static uint16_t _symbol_timeout;
+#if CONFIG_GNRC_LORAWAN_LBT
+static bool _cca_busy;
+#endif
+
+/* Fires the timer of the MAC once its delay passed, also if the MAC stopped
+ * it (a late hardware event) */
+static void _fire(void)
+{
+    _hooks->now += _hooks->timer_ms * US_PER_MS;
+    _hooks->timer_armed = false;
+    gnrc_lorawan_timer_fired(&_mac);
+}
+
+/* The timer of the MAC is armed */
+static bool _armed(void)
+{
+#if CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+    /* The hardware timer follows the hourly timer of the wheel */
+    return gnrc_lorawan_wheel_armed(&_mac.timer);
+#else
+    return _hooks->timer_armed;
+#endif
+}
+
+static void _join(void)
+{
+    mlme_request_t req = { .type = MLME_JOIN };
+    mlme_confirm_t conf;
+
+    req.join.deveui = _deveui;
+    req.join.appeui = _appeui;
+    req.join.appkey = _appkey;
+    req.join.dr = 5;
+
+    gnrc_lorawan_mlme_request(&_mac, &req, &conf);
+    TEST_CHECK(conf.status == GNRC_LORAWAN_REQ_STATUS_DEFERRED);
+}
+
+static void _reset(void)
+{
+    mlme_request_t req = { .type = MLME_RESET };
+    mlme_confirm_t conf;
+
+    gnrc_lorawan_mlme_request(&_mac, &req, &conf);
+    TEST_CHECK(conf.status == GNRC_LORAWAN_REQ_STATUS_SUCCESS);
+}
+
+/* A reset during the random delay of a Join Request cancels the request */
+static void _test_reset_join(void)
+{
+    unsigned sends = _hooks->sends;
+
+    _join();
+    TEST_CHECK(_mac.state == LORAWAN_STATE_TX_WAIT && _mac.busy);
+    TEST_CHECK(_armed() && _hooks->timer_ms == TEST_JOIN_JITTER_MS);
+
+    _reset();
+    TEST_CHECK(_mac.state == LORAWAN_STATE_IDLE && !_mac.busy);
+    TEST_CHECK(!_armed());
+
+    _fire();
+    TEST_CHECK(_hooks->sends == sends);
+    TEST_CHECK(_mac.state == LORAWAN_STATE_IDLE && !_mac.busy);
+
+    /* The MAC takes the next Join Request */
+    _join();
+    _fire();
+    TEST_CHECK(_hooks->sends == sends + 1);
+    TEST_CHECK(_hooks->sent_len == sizeof(lorawan_join_request_t));
+    TEST_CHECK(_mac.state == LORAWAN_STATE_TX);
+
+    /* No Join Accept in both reception windows */
+    gnrc_lorawan_event_tx_complete(&_mac);
+    for (unsigned i = 0; i < 2; i++) {
+        _fire();
+        gnrc_lorawan_event_timeout(&_mac);
+    }
+    TEST_CHECK(_mac.state == LORAWAN_STATE_IDLE && !_mac.busy);
+    TEST_CHECK(_hooks->mlme_status == -ETIMEDOUT);
+    puts("mac,reset_join,done");
+}
+
+static void _set(mlme_mib_t *mib)
+{
+    mlme_request_t req = { .type = MLME_SET, .mib = *mib };
+    mlme_confirm_t conf;
+
+    gnrc_lorawan_mlme_request(&_mac, &req, &conf);
+    TEST_CHECK(conf.status == GNRC_LORAWAN_REQ_STATUS_SUCCESS);
+}
+
+static void _activate(uint8_t drain_policy)
+{
+    uint8_t dev_addr[LORAMAC_DEVADDR_LEN] = { 1, 2, 3, 4 };
+
+    _set(&(mlme_mib_t) { .type = MIB_DEV_ADDR, .dev_addr = dev_addr });
+    _set(&(mlme_mib_t) { .type = MIB_ACTIVATION_METHOD,
+                         .activation = MLME_ACTIVATION_ABP });
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    _set(&(mlme_mib_t) { .type = MIB_DRAIN_POLICY, .drain_policy = drain_policy });
+#else
+    (void) drain_policy;
+#endif
+}
+
+/* Sends an uplink, after the duty cycle of the last one if needed */
+static void _uplink(uint8_t dr)
+{
+    iolist_t io = { .iol_base = "mac", .iol_len = 3 };
+    mcps_request_t req = { .type = MCPS_UNCONFIRMED };
+    mcps_confirm_t conf;
+
+    req.data.pkt = &io;
+    req.data.port = 1;
+    req.data.dr = dr;
+    gnrc_lorawan_mcps_request(&_mac, &req, &conf);
+    TEST_CHECK(conf.status == GNRC_LORAWAN_REQ_STATUS_DEFERRED);
+    if (_mac.state == LORAWAN_STATE_TX_WAIT) {
+        _fire();
+    }
+    TEST_CHECK(_mac.state == LORAWAN_STATE_TX);
+}
+
+/* Ends the current uplink with an empty downlink in reception window
+ * `window` */
+static void _downlink(uint8_t mtype, unsigned window, const gnrc_lorawan_rx_info_t *info)
+{
+    /* The MIC of the default CMAC hook is all zeros */
+    uint8_t buf[sizeof(lorawan_hdr_t) + MIC_SIZE] = { 0 };
+    lorawan_hdr_t *hdr = (lorawan_hdr_t *) buf;
+
+    lorawan_hdr_set_mtype(hdr, mtype);
+    hdr->addr = _mac.dev_addr;
+    hdr->fcnt = byteorder_btols(byteorder_htons(_fcnt_down++));
+
+    gnrc_lorawan_event_tx_complete(&_mac);
+    _fire();
+    if (window == 2) {
+        gnrc_lorawan_event_timeout(&_mac);
+        _fire();
+    }
+    TEST_CHECK(_mac.state == (window == 2 ? LORAWAN_STATE_RX_2 : LORAWAN_STATE_RX_1));
+    gnrc_lorawan_process_pkt(&_mac, buf, sizeof(buf), info);
+}
+
+/* Answers a Join Request in RX1 with a Join Accept of `size` bytes. The
+ * buffer carries a CFList in both cases */
+static void _join_accept(size_t size)
+{
+    /* The MIC of the default CMAC hook is all zeros and AES is the
+     * identity, so the frame is sent in plain text */
+    uint8_t buf[GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE] = { MTYPE_JOIN_ACCEPT << 5 };
+    lorawan_join_accept_t *hdr = (lorawan_join_accept_t *) buf;
+    uint8_t *cflist = &buf[sizeof(lorawan_join_accept_t)];
+
+    hdr->dev_addr[0] = 1;
+    hdr->rx_delay = 1;
+    for (unsigned i = 0; i < TEST_CFLIST_CHANNELS; i++) {
+        uint32_t freq = (TEST_CFLIST_FREQ + i * 200000UL) / GNRC_LORAWAN_CHANNEL_STEP;
+        cflist[3 * i] = freq & 0xFF;
+        cflist[3 * i + 1] = (freq >> 8) & 0xFF;
+        cflist[3 * i + 2] = freq >> 16;
+    }
+
+    _join();
+    _fire();
+    gnrc_lorawan_event_tx_complete(&_mac);
+    _fire();
+    TEST_CHECK(_mac.state == LORAWAN_STATE_RX_1);
+
+    /* The MIC of a frame without CFList comes before the CFList */
+    memset(&buf[size - MIC_SIZE], 0, MIC_SIZE);
+    gnrc_lorawan_process_pkt(&_mac, buf, size, NULL);
+    TEST_CHECK(_hooks->mlme_status == GNRC_LORAWAN_REQ_STATUS_SUCCESS);
+    TEST_CHECK(_mac.mlme.activation == MLME_ACTIVATION_OTAA);
+}
+
+/* Only a Join Accept with the CFList adds channels */
+static void _test_join_accept_cflist(void)
+{
+    _join_accept(GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE - CFLIST_SIZE);
+    for (unsigned i = TEST_CFLIST_FIRST; i < TEST_CFLIST_FIRST + TEST_CFLIST_CHANNELS; i++) {
+        TEST_CHECK(gnrc_lorawan_channel_get(&_mac, i) == 0);
+    }
+
+    _set(&(mlme_mib_t) { .type = MIB_ACTIVATION_METHOD,
+                         .activation = MLME_ACTIVATION_NONE });
+    _join_accept(GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE);
+    for (unsigned i = TEST_CFLIST_FIRST; i < TEST_CFLIST_FIRST + TEST_CFLIST_CHANNELS; i++) {
+        uint32_t freq = TEST_CFLIST_FREQ +
+                        (i - TEST_CFLIST_FIRST) * 200000UL;
+        TEST_CHECK(gnrc_lorawan_channel_get(&_mac, i) == freq);
+    }
+    puts("mac,join_accept_cflist,done");
+}
+
+/* RX1 has to time out before RX2 opens one second later. At the slow
+ * datarates, the default symbol timeout is longer than that, and the RX2
+ * timer would open RX1 again instead of RX2 */
+static void _test_rx_timeout(void)
+{
+    const uint8_t datarates[] = { 0, 5 };
+
+    _activate(0);
+    for (unsigned i = 0; i < ARRAY_SIZE(datarates); i++) {
+        uint8_t dr = datarates[i];
+
+        _uplink(dr);
+        gnrc_lorawan_event_tx_complete(&_mac);
+        TEST_CHECK(_symbol_timeout <= CONFIG_GNRC_LORAWAN_MIN_SYMBOLS_TIMEOUT);
+        TEST_CHECK(_symbol_timeout * gnrc_lorawan_region_symbol_time(dr) < US_PER_SEC);
+        if (CONFIG_GNRC_LORAWAN_MIN_SYMBOLS_TIMEOUT * gnrc_lorawan_region_symbol_time(dr) <
+            US_PER_SEC) {
+            TEST_CHECK(_symbol_timeout == CONFIG_GNRC_LORAWAN_MIN_SYMBOLS_TIMEOUT);
+        }
+
+        /* RX2 has no deadline */
+        _fire();
+        gnrc_lorawan_event_timeout(&_mac);
+        TEST_CHECK(_mac.state == LORAWAN_STATE_RX_2);
+        TEST_CHECK(_symbol_timeout == CONFIG_GNRC_LORAWAN_MIN_SYMBOLS_TIMEOUT);
+        _fire();
+        gnrc_lorawan_event_timeout(&_mac);
+        TEST_CHECK(_mac.state == LORAWAN_STATE_IDLE && !_mac.busy);
+    }
+    puts("mac,rx_timeout,done");
+}
+
+#if CONFIG_GNRC_LORAWAN_LINK_QUALITY
+/* Downlinks without metadata of the radio don't change the link quality */
+static void _test_no_metadata(void)
+{
+    gnrc_lorawan_rx_info_t info = { .rssi = -80, .snr = 5 };
+
+    _activate(0);
+    _uplink(5);
+    _downlink(MTYPE_UNCNF_DOWNLINK, 1, NULL);
+    TEST_CHECK(_mac.state == LORAWAN_STATE_IDLE && !_mac.busy);
+    TEST_CHECK(gnrc_lorawan_link_get(&_mac, _mac.last_chan)->count == 0);
+
+    _uplink(5);
+    _downlink(MTYPE_UNCNF_DOWNLINK, 1, &info);
+    TEST_CHECK(gnrc_lorawan_link_get(&_mac, _mac.last_chan)->count == 1);
+    TEST_CHECK(gnrc_lorawan_link_get(&_mac, _mac.last_chan)->rssi == -80 * 16);
+    puts("mac,no_metadata,done");
+}
+#endif
+
+#if CONFIG_GNRC_LORAWAN_STATS && CONFIG_GNRC_LORAWAN_LINK_QUALITY
+/* Downlinks are accounted to the window they were received in, also if the
+ * uplink channel uses the frequency of RX2 */
+static void _test_rx_window(void)
+{
+    gnrc_lorawan_rx_info_t info = { .rssi = -100, .snr = -5 };
+    uint32_t rx1 = _mac.stats.rx1;
+    uint32_t rx2 = _mac.stats.rx2;
+
+    _activate(0);
+    _uplink(5);
+    uint8_t chan = _mac.last_chan;
+    uint32_t freq = gnrc_lorawan_channel_get(&_mac, chan);
+    gnrc_lorawan_channel_set(&_mac, chan, LORAMAC_DEFAULT_RX2_FREQ);
+    unsigned count = gnrc_lorawan_link_get(&_mac, chan)->count;
+
+    _downlink(MTYPE_UNCNF_DOWNLINK, 2, &info);
+    TEST_CHECK(_mac.stats.rx1 == rx1 && _mac.stats.rx2 == rx2 + 1);
+    TEST_CHECK(gnrc_lorawan_link_get(&_mac, chan)->count == count);
+    TEST_CHECK(gnrc_lorawan_link_get(&_mac, GNRC_LORAWAN_LINK_RX2)->count == 1);
+
+    gnrc_lorawan_channel_set(&_mac, chan, freq);
+    _uplink(5);
+    _downlink(MTYPE_UNCNF_DOWNLINK, 1, &info);
+    TEST_CHECK(_mac.stats.rx1 == rx1 + 1 && _mac.stats.rx2 == rx2 + 1);
+    puts("mac,rx_window,done");
+}
+#endif
+
+#if CONFIG_GNRC_LORAWAN_DRAIN && CONFIG_GNRC_LORAWAN_LBT
+/* The automatic uplink with the ACK of a confirmed downlink keeps the ACK if
+ * LBT gives it up */
+static void _test_drain_ack_lbt(void)
+{
+    gnrc_lorawan_rx_info_t info = { .rssi = -80, .snr = 5 };
+    unsigned sends = _hooks->sends;
+
+    _activate(GNRC_LORAWAN_DRAIN_ACK);
+    _uplink(5);
+    TEST_CHECK(_hooks->sends == ++sends);
+    _downlink(MTYPE_CNF_DOWNLINK, 1, &info);
+    TEST_CHECK(_mac.drain.active && _mac.state == LORAWAN_STATE_TX_WAIT);
+
+    /* All channels stay busy until LBT gives up */
+    _cca_busy = true;
+    for (unsigned i = 0; i <= CONFIG_GNRC_LORAWAN_LBT_DEFER_MAX; i++) {
+        TEST_CHECK(_mac.state == LORAWAN_STATE_TX_WAIT);
+        _fire();
+    }
+    TEST_CHECK(_hooks->sends == sends);
+    TEST_CHECK(_mac.drain.active && _mac.state == LORAWAN_STATE_TX_WAIT);
+    TEST_CHECK(_mac.drain.count == 2);
+
+    _cca_busy = false;
+    _fire();
+    TEST_CHECK(_hooks->sends == ++sends);
+    TEST_CHECK(lorawan_hdr_get_ack((lorawan_hdr_t *) _tx_buf));
+    gnrc_lorawan_event_tx_complete(&_mac);
+    TEST_CHECK(!_mac.mcps.ack_requested);
+
+    _reset();
+    TEST_CHECK(_mac.state == LORAWAN_STATE_IDLE && !_mac.busy);
+    puts("mac,drain_ack_lbt,done");
+}
+#endif
+
+int main(void)
+{
+    gnrc_lorawan_init(&_mac, _nwkskey, _appskey, _tx_buf);
+    /* First hourly tick of the port, it opens the Join Request budget */
+    gnrc_lorawan_mlme_backoff_expire(&_mac);
+
+    _test_reset_join();
+    _test_join_accept_cflist();
+    _test_rx_timeout();
+#if CONFIG_GNRC_LORAWAN_LINK_QUALITY
+    _test_no_metadata();
+#endif
+#if CONFIG_GNRC_LORAWAN_STATS && CONFIG_GNRC_LORAWAN_LINK_QUALITY
+    _test_rx_window();
+#endif
+#if CONFIG_GNRC_LORAWAN_DRAIN && CONFIG_GNRC_LORAWAN_LBT
+    _test_drain_ack_lbt();
+#endif
+
+    return test_gnrc_lorawan_result();
+}
+
+uint32_t gnrc_lorawan_random_get(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+    return TEST_JOIN_JITTER_MS * US_PER_MS;
+}
+
+void gnrc_lorawan_radio_set_rx_symbol_timeout(gnrc_lorawan_t *mac, uint16_t timeout)
+{
+    (void) mac;
+    _symbol_timeout = timeout;
+}
+
+#if CONFIG_GNRC_LORAWAN_LBT
+int gnrc_lorawan_radio_cca(gnrc_lorawan_t *mac)
+{
+    (void) mac;
+    return !_cca_busy;
+}
+#endif
+
+/** @} */
@@ -0,0 +1,1183 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @brief   Fleet scale scenarios on the simulated MAC
+ *
+ * Runs SIM_NODES MAC descriptors against the channel model and an emulated
+ * network server, one scenario after the other:
+ *
+ * - join_storm: all nodes power on within SIM_JOIN_WINDOW seconds and join
+ *   with OTAA, retrying with an exponential backoff. The Join Requests are
+ *   answered by @ref gnrc_lorawan_sim/js.h in batches of one second.
+ * - telemetry: ABP nodes send an unconfirmed uplink every
+ *   SIM_TELEMETRY_PERIOD seconds.
+ * - alarm: all ABP nodes send a confirmed uplink within SIM_ALARM_WINDOW
+ *   seconds.
+ * - fw_push: a SIM_FW_SIZE bytes image is sent to every ABP node with the
+ *   Fragmented Data Block Transport, one fragment per class A downlink. With
+ *   CONFIG_GNRC_LORAWAN_DRAIN the MAC fetches the fragments itself.
+ *
+ * Every KPI is printed as a CSV line "sim,<scenario>,<metric>,<value>", or
+ * as one JSON object per scenario with SIM_JSON=1.
+ *
+ * With SIM_THREADS > 1 the nodes are simulated in parallel by
+ * @ref gnrc_lorawan_sim/par.h. The callbacks of the nodes then run in
+ * several threads and only update their own node and the atomic KPIs.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xtimer.h"
+
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/frag.h"
+#include "gnrc_lorawan_internal.h"
+#include "gnrc_lorawan_sim/channel.h"
+#include "gnrc_lorawan_sim/crypto.h"
+#include "gnrc_lorawan_sim/dedup.h"
+#include "gnrc_lorawan_sim/js.h"
+#include "gnrc_lorawan_sim/net.h"
+#include "gnrc_lorawan_sim/par.h"
+#include "gnrc_lorawan_sim/sched.h"
+#include "net/lorawan/hdr.h"
+
+#ifndef SIM_NODES
+#define SIM_NODES               (1000U)
+#endif
+
+#ifndef SIM_GATEWAYS
+#define SIM_GATEWAYS            (1U)
+#endif
+
+#ifndef SIM_THREADS
+#define SIM_THREADS             (1U)
+#endif
+
+#ifndef SIM_SEED
+#define SIM_SEED                (1U)
+#endif
+
+#ifndef SIM_RADIUS
+#define SIM_RADIUS              (450)   /**< radius of the deployment in m */
+#endif
+
+#ifndef SIM_DR_MARGIN
+#define SIM_DR_MARGIN           (3)     /**< SNR margin of the datarate assignment in dB */
+#endif
+
+#ifndef SIM_PAYLOAD
+#define SIM_PAYLOAD             (12U)   /**< size of the application payloads */
+#endif
+
+#ifndef SIM_JOIN_WINDOW
+#define SIM_JOIN_WINDOW         (60U)   /**< power on window in s */
+#endif
+
+#ifndef SIM_JOIN_DURATION
+#define SIM_JOIN_DURATION       (4 * 3600U)
+#endif
+
+#ifndef SIM_CFLIST
+#define SIM_CFLIST              (0)     /**< send a CFList with five channels */
+#endif
+
+#ifndef SIM_RX1_DR_OFFSET
+#define SIM_RX1_DR_OFFSET       (0U)    /**< RX1DROffset of the joined nodes */
+#endif
+
+#ifndef SIM_TELEMETRY_PERIOD
+#define SIM_TELEMETRY_PERIOD    (600U)
+#endif
+
+#ifndef SIM_TELEMETRY_DURATION
+#define SIM_TELEMETRY_DURATION  (3 * 3600U)
+#endif
+
+#ifndef SIM_ALARM_WINDOW
+#define SIM_ALARM_WINDOW        (10U)
+#endif
+
+#ifndef SIM_ALARM_DURATION
+#define SIM_ALARM_DURATION      (3600U)
+#endif
+
+#ifndef SIM_FW_SIZE
+#define SIM_FW_SIZE             (1024U)
+#endif
+
+#ifndef SIM_FW_FRAG_SIZE
+#define SIM_FW_FRAG_SIZE        (32U)
+#endif
+
+#ifndef SIM_FW_POLL
+#define SIM_FW_POLL             (300U)  /**< poll period without pending data in s */
+#endif
+
+#ifndef SIM_FW_DURATION
+#define SIM_FW_DURATION         (12 * 3600U)
+#endif
+
+#ifndef SIM_JSON
+#define SIM_JSON                (0)
+#endif
+
+#define SIM_SLICE               (US_PER_SEC)    /**< granularity of the run loop and join batches */
+#define SIM_HOUR                (3600ULL * US_PER_SEC)
+#define SIM_TXS                 (SIM_NODES > 65536U ? (1U << 20) : (1U << 14))  /**< channel ring */
+#define SIM_EVENTS              (8U * SIM_NODES / SIM_THREADS + 1024U)   /**< per shard */
+#define SIM_DLS                 (64U * SIM_GATEWAYS)
+#define SIM_JS_PAGES            (4U * SIM_NODES)    /**< DevNonce bitmap pages */
+#define SIM_DEDUP_SHARDS        (4U * SIM_THREADS)
+#define SIM_DEDUP_SIZE          (2U * SIM_NODES / SIM_DEDUP_SHARDS + 64U)   /**< per shard */
+#define SIM_HIST_BUCKETS        (25U)
+#define SIM_PCT_BUCKETS         (16U + 28U * 16U)  /**< 1/16 octave buckets of 32 bit */
+#define SIM_TX_POWER            (14)
+#define SIM_DEV_ADDR_BASE       (0x26000000UL)
+#define SIM_APP_PORT            (2U)
+
+#define SIM_FW_NB_FRAG          ((SIM_FW_SIZE + SIM_FW_FRAG_SIZE - 1) / SIM_FW_FRAG_SIZE)
+#define SIM_FW_STORAGE          (SIM_FW_NB_FRAG * SIM_FW_FRAG_SIZE)
+#define SIM_FW_MAX_FRAGS        (2 * SIM_FW_NB_FRAG + 16)   /**< fragments sent per node */
+#define SIM_FW_DESCRIPTOR       (0x46570001UL)
+
+#define FRAG_CID_SESSION_SETUP  (0x02)
+#define FRAG_CID_DATA_FRAGMENT  (0x08)
+
+enum {
+    APP_JOIN,       /**< send a Join Request */
+    APP_SEND,       /**< send an application uplink */
+    APP_POLL,       /**< send a firmware answer or poll */
+};
+
+/* Node side application state */
+typedef struct {
+    uint64_t start;         /**< power on, request or transfer start */
+    uint32_t seq;           /**< sequence number of the last message */
+    uint32_t poll_gen;      /**< generation of the pending poll */
+    uint8_t deveui[LORAMAC_DEVEUI_LEN];
+    uint8_t appeui[LORAMAC_APPEUI_LEN];
+    uint8_t appkey[LORAMAC_APPKEY_LEN];
+    uint8_t nwkskey[LORAMAC_NWKSKEY_LEN];
+    uint8_t appskey[LORAMAC_APPSKEY_LEN];
+    uint8_t tx_buf[GNRC_LORAWAN_SIM_FRAME_MAX];
+    uint8_t attempts;       /**< join attempts */
+    uint8_t dr;             /**< datarate assigned from the path loss */
+    uint8_t delivered;      /**< last message reached the network server */
+    uint8_t done;           /**< scenario finished for this node */
+} _app_t;
+
+/* Network server state of a device */
+typedef struct {
+    uint8_t nwkskey[LORAMAC_NWKSKEY_LEN];
+    uint8_t appskey[LORAMAC_APPSKEY_LEN];
+    uint32_t fcnt_up;
+    uint32_t fcnt_down;
+    uint16_t fw_next;       /**< next fragment number, 0 before the session setup */
+    uint8_t dl_settings;    /**< DLSettings of the device */
+    uint8_t active;
+    uint8_t has_up;
+} _dev_t;
+
+typedef enum {
+    SCENARIO_JOIN_STORM,
+    SCENARIO_TELEMETRY,
+    SCENARIO_ALARM,
+    SCENARIO_FW_PUSH,
+} _scenario_id_t;
+
+typedef struct {
+    _scenario_id_t id;
+    const char *name;
+    uint32_t duration;      /**< maximum simulated time in s */
+    void (*start)(uint32_t i);
+    const char *latency;    /**< name of the latency metric */
+} _scenario_t;
+
+typedef struct {
+    uint32_t generated;
+    uint32_t delivered;
+    uint32_t acked;
+    uint32_t finished;
+    uint32_t frames;        /**< frames received by the network server */
+    uint32_t downlinks;
+    uint32_t dl_dropped;    /**< downlinks without a free gateway slot */
+    uint32_t link_checks;   /**< Link Check Answers received by the nodes */
+    uint32_t max;           /**< largest latency sample in ms */
+    uint32_t flush_max;     /**< longest join server flush in us */
+    uint32_t pct[SIM_PCT_BUCKETS];  /**< latency samples */
+} _kpi_t;
+
+static gnrc_lorawan_sim_channel_t _ch;
+static gnrc_lorawan_sim_radio_t _radios[SIM_GATEWAYS + SIM_NODES];
+static gnrc_lorawan_sim_tx_t _txs[SIM_TXS];
+static gnrc_lorawan_sim_net_t _net;
+static gnrc_lorawan_sim_par_t _par;
+static gnrc_lorawan_sim_node_t _nodes[SIM_NODES];
+static gnrc_lorawan_sim_event_t _events[SIM_EVENTS];
+static gnrc_lorawan_sim_dl_t _dls[SIM_DLS];
+static uint32_t _gws[SIM_GATEWAYS];
+
+static _app_t _app[SIM_NODES];
+static _dev_t _devs[SIM_NODES];
+static uint8_t _storage[SIM_NODES][SIM_FW_STORAGE];
+static uint8_t _image[SIM_FW_STORAGE];
+static _kpi_t _kpi;
+static const _scenario_t *_scenario;
+
+static gnrc_lorawan_t _ns_mac;   /* only passed to the crypto helpers */
+static gnrc_lorawan_sim_js_t _js;
+static gnrc_lorawan_sim_sched_t _sched;
+static gnrc_lorawan_sim_dedup_t _dedup;
+static gnrc_lorawan_sim_uplink_t _joins[SIM_NODES];    /* pending Join Requests */
+static uint32_t _rng;
+
+static uint32_t _random(void)
+{
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    return _rng;
+}
+
+/* Uses the generator of the node, so shards don't share state */
+static uint64_t _random_us(uint32_t i, uint32_t secs)
+{
+    gnrc_lorawan_t *mac = &_nodes[i].mac;
+    uint64_t r = (uint64_t) gnrc_lorawan_random_get(mac) << 32 | gnrc_lorawan_random_get(mac);
+
+    return r % ((uint64_t) secs * US_PER_SEC);
+}
+
+static inline uint32_t _index(gnrc_lorawan_t *mac)
+{
+    return gnrc_lorawan_sim_node(mac) - _nodes;
+}
+
+static inline uint64_t _now(uint32_t i)
+{
+    return _nodes[i].net->now;
+}
+
+static inline void _inc(uint32_t *counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+static void _schedule(uint32_t i, uint64_t time, uint64_t arg)
+{
+    gnrc_lorawan_sim_net_t *net = _nodes[i].net;
+
+    gnrc_lorawan_sim_net_schedule(net, &_nodes[i] - net->nodes, time, arg);
+}
+
+static void _key(uint8_t *key, uint32_t i, uint8_t salt)
+{
+    for (unsigned b = 0; b < 16; b++) {
+        key[b] = (i >> (8 * (b % 4))) ^ (uint8_t) ((salt * 16 + b) * 37);
+    }
+}
+
+/* Latencies are counted in buckets of 1/16 octave, so percentiles have a
+ * bounded error for any number of samples */
+static unsigned _pct_bucket(uint32_t ms)
+{
+    if (ms < 16) {
+        return ms;
+    }
+    unsigned e = 31 - __builtin_clz(ms);
+    return 16 + (e - 4) * 16 + ((ms >> (e - 4)) & 0xF);
+}
+
+static uint32_t _pct_lower(unsigned bucket)
+{
+    if (bucket < 16) {
+        return bucket;
+    }
+    unsigned e = (bucket - 16) / 16 + 4;
+    return (16 + (bucket - 16) % 16) << (e - 4);
+}
+
+static void _sample(uint64_t us)
+{
+    uint32_t ms = us / US_PER_MS;
+    uint32_t max = __atomic_load_n(&_kpi.max, __ATOMIC_RELAXED);
+
+    _inc(&_kpi.pct[_pct_bucket(ms)]);
+    while (ms > max && !__atomic_compare_exchange_n(&_kpi.max, &max, ms, true,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+/* Fastest datarate with SIM_DR_MARGIN dB of SNR at the closest gateway */
+static uint8_t _assign_dr(uint32_t radio)
+{
+    static const float snr_min[] = { -20.0f, -17.5f, -15.0f, -12.5f, -10.0f, -7.5f };
+    float noise = -174.0f + 10.0f * log10f(125000.0f) + _ch.noise_figure;
+    float snr = -INFINITY;
+
+    for (unsigned g = 0; g < SIM_GATEWAYS; g++) {
+        gnrc_lorawan_sim_tx_t tx = { .radio = _gws[g], .tx_power = SIM_TX_POWER };
+        float s = gnrc_lorawan_sim_channel_rssi(&_ch, &tx, radio) - noise;
+        snr = s > snr ? s : snr;
+    }
+
+    uint8_t dr = 0;
+    while (dr < 5 && snr >= snr_min[dr + 1] + SIM_DR_MARGIN) {
+        dr++;
+    }
+    return dr;
+}
+
+/* Row `n` (starting at 1) of the parity check matrix of TS004 */
+static int32_t _prbs23(int32_t x)
+{
+    int32_t b0 = x & 0x01;
+    int32_t b1 = (x & 0x20) >> 5;
+
+    return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+static void _coded_fragment(int32_t n, int32_t m, uint8_t *out)
+{
+    uint8_t row[(SIM_FW_NB_FRAG + 7) / 8] = { 0 };
+    int32_t mm = m + (((m & (m - 1)) == 0) ? 1 : 0);
+    int32_t x = 1 + (1001 * n);
+
+    for (int32_t nb_coeff = 0; nb_coeff < (m >> 1); nb_coeff++) {
+        int32_t r = 1 << 16;
+        while (r >= m) {
+            x = _prbs23(x);
+            r = x % mm;
+        }
+        row[r >> 3] |= 1 << (r & 7);
+    }
+
+    memset(out, 0, SIM_FW_FRAG_SIZE);
+    for (int32_t i = 0; i < m; i++) {
+        if (row[i >> 3] & (1 << (i & 7))) {
+            for (unsigned b = 0; b < SIM_FW_FRAG_SIZE; b++) {
+                out[b] ^= _image[i * SIM_FW_FRAG_SIZE + b];
+            }
+        }
+    }
+}
+
+/* Builds the firmware push payload for a device. Returns the size, or 0 if
+ * there is nothing left to send */
+static size_t _ns_fw_payload(_dev_t *dev, uint8_t *buf)
+{
+    if (dev->fw_next == 0) {
+        buf[0] = FRAG_CID_SESSION_SETUP;
+        buf[1] = 0;
+        buf[2] = SIM_FW_NB_FRAG & 0xFF;
+        buf[3] = SIM_FW_NB_FRAG >> 8;
+        buf[4] = SIM_FW_FRAG_SIZE;
+        buf[5] = 0;
+        buf[6] = SIM_FW_STORAGE - SIM_FW_SIZE;
+        for (unsigned b = 0; b < 4; b++) {
+            buf[7 + b] = SIM_FW_DESCRIPTOR >> (8 * b);
+        }
+        return 11;
+    }
+    if (dev->fw_next > SIM_FW_MAX_FRAGS) {
+        return 0;
+    }
+
+    uint16_t n = dev->fw_next;
+    buf[0] = FRAG_CID_DATA_FRAGMENT;
+    buf[1] = n & 0xFF;
+    buf[2] = (n >> 8) & 0x3F;
+    if (n <= SIM_FW_NB_FRAG) {
+        memcpy(buf + 3, &_image[(n - 1) * SIM_FW_FRAG_SIZE], SIM_FW_FRAG_SIZE);
+    }
+    else {
+        _coded_fragment(n - SIM_FW_NB_FRAG, SIM_FW_NB_FRAG, buf + 3);
+    }
+    return 3 + SIM_FW_FRAG_SIZE;
+}
+
+static int _downlink(uint32_t node, const gnrc_lorawan_sim_sched_tx_t *tx,
+                     const uint8_t *frame, size_t len)
+{
+    if (SIM_THREADS > 1) {
+        return gnrc_lorawan_sim_par_downlink(&_par, tx->gw, node, tx->start, tx->freq,
+                                             tx->sf, frame, len);
+    }
+    return gnrc_lorawan_sim_net_downlink(&_net, tx->gw, tx->start, tx->freq, tx->sf,
+                                         frame, len);
+}
+
+static inline uint64_t _ns_now(void)
+{
+    return SIM_THREADS > 1 ? _par.now : _net.now;
+}
+
+/* Sends a frame in the receive window and from the gateway chosen by the
+ * scheduler */
+static int _ns_send(const gnrc_lorawan_sim_uplink_t *up, uint8_t rx_delay,
+                    uint8_t dl_settings, const uint8_t *frame, size_t len)
+{
+    gnrc_lorawan_sim_sched_tx_t tx;
+    int res = gnrc_lorawan_sim_sched_pick(&_sched, up, rx_delay, dl_settings, len,
+                                          _ns_now(), &tx);
+
+    if (res == 0) {
+        res = _downlink(up->node, &tx, frame, len);
+    }
+    if (res < 0) {
+        _inc(&_kpi.dl_dropped);
+        return res;
+    }
+    _inc(&_kpi.downlinks);
+    return 0;
+}
+
+/* Queued until the end of the slice, see _ns_accept */
+static void _ns_join(const gnrc_lorawan_sim_uplink_t *up)
+{
+    uint64_t rx1 = up->end + LORAMAC_DEFAULT_JOIN_DELAY1 * US_PER_SEC;
+
+    _inc(&_kpi.frames);
+    if (gnrc_lorawan_sim_js_request(&_js, up->data, up->len, rx1, up->node) == 0) {
+        _joins[up->node] = *up;
+        _joins[up->node].data = NULL;
+    }
+}
+
+static void _ns_accept(gnrc_lorawan_sim_js_t *js, const gnrc_lorawan_sim_js_accept_t *acc)
+{
+    const gnrc_lorawan_sim_uplink_t *up = &_joins[acc->arg];
+    _dev_t *dev = &_devs[acc->dev];
+
+    if (_ns_send(up, LORAMAC_DEFAULT_JOIN_DELAY1, LORAMAC_DEFAULT_RX2_DR,
+                 acc->frame, acc->len) == 0) {
+        memcpy(dev->nwkskey, acc->nwkskey, sizeof(dev->nwkskey));
+        memcpy(dev->appskey, acc->appskey, sizeof(dev->appskey));
+        dev->fcnt_up = 0;
+        dev->fcnt_down = 0;
+        dev->has_up = false;
+        dev->active = true;
+        dev->dl_settings = js->dl_settings;
+        gnrc_lorawan_sim_sched_sent(&_sched, acc->dev);
+    }
+}
+
+static void _ns_data(uint32_t i, uint64_t end, uint8_t port, const uint8_t *payload,
+                     size_t len)
+{
+    _app_t *app = &_app[i];
+
+    if (port != SIM_APP_PORT || len < 4) {
+        return;
+    }
+
+    uint32_t seq = payload[0] | (payload[1] << 8) | (payload[2] << 16) |
+                   ((uint32_t) payload[3] << 24);
+    if (seq == app->seq && !app->delivered) {
+        app->delivered = true;
+        _inc(&_kpi.delivered);
+        _sample(end - app->start);
+    }
+}
+
+/* Answers the Link Check Requests in the FOpts of an uplink */
+static void _ns_mac_cmds(const gnrc_lorawan_sim_uplink_t *up, uint32_t i,
+                         const uint8_t *fopts, size_t len)
+{
+    for (size_t c = 0; c < len && fopts[c] == GNRC_LORAWAN_CID_LINK_CHECK_REQ_ANS; c++) {
+        /* Demodulation floor of SF7 to SF12 is -7.5 dB to -20 dB */
+        float margin = up->rx.snr + 7.5f + 2.5f * (up->sf - 7);
+        uint8_t ans[] = {
+            GNRC_LORAWAN_CID_LINK_CHECK_REQ_ANS,
+            margin > 0 ? (uint8_t) margin : 0,
+            up->gws,
+        };
+        gnrc_lorawan_sim_sched_mac_cmd(&_sched, i, ans, sizeof(ans));
+    }
+}
+
+static void _ns_uplink(gnrc_lorawan_sim_net_t *net, const gnrc_lorawan_sim_uplink_t *up)
+{
+    uint8_t buf[GNRC_LORAWAN_SIM_FRAME_MAX];
+    lorawan_hdr_t *hdr = (lorawan_hdr_t *) buf;
+    uint8_t mtype;
+    le_uint32_t mic;
+
+    (void) net;
+    memcpy(buf, up->data, up->len);
+    mtype = lorawan_hdr_get_mtype(hdr);
+
+    if (mtype == MTYPE_JOIN_REQUEST) {
+        _ns_join(up);
+        return;
+    }
+    if ((mtype != MTYPE_UNCNF_UPLINK && mtype != MTYPE_CNF_UPLINK) ||
+        up->len < sizeof(lorawan_hdr_t) + MIC_SIZE) {
+        return;
+    }
+
+    uint32_t i = (buf[1] | (buf[2] << 8) | (buf[3] << 16) | ((uint32_t) buf[4] << 24)) -
+                 SIM_DEV_ADDR_BASE;
+    if (i >= SIM_NODES || !_devs[i].active) {
+        return;
+    }
+
+    _dev_t *dev = &_devs[i];
+    uint32_t fcnt = (dev->fcnt_up & 0xFFFF0000) | buf[6] | (buf[7] << 8);
+    if (dev->has_up && fcnt < dev->fcnt_up) {
+        fcnt += 0x10000;
+    }
+
+    size_t len = up->len - MIC_SIZE;
+    gnrc_lorawan_calculate_mic(&_ns_mac, &hdr->addr, fcnt, GNRC_LORAWAN_DIR_UPLINK,
+                               buf, len, dev->nwkskey, &mic);
+    if (memcmp(&mic, buf + len, MIC_SIZE)) {
+        return;
+    }
+    _inc(&_kpi.frames);
+
+    /* Retransmissions of confirmed uplinks are only acknowledged again */
+    gnrc_lorawan_sim_sched_uplink(&_sched, i, mtype == MTYPE_CNF_UPLINK);
+    if (!dev->has_up || fcnt != dev->fcnt_up) {
+        size_t index = sizeof(lorawan_hdr_t) + lorawan_hdr_get_frame_opts_len(hdr);
+        dev->fcnt_up = fcnt;
+        dev->has_up = true;
+        _ns_mac_cmds(up, i, buf + sizeof(lorawan_hdr_t), index - sizeof(lorawan_hdr_t));
+        if (index < len) {
+            uint8_t port = buf[index++];
+            gnrc_lorawan_encrypt_payload(&_ns_mac, buf + index, len - index, &hdr->addr,
+                                         fcnt, GNRC_LORAWAN_DIR_UPLINK, dev->appskey);
+            _ns_data(i, up->end, port, buf + index, len - index);
+        }
+    }
+
+    /* Answer with the pending acknowledgement and MAC commands and the next
+     * firmware payload in one frame */
+    const gnrc_lorawan_sim_sched_dev_t *pending = gnrc_lorawan_sim_sched_pending(&_sched, i);
+    uint8_t payload[GNRC_LORAWAN_SIM_FRAME_MAX];
+    size_t payload_len = 0;
+    if (_scenario->id == SCENARIO_FW_PUSH) {
+        payload_len = _ns_fw_payload(dev, payload);
+    }
+    if (!pending->ack && !pending->fopts_len && !payload_len) {
+        return;
+    }
+
+    uint8_t frame[GNRC_LORAWAN_SIM_FRAME_MAX];
+    lorawan_hdr_t *dl = (lorawan_hdr_t *) frame;
+    size_t index = sizeof(lorawan_hdr_t);
+
+    dl->mt_maj = 0;
+    lorawan_hdr_set_mtype(dl, MTYPE_UNCNF_DOWNLINK);
+    lorawan_hdr_set_maj(dl, MAJOR_LRWAN_R1);
+    dl->addr = hdr->addr;
+    dl->fctrl = 0;
+    lorawan_hdr_set_ack(dl, pending->ack);
+    lorawan_hdr_set_frame_pending(dl, payload_len != 0);
+    lorawan_hdr_set_frame_opts_len(dl, pending->fopts_len);
+    dl->fcnt = byteorder_btols(byteorder_htons(dev->fcnt_down));
+    memcpy(frame + index, pending->fopts, pending->fopts_len);
+    index += pending->fopts_len;
+
+    if (payload_len) {
+        frame[index++] = GNRC_LORAWAN_FRAG_PORT;
+        memcpy(frame + index, payload, payload_len);
+        gnrc_lorawan_encrypt_payload(&_ns_mac, frame + index, payload_len, &dl->addr,
+                                     dev->fcnt_down, GNRC_LORAWAN_DIR_DOWNLINK,
+                                     dev->appskey);
+        index += payload_len;
+    }
+    gnrc_lorawan_calculate_mic(&_ns_mac, &dl->addr, dev->fcnt_down,
+                               GNRC_LORAWAN_DIR_DOWNLINK, frame, index, dev->nwkskey,
+                               (le_uint32_t *) (frame + index));
+
+    if (_ns_send(up, 1, dev->dl_settings, frame, index + MIC_SIZE) == 0) {
+        gnrc_lorawan_sim_sched_sent(&_sched, i);
+        dev->fcnt_down++;
+        if (payload_len) {
+            dev->fw_next++;
+        }
+    }
+}
+
+static int _send(uint32_t i, mcps_type_t type, uint8_t port, const uint8_t *payload,
+                 size_t len)
+{
+    iolist_t pkt = { .iol_base = (void *) payload, .iol_len = len };
+    mcps_request_t req = {
+        .type = type,
+        .data = { .pkt = &pkt, .port = port, .dr = _app[i].dr },
+    };
+    mcps_confirm_t conf;
+
+    gnrc_lorawan_mcps_request(&_nodes[i].mac, &req, &conf);
+    return conf.status;
+}
+
+static void _send_seq(uint32_t i, mcps_type_t type)
+{
+    _app_t *app = &_app[i];
+    uint8_t payload[SIM_PAYLOAD] = { 0 };
+
+    app->seq++;
+    app->start = _now(i);
+    app->delivered = false;
+    for (unsigned b = 0; b < 4; b++) {
+        payload[b] = app->seq >> (8 * b);
+    }
+    if (_send(i, type, SIM_APP_PORT, payload, sizeof(payload)) < 0 &&
+        type == MCPS_CONFIRMED) {
+        app->done = true;
+        _inc(&_kpi.finished);
+    }
+}
+
+static void _join(uint32_t i)
+{
+    _app_t *app = &_app[i];
+    uint8_t step = app->attempts / 2;
+    mlme_request_t req = {
+        .type = MLME_JOIN,
+        .join = {
+            .deveui = app->deveui, .appeui = app->appeui, .appkey = app->appkey,
+            .dr = app->dr > step ? app->dr - step : 0,
+        },
+    };
+    mlme_confirm_t conf;
+
+    gnrc_lorawan_mlme_request(&_nodes[i].mac, &req, &conf);
+    if (conf.status < 0) {
+        /* Busy or out of duty cycle budget until the next hourly tick */
+        _schedule(i, _now(i) + 60 * US_PER_SEC + _random_us(i, 60), APP_JOIN);
+    }
+}
+
+static void _poll(uint32_t i)
+{
+    _app_t *app = &_app[i];
+    gnrc_lorawan_t *mac = &_nodes[i].mac;
+    uint32_t wait = gnrc_lorawan_band_wait(mac);
+    uint8_t ans[GNRC_LORAWAN_FRAG_ANS_MAX];
+    int res;
+
+    if (app->done) {
+        return;
+    }
+    if (mac->busy || wait) {
+        _schedule(i, _now(i) + wait + US_PER_SEC, APP_POLL | (uint64_t) app->poll_gen << 8);
+        return;
+    }
+
+    if ((res = gnrc_lorawan_frag_get_answer(mac, ans, sizeof(ans))) > 0) {
+        _send(i, MCPS_UNCONFIRMED, GNRC_LORAWAN_FRAG_PORT, ans, res);
+    }
+    else {
+        _send(i, MCPS_UNCONFIRMED, SIM_APP_PORT, (const uint8_t *) "P", 1);
+    }
+
+    /* Keep polling if a downlink with the pending bit gets lost */
+    _schedule(i, _now(i) + SIM_FW_POLL * US_PER_SEC,
+              APP_POLL | (uint64_t) ++app->poll_gen << 8);
+}
+
+static void _app_event(gnrc_lorawan_sim_net_t *net, gnrc_lorawan_sim_node_t *node,
+                       uint64_t arg)
+{
+    uint32_t i = node - _nodes;
+
+    (void) net;
+    switch (arg & 0xFF) {
+        case APP_JOIN:
+            _join(i);
+            break;
+        case APP_SEND:
+            if (_scenario->id == SCENARIO_ALARM) {
+                /* The Link Check Answer shares the frame with the ACK */
+                mlme_request_t req = { .type = MLME_LINK_CHECK };
+                mlme_confirm_t conf;
+                gnrc_lorawan_mlme_request(&_nodes[i].mac, &req, &conf);
+                _send_seq(i, MCPS_CONFIRMED);
+                break;
+            }
+            _inc(&_kpi.generated);
+            _send_seq(i, MCPS_UNCONFIRMED);
+            _schedule(i, _now(i) + SIM_TELEMETRY_PERIOD * US_PER_SEC, APP_SEND);
+            break;
+        case APP_POLL:
+            if ((arg >> 8) == _app[i].poll_gen) {
+                _poll(i);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void _abp(uint32_t i)
+{
+    gnrc_lorawan_t *mac = &_nodes[i].mac;
+    le_uint32_t dev_addr = { .u32 = 0 };
+    mlme_request_t req = { .type = MLME_SET };
+    mlme_confirm_t conf;
+
+    for (unsigned b = 0; b < 4; b++) {
+        dev_addr.u8[b] = (SIM_DEV_ADDR_BASE + i) >> (8 * b);
+    }
+    _key(_app[i].nwkskey, i, 1);
+    _key(_app[i].appskey, i, 2);
+    memcpy(_devs[i].nwkskey, _app[i].nwkskey, LORAMAC_NWKSKEY_LEN);
+    memcpy(_devs[i].appskey, _app[i].appskey, LORAMAC_APPSKEY_LEN);
+    _devs[i].active = true;
+
+    req.mib.type = MIB_DEV_ADDR;
+    req.mib.dev_addr = &dev_addr;
+    gnrc_lorawan_mlme_request(mac, &req, &conf);
+    req.mib.type = MIB_ACTIVATION_METHOD;
+    req.mib.activation = MLME_ACTIVATION_ABP;
+    gnrc_lorawan_mlme_request(mac, &req, &conf);
+}
+
+static void _join_start(uint32_t i)
+{
+    _app[i].start = _random_us(i, SIM_JOIN_WINDOW);
+    _inc(&_kpi.generated);
+    _schedule(i, _app[i].start, APP_JOIN);
+}
+
+static void _telemetry_start(uint32_t i)
+{
+    _abp(i);
+    _schedule(i, _random_us(i, SIM_TELEMETRY_PERIOD), APP_SEND);
+}
+
+static void _alarm_start(uint32_t i)
+{
+    _abp(i);
+    _inc(&_kpi.generated);
+    _schedule(i, _random_us(i, SIM_ALARM_WINDOW), APP_SEND);
+}
+
+static void _fw_start(uint32_t i)
+{
+    _abp(i);
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    /* The MAC fetches the fragments while FPending is set */
+    mlme_request_t req = { .type = MLME_SET };
+    mlme_confirm_t conf;
+
+    req.mib.type = MIB_DRAIN_POLICY;
+    req.mib.drain_policy = GNRC_LORAWAN_DRAIN_FPENDING | GNRC_LORAWAN_DRAIN_ACK;
+    gnrc_lorawan_mlme_request(&_nodes[i].mac, &req, &conf);
+#endif
+    _app[i].start = _random_us(i, SIM_FW_POLL);
+    _inc(&_kpi.generated);
+    _schedule(i, _app[i].start, APP_POLL);
+}
+
+static const _scenario_t _scenarios[] = {
+    { SCENARIO_JOIN_STORM, "join_storm", SIM_JOIN_DURATION, _join_start, "join_time" },
+    { SCENARIO_TELEMETRY, "telemetry", SIM_TELEMETRY_DURATION, _telemetry_start, "latency" },
+    { SCENARIO_ALARM, "alarm", SIM_ALARM_DURATION, _alarm_start, "latency" },
+    { SCENARIO_FW_PUSH, "fw_push", SIM_FW_DURATION, _fw_start, "transfer_time" },
+};
+
+void gnrc_lorawan_mlme_confirm(gnrc_lorawan_t *mac, mlme_confirm_t *confirm)
+{
+    uint32_t i = _index(mac);
+    _app_t *app = &_app[i];
+
+    if (confirm->type == MLME_LINK_CHECK &&
+        confirm->status == GNRC_LORAWAN_REQ_STATUS_SUCCESS) {
+        _inc(&_kpi.link_checks);
+    }
+    if (confirm->type != MLME_JOIN) {
+        return;
+    }
+    if (confirm->status == GNRC_LORAWAN_REQ_STATUS_SUCCESS) {
+        app->done = true;
+        _inc(&_kpi.delivered);
+        _inc(&_kpi.finished);
+        _sample(_now(i) - app->start);
+        return;
+    }
+
+    /* Exponential backoff between 8 s and about 8 minutes */
+    uint32_t backoff = 8U << (app->attempts < 6 ? app->attempts : 6);
+    app->attempts++;
+    _schedule(i, _now(i) + _random_us(i, backoff) + (uint64_t) backoff * US_PER_SEC / 2,
+              APP_JOIN);
+}
+
+void gnrc_lorawan_mcps_confirm(gnrc_lorawan_t *mac, mcps_confirm_t *confirm)
+{
+    _app_t *app = &_app[_index(mac)];
+
+    if (confirm->type == MCPS_CONFIRMED && !app->done) {
+        app->done = true;
+        _inc(&_kpi.finished);
+        if (confirm->status == GNRC_LORAWAN_REQ_STATUS_SUCCESS) {
+            _inc(&_kpi.acked);
+        }
+    }
+}
+
+void gnrc_lorawan_mlme_indication(gnrc_lorawan_t *mac, mlme_indication_t *ind)
+{
+    uint32_t i = _index(mac);
+
+    if (ind->type == MLME_SCHEDULE_UPLINK && !_app[i].done) {
+        _schedule(i, _now(i) + US_PER_MS, APP_POLL | (uint64_t) ++_app[i].poll_gen << 8);
+    }
+}
+
+void gnrc_lorawan_mcps_indication(gnrc_lorawan_t *mac, mcps_indication_t *ind)
+{
+    (void) mac;
+    (void) ind;
+}
+
+int gnrc_lorawan_frag_write(gnrc_lorawan_t *mac, uint32_t offset,
+                            const uint8_t *buf, size_t len)
+{
+    if (offset + len > SIM_FW_STORAGE) {
+        return -ENOSPC;
+    }
+    memcpy(&_storage[_index(mac)][offset], buf, len);
+    return 0;
+}
+
+int gnrc_lorawan_frag_read(gnrc_lorawan_t *mac, uint32_t offset,
+                           uint8_t *buf, size_t len)
+{
+    if (offset + len > SIM_FW_STORAGE) {
+        return -ENOSPC;
+    }
+    memcpy(buf, &_storage[_index(mac)][offset], len);
+    return 0;
+}
+
+void gnrc_lorawan_frag_done(gnrc_lorawan_t *mac, uint32_t size, uint32_t descriptor)
+{
+    uint32_t i = _index(mac);
+    _app_t *app = &_app[i];
+
+    if (app->done) {
+        return;
+    }
+    app->done = true;
+    _inc(&_kpi.finished);
+#if CONFIG_GNRC_LORAWAN_DRAIN
+    /* Don't fetch the remaining coded fragments */
+    mlme_request_t req = { .type = MLME_SET };
+    mlme_confirm_t conf;
+
+    req.mib.type = MIB_DRAIN_POLICY;
+    req.mib.drain_policy = 0;
+    gnrc_lorawan_mlme_request(mac, &req, &conf);
+#endif
+    if (descriptor == SIM_FW_DESCRIPTOR && size == SIM_FW_SIZE &&
+        !memcmp(_storage[i], _image, SIM_FW_SIZE)) {
+        _inc(&_kpi.delivered);
+        _sample(_now(i) - app->start);
+    }
+}
+
+static void _setup(const _scenario_t *sc)
+{
+    _rng = SIM_SEED * 2654435761U + 1;
+    memset(&_kpi, 0, sizeof(_kpi));
+    memset(_app, 0, sizeof(_app));
+    memset(_devs, 0, sizeof(_devs));
+    if (sc->id == SCENARIO_FW_PUSH) {
+        memset(_storage, 0, sizeof(_storage));
+    }
+    _scenario = sc;
+
+    if (gnrc_lorawan_sim_js_init(&_js, SIM_NODES, SIM_JS_PAGES, SIM_NODES,
+                                 LORAMAC_DEFAULT_NETID, SIM_DEV_ADDR_BASE) < 0) {
+        puts("sim: can't allocate the join server");
+        exit(1);
+    }
+    _js.accept = _ns_accept;
+    _js.dl_settings = SIM_RX1_DR_OFFSET << 4 | LORAMAC_DEFAULT_RX2_DR;
+    if (gnrc_lorawan_sim_sched_init(&_sched, _gws, SIM_GATEWAYS, SIM_NODES) < 0) {
+        puts("sim: can't allocate the downlink scheduler");
+        exit(1);
+    }
+    if (gnrc_lorawan_sim_dedup_init(&_dedup, SIM_DEDUP_SIZE, SIM_DEDUP_SHARDS) < 0) {
+        puts("sim: can't allocate the deduplication stage");
+        exit(1);
+    }
+    if (SIM_CFLIST) {
+        for (unsigned c = 0; c < GNRC_LORAWAN_SIM_JS_CFLIST_MAX; c++) {
+            _js.cflist[c] = 867100000UL + c * 200000UL;
+        }
+        _js.cflist_numof = GNRC_LORAWAN_SIM_JS_CFLIST_MAX;
+    }
+
+    for (unsigned g = 0; g < SIM_GATEWAYS; g++) {
+        float angle = 2.0f * (float) M_PI * g / SIM_GATEWAYS;
+        float r = SIM_GATEWAYS > 1 ? SIM_RADIUS / 2.0f : 0.0f;
+        _radios[g] = (gnrc_lorawan_sim_radio_t) {
+            .x = r * cosf(angle), .y = r * sinf(angle), .tx_power = SIM_TX_POWER
+        };
+        _gws[g] = g;
+    }
+    for (unsigned i = 0; i < SIM_NODES; i++) {
+        /* Uniform in the disc */
+        float r = SIM_RADIUS * sqrtf((_random() & 0xFFFF) / 65536.0f);
+        float angle = 2.0f * (float) M_PI * (_random() & 0xFFFF) / 65536.0f;
+        _radios[SIM_GATEWAYS + i] = (gnrc_lorawan_sim_radio_t) {
+            .x = r * cosf(angle), .y = r * sinf(angle), .tx_power = SIM_TX_POWER
+        };
+        _nodes[i].radio = SIM_GATEWAYS + i;
+    }
+
+    gnrc_lorawan_sim_channel_init(&_ch, _radios, SIM_GATEWAYS + SIM_NODES,
+                                  _txs, SIM_TXS);
+    if (SIM_THREADS > 1) {
+        if (gnrc_lorawan_sim_par_init(&_par, &_ch, _nodes, SIM_NODES, _gws, SIM_GATEWAYS,
+                                      SIM_THREADS, SIM_EVENTS, SIM_DLS, SIM_SEED) < 0) {
+            puts("sim: can't start the parallel simulation");
+            exit(1);
+        }
+        _par.uplink = _ns_uplink;
+        _par.app = _app_event;
+        _par.dedup = &_dedup;
+    }
+    else {
+        gnrc_lorawan_sim_net_init(&_net, &_ch, _nodes, SIM_NODES, _gws, SIM_GATEWAYS,
+                                  _events, SIM_EVENTS, _dls, SIM_DLS, SIM_SEED);
+        _net.uplink = _ns_uplink;
+        _net.app = _app_event;
+        _net.dedup = &_dedup;
+    }
+
+    for (unsigned i = 0; i < SIM_NODES; i++) {
+        _app_t *app = &_app[i];
+        for (unsigned b = 0; b < 4; b++) {
+            app->deveui[b] = i >> (8 * b);
+        }
+        _key(app->appkey, i, 0);
+        gnrc_lorawan_sim_js_add(&_js, app->deveui, app->appeui, app->appkey);
+        app->dr = _assign_dr(_nodes[i].radio);
+
+        gnrc_lorawan_init(&_nodes[i].mac, app->nwkskey, app->appskey, app->tx_buf);
+#if !CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+        gnrc_lorawan_mlme_backoff_expire(&_nodes[i].mac);
+#endif
+        sc->start(i);
+    }
+}
+
+static int _done(void)
+{
+    /* Telemetry runs for the whole duration */
+    return _scenario->id != SCENARIO_TELEMETRY && _kpi.finished == _kpi.generated;
+}
+
+static uint32_t _percentile(unsigned p)
+{
+    uint64_t total = 0;
+    uint64_t rank;
+
+    for (unsigned b = 0; b < SIM_PCT_BUCKETS; b++) {
+        total += _kpi.pct[b];
+    }
+    if (!total || p >= 100) {
+        return _kpi.max;
+    }
+
+    rank = (total * p + 99) / 100;
+    for (unsigned b = 0; b < SIM_PCT_BUCKETS; b++) {
+        if (rank <= _kpi.pct[b]) {
+            return _pct_lower(b);
+        }
+        rank -= _kpi.pct[b];
+    }
+    return _kpi.max;
+}
+
+static void _begin(const char *scenario)
+{
+    if (SIM_JSON) {
+        printf("{\"scenario\":\"%s\"", scenario);
+    }
+}
+
+static void _metric(const char *scenario, const char *name, const char *suffix,
+                    double value)
+{
+    char key[48];
+
+    snprintf(key, sizeof(key), "%s%s", name, suffix);
+    if (SIM_JSON) {
+        printf(",\"%s\":%.6g", key, value);
+    }
+    else {
+        printf("sim,%s,%s,%.6g\n", scenario, key, value);
+    }
+}
+
+static void _hist(const char *scenario, const char *name)
+{
+    uint32_t hist[SIM_HIST_BUCKETS] = { 0 };
+
+    for (unsigned b = 0; b < SIM_PCT_BUCKETS; b++) {
+        uint32_t ms = _pct_lower(b);
+        unsigned bucket = ms ? 32 - __builtin_clz(ms) : 0;
+        hist[bucket < SIM_HIST_BUCKETS ? bucket : SIM_HIST_BUCKETS - 1] += _kpi.pct[b];
+    }
+
+    if (SIM_JSON) {
+        printf(",\"%s_hist_ms\":{", name);
+    }
+    for (unsigned b = 0; b < SIM_HIST_BUCKETS; b++) {
+        if (SIM_JSON) {
+            printf("%s\"%lu\":%lu", b ? "," : "", 1UL << b, (unsigned long) hist[b]);
+        }
+        else {
+            printf("sim,%s,%s_hist_le_%lums,%lu\n", scenario, name, 1UL << b,
+                   (unsigned long) hist[b]);
+        }
+    }
+    if (SIM_JSON) {
+        printf("}");
+    }
+}
+
+static void _report(const _scenario_t *sc, uint64_t now, uint64_t processed, uint32_t lost,
+                    uint64_t wall_us)
+{
+    const char *name = sc->name;
+    uint64_t airtime = 0;
+    uint64_t airtime_max = 0;
+    uint64_t frames = 0;
+
+    for (unsigned i = 0; i < SIM_NODES; i++) {
+        airtime += _nodes[i].airtime;
+        frames += _nodes[i].tx_count;
+        if (_nodes[i].airtime > airtime_max) {
+            airtime_max = _nodes[i].airtime;
+        }
+    }
+
+    _begin(name);
+    _metric(name, "nodes", "", SIM_NODES);
+    _metric(name, "gateways", "", SIM_GATEWAYS);
+    _metric(name, "threads", "", SIM_THREADS);
+    _metric(name, "sim_time_s", "", (double) now / US_PER_SEC);
+    _metric(name, "generated", "", _kpi.generated);
+    _metric(name, "delivered", "", _kpi.delivered);
+    _metric(name, "pdr", "", _kpi.generated ?
+            (double) _kpi.delivered / _kpi.generated : 0.0);
+    if (sc->id == SCENARIO_ALARM) {
+        _metric(name, "ack_ratio", "", _kpi.generated ?
+                (double) _kpi.acked / _kpi.generated : 0.0);
+        _metric(name, "link_checks", "", _kpi.link_checks);
+    }
+    if (sc->id == SCENARIO_JOIN_STORM) {
+        _metric(name, "join_accepts", "", _js.stats.accepted);
+        _metric(name, "join_accepts_late", "", _js.stats.late);
+        _metric(name, "join_replays", "", _js.stats.replays);
+        _metric(name, "join_batch_max", "", _js.stats.batch_max);
+        _metric(name, "join_flush_max_us", "", _kpi.flush_max);
+    }
+    _metric(name, "uplink_frames", "", frames);
+    _metric(name, "frame_pdr", "", frames ? (double) _kpi.frames / frames : 0.0);
+    _metric(name, "uplink_copies", "", _dedup.stats.copies);
+    _metric(name, "uplink_duplicates", "", _dedup.stats.duplicates);
+    _metric(name, "uplink_copies_late", "", _dedup.stats.late);
+    _metric(name, "uplink_copies_dropped", "", _dedup.stats.dropped);
+    _metric(name, "downlinks", "", _kpi.downlinks);
+    _metric(name, "downlinks_dropped", "", _kpi.dl_dropped);
+    _metric(name, "downlinks_rx1", "", _sched.stats.rx1);
+    _metric(name, "downlinks_rx2", "", _sched.stats.rx2);
+    _metric(name, "downlinks_gw_busy", "", _sched.stats.busy);
+    _metric(name, "downlinks_missed", "", _sched.stats.missed);
+    _metric(name, "gw_duty_cycle_skips", "", _sched.stats.duty_cycle);
+    _metric(name, "downlinks_merged", "", _sched.stats.merged);
+    _metric(name, sc->latency, "_p50_ms", _percentile(50));
+    _metric(name, sc->latency, "_p90_ms", _percentile(90));
+    _metric(name, sc->latency, "_p99_ms", _percentile(99));
+    _metric(name, sc->latency, "_max_ms", _percentile(100));
+    _metric(name, "airtime_mean_ms", "", (double) airtime / SIM_NODES / US_PER_MS);
+    _metric(name, "airtime_max_ms", "", (double) airtime_max / US_PER_MS);
+    _metric(name, "events", "", processed);
+    _metric(name, "events_lost", "", lost);
+    _metric(name, "events_per_sec", "", wall_us ?
+            (double) processed * US_PER_SEC / wall_us : 0.0);
+    _hist(name, sc->latency);
+    if (SIM_JSON) {
+        printf("}\n");
+    }
+}
+
+int main(void)
+{
+    for (unsigned i = 0; i < SIM_FW_STORAGE; i++) {
+        _image[i] = i < SIM_FW_SIZE ? (uint8_t) (i * 31 + 7) : 0;
+    }
+    /* Before gnrc_lorawan_sim_par_init() starts the worker threads */
+    gnrc_lorawan_sim_crypto_select(GNRC_LORAWAN_SIM_CRYPTO_AUTO);
+
+    for (unsigned s = 0; s < sizeof(_scenarios) / sizeof(_scenarios[0]); s++) {
+        const _scenario_t *sc = &_scenarios[s];
+        uint64_t end = (uint64_t) sc->duration * US_PER_SEC;
+        uint64_t processed = 0;
+        uint64_t t = 0;
+
+        _setup(sc);
+        uint64_t start = xtimer_now_usec64();
+        while (t < end && !_done()) {
+            t += SIM_SLICE;
+            if (SIM_THREADS > 1) {
+                processed += gnrc_lorawan_sim_par_run(&_par, t);
+            }
+            else {
+                processed += gnrc_lorawan_sim_net_run(&_net, t);
+            }
+            uint64_t flush = xtimer_now_usec64();
+            gnrc_lorawan_sim_js_flush(&_js, t);
+            flush = xtimer_now_usec64() - flush;
+            if (flush > _kpi.flush_max) {
+                _kpi.flush_max = flush;
+            }
+#if !CONFIG_GNRC_LORAWAN_TIMER_WHEEL
+            if (t % SIM_HOUR == 0) {
+                for (unsigned i = 0; i < SIM_NODES; i++) {
+                    gnrc_lorawan_mlme_backoff_expire(&_nodes[i].mac);
+                }
+            }
+#endif
+        }
+        uint64_t wall = xtimer_now_usec64() - start;
+
+        if (SIM_THREADS > 1) {
+            _report(sc, t, processed, gnrc_lorawan_sim_par_lost(&_par), wall);
+            gnrc_lorawan_sim_par_free(&_par);
+        }
+        else {
+            _report(sc, t, processed, _net.lost, wall);
+        }
+        gnrc_lorawan_sim_js_free(&_js);
+        gnrc_lorawan_sim_sched_free(&_sched);
+        gnrc_lorawan_sim_dedup_free(&_dedup);
+    }
+
+    return 0;
+}
+
+/** @} */
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2019 HAW Hamburg
+ *
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @{
+ *
+ * @file
+ * @brief   Tests for the GNRC LoRaWAN timer wheel
+ *
+ * The test drives the clock and the timer of the default hooks
+ * (test_gnrc_lorawan.h), so it covers days of MAC time in a few
+ * milliseconds. Every timer must fire exactly once at its deadline: after
+ * cascading through all levels, around the wrap of the microsecond timestamp
+ * and of the millisecond clock of the wheel, and when timers are cancelled or
+ * moved.
+ *
+ * @author  José Ignacio Alamos <jose.alamos@haw-hamburg.de>
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel_defines.h"
+#include "timex.h"
+
+#include "gnrc_lorawan/lorawan.h"
+#include "gnrc_lorawan/wheel.h"
+#include "gnrc_lorawan_internal.h"
+#include "test_gnrc_lorawan.h"
+
+#define TEST_TIMERS     (16U)           /**< timers of the application */
+#define TEST_HOUR       (3600UL * MS_PER_SEC)
+
+/* Start close to the wrap of the microsecond timestamp */
+#define TEST_NOW_START  (UINT32_MAX - 2 * US_PER_SEC)
+
+typedef struct {
+    gnrc_lorawan_timer_t timer;
+    uint64_t deadline;          /**< expected expiry in ms since the start */
+    uint64_t fired_at;          /**< last expiry in ms since the start */
+    unsigned fired;             /**< number of expiries */
+    unsigned period;            /**< re-arm from the callback if not 0 */
+    unsigned rounds;            /**< remaining re-arms */
+    gnrc_lorawan_timer_t *cancel;   /**< timer to cancel from the callback */
+} _test_timer_t;
+
+static gnrc_lorawan_t _mac;
+static uint8_t _nwkskey[LORAMAC_NWKSKEY_LEN];
+static uint8_t _appskey[LORAMAC_APPSKEY_LEN];
+static uint8_t _tx_buf[GNRC_LORAWAN_JOIN_ACCEPT_MAX_SIZE];
+static _test_timer_t _timers[TEST_TIMERS];
+static test_gnrc_lorawan_hooks_t *_hooks = &test_gnrc_lorawan_hooks;
+static uint64_t _elapsed;       /* ms since the start of the test */
+
+/* Moves the time forward, firing the hardware timer on the way */
+static void _advance(uint32_t ms)
+{
+    for (;;) {
+        if (_hooks->timer_armed && _hooks->timer_ms == 0) {
+            _hooks->timer_armed = false;
+            gnrc_lorawan_timer_fired(&_mac);
+            continue;
+        }
+        if (!ms) {
+            break;
+        }
+
+        /* The hourly timer is always armed, so a step is never longer
+         * than the wrap period of the microsecond timestamp */
+        uint32_t step = ms;
+        if (_hooks->timer_armed && _hooks->timer_ms < ms) {
+            step = _hooks->timer_ms;
+        }
+        _hooks->now += step * US_PER_MS;
+        _elapsed += step;
+        ms -= step;
+        if (_hooks->timer_armed) {
+            _hooks->timer_ms -= step;
+        }
+    }
+}
+
+static void _expire(gnrc_lorawan_timer_t *timer)
+{
+    _test_timer_t *t = timer->arg;
+
+    t->fired_at = _elapsed;
+    t->fired++;
+    if (t->cancel) {
+        gnrc_lorawan_wheel_cancel(&_mac, t->cancel);
+    }
+    if (t->rounds) {
+        t->rounds--;
+        t->deadline += t->period;
+        gnrc_lorawan_wheel_set(&_mac, timer, t->period);
+    }
+}
+
+static _test_timer_t *_arm(unsigned i, uint32_t ms)
+{
+    _test_timer_t *t = &_timers[i];
+
+    memset(t, 0, sizeof(*t));
+    gnrc_lorawan_wheel_timer_init(&t->timer, _expire, t);
+    t->deadline = _elapsed + ms;
+    gnrc_lorawan_wheel_set(&_mac, &t->timer, ms);
+    return t;
+}
+
+static void _check_fired(unsigned numof)
+{
+    for (unsigned i = 0; i < numof; i++) {
+        TEST_CHECK(_timers[i].fired == 1);
+        TEST_CHECK(_timers[i].fired_at == _timers[i].deadline);
+        TEST_CHECK(!gnrc_lorawan_wheel_armed(&_timers[i].timer));
+    }
+}
+
+/* Delays around the slot boundaries of every level */
+static void _test_cascade(void)
+{
+    const uint32_t delays[] = {
+        0, 1, 15, 16, 17, 255, 256, 257, 4095, 4096, 65535, 65536,
+        1048575, 1048576, 1048577, GNRC_LORAWAN_WHEEL_DELAY_MAX
+    };
+    uint32_t ms;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(delays); i++) {
+        _arm(i, delays[i]);
+    }
+    TEST_CHECK(gnrc_lorawan_wheel_next(&_mac, &ms) == 0 && ms == 0);
+
+    _advance(GNRC_LORAWAN_WHEEL_DELAY_MAX + 1);
+    _check_fired(ARRAY_SIZE(delays));
+
+    /* A timer one rotation ahead shares the current slot of level 1 with the
+     * clock, so the timer of the next slot expires first */
+    _advance((266 - (_elapsed & 0xff)) & 0xff);
+    _arm(0, 250);
+    _arm(1, 20);
+    TEST_CHECK(gnrc_lorawan_wheel_next(&_mac, &ms) == 0 && ms == 20);
+    _advance(300);
+    _check_fired(2);
+    puts("wheel,cascade,done");
+}
+
+static void _test_cancel(void)
+{
+    uint32_t ms;
+
+    _test_timer_t *a = _arm(0, 100);
+    _test_timer_t *b = _arm(1, 200);
+    _test_timer_t *c = _arm(2, 70000);
+
+    /* Cancel twice, move an armed timer and re-arm a cancelled one */
+    gnrc_lorawan_wheel_cancel(&_mac, &a->timer);
+    gnrc_lorawan_wheel_cancel(&_mac, &a->timer);
+    gnrc_lorawan_wheel_cancel(&_mac, &c->timer);
+    gnrc_lorawan_wheel_set(&_mac, &b->timer, 50);
+    b->deadline = _elapsed + 50;
+    gnrc_lorawan_wheel_set(&_mac, &a->timer, 300);
+    a->deadline = _elapsed + 300;
+    TEST_CHECK(!gnrc_lorawan_wheel_armed(&c->timer));
+    TEST_CHECK(gnrc_lorawan_wheel_next(&_mac, &ms) == 0 && ms == 50);
+    TEST_CHECK(_hooks->timer_armed && _hooks->timer_ms == 50);
+
+    /* Cancel a timer after it was cascaded to the lowest level */
+    _test_timer_t *d = _arm(3, 5000);
+    _advance(400);
+    TEST_CHECK(a->fired == 1 && a->fired_at == a->deadline);
+    TEST_CHECK(b->fired == 1 && b->fired_at == b->deadline);
+    _advance(4590);
+    _test_timer_t *e = _arm(4, 1);
+    gnrc_lorawan_wheel_cancel(&_mac, &d->timer);
+    _advance(TEST_HOUR);
+    TEST_CHECK(e->fired == 1 && e->fired_at == e->deadline);
+    TEST_CHECK(c->fired == 0 && d->fired == 0);
+
+    /* Without application timers, the hardware timer follows the hourly
+     * timer */
+    _arm(5, 10);
+    gnrc_lorawan_wheel_cancel(&_mac, &_timers[5].timer);
+    TEST_CHECK(gnrc_lorawan_wheel_next(&_mac, &ms) == 0);
+    TEST_CHECK(_hooks->timer_armed && _hooks->timer_ms == ms);
+    TEST_CHECK(ms <= TEST_HOUR);
+    puts("wheel,cancel,done");
+}
+
+static void _test_rearm(void)
+{
+    /* A periodic timer re-armed from its callback */
+    _test_timer_t *p = _arm(0, 1000);
+    p->period = 1000;
+    p->rounds = 9;
+
+    /* Two timers of the same slot cancel each other */
+    _test_timer_t *x = _arm(1, 500);
+    _test_timer_t *y = _arm(2, 500);
+    x->cancel = &y->timer;
+    y->cancel = &x->timer;
+
+    _advance(20000);
+    TEST_CHECK(p->fired == 10 && p->fired_at == p->deadline);
+    TEST_CHECK(p->deadline == x->deadline + 9500);
+    TEST_CHECK(x->fired + y->fired == 1);
+    puts("wheel,rearm,done");
+}
+
+/* Millisecond clock of the wheel, brought up to date */
+static uint32_t _clock(void)
+{
+    uint32_t ms;
+
+    gnrc_lorawan_wheel_next(&_mac, &ms);
+    return _mac.wheel.clock;
+}
+
+/* Runs the wheel across the wrap of its millisecond clock */
+static void _test_wrap(void)
+{
+    const uint32_t delays[] = {
+        50, 99, 100, 101, 5000, 70000, 1048576, GNRC_LORAWAN_WHEEL_DELAY_MAX
+    };
+
+    while (_clock() < UINT32_MAX - 2 * TEST_HOUR) {
+        _advance(TEST_HOUR);
+    }
+    _advance(UINT32_MAX - _clock() - 99);
+    TEST_CHECK(_clock() == UINT32_MAX - 99);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(delays); i++) {
+        _arm(i, delays[i]);
+    }
+    _advance(GNRC_LORAWAN_WHEEL_DELAY_MAX + 1);
+    TEST_CHECK(_clock() < GNRC_LORAWAN_WHEEL_DELAY_MAX);
+    _check_fired(ARRAY_SIZE(delays));
+    printf("wheel,wrap,done,%lu\n", (unsigned long)(_elapsed / TEST_HOUR));
+}
+
+int main(void)
+{
+    _hooks->now = TEST_NOW_START;
+    gnrc_lorawan_init(&_mac, _nwkskey, _appskey, _tx_buf);
+
+    _test_cascade();
+    _test_cancel();
+    _test_rearm();
+    _test_wrap();
+
+    return test_gnrc_lorawan_result();
+}
+
+/** @} */